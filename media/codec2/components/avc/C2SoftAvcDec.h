@@ -139,6 +139,7 @@ private:
     status_t resetDecoder();
     void resetPlugin();
     status_t deleteDecoder();
+    void updateProcessingTime(uint32_t decodeTimeUs);
 
     std::shared_ptr<IntfImpl> mIntf;
 
@@ -186,6 +187,11 @@ private:
     // profile
     struct timeval mTimeStart;
     struct timeval mTimeEnd;
+    // decode time statistics reported through C2ComponentProcessingTimeInfo
+    uint64_t mDecodeCount;
+    uint64_t mDecodeTimeTotalUs;
+    uint32_t mDecodeTimeMaxUs;
+    uint64_t mDecodeCountReported;  // mDecodeCount when the statistics were last published
 #ifdef FILE_DUMP_ENABLE
     char mInFile[200];
 #endif /* FILE_DUMP_ENABLE */
@@ -22,6 +22,9 @@
 #include <media/stagefright/foundation/AMessage.h>
 
 #include <inttypes.h>
+#include <unistd.h>
+
+#include <algorithm>
 
 #include <C2Config.h>
 #include <C2Debug.h>
@@ -109,17 +112,20 @@ void SimpleC2Component::WorkHandler::onMessageReceived(const sp<AMessage> &msg)
             break;
         }
         case kWhatStop: {
+            thiz->waitForParallelWorks();
             int32_t err = thiz->onStop();
             Reply(msg, &err);
             break;
         }
         case kWhatReset: {
+            thiz->waitForParallelWorks();
             thiz->onReset();
             mRunning = false;
             Reply(msg);
             break;
         }
         case kWhatRelease: {
+            thiz->waitForParallelWorks();
             thiz->onRelease();
             mRunning = false;
             Reply(msg);
@@ -132,6 +138,38 @@ void SimpleC2Component::WorkHandler::onMessageReceived(const sp<AMessage> &msg)
     }
 }
 
+class SimpleC2Component::WorkerHandler : public AHandler {
+public:
+    enum {
+        kWhatProcessWork,
+    };
+
+    explicit WorkerHandler(const std::weak_ptr<SimpleC2Component> &thiz) : mThiz(thiz) {}
+    ~WorkerHandler() override = default;
+
+protected:
+    void onMessageReceived(const sp<AMessage> &msg) override {
+        std::shared_ptr<SimpleC2Component> thiz = mThiz.lock();
+        if (!thiz) {
+            ALOGD("component already released; msg = %s", msg->debugString().c_str());
+            return;
+        }
+        switch (msg->what()) {
+            case kWhatProcessWork: {
+                thiz->processParallelWork();
+                break;
+            }
+            default: {
+                ALOGD("Unrecognized msg: %d", msg->what());
+                break;
+            }
+        }
+    }
+
+private:
+    std::weak_ptr<SimpleC2Component> mThiz;
+};
+
 class SimpleC2Component::BlockingBlockPool : public C2BlockPool {
 public:
     BlockingBlockPool(const std::shared_ptr<C2BlockPool>& base): mBase{base} {}
@@ -201,11 +239,17 @@ SimpleC2Component::SimpleC2Component(
     mLooper->setName(intf->getName().c_str());
     (void)mLooper->registerHandler(mHandler);
     mLooper->start(false, false, ANDROID_PRIORITY_VIDEO);
+    setMaxParallelWorks(
+            std::max(property_get_int32("debug.stagefright.c2-sw-parallel-works", 0), 0));
 }
 
 SimpleC2Component::~SimpleC2Component() {
     mLooper->unregisterHandler(mHandler->id());
     (void)mLooper->stop();
+    for (size_t i = 0; i < mWorkerLoopers.size(); ++i) {
+        mWorkerLoopers[i]->unregisterHandler(mWorkerHandlers[i]->id());
+        (void)mWorkerLoopers[i]->stop();
+    }
 }
 
 c2_status_t SimpleC2Component::setListener_vb(
@@ -454,6 +498,7 @@ bool SimpleC2Component::processQueue() {
     }
     if (isFlushPending) {
         ALOGV("processing pending flush");
+        waitForParallelWorks();
         c2_status_t err = onFlush_sm();
         if (err != C2_OK) {
             ALOGD("flush err: %d", err);
@@ -508,6 +553,14 @@ bool SimpleC2Component::processQueue() {
         }
     }
 
+    if (work && work->input.configUpdate.empty()
+            && isParallelEnabled() && isWorkIndependent(work)) {
+        dispatchParallelWork(std::move(work), generation);
+        return hasQueuedWork;
+    }
+    // everything else is processed in order after all outstanding parallel work
+    waitForParallelWorks();
+
     if (!work) {
         c2_status_t err = drain(drainMode, mOutputBlockPool);
         if (err != C2_OK) {
@@ -588,6 +641,126 @@ bool SimpleC2Component::processQueue() {
     return hasQueuedWork;
 }
 
+bool SimpleC2Component::isWorkIndependent(const std::unique_ptr<C2Work> &work) {
+    (void)work;
+    return false;
+}
+
+void SimpleC2Component::setMaxParallelWorks(uint32_t count) {
+    Mutexed<ParallelState>::Locked state(mParallelState);
+    if (!mWorkerLoopers.empty()) {
+        ALOGW("cannot change parallel works once started");
+        return;
+    }
+    state->mMaxWorks = count;
+}
+
+bool SimpleC2Component::isParallelEnabled() {
+    return mParallelState.lock()->mMaxWorks > 1;
+}
+
+void SimpleC2Component::dispatchParallelWork(
+        std::unique_ptr<C2Work> work, uint64_t generation) {
+    Mutexed<ParallelState>::Locked state(mParallelState);
+    if (mWorkerLoopers.empty()) {
+        std::string name = intf()->getName() + "-worker";
+        for (uint32_t i = 0; i < state->mMaxWorks; ++i) {
+            sp<ALooper> looper = new ALooper;
+            sp<WorkerHandler> handler = new WorkerHandler(shared_from_this());
+            looper->setName(name.c_str());
+            (void)looper->registerHandler(handler);
+            looper->start(false, false, ANDROID_PRIORITY_VIDEO);
+            mWorkerLoopers.push_back(looper);
+            mWorkerHandlers.push_back(handler);
+        }
+    }
+    while (state->mWorks.size() >= state->mMaxWorks) {
+        state.waitForCondition(state->mCondition);
+    }
+    ALOGV("dispatching frame #%" PRIu64, work->input.ordinal.frameIndex.peeku());
+    state->mWorks.push_back(std::make_shared<ParallelWork>(
+            ParallelWork{ std::move(work), generation, false, false }));
+    sp<WorkerHandler> handler = mWorkerHandlers[state->mNextWorker++ % mWorkerHandlers.size()];
+    state.unlock();
+    (new AMessage(WorkerHandler::kWhatProcessWork, handler))->post();
+}
+
+void SimpleC2Component::processParallelWork() {
+    // Each message processes the oldest work not yet started, so that a work is never held
+    // up behind a busy worker while another worker is idle.
+    std::shared_ptr<ParallelWork> entry;
+    {
+        Mutexed<ParallelState>::Locked state(mParallelState);
+        for (const std::shared_ptr<ParallelWork> &it : state->mWorks) {
+            if (!it->started) {
+                it->started = true;
+                entry = it;
+                break;
+            }
+        }
+    }
+    if (!entry) {
+        return;
+    }
+    const std::unique_ptr<C2Work> &work = entry->work;
+    ALOGV("start processing frame #%" PRIu64 " in parallel",
+            work->input.ordinal.frameIndex.peeku());
+    if (!work->input.buffers.empty() && !work->input.buffers[0]) {
+        ALOGD("Encountered null input buffer. Clearing the input buffer");
+        work->input.buffers.clear();
+    }
+    process(work, mOutputBlockPool);
+    if (work->workletsProcessed == 0u) {
+        ALOGW("independent work #%" PRIu64 " was not completed",
+                work->input.ordinal.frameIndex.peeku());
+        work->result = C2_CORRUPTED;
+    }
+
+    // Return the completed prefix of the in-flight list. Entries stay in the list until they
+    // are returned, so waitForParallelWorks() also waits for the onWorkDone_nb() call.
+    std::lock_guard<std::mutex> doneLock(mParallelDoneLock);
+    std::list<std::shared_ptr<ParallelWork>> done;
+    {
+        Mutexed<ParallelState>::Locked state(mParallelState);
+        entry->done = true;
+        for (const std::shared_ptr<ParallelWork> &it : state->mWorks) {
+            if (!it->done) {
+                break;
+            }
+            done.push_back(it);
+        }
+    }
+    if (done.empty()) {
+        return;
+    }
+    uint64_t generation = mWorkQueue.lock()->generation();
+    std::list<std::unique_ptr<C2Work>> workItems;
+    for (const std::shared_ptr<ParallelWork> &it : done) {
+        if (it->generation != generation) {
+            ALOGD("work form old generation: was %" PRIu64 " now %" PRIu64,
+                    generation, it->generation);
+            it->work->result = C2_NOT_FOUND;
+        }
+        workItems.push_back(std::move(it->work));
+    }
+    std::shared_ptr<C2Component::Listener> listener = mExecState.lock()->mListener;
+    ALOGV("returning %zu parallel work", workItems.size());
+    listener->onWorkDone_nb(shared_from_this(), std::move(workItems));
+
+    Mutexed<ParallelState>::Locked state(mParallelState);
+    for (size_t i = 0; i < done.size(); ++i) {
+        state->mWorks.pop_front();
+    }
+    state->mCondition.broadcast();
+}
+
+void SimpleC2Component::waitForParallelWorks() {
+    Mutexed<ParallelState>::Locked state(mParallelState);
+    while (!state->mWorks.empty()) {
+        state.waitForCondition(state->mCondition);
+    }
+}
+
 std::shared_ptr<C2Buffer> SimpleC2Component::createLinearBuffer(
         const std::shared_ptr<C2LinearBlock> &block) {
     return createLinearBuffer(block, block->offset(), block->size());
@@ -608,4 +781,18 @@ std::shared_ptr<C2Buffer> SimpleC2Component::createGraphicBuffer(
     return C2Buffer::CreateGraphicBuffer(block->share(crop, ::C2Fence()));
 }
 
+// static
+size_t SimpleC2Component::getNumCoresForResolution(
+        uint32_t width, uint32_t height, size_t maxCores, const char *property) {
+    constexpr size_t kPixelsPerCore = 1280 * 720;
+    long cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+    CHECK(cpuCoreCount >= 1);
+    int32_t numCores = property_get_int32(property, 0);
+    size_t cores = numCores > 0 ? (size_t)numCores
+            : ((size_t)width * height + kPixelsPerCore - 1) / kPixelsPerCore;
+    cores = std::min({std::max(cores, (size_t)1), (size_t)cpuCoreCount, maxCores});
+    ALOGV("Using %zu of %ld cores for %ux%u", cores, cpuCoreCount, width, height);
+    return cores;
+}
+
 } // namespace android
@@ -18,7 +18,9 @@
 #define SIMPLE_C2_COMPONENT_H_
 
 #include <list>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include <C2Component.h>
 
@@ -53,6 +55,9 @@ public:
     // for handler
     bool processQueue();
 
+    // for worker handlers
+    void processParallelWork();
+
 protected:
     /**
      * Initialize internal states of the component according to the config set
@@ -107,7 +112,38 @@ protected:
             uint32_t drainMode,
             const std::shared_ptr<C2BlockPool> &pool) = 0;
 
+    /**
+     * Returns whether |work| can be processed concurrently with other work.
+     *
+     * This is only consulted if parallel processing is enabled (see
+     * setMaxParallelWorks()). Independent work (e.g. audio frames or
+     * intra-only video frames) must be fully completed by process(): it must
+     * set workletsProcessed, and must not rely on finish() or cloneAndSend().
+     * process() must be safe to call concurrently for independent work.
+     * Independent work is still returned to the client in queue order.
+     *
+     * Work that is not independent, drain requests, flushes and work carrying
+     * configuration updates wait for all outstanding independent work to
+     * complete, and are then processed on the component thread.
+     *
+     * The default implementation returns false.
+     *
+     * \param[in]   work    the work to be processed
+     */
+    virtual bool isWorkIndependent(const std::unique_ptr<C2Work> &work);
+
     // for derived classes
+    /**
+     * Set the maximum number of independent works processed in parallel.
+     *
+     * A value of 0 or 1 disables parallel processing. This must be called
+     * before start(). The initial value is taken from the
+     * debug.stagefright.c2-sw-parallel-works property (default 0).
+     *
+     * \param[in]   count   the maximum number of works in flight
+     */
+    void setMaxParallelWorks(uint32_t count);
+
     /**
      * Finish pending work.
      *
@@ -152,6 +188,16 @@ protected:
             const std::shared_ptr<C2GraphicBlock> &block,
             const C2Rect &crop);
 
+    /**
+     * Returns the number of decoder threads to use for a |width|x|height| stream.
+     *
+     * Small streams do not gain from more threads, so this is about one thread per 720p
+     * worth of pixels, limited by the online CPUs and |maxCores|. A positive value of the
+     * system property |property| overrides this.
+     */
+    static size_t getNumCoresForResolution(
+            uint32_t width, uint32_t height, size_t maxCores, const char *property);
+
     static constexpr uint32_t NO_DRAIN = ~0u;
 
     C2ReadView mDummyReadView;
@@ -159,6 +205,7 @@ protected:
 private:
     const std::shared_ptr<C2ComponentInterface> mIntf;
 
+    class WorkerHandler;
     class WorkHandler : public AHandler {
     public:
         enum {
@@ -238,6 +285,33 @@ private:
     class BlockingBlockPool;
     std::shared_ptr<BlockingBlockPool> mOutputBlockPool;
 
+    struct ParallelWork {
+        std::unique_ptr<C2Work> work;
+        uint64_t generation;
+        bool started;
+        bool done;
+    };
+
+    struct ParallelState {
+        ParallelState() : mMaxWorks(0u), mNextWorker(0u) {}
+
+        uint32_t mMaxWorks;
+        size_t mNextWorker;
+        // in queue order; completed works are returned from the front only
+        std::list<std::shared_ptr<ParallelWork>> mWorks;
+        Condition mCondition;
+    };
+    Mutexed<ParallelState> mParallelState;
+    // serializes returning parallel work so that the client sees queue order
+    std::mutex mParallelDoneLock;
+
+    std::vector<sp<ALooper>> mWorkerLoopers;
+    std::vector<sp<WorkerHandler>> mWorkerHandlers;
+
+    bool isParallelEnabled();
+    void dispatchParallelWork(std::unique_ptr<C2Work> work, uint64_t generation);
+    void waitForParallelWorks();
+
     SimpleC2Component() = delete;
 };
 
@@ -208,6 +208,11 @@ void C2SoftG711Dec::process(
     }
 }
 
+bool C2SoftG711Dec::isWorkIndependent(const std::unique_ptr<C2Work> &work) {
+    // Every frame is decoded on its own; only the end of stream updates state.
+    return (work->input.flags & C2FrameData::FLAG_END_OF_STREAM) == 0;
+}
+
 c2_status_t C2SoftG711Dec::drain(
         uint32_t drainMode,
         const std::shared_ptr<C2BlockPool> &pool) {
@@ -18,6 +18,8 @@
 #define LOG_TAG "C2SoftHevcDec"
 #include <log/log.h>
 
+#include <cutils/properties.h>
+
 #include <media/stagefright/foundation/MediaDefs.h>
 
 #include <C2Debug.h>
@@ -192,6 +194,18 @@ public:
                 .withConstValue(new C2StreamPixelFormatInfo::output(
                                      0u, HAL_PIXEL_FORMAT_YCBCR_420_888))
                 .build());
+
+        addParameter(
+                DefineParam(mProcessingTime, C2_PARAMKEY_PROCESSING_TIME)
+                .withDefault(new C2ComponentProcessingTimeInfo())
+                .withFields({
+                    C2F(mProcessingTime, count).any(),
+                    C2F(mProcessingTime, last).any(),
+                    C2F(mProcessingTime, average).any(),
+                    C2F(mProcessingTime, max).any(),
+                })
+                .withSetter(ProcessingTimeSetter)
+                .build());
     }
 
     static C2R SizeSetter(bool mayBlock, const C2P<C2StreamPictureSizeInfo::output> &oldMe,
@@ -282,10 +296,20 @@ public:
         return C2R::Ok();
     }
 
+    static C2R ProcessingTimeSetter(bool mayBlock, C2P<C2ComponentProcessingTimeInfo> &me) {
+        (void)mayBlock;
+        (void)me;
+        return C2R::Ok();
+    }
+
     std::shared_ptr<C2StreamColorAspectsInfo::output> getColorAspects_l() {
         return mColorAspects;
     }
 
+    std::shared_ptr<C2StreamPictureSizeInfo::output> getSize_l() {
+        return mSize;
+    }
+
 private:
     std::shared_ptr<C2StreamProfileLevelInfo::input> mProfileLevel;
     std::shared_ptr<C2StreamPictureSizeInfo::output> mSize;
@@ -296,20 +320,10 @@ private:
     std::shared_ptr<C2StreamColorAspectsTuning::output> mDefaultColorAspects;
     std::shared_ptr<C2StreamColorAspectsInfo::output> mColorAspects;
     std::shared_ptr<C2StreamPixelFormatInfo::output> mPixelFormat;
+    std::shared_ptr<C2ComponentProcessingTimeInfo> mProcessingTime;
 };
 
-static size_t getCpuCoreCount() {
-    long cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
-    return (size_t)cpuCoreCount;
-}
+constexpr char kNumCoresProperty[] = "debug.stagefright.c2-hevcdec-num-cores";
 
 static void *ivd_aligned_malloc(void *ctxt, WORD32 alignment, WORD32 size) {
     (void) ctxt;
@@ -496,7 +510,12 @@ status_t C2SoftHevcDec::getVersion() {
 
 status_t C2SoftHevcDec::initDecoder() {
     if (OK != createDecoder()) return UNKNOWN_ERROR;
-    mNumCores = MIN(getCpuCoreCount(), MAX_NUM_CORES);
+    {
+        IntfImpl::Lock lock = mIntf->lock();
+        std::shared_ptr<C2StreamPictureSizeInfo::output> size = mIntf->getSize_l();
+        mNumCores = getNumCoresForResolution(
+                size->width, size->height, MAX_NUM_CORES, kNumCoresProperty);
+    }
     mStride = ALIGN32(mWidth);
     mSignalledError = false;
     resetPlugin();
@@ -656,10 +675,35 @@ status_t C2SoftHevcDec::resetDecoder() {
 
 void C2SoftHevcDec::resetPlugin() {
     mSignalledOutputEos = false;
+    mDecodeCount = 0;
+    mDecodeTimeTotalUs = 0;
+    mDecodeTimeMaxUs = 0;
+    mDecodeCountReported = 0;
     gettimeofday(&mTimeStart, nullptr);
     gettimeofday(&mTimeEnd, nullptr);
 }
 
+// Configuring the interface takes its lock, so the statistics are only published on the
+// first picture, on a new maximum and then every kProcessingTimeReportInterval pictures.
+constexpr uint64_t kProcessingTimeReportInterval = 30;
+
+void C2SoftHevcDec::updateProcessingTime(uint32_t decodeTimeUs) {
+    ++mDecodeCount;
+    mDecodeTimeTotalUs += decodeTimeUs;
+    const bool newMax = decodeTimeUs > mDecodeTimeMaxUs;
+    mDecodeTimeMaxUs = c2_max(mDecodeTimeMaxUs, decodeTimeUs);
+    if (mDecodeCountReported != 0 && !newMax
+            && mDecodeCount - mDecodeCountReported < kProcessingTimeReportInterval) {
+        return;
+    }
+    mDecodeCountReported = mDecodeCount;
+    C2ComponentProcessingTimeInfo processingTime(
+            mDecodeCount, decodeTimeUs,
+            (uint32_t)(mDecodeTimeTotalUs / mDecodeCount), mDecodeTimeMaxUs);
+    std::vector<std::unique_ptr<C2SettingResult>> failures;
+    (void)mIntf->config({&processingTime}, C2_MAY_BLOCK, &failures);
+}
+
 status_t C2SoftHevcDec::deleteDecoder() {
     if (mDecHandle) {
         ivdext_delete_ip_t s_delete_ip;
@@ -912,6 +956,13 @@ void C2SoftHevcDec::process(
             if (mHeaderDecoded == false) {
                 mHeaderDecoded = true;
                 setParams(ALIGN32(s_decode_op.u4_pic_wd), IVD_DECODE_FRAME);
+                // no picture has been decoded yet, so the core count can still change
+                size_t numCores = getNumCoresForResolution(s_decode_op.u4_pic_wd,
+                        s_decode_op.u4_pic_ht, MAX_NUM_CORES, kNumCoresProperty);
+                if (numCores != mNumCores) {
+                    mNumCores = numCores;
+                    (void) setNumCores();
+                }
             }
             if (s_decode_op.u4_pic_wd != mWidth ||  s_decode_op.u4_pic_ht != mHeight) {
                 mWidth = s_decode_op.u4_pic_wd;
@@ -937,6 +988,9 @@ void C2SoftHevcDec::process(
         }
         (void) getVuiParams();
         hasPicture |= (1 == s_decode_op.u4_frame_decoded_flag);
+        if (1 == s_decode_op.u4_frame_decoded_flag) {
+            updateProcessingTime((uint32_t)decodeTime);
+        }
         if (s_decode_op.u4_output_present) {
             finishWork(s_decode_op.u4_ts, work);
         }
@@ -98,6 +98,7 @@ struct C2SoftHevcDec : public SimpleC2Component {
     status_t resetDecoder();
     void resetPlugin();
     status_t deleteDecoder();
+    void updateProcessingTime(uint32_t decodeTimeUs);
 
     // TODO:This is not the right place for this enum. These should
     // be part of c2-vndk so that they can be accessed by all video plugins
@@ -145,6 +146,11 @@ struct C2SoftHevcDec : public SimpleC2Component {
     // profile
     struct timeval mTimeStart;
     struct timeval mTimeEnd;
+    // decode time statistics reported through C2ComponentProcessingTimeInfo
+    uint64_t mDecodeCount;
+    uint64_t mDecodeTimeTotalUs;
+    uint32_t mDecodeTimeMaxUs;
+    uint64_t mDecodeCountReported;  // mDecodeCount when the statistics were last published
 
     C2_DO_NOT_COPY(C2SoftHevcDec);
 };
@@ -162,6 +162,11 @@ void C2SoftRawDec::process(
     }
 }
 
+bool C2SoftRawDec::isWorkIndependent(const std::unique_ptr<C2Work> &work) {
+    // Every frame is decoded on its own; only the end of stream updates state.
+    return (work->input.flags & C2FrameData::FLAG_END_OF_STREAM) == 0;
+}
+
 c2_status_t C2SoftRawDec::drain(
         uint32_t drainMode,
         const std::shared_ptr<C2BlockPool> &pool) {
@@ -41,6 +41,7 @@ struct C2SoftRawDec : public SimpleC2Component {
     c2_status_t drain(
             uint32_t drainMode,
             const std::shared_ptr<C2BlockPool> &pool) override;
+    bool isWorkIndependent(const std::unique_ptr<C2Work> &work) override;
 private:
     std::shared_ptr<IntfImpl> mIntf;
     bool mSignalledEos;
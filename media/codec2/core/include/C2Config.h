@@ -249,6 +249,9 @@ enum C2ParamIndexKind : C2Param::type_index_t {
 
     // low latency mode
     kParamIndexLowLatencyMode, // bool
+
+    // statistics
+    kParamIndexProcessingTime, // struct
 };
 
 }
@@ -823,6 +826,37 @@ typedef C2GlobalParam<C2Tuning, C2EasyBoolValue, kParamIndexLowLatencyMode>
         C2GlobalLowLatencyModeTuning;
 constexpr char C2_PARAMKEY_LOW_LATENCY_MODE[] = "algo.low-latency";
 
+/**
+ * Processing time statistics.
+ *
+ * Time spent by the component processing each frame (e.g. inside the codec library), in
+ * microseconds. This is updated by the component as frames are processed and is reset on
+ * stop and flush.
+ */
+struct C2ProcessingTimeStruct {
+    inline C2ProcessingTimeStruct()
+        : count(0), last(0), average(0), max(0) { }
+
+    inline C2ProcessingTimeStruct(uint64_t count_, uint32_t last_, uint32_t average_, uint32_t max_)
+        : count(count_), last(last_), average(average_), max(max_) { }
+
+    uint64_t count;     ///< number of frames processed
+    uint32_t last;      ///< processing time of the last frame
+    uint32_t average;   ///< average processing time per frame
+    uint32_t max;       ///< maximum processing time of a frame
+
+    DEFINE_AND_DESCRIBE_C2STRUCT(ProcessingTime)
+    C2FIELD(count, "count")
+    C2FIELD(last, "last")
+    C2FIELD(average, "average")
+    C2FIELD(max, "max")
+};
+
+// read-only
+typedef C2GlobalParam<C2Info, C2ProcessingTimeStruct, kParamIndexProcessingTime>
+        C2ComponentProcessingTimeInfo;
+constexpr char C2_PARAMKEY_PROCESSING_TIME[] = "algo.processing-time";
+
 /**
  * Reference characteristics.
  *
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of SimpleC2Component based software codecs with serial and parallel
+// (debug.stagefright.c2-sw-parallel-works) work processing.
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include <android-base/properties.h>
+#include <benchmark/benchmark.h>
+
+#include <C2Buffer.h>
+#include <C2Component.h>
+#include <C2Config.h>
+#include <C2PlatformSupport.h>
+#include <C2Work.h>
+
+namespace {
+
+constexpr size_t kFrameSize = 4096;
+constexpr size_t kFramesPerIteration = 256;
+
+class Listener : public C2Component::Listener {
+public:
+    void onWorkDone_nb(std::weak_ptr<C2Component> component,
+                       std::list<std::unique_ptr<C2Work>> workItems) override {
+        (void)component;
+        std::lock_guard<std::mutex> lock(mLock);
+        for (const std::unique_ptr<C2Work> &work : workItems) {
+            if (work->result != C2_OK) {
+                ++mErrors;
+            }
+            if (work->input.ordinal.frameIndex.peeku() != mNextFrameIndex) {
+                ++mOutOfOrder;
+            }
+            mNextFrameIndex = work->input.ordinal.frameIndex.peeku() + 1;
+        }
+        mDone += workItems.size();
+        mCondition.notify_all();
+    }
+
+    void onTripped_nb(std::weak_ptr<C2Component> component,
+                      std::vector<std::shared_ptr<C2SettingResult>> settingResult) override {
+        (void)component;
+        (void)settingResult;
+    }
+
+    void onError_nb(std::weak_ptr<C2Component> component, uint32_t errorCode) override {
+        (void)component;
+        (void)errorCode;
+        std::lock_guard<std::mutex> lock(mLock);
+        ++mErrors;
+        mCondition.notify_all();
+    }
+
+    void waitFor(size_t count) {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCondition.wait(lock, [this, count] { return mDone >= count || mErrors > 0; });
+    }
+
+    size_t errors() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mErrors;
+    }
+
+    size_t outOfOrder() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mOutOfOrder;
+    }
+
+private:
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    size_t mDone = 0;
+    size_t mErrors = 0;
+    size_t mOutOfOrder = 0;
+    uint64_t mNextFrameIndex = 0;
+};
+
+void BM_Decode(benchmark::State &state, const char *componentName) {
+    const int64_t parallelWorks = state.range(0);
+    android::base::SetProperty(
+            "debug.stagefright.c2-sw-parallel-works", std::to_string(parallelWorks));
+
+    std::shared_ptr<C2ComponentStore> store = android::GetCodec2PlatformComponentStore();
+    std::shared_ptr<C2Component> component;
+    if (store->createComponent(componentName, &component) != C2_OK) {
+        state.SkipWithError("cannot create component");
+        return;
+    }
+    std::shared_ptr<Listener> listener = std::make_shared<Listener>();
+    (void)component->setListener_vb(listener, C2_DONT_BLOCK);
+
+    std::shared_ptr<C2BlockPool> linearPool;
+    if (android::GetCodec2BlockPool(
+            C2BlockPool::BASIC_LINEAR, nullptr, &linearPool) != C2_OK) {
+        state.SkipWithError("cannot get linear block pool");
+        return;
+    }
+    C2MemoryUsage usage = { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE };
+    std::vector<std::shared_ptr<C2Buffer>> inputs;
+    for (size_t i = 0; i < kFramesPerIteration; ++i) {
+        std::shared_ptr<C2LinearBlock> block;
+        if (linearPool->fetchLinearBlock(kFrameSize, usage, &block) != C2_OK) {
+            state.SkipWithError("cannot allocate input");
+            return;
+        }
+        C2WriteView view = block->map().get();
+        memset(view.data(), (int)i, kFrameSize);
+        inputs.push_back(C2Buffer::CreateLinearBuffer(block->share(0, kFrameSize, C2Fence())));
+    }
+
+    if (component->start() != C2_OK) {
+        state.SkipWithError("cannot start component");
+        return;
+    }
+    uint64_t frameIndex = 0;
+    for (auto _ : state) {
+        std::list<std::unique_ptr<C2Work>> items;
+        for (size_t i = 0; i < kFramesPerIteration; ++i) {
+            std::unique_ptr<C2Work> work(new C2Work);
+            work->input.flags = (C2FrameData::flags_t)0;
+            work->input.ordinal.timestamp = frameIndex * 20000;
+            work->input.ordinal.frameIndex = frameIndex++;
+            work->input.buffers.push_back(inputs[i]);
+            work->worklets.emplace_back(new C2Worklet);
+            items.push_back(std::move(work));
+        }
+        (void)component->queue_nb(&items);
+        listener->waitFor(frameIndex);
+    }
+    (void)component->stop();
+    (void)component->release();
+
+    if (listener->errors() > 0) {
+        state.SkipWithError("component reported errors");
+    } else if (listener->outOfOrder() > 0) {
+        state.SkipWithError("work returned out of order");
+    }
+    state.SetItemsProcessed(state.iterations() * kFramesPerIteration);
+    state.SetBytesProcessed(state.iterations() * kFramesPerIteration * kFrameSize);
+    android::base::SetProperty("debug.stagefright.c2-sw-parallel-works", "");
+}
+
+void ParallelWorksArgs(benchmark::internal::Benchmark *b) {
+    for (int64_t works : { 0, 2, 4, 8 }) {
+        b->Arg(works);
+    }
+    b->UseRealTime();
+}
+
+}  // namespace
+
+BENCHMARK_CAPTURE(BM_Decode, raw, "c2.android.raw.decoder")->Apply(ParallelWorksArgs);
+BENCHMARK_CAPTURE(BM_Decode, g711_mlaw, "c2.android.g711.mlaw.decoder")->Apply(ParallelWorksArgs);
+BENCHMARK_CAPTURE(BM_Decode, g711_alaw, "c2.android.g711.alaw.decoder")->Apply(ParallelWorksArgs);
+
+BENCHMARK_MAIN();
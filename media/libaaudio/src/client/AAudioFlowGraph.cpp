@@ -18,11 +18,18 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <algorithm>
+
+#ifdef __ANDROID__
+#include <audio_utils/primitives.h>
+#endif
+
 #include "AAudioFlowGraph.h"
 
 #include <flowgraph/ClipToRange.h>
 #include <flowgraph/MonoToMultiConverter.h>
 #include <flowgraph/RampLinear.h>
+#include <flowgraph/SampleRateConverter.h>
 #include <flowgraph/SinkFloat.h>
 #include <flowgraph/SinkI16.h>
 #include <flowgraph/SinkI24.h>
@@ -32,14 +39,105 @@
 
 using namespace flowgraph;
 
+namespace {
+
+// These match the conversions done by the SourceI16 and SinkI16 nodes
+// so that the fast path produces the same output as the graph.
+inline float sampleToFloat(float sample) {
+    return sample;
+}
+
+inline float sampleToFloat(int16_t sample) {
+#ifdef __ANDROID__
+    return float_from_i16(sample);
+#else
+    return sample * (1.0f / 32768);
+#endif
+}
+
+template <typename T>
+inline T sampleFromFloat(float sample);
+
+template <>
+inline float sampleFromFloat<float>(float sample) {
+    return sample;
+}
+
+template <>
+inline int16_t sampleFromFloat<int16_t>(float sample) {
+#ifdef __ANDROID__
+    return clamp16_from_float(sample);
+#else
+    int32_t n = (int32_t) (sample * 32768.0f);
+    return std::min(INT16_MAX, std::max(INT16_MIN, n)); // clip
+#endif
+}
+
+/**
+ * Apply the gain, clip if requested, and convert each sample exactly once.
+ * The inner loops have no dependencies between samples so they can be vectorized.
+ */
+template <typename SourceType, typename SinkType>
+void convertSteady(const SourceType * __restrict source,
+                   SinkType * __restrict sink,
+                   int32_t numFrames,
+                   int32_t sinkChannelCount,
+                   bool expandMono,
+                   float gain,
+                   bool clip,
+                   float minimum,
+                   float maximum) {
+    if (!expandMono) {
+        const int32_t numSamples = numFrames * sinkChannelCount;
+        if (clip) {
+            for (int32_t i = 0; i < numSamples; i++) {
+                float sample = sampleToFloat(source[i]) * gain;
+                sample = std::min(maximum, std::max(minimum, sample));
+                sink[i] = sampleFromFloat<SinkType>(sample);
+            }
+        } else {
+            for (int32_t i = 0; i < numSamples; i++) {
+                sink[i] = sampleFromFloat<SinkType>(sampleToFloat(source[i]) * gain);
+            }
+        }
+    } else if (sinkChannelCount == 2) {
+        for (int32_t i = 0; i < numFrames; i++) {
+            float sample = sampleToFloat(source[i]) * gain;
+            if (clip) {
+                sample = std::min(maximum, std::max(minimum, sample));
+            }
+            const SinkType packed = sampleFromFloat<SinkType>(sample);
+            sink[2 * i] = packed;
+            sink[2 * i + 1] = packed;
+        }
+    } else {
+        for (int32_t i = 0; i < numFrames; i++) {
+            float sample = sampleToFloat(source[i]) * gain;
+            if (clip) {
+                sample = std::min(maximum, std::max(minimum, sample));
+            }
+            const SinkType packed = sampleFromFloat<SinkType>(sample);
+            for (int32_t ch = 0; ch < sinkChannelCount; ch++) {
+                *sink++ = packed;
+            }
+        }
+    }
+}
+
+} // namespace
+
 aaudio_result_t AAudioFlowGraph::configure(audio_format_t sourceFormat,
                           int32_t sourceChannelCount,
                           audio_format_t sinkFormat,
-                          int32_t sinkChannelCount) {
+                          int32_t sinkChannelCount,
+                          int32_t sourceSampleRate,
+                          int32_t sinkSampleRate) {
     AudioFloatOutputPort *lastOutput = nullptr;
 
-    ALOGV("%s() source format = 0x%08x, channels = %d, sink format = 0x%08x, channels = %d",
-          __func__, sourceFormat, sourceChannelCount, sinkFormat, sinkChannelCount);
+    ALOGV("%s() source format = 0x%08x, channels = %d, rate = %d,"
+          " sink format = 0x%08x, channels = %d, rate = %d",
+          __func__, sourceFormat, sourceChannelCount, sourceSampleRate,
+          sinkFormat, sinkChannelCount, sinkSampleRate);
 
     switch (sourceFormat) {
         case AUDIO_FORMAT_PCM_FLOAT:
@@ -62,6 +160,20 @@ aaudio_result_t AAudioFlowGraph::configure(audio_format_t sourceFormat,
     lastOutput->connect(&mVolumeRamp->input);
     lastOutput = &mVolumeRamp->output;
 
+    // Convert the sample rate before expanding the channels, so fewer channels are filtered.
+    if (sourceSampleRate != 0 && sinkSampleRate != 0 && sourceSampleRate != sinkSampleRate) {
+        if (!SampleRateConverter::isSupported(sourceSampleRate, sinkSampleRate)) {
+            ALOGE("%s() Unsupported rate conversion %d => %d",
+                  __func__, sourceSampleRate, sinkSampleRate);
+            return AAUDIO_ERROR_UNIMPLEMENTED;
+        }
+        mRateConverter = std::make_unique<SampleRateConverter>(sourceChannelCount,
+                                                               sourceSampleRate,
+                                                               sinkSampleRate);
+        lastOutput->connect(&mRateConverter->input);
+        lastOutput = &mRateConverter->output;
+    }
+
     // For a pure float graph, there is chance that the data range may be very large.
     // So we should clip to a reasonable value that allows a little headroom.
     if (sourceFormat == AUDIO_FORMAT_PCM_FLOAT && sinkFormat == AUDIO_FORMAT_PCM_FLOAT) {
@@ -96,14 +208,97 @@ aaudio_result_t AAudioFlowGraph::configure(audio_format_t sourceFormat,
     }
     lastOutput->connect(&mSink->input);
 
+    // The common shapes can be converted in one pass when the volume is steady.
+    mSourceFormat = sourceFormat;
+    mSinkFormat = sinkFormat;
+    mSourceChannelCount = sourceChannelCount;
+    mSinkChannelCount = sinkChannelCount;
+    mFastPathSupported = mRateConverter == nullptr
+            && (sourceFormat == AUDIO_FORMAT_PCM_FLOAT || sourceFormat == AUDIO_FORMAT_PCM_16_BIT)
+            && (sinkFormat == AUDIO_FORMAT_PCM_FLOAT || sinkFormat == AUDIO_FORMAT_PCM_16_BIT);
+    ALOGV("%s() fast path supported = %d", __func__, mFastPathSupported);
+
     return AAUDIO_OK;
 }
 
 void AAudioFlowGraph::process(const void *source, void *destination, int32_t numFrames) {
+    if (mFastPathSupported && mFastPathEnabled && !mVolumeRamp->isRamping()) {
+        processFast(source, destination, numFrames);
+        return;
+    }
     mSource->setData(source, numFrames);
     mSink->read(destination, numFrames);
 }
 
+void AAudioFlowGraph::processFast(const void *source, void *destination, int32_t numFrames) {
+    const bool expandMono = mSourceChannelCount != mSinkChannelCount;
+    const float gain = mVolumeRamp->getLevel();
+    const bool clip = mClipper != nullptr;
+    const float minimum = clip ? mClipper->getMinimum() : 0.0f;
+    const float maximum = clip ? mClipper->getMaximum() : 0.0f;
+    if (mSourceFormat == AUDIO_FORMAT_PCM_FLOAT) {
+        const float *floatSource = static_cast<const float *>(source);
+        if (mSinkFormat == AUDIO_FORMAT_PCM_FLOAT) {
+            convertSteady(floatSource, static_cast<float *>(destination),
+                          numFrames, mSinkChannelCount, expandMono, gain,
+                          clip, minimum, maximum);
+        } else {
+            convertSteady(floatSource, static_cast<int16_t *>(destination),
+                          numFrames, mSinkChannelCount, expandMono, gain,
+                          clip, minimum, maximum);
+        }
+    } else {
+        const int16_t *shortSource = static_cast<const int16_t *>(source);
+        if (mSinkFormat == AUDIO_FORMAT_PCM_FLOAT) {
+            convertSteady(shortSource, static_cast<float *>(destination),
+                          numFrames, mSinkChannelCount, expandMono, gain,
+                          clip, minimum, maximum);
+        } else {
+            convertSteady(shortSource, static_cast<int16_t *>(destination),
+                          numFrames, mSinkChannelCount, expandMono, gain,
+                          clip, minimum, maximum);
+        }
+    }
+}
+
+int32_t AAudioFlowGraph::process(const void *source, int32_t numSourceFrames,
+                                 void *destination) {
+    if (mRateConverter == nullptr) {
+        process(source, destination, numSourceFrames);
+        return numSourceFrames;
+    }
+    mSource->setData(source, numSourceFrames);
+    int32_t numSinkFrames = getSinkFramesForSourceFrames(numSourceFrames);
+    int32_t numSourceFramesUsed = getSourceFramesForSinkFrames(numSinkFrames);
+    int32_t framesWritten = mSink->read(destination, numSinkFrames);
+    if (mRateConverter != nullptr) {
+        // The remaining source frames only contribute to later sink frames.
+        // Keep them in the converter because the source data is not retained.
+        mRateConverter->drainInput(numSourceFrames - numSourceFramesUsed);
+    }
+    return framesWritten;
+}
+
+int32_t AAudioFlowGraph::getSinkFramesForSourceFrames(int32_t numSourceFrames) const {
+    return (mRateConverter == nullptr)
+            ? numSourceFrames
+            : mRateConverter->getOutputFramesForInputFrames(numSourceFrames);
+}
+
+int32_t AAudioFlowGraph::getSourceFramesForSinkFrames(int32_t numSinkFrames) const {
+    return (mRateConverter == nullptr)
+            ? numSinkFrames
+            : mRateConverter->getInputFramesForOutputFrames(numSinkFrames);
+}
+
+int32_t AAudioFlowGraph::getMaxSourceFramesForSinkFrames(int32_t numSinkFrames) const {
+    if (mRateConverter == nullptr) {
+        return numSinkFrames;
+    }
+    // One source frame less than needed for one more sink frame.
+    return std::max(0, mRateConverter->getInputFramesForOutputFrames(numSinkFrames + 1) - 1);
+}
+
 /**
  * @param volume between 0.0 and 1.0
  */
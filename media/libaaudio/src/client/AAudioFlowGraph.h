@@ -26,6 +26,7 @@
 #include <flowgraph/ClipToRange.h>
 #include <flowgraph/MonoToMultiConverter.h>
 #include <flowgraph/RampLinear.h>
+#include <flowgraph/SampleRateConverter.h>
 
 class AAudioFlowGraph {
 public:
@@ -36,15 +37,50 @@ public:
      * @param sourceChannelCount
      * @param sinkFormat
      * @param sinkChannelCount
+     * @param sourceSampleRate rate of the source, or 0 if it matches the sink
+     * @param sinkSampleRate rate of the sink, or 0 if it matches the source
      * @return
      */
     aaudio_result_t configure(audio_format_t sourceFormat,
                               int32_t sourceChannelCount,
                               audio_format_t sinkFormat,
-                              int32_t sinkChannelCount);
+                              int32_t sinkChannelCount,
+                              int32_t sourceSampleRate = 0,
+                              int32_t sinkSampleRate = 0);
 
+    /**
+     * Convert numFrames source frames into numFrames destination frames.
+     * Only valid when the graph does not convert the sample rate.
+     */
     void process(const void *source, void *destination, int32_t numFrames);
 
+    /**
+     * Convert all of the source frames. The destination must have room for
+     * getSinkFramesForSourceFrames(numSourceFrames) frames.
+     *
+     * @return number of frames written to the destination
+     */
+    int32_t process(const void *source, int32_t numSourceFrames, void *destination);
+
+    /**
+     * @return number of frames that process() will write for this many source frames
+     */
+    int32_t getSinkFramesForSourceFrames(int32_t numSourceFrames) const;
+
+    /**
+     * @return number of source frames needed to write this many frames to the destination
+     */
+    int32_t getSourceFramesForSinkFrames(int32_t numSinkFrames) const;
+
+    /**
+     * The rate converter may write a frame without consuming a source frame, so this
+     * can be zero while the destination has room.
+     *
+     * @return largest number of source frames for which process() writes at most
+     *         numSinkFrames frames
+     */
+    int32_t getMaxSourceFramesForSinkFrames(int32_t numSinkFrames) const;
+
     /**
      * @param volume between 0.0 and 1.0
      */
@@ -52,12 +88,36 @@ public:
 
     void setRampLengthInFrames(int32_t numFrames);
 
+    /**
+     * Enable or disable the single pass conversion that bypasses the graph
+     * when the volume is steady. It is enabled by default.
+     * This is mostly useful for testing and benchmarking.
+     */
+    void setFastPathEnabled(bool enabled) {
+        mFastPathEnabled = enabled;
+    }
+
 private:
+    /**
+     * Convert, scale, clip, expand and pack in a single pass over the data.
+     * Only called when mFastPathSupported is true and the volume is not ramping.
+     */
+    void processFast(const void *source, void *destination, int32_t numFrames);
+
     std::unique_ptr<flowgraph::AudioSource>          mSource;
     std::unique_ptr<flowgraph::RampLinear>           mVolumeRamp;
+    std::unique_ptr<flowgraph::SampleRateConverter>  mRateConverter;
     std::unique_ptr<flowgraph::ClipToRange>          mClipper;
     std::unique_ptr<flowgraph::MonoToMultiConverter> mChannelConverter;
     std::unique_ptr<flowgraph::AudioSink>            mSink;
+
+    // Shape of the graph, used by processFast().
+    audio_format_t mSourceFormat = AUDIO_FORMAT_INVALID;
+    audio_format_t mSinkFormat = AUDIO_FORMAT_INVALID;
+    int32_t        mSourceChannelCount = 0;
+    int32_t        mSinkChannelCount = 0;
+    bool           mFastPathSupported = false;
+    bool           mFastPathEnabled = true;
 };
 
 
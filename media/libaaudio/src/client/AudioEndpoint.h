@@ -48,17 +48,14 @@ public:
      */
     aaudio_result_t readUpCommand(AAudioServiceMessage *commandPtr);
 
-    int32_t getEmptyFramesAvailable(android::WrappingBuffer *wrappingBuffer);
-
     int32_t getEmptyFramesAvailable();
 
-    int32_t getFullFramesAvailable(android::WrappingBuffer *wrappingBuffer);
-
     int32_t getFullFramesAvailable();
 
-    void advanceReadIndex(int32_t deltaFrames);
-
-    void advanceWriteIndex(int32_t deltaFrames);
+    /**
+     * For moving data in batches with FifoBatchReader or FifoBatchWriter.
+     */
+    android::FifoBuffer &getDataQueue() { return *mDataQueue; }
 
     /**
      * Set the read index in the downData queue.
@@ -141,6 +141,17 @@ aaudio_result_t AudioStreamInternal::open(const AudioStreamBuilder &builder) {
         request.getConfiguration().setSamplesPerFrame(2); // stereo
         mServiceStreamHandle = mServiceInterface.openStream(request, configurationOutput);
     }
+    if (mServiceStreamHandle < 0
+            && request.getConfiguration().getSampleRate() != AAUDIO_UNSPECIFIED
+            && getDirection() == AAUDIO_DIRECTION_OUTPUT
+            && !isInService()) {
+        // If that failed then open the endpoint at its own rate and convert the rate
+        // in the client flowgraph, so that the stream can still use MMAP.
+        ALOGD("%s() - openStream() returned %d, try the sample rate of the endpoint",
+              __func__, mServiceStreamHandle);
+        request.getConfiguration().setSampleRate(AAUDIO_UNSPECIFIED);
+        mServiceStreamHandle = mServiceInterface.openStream(request, configurationOutput);
+    }
     if (mServiceStreamHandle < 0) {
         return mServiceStreamHandle;
     }
@@ -160,7 +171,12 @@ aaudio_result_t AudioStreamInternal::open(const AudioStreamBuilder &builder) {
     }
     mDeviceChannelCount = configurationOutput.getSamplesPerFrame();
 
-    setSampleRate(configurationOutput.getSampleRate());
+    // Keep the rate requested by the app if the client converts it.
+    mDeviceSampleRate = configurationOutput.getSampleRate();
+    if (getSampleRate() == AAUDIO_UNSPECIFIED
+            || request.getConfiguration().getSampleRate() != AAUDIO_UNSPECIFIED) {
+        setSampleRate(mDeviceSampleRate);
+    }
     setDeviceId(configurationOutput.getDeviceId());
     setSessionId(configurationOutput.getSessionId());
     setSharingMode(configurationOutput.getSharingMode());
@@ -200,7 +216,7 @@ aaudio_result_t AudioStreamInternal::open(const AudioStreamBuilder &builder) {
         if (burstMicros > 0) {  // skip first loop
             framesPerBurst *= 2;
         }
-        burstMicros = framesPerBurst * static_cast<int64_t>(1000000) / getSampleRate();
+        burstMicros = framesPerBurst * static_cast<int64_t>(1000000) / getDeviceSampleRate();
     } while (burstMicros < burstMinMicros);
     ALOGD("%s() original HW burst = %d, minMicros = %d => SW burst = %d\n",
           __func__, framesPerHardwareBurst, burstMinMicros, framesPerBurst);
@@ -221,8 +237,9 @@ aaudio_result_t AudioStreamInternal::open(const AudioStreamBuilder &builder) {
         goto error;
     }
 
-    mClockModel.setSampleRate(getSampleRate());
+    mClockModel.setSampleRate(getDeviceSampleRate());
     mClockModel.setFramesPerBurst(framesPerHardwareBurst);
+    mClockModel.setAdaptiveEnabled(AAudioProperty_getClockModel() == AAUDIO_CLOCK_MODEL_ADAPTIVE);
 
     if (isDataCallbackSet()) {
         mCallbackFrames = builder.getFramesPerDataCallback();
@@ -239,7 +256,7 @@ aaudio_result_t AudioStreamInternal::open(const AudioStreamBuilder &builder) {
 
         }
         if (mCallbackFrames == AAUDIO_UNSPECIFIED) {
-            mCallbackFrames = mFramesPerBurst;
+            mCallbackFrames = getFramesPerBurst();
         }
 
         const int32_t callbackBufferSize = mCallbackFrames * getBytesPerFrame();
@@ -264,7 +281,7 @@ aaudio_result_t AudioStreamInternal::open(const AudioStreamBuilder &builder) {
         mTimeOffsetNanos = offsetMicros * AAUDIO_NANOS_PER_MICROSECOND;
     }
 
-    setBufferSize(mBufferCapacityInFrames / 2); // Default buffer size to match Q
+    setBufferSize(getBufferCapacity() / 2); // Default buffer size to match Q
 
     setState(AAUDIO_STREAM_STATE_OPEN);
 
@@ -493,7 +510,8 @@ aaudio_result_t AudioStreamInternal::getTimestamp(clockid_t clockId,
     // Generated in server and passed to client. Return latest.
     if (mAtomicInternalTimestamp.isValid()) {
         Timestamp timestamp = mAtomicInternalTimestamp.read();
-        int64_t position = timestamp.getPosition() + mFramesOffsetFromService;
+        int64_t position = convertDeviceFramesToApp(
+                timestamp.getPosition() + mFramesOffsetFromService);
         if (position >= 0) {
             *framePosition = position;
             *timeNanoseconds = timestamp.getNanoseconds();
@@ -754,10 +772,13 @@ void AudioStreamInternal::processTimestamp(uint64_t position, int64_t time) {
 }
 
 aaudio_result_t AudioStreamInternal::setBufferSize(int32_t requestedFrames) {
-    int32_t adjustedFrames = requestedFrames;
-    const int32_t maximumSize = getBufferCapacity() - mFramesPerBurst;
+    const int32_t maximumSize = mBufferCapacityInFrames - mFramesPerBurst;
     // Minimum size should be a multiple number of bursts.
     const int32_t minimumSize = 1 * mFramesPerBurst;
+    // The FIFO is sized in frames at the device sample rate.
+    // Clip before narrowing, the conversion may scale the request up.
+    int32_t adjustedFrames = static_cast<int32_t>(std::min<int64_t>(
+            convertAppFramesToDevice(requestedFrames), maximumSize));
 
     // Clip to minimum size so that rounding up will work better.
     adjustedFrames = std::max(minimumSize, adjustedFrames);
@@ -793,19 +814,33 @@ aaudio_result_t AudioStreamInternal::setBufferSize(int32_t requestedFrames) {
 
     mBufferSizeInFrames = adjustedFrames;
     ALOGV("%s(%d) returns %d", __func__, requestedFrames, adjustedFrames);
-    return (aaudio_result_t) adjustedFrames;
+    return (aaudio_result_t) getBufferSize();
 }
 
 int32_t AudioStreamInternal::getBufferSize() const {
-    return mBufferSizeInFrames;
+    return static_cast<int32_t>(convertDeviceFramesToApp(mBufferSizeInFrames));
 }
 
 int32_t AudioStreamInternal::getBufferCapacity() const {
-    return mBufferCapacityInFrames;
+    return static_cast<int32_t>(convertDeviceFramesToApp(mBufferCapacityInFrames));
 }
 
 int32_t AudioStreamInternal::getFramesPerBurst() const {
-    return mFramesPerBurst;
+    return static_cast<int32_t>(convertDeviceFramesToApp(mFramesPerBurst));
+}
+
+int64_t AudioStreamInternal::convertDeviceFramesToApp(int64_t deviceFrames) const {
+    if (mDeviceSampleRate == getSampleRate()) {
+        return deviceFrames;
+    }
+    return deviceFrames * getSampleRate() / mDeviceSampleRate;
+}
+
+int64_t AudioStreamInternal::convertAppFramesToDevice(int64_t appFrames) const {
+    if (mDeviceSampleRate == getSampleRate()) {
+        return appFrames;
+    }
+    return appFrames * mDeviceSampleRate / getSampleRate();
 }
 
 // This must be called under mStreamLock.
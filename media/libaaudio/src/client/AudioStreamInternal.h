@@ -140,6 +140,18 @@ protected:
 
     int32_t getDeviceChannelCount() const { return mDeviceChannelCount; }
 
+    int32_t getDeviceSampleRate() const { return mDeviceSampleRate; }
+
+    // Buffer size in frames at the device sample rate.
+    int32_t getDeviceBufferSize() const { return mBufferSizeInFrames; }
+
+    /**
+     * Convert a frame count or position between the device sample rate, used by the FIFO,
+     * the clock model and the service, and the sample rate of the app.
+     */
+    int64_t convertDeviceFramesToApp(int64_t deviceFrames) const;
+    int64_t convertAppFramesToDevice(int64_t appFrames) const;
+
     /**
      * @return true if running in audio service, versus in app process
      */
@@ -210,6 +222,10 @@ private:
     // Then we require conversion in AAudio.
     int32_t                  mDeviceChannelCount = 0;
 
+    // The app may use another sample rate than the endpoint for OUTPUT streams.
+    // Then the client flowgraph converts the rate.
+    int32_t                  mDeviceSampleRate = 0;
+
     int32_t                  mBufferSizeInFrames = 0; // local threshold to control latency
     int32_t                  mBufferCapacityInFrames = 0;
 
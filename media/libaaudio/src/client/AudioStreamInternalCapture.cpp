@@ -29,6 +29,7 @@
 #define ATRACE_TAG ATRACE_TAG_AUDIO
 #include <utils/Trace.h>
 
+using android::FifoBatchReader;
 using android::WrappingBuffer;
 
 using namespace aaudio;
@@ -166,7 +167,9 @@ aaudio_result_t AudioStreamInternalCapture::readNowWithConversion(void *buffer,
     uint8_t *destination = (uint8_t *) buffer;
     int32_t framesLeft = numFrames;
 
-    mAudioEndpoint->getFullFramesAvailable(&wrappingBuffer);
+    // The counters are loaded once and the read counter is published once.
+    FifoBatchReader reader(mAudioEndpoint->getDataQueue());
+    reader.getFullDataAvailable(&wrappingBuffer);
 
     // Read data in one or two parts.
     for (int partIndex = 0; framesLeft > 0 && partIndex < WrappingBuffer::SIZE; partIndex++) {
@@ -208,7 +211,7 @@ aaudio_result_t AudioStreamInternalCapture::readNowWithConversion(void *buffer,
     }
 
     int32_t framesProcessed = numFrames - framesLeft;
-    mAudioEndpoint->advanceReadIndex(framesProcessed);
+    reader.advanceReadIndex(framesProcessed);
 
     //ALOGD("readNowWithConversion() returns %d", framesProcessed);
     return framesProcessed;
@@ -21,11 +21,15 @@
 
 #define ATRACE_TAG ATRACE_TAG_AUDIO
 
+#include <string.h>
+
 #include <utils/Trace.h>
 
 #include "client/AudioStreamInternalPlay.h"
 #include "utility/AudioClock.h"
 
+using android::FifoBatchWriter;
+using android::FifoBuffer;
 using android::WrappingBuffer;
 
 using namespace aaudio;
@@ -46,10 +50,18 @@ aaudio_result_t AudioStreamInternalPlay::open(const AudioStreamBuilder &builder)
         result = mFlowGraph.configure(getFormat(),
                              getSamplesPerFrame(),
                              getDeviceFormat(),
-                             getDeviceChannelCount());
+                             getDeviceChannelCount(),
+                             getSampleRate(),
+                             getDeviceSampleRate());
 
         if (result != AAUDIO_OK) {
             releaseCloseFinal();
+        } else if (getSampleRate() != getDeviceSampleRate()) {
+            // Room for the converted data of one write, which can fill the whole FIFO.
+            FifoBuffer &dataQueue = mAudioEndpoint->getDataQueue();
+            mRateConversionFrames = dataQueue.getBufferCapacityInFrames();
+            mRateConversionBuffer = std::make_unique<uint8_t[]>(
+                    dataQueue.convertFramesToBytes(mRateConversionFrames));
         }
         // Sample rate is constrained to common values by now and should not overflow.
         int32_t numFrames = kRampMSec * getSampleRate() / AAUDIO_MILLIS_PER_SECOND;
@@ -170,7 +182,7 @@ aaudio_result_t AudioStreamInternalPlay::processDataNow(void *buffer, int32_t nu
     // Sleep if there is too much data in the buffer.
     // Calculate an ideal time to wake up.
     if (wakeTimePtr != nullptr
-            && (mAudioEndpoint->getFullFramesAvailable() >= getBufferSize())) {
+            && (mAudioEndpoint->getFullFramesAvailable() >= getDeviceBufferSize())) {
         // By default wake up a few milliseconds from now.  // TODO review
         int64_t wakeTime = currentNanoTime + (1 * AAUDIO_NANOS_PER_MILLISECOND);
         aaudio_stream_state_t state = getState();
@@ -188,7 +200,8 @@ aaudio_result_t AudioStreamInternalPlay::processDataNow(void *buffer, int32_t nu
             {
                 // Sleep until the readCounter catches up and we only have
                 // the getBufferSize() frames of data sitting in the buffer.
-                int64_t nextReadPosition = mAudioEndpoint->getDataWriteCounter() - getBufferSize();
+                int64_t nextReadPosition = mAudioEndpoint->getDataWriteCounter()
+                        - getDeviceBufferSize();
                 wakeTime = mClockModel.convertPositionToTime(nextReadPosition);
             }
                 break;
@@ -206,11 +219,16 @@ aaudio_result_t AudioStreamInternalPlay::processDataNow(void *buffer, int32_t nu
 
 aaudio_result_t AudioStreamInternalPlay::writeNowWithConversion(const void *buffer,
                                                             int32_t numFrames) {
+    if (mRateConversionBuffer != nullptr) {
+        return writeNowWithRateConversion(buffer, numFrames);
+    }
     WrappingBuffer wrappingBuffer;
     uint8_t *byteBuffer = (uint8_t *) buffer;
     int32_t framesLeft = numFrames;
 
-    mAudioEndpoint->getEmptyFramesAvailable(&wrappingBuffer);
+    // The counters are loaded once and the write counter is published once.
+    FifoBatchWriter writer(mAudioEndpoint->getDataQueue());
+    writer.getEmptyRoomAvailable(&wrappingBuffer);
 
     // Write data in one or two parts.
     int partIndex = 0;
@@ -236,26 +254,62 @@ aaudio_result_t AudioStreamInternalPlay::writeNowWithConversion(const void *buff
         partIndex++;
     }
     int32_t framesWritten = numFrames - framesLeft;
-    mAudioEndpoint->advanceWriteIndex(framesWritten);
+    writer.advanceWriteIndex(framesWritten);
 
     return framesWritten;
 }
 
+aaudio_result_t AudioStreamInternalPlay::writeNowWithRateConversion(const void *buffer,
+                                                                int32_t numFrames) {
+    WrappingBuffer wrappingBuffer;
+    FifoBuffer &dataQueue = mAudioEndpoint->getDataQueue();
+
+    // The counters are loaded once and the write counter is published once.
+    FifoBatchWriter writer(dataQueue);
+    int32_t emptyFrames = std::min(writer.getEmptyRoomAvailable(&wrappingBuffer),
+                                   mRateConversionFrames);
+
+    // The number of frames written by the converter depends on its phase,
+    // so only convert the app frames whose output fits in the FIFO.
+    int32_t framesToConvert = std::min(numFrames,
+                                       mFlowGraph.getMaxSourceFramesForSinkFrames(emptyFrames));
+    if (framesToConvert <= 0) {
+        return 0;
+    }
+    int32_t framesConverted = mFlowGraph.process(buffer, framesToConvert,
+                                                 mRateConversionBuffer.get());
+
+    // Copy the converted data in one or two parts.
+    const uint8_t *convertedData = mRateConversionBuffer.get();
+    int32_t framesLeft = framesConverted;
+    for (int partIndex = 0; framesLeft > 0 && partIndex < WrappingBuffer::SIZE; partIndex++) {
+        int32_t framesToCopy = std::min(framesLeft, wrappingBuffer.numFrames[partIndex]);
+        int32_t numBytes = dataQueue.convertFramesToBytes(framesToCopy);
+        memcpy(wrappingBuffer.data[partIndex], convertedData, numBytes);
+        convertedData += numBytes;
+        framesLeft -= framesToCopy;
+    }
+    writer.advanceWriteIndex(framesConverted);
+
+    return framesToConvert;
+}
+
 int64_t AudioStreamInternalPlay::getFramesRead() {
     if (mAudioEndpoint) {
         const int64_t framesReadHardware = isClockModelInControl()
                 ? mClockModel.convertTimeToPosition(AudioClock::getNanoseconds())
                 : mAudioEndpoint->getDataReadCounter();
         // Add service offset and prevent retrograde motion.
-        mLastFramesRead = std::max(mLastFramesRead, framesReadHardware + mFramesOffsetFromService);
+        mLastFramesRead = std::max(mLastFramesRead,
+                convertDeviceFramesToApp(framesReadHardware + mFramesOffsetFromService));
     }
     return mLastFramesRead;
 }
 
 int64_t AudioStreamInternalPlay::getFramesWritten() {
     if (mAudioEndpoint) {
-        mLastFramesWritten = mAudioEndpoint->getDataWriteCounter()
-                             + mFramesOffsetFromService;
+        mLastFramesWritten = convertDeviceFramesToApp(mAudioEndpoint->getDataWriteCounter()
+                                                      + mFramesOffsetFromService);
     }
     return mLastFramesWritten;
 }
@@ -92,8 +92,21 @@ private:
     aaudio_result_t writeNowWithConversion(const void *buffer,
                                            int32_t numFrames);
 
+    /*
+     * Asynchronous write when the app and the device use different sample rates.
+     * @param buffer
+     * @param numFrames
+     * @return app frames written or negative error
+     */
+    aaudio_result_t writeNowWithRateConversion(const void *buffer,
+                                               int32_t numFrames);
+
     AAudioFlowGraph          mFlowGraph;
 
+    // Data converted to the device sample rate, before it is copied to the FIFO.
+    std::unique_ptr<uint8_t[]> mRateConversionBuffer;
+    int32_t                  mRateConversionFrames = 0;
+
 };
 
 } /* namespace aaudio */
@@ -22,6 +22,7 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
 
 #include "utility/AudioClock.h"
 #include "utility/AAudioUtilities.h"
@@ -55,9 +56,16 @@ IsochronousClockModel::IsochronousClockModel()
     if ((AAudioProperty_getLogMask() & AAUDIO_LOG_CLOCK_MODEL_HISTOGRAM) != 0) {
         mHistogramMicros = std::make_unique<Histogram>(kHistogramBinCount,
                 kHistogramBinWidthMicros);
+        mJitterHistogramMicros = std::make_unique<Histogram>(kHistogramBinCount,
+                kHistogramBinWidthMicros);
     }
 }
 
+void IsochronousClockModel::setAdaptiveEnabled(bool enabled) {
+    ALOGV("%s(%d)", __func__, enabled);
+    mAdaptiveEnabled = enabled;
+}
+
 void IsochronousClockModel::setPositionAndTime(int64_t framePosition, int64_t nanoTime) {
     ALOGV("setPositionAndTime, %lld, %lld", (long long) framePosition, (long long) nanoTime);
     mMarkerFramePosition = framePosition;
@@ -68,9 +76,17 @@ void IsochronousClockModel::start(int64_t nanoTime) {
     ALOGV("start(nanos = %lld)\n", (long long) nanoTime);
     mMarkerNanoTime = nanoTime;
     mState = STATE_STARTING;
+    // The timestamps from before a stop cannot be used to fit the new run.
+    mWindowCount = 0;
+    mWindowCursor = 0;
+    mMeasuredNanosPerFrame = 0.0;
+    mOutlierCount = 0;
     if (mHistogramMicros) {
         mHistogramMicros->clear();
     }
+    if (mJitterHistogramMicros) {
+        mJitterHistogramMicros->clear();
+    }
 }
 
 void IsochronousClockModel::stop(int64_t nanoTime) {
@@ -136,6 +152,10 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
         if (mHistogramMicros) {
             mHistogramMicros->add(latenessNanos / AAUDIO_NANOS_PER_MICROSECOND);
         }
+        // Once it has enough timestamps the adaptive model replaces the code below.
+        if (mAdaptiveEnabled && processTimestampAdaptive(framePosition, nanoTime)) {
+            break;
+        }
         // Modify estimated position based on lateness.
         // This affects the "early" side of the window, which controls output glitches.
         if (latenessNanos < 0) {
@@ -196,6 +216,119 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
     }
 }
 
+bool IsochronousClockModel::processTimestampAdaptive(int64_t framePosition, int64_t nanoTime) {
+    mWindow[mWindowCursor] = {framePosition, nanoTime};
+    mWindowCursor = (mWindowCursor + 1) % kAdaptiveWindowSize;
+    mWindowCount = std::min(mWindowCount + 1, kAdaptiveWindowSize);
+    if (mWindowCount < kAdaptiveMinTimestamps) {
+        return false;
+    }
+
+    // Work relative to the newest timestamp to keep the numbers small.
+    const double nominalNanosPerFrame = (double) AAUDIO_NANOS_PER_SECOND / mSampleRate;
+    double frames[kAdaptiveWindowSize];
+    double nanos[kAdaptiveWindowSize];
+    double residuals[kAdaptiveWindowSize];
+    double sorted[kAdaptiveWindowSize];
+    for (int32_t i = 0; i < mWindowCount; i++) {
+        frames[i] = (double) (mWindow[i].framePosition - framePosition);
+        nanos[i] = (double) (mWindow[i].nanoTime - nanoTime);
+        residuals[i] = nanos[i] - (frames[i] * nominalNanosPerFrame);
+        sorted[i] = residuals[i];
+    }
+
+    // Use the median and the median absolute deviation because they are not
+    // disturbed by a few very late timestamps.
+    const int32_t middle = mWindowCount / 2;
+    std::nth_element(sorted, sorted + middle, sorted + mWindowCount);
+    const double median = sorted[middle];
+    for (int32_t i = 0; i < mWindowCount; i++) {
+        sorted[i] = std::abs(residuals[i] - median);
+    }
+    std::nth_element(sorted, sorted + middle, sorted + mWindowCount);
+    const double threshold = kOutlierDeviations
+            * std::max(sorted[middle], (double) kMinDeviationNanos);
+
+    // Least squares fit of time against position using only the inliers.
+    bool inlier[kAdaptiveWindowSize];
+    int32_t numInliers = 0;
+    double sumFrames = 0.0, sumNanos = 0.0, sumFrames2 = 0.0, sumFramesNanos = 0.0;
+    for (int32_t i = 0; i < mWindowCount; i++) {
+        inlier[i] = std::abs(residuals[i] - median) <= threshold;
+        if (inlier[i]) {
+            numInliers++;
+            sumFrames += frames[i];
+            sumNanos += nanos[i];
+            sumFrames2 += frames[i] * frames[i];
+            sumFramesNanos += frames[i] * nanos[i];
+        }
+    }
+    if (numInliers < kAdaptiveMinTimestamps) {
+        return false; // too noisy to trust, use the fixed model for now
+    }
+    double slope = nominalNanosPerFrame;
+    const double denominator = (numInliers * sumFrames2) - (sumFrames * sumFrames);
+    if (denominator > 0.0) {
+        const double fittedSlope = ((numInliers * sumFramesNanos) - (sumFrames * sumNanos))
+                / denominator;
+        if (std::abs((fittedSlope / nominalNanosPerFrame) - 1.0) <= kMaxDriftRatio) {
+            slope = fittedSlope;
+        }
+    }
+    const double intercept = (sumNanos - (slope * sumFrames)) / numInliers;
+
+    // The spread of the inliers around the line is the jitter.
+    double minError = 0.0;
+    double maxError = 0.0;
+    bool first = true;
+    for (int32_t i = 0; i < mWindowCount; i++) {
+        if (inlier[i]) {
+            const double error = nanos[i] - (intercept + (slope * frames[i]));
+            minError = first ? error : std::min(minError, error);
+            maxError = first ? error : std::max(maxError, error);
+            first = false;
+        }
+    }
+    if (!inlier[(mWindowCursor + kAdaptiveWindowSize - 1) % kAdaptiveWindowSize]) {
+        mOutlierCount++;
+    }
+
+    // The early edge of the line is the earliest time that this position could be reached.
+    // An even earlier timestamp is probably more accurate, so use it, like the fixed model.
+    // The window may not contain the earliest burst that was seen, so only let the
+    // edge move later slowly, using the previous slope to follow any drift.
+    const int64_t earliestNanoTime = nanoTime + (int64_t) (intercept + minError);
+    const int64_t previousNanoTime = mMarkerNanoTime
+            + convertDeltaPositionToModelTime(framePosition - mMarkerFramePosition)
+            + kDriftNanos;
+    setPositionAndTime(framePosition,
+                       std::min(nanoTime, std::min(earliestNanoTime, previousNanoTime)));
+    if (mMeasuredNanosPerFrame > 0.0) {
+        mMeasuredNanosPerFrame += (slope - mMeasuredNanosPerFrame)
+                / (1 << kSlopeSmoothingShift);
+    } else {
+        mMeasuredNanosPerFrame = slope;
+    }
+    // Measure the late edge from the marker so the window covers every inlier.
+    const int64_t latestNanoTime = nanoTime + (int64_t) (intercept + maxError);
+    mMaxMeasuredLatenessNanos = (int32_t) (latestNanoTime - mMarkerNanoTime);
+    if (mJitterHistogramMicros) {
+        mJitterHistogramMicros->add(mMaxMeasuredLatenessNanos / AAUDIO_NANOS_PER_MICROSECOND);
+    }
+#if ICM_LOG_DRIFT
+    ALOGD("%s() - #%d, rate = %.2f, jitter = %d micros, inliers = %d",
+          __func__, mTimestampCount, getMeasuredSampleRate(),
+          mMaxMeasuredLatenessNanos / 1000, numInliers);
+#endif
+    return true;
+}
+
+double IsochronousClockModel::getMeasuredSampleRate() const {
+    return (mMeasuredNanosPerFrame > 0.0)
+            ? AAUDIO_NANOS_PER_SECOND / mMeasuredNanosPerFrame
+            : mSampleRate;
+}
+
 void IsochronousClockModel::setSampleRate(int32_t sampleRate) {
     mSampleRate = sampleRate;
     update();
@@ -219,6 +352,20 @@ int64_t IsochronousClockModel::convertDeltaTimeToPosition(int64_t nanosDelta) co
     return (mSampleRate * nanosDelta) / AAUDIO_NANOS_PER_SECOND;
 }
 
+int64_t IsochronousClockModel::convertDeltaPositionToModelTime(int64_t framesDelta) const {
+    if (mAdaptiveEnabled && mMeasuredNanosPerFrame > 0.0) {
+        return (int64_t) (framesDelta * mMeasuredNanosPerFrame);
+    }
+    return convertDeltaPositionToTime(framesDelta);
+}
+
+int64_t IsochronousClockModel::convertDeltaTimeToModelPosition(int64_t nanosDelta) const {
+    if (mAdaptiveEnabled && mMeasuredNanosPerFrame > 0.0) {
+        return (int64_t) (nanosDelta / mMeasuredNanosPerFrame);
+    }
+    return convertDeltaTimeToPosition(nanosDelta);
+}
+
 int64_t IsochronousClockModel::convertPositionToTime(int64_t framePosition) const {
     if (mState == STATE_STOPPED) {
         return mMarkerNanoTime;
@@ -226,7 +373,7 @@ int64_t IsochronousClockModel::convertPositionToTime(int64_t framePosition) cons
     int64_t nextBurstIndex = (framePosition + mFramesPerBurst - 1) / mFramesPerBurst;
     int64_t nextBurstPosition = mFramesPerBurst * nextBurstIndex;
     int64_t framesDelta = nextBurstPosition - mMarkerFramePosition;
-    int64_t nanosDelta = convertDeltaPositionToTime(framesDelta);
+    int64_t nanosDelta = convertDeltaPositionToModelTime(framesDelta);
     int64_t time = mMarkerNanoTime + nanosDelta;
 //    ALOGD("convertPositionToTime: pos = %llu --> time = %llu",
 //         (unsigned long long)framePosition,
@@ -239,7 +386,7 @@ int64_t IsochronousClockModel::convertTimeToPosition(int64_t nanoTime) const {
         return mMarkerFramePosition;
     }
     int64_t nanosDelta = nanoTime - mMarkerNanoTime;
-    int64_t framesDelta = convertDeltaTimeToPosition(nanosDelta);
+    int64_t framesDelta = convertDeltaTimeToModelPosition(nanosDelta);
     int64_t nextBurstPosition = mMarkerFramePosition + framesDelta;
     int64_t nextBurstIndex = nextBurstPosition / mFramesPerBurst;
     int64_t position = nextBurstIndex * mFramesPerBurst;
@@ -270,6 +417,10 @@ void IsochronousClockModel::dump() const {
     ALOGD("mFramesPerBurst      = %6d", mFramesPerBurst);
     ALOGD("mMaxMeasuredLatenessNanos = %6d", mMaxMeasuredLatenessNanos);
     ALOGD("mState               = %6d", mState);
+    if (mAdaptiveEnabled) {
+        ALOGD("measured sample rate = %.2f", getMeasuredSampleRate());
+        ALOGD("mOutlierCount        = %6d", mOutlierCount);
+    }
 }
 
 void IsochronousClockModel::dumpHistogram() const {
@@ -279,4 +430,10 @@ void IsochronousClockModel::dumpHistogram() const {
     while (std::getline(istr, line)) {
         ALOGD("lateness, %s", line.c_str());
     }
+    if (!mAdaptiveEnabled || !mJitterHistogramMicros) return;
+    std::istringstream jitterStream(mJitterHistogramMicros->dump());
+    while (std::getline(jitterStream, line)) {
+        ALOGD("jitter, %s", line.c_str());
+    }
+    ALOGD("jitter, outliers = %d of %d timestamps", mOutlierCount, mTimestampCount);
 }
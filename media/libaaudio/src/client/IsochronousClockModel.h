@@ -74,6 +74,36 @@ public:
         return mFramesPerBurst;
     }
 
+    /**
+     * Select a model that fits a line to a window of recent timestamps.
+     * The slope of the line tracks drift between the audio clock and the CPU clock,
+     * and the spread of the timestamps around the line sets the jitter allowance.
+     * Timestamps far from the line, for example caused by preemption, are ignored.
+     *
+     * The default model uses a fixed jitter allowance that slowly follows the
+     * lateness of the timestamps.
+     *
+     * This should be called before start().
+     *
+     * @param enabled true to use the adaptive model
+     */
+    void setAdaptiveEnabled(bool enabled);
+
+    bool isAdaptiveEnabled() const {
+        return mAdaptiveEnabled;
+    }
+
+    /**
+     * @return sample rate measured by the adaptive model, or the nominal rate
+     *         if there are not enough timestamps yet
+     */
+    double getMeasuredSampleRate() const;
+
+    /**
+     * @return current allowance for late timestamps in nanoseconds
+     */
+    int32_t getLateTimeOffsetNanos() const;
+
     /**
      * Calculate an estimated time when the stream will be at that position.
      *
@@ -129,9 +159,18 @@ public:
 
 private:
 
-    int32_t getLateTimeOffsetNanos() const;
     void update();
 
+    /**
+     * Add a timestamp to the window and fit the adaptive model to it.
+     * @return true if the markers were updated by the adaptive model
+     */
+    bool processTimestampAdaptive(int64_t framePosition, int64_t nanoTime);
+
+    // Conversions that use the measured rate when the adaptive model has one.
+    int64_t convertDeltaPositionToModelTime(int64_t framesDelta) const;
+    int64_t convertDeltaTimeToModelPosition(int64_t nanosDelta) const;
+
     enum clock_model_state_t {
         STATE_STOPPED,
         STATE_STARTING,
@@ -149,6 +188,25 @@ private:
     static constexpr int32_t   kHistogramBinWidthMicros = 50;
     static constexpr int32_t   kHistogramBinCount = 128;
 
+    // Number of recent timestamps used by the adaptive model.
+    static constexpr int32_t   kAdaptiveWindowSize = 32;
+    // Fewer timestamps than this cannot give a reliable slope.
+    static constexpr int32_t   kAdaptiveMinTimestamps = 8;
+    // Timestamps further than this many median absolute deviations from the median
+    // residual are treated as outliers.
+    static constexpr int32_t   kOutlierDeviations = 4;
+    // Lower bound on the deviation so that a very regular clock does not reject everything.
+    static constexpr int32_t   kMinDeviationNanos = 20 * 1000;
+    // Measured rates further than this from the nominal rate are not trusted.
+    static constexpr double    kMaxDriftRatio = 0.005;
+    // Each fit only spans a short time so its slope is smoothed before it is used.
+    static constexpr int32_t   kSlopeSmoothingShift = 4;
+
+    struct Timestamp {
+        int64_t framePosition;
+        int64_t nanoTime;
+    };
+
     int64_t             mMarkerFramePosition; // Estimated HW position.
     int64_t             mMarkerNanoTime;      // Estimated HW time.
     int32_t             mSampleRate;
@@ -162,8 +220,18 @@ private:
 
     int32_t             mTimestampCount = 0;  // For logging.
 
+    // Adaptive model, see setAdaptiveEnabled().
+    bool                mAdaptiveEnabled = false;
+    Timestamp           mWindow[kAdaptiveWindowSize];
+    int32_t             mWindowCount = 0;     // number of valid timestamps in mWindow
+    int32_t             mWindowCursor = 0;    // where the next timestamp is written
+    double              mMeasuredNanosPerFrame = 0.0; // 0.0 until the model has a fit
+    int32_t             mOutlierCount = 0;    // For logging.
+
     // distribution of timestamps relative to earliest
     std::unique_ptr<android::audio_utils::Histogram>   mHistogramMicros;
+    // distribution of the jitter allowance of the adaptive model
+    std::unique_ptr<android::audio_utils::Histogram>   mJitterHistogramMicros;
 
 };
 
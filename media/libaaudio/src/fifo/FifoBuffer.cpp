@@ -30,6 +30,8 @@
 #include "FifoControllerIndirect.h"
 #include "FifoBuffer.h"
 
+using android::FifoBatchReader;
+using android::FifoBatchWriter;
 using android::FifoBuffer;
 using android::fifo_frames_t;
 
@@ -115,6 +117,61 @@ fifo_frames_t FifoBuffer::getEmptyRoomAvailable(WrappingBuffer *wrappingBuffer)
 }
 
 fifo_frames_t FifoBuffer::read(void *buffer, fifo_frames_t numFrames) {
+    FifoBatchReader reader(*this);
+    return reader.read(buffer, numFrames);
+}
+
+fifo_frames_t FifoBuffer::write(const void *buffer, fifo_frames_t numFrames) {
+    FifoBatchWriter writer(*this);
+    return writer.write(buffer, numFrames);
+}
+
+fifo_frames_t FifoBuffer::getThreshold() {
+    return mFifo->getThreshold();
+}
+
+void FifoBuffer::setThreshold(fifo_frames_t threshold) {
+    mFifo->setThreshold(threshold);
+}
+
+fifo_frames_t FifoBuffer::getBufferCapacityInFrames() {
+    return mFifo->getCapacity();
+}
+
+void FifoBuffer::eraseMemory() {
+    int32_t numBytes = convertFramesToBytes(getBufferCapacityInFrames());
+    if (numBytes > 0) {
+        memset(mStorage, 0, (size_t) numBytes);
+    }
+}
+
+FifoBatchReader::FifoBatchReader(FifoBuffer &fifo)
+        : mFifo(fifo)
+        , mReadCounter(fifo.mFifo->getReadCounter())
+        , mWriteCounter(fifo.mFifo->getWriteCounter()) {
+}
+
+fifo_frames_t FifoBatchReader::getFullFramesAvailable() const {
+    fifo_frames_t temp = 0;
+    __builtin_sub_overflow(mWriteCounter, mReadCounter, &temp);
+    return temp;
+}
+
+fifo_frames_t FifoBatchReader::getFullDataAvailable(WrappingBuffer *wrappingBuffer) {
+    // The FIFO might be overfull so clip to capacity.
+    fifo_frames_t capacity = mFifo.mFifo->getCapacity();
+    fifo_frames_t framesAvailable = std::min(getFullFramesAvailable(), capacity);
+    fifo_frames_t startIndex = (fifo_frames_t) ((uint64_t) mReadCounter % capacity);
+    mFifo.fillWrappingBuffer(wrappingBuffer, framesAvailable, startIndex);
+    return framesAvailable;
+}
+
+void FifoBatchReader::advanceReadIndex(fifo_frames_t numFrames) {
+    __builtin_add_overflow(mReadCounter, numFrames, &mReadCounter);
+    mCommitNeeded |= (numFrames != 0);
+}
+
+fifo_frames_t FifoBatchReader::read(void *buffer, fifo_frames_t numFrames) {
     WrappingBuffer wrappingBuffer;
     uint8_t *destination = (uint8_t *) buffer;
     fifo_frames_t framesLeft = numFrames;
@@ -130,7 +187,7 @@ fifo_frames_t FifoBuffer::read(void *buffer, fifo_frames_t numFrames) {
             if (framesToRead > framesAvailable) {
                 framesToRead = framesAvailable;
             }
-            int32_t numBytes = convertFramesToBytes(framesToRead);
+            int32_t numBytes = mFifo.convertFramesToBytes(framesToRead);
             memcpy(destination, wrappingBuffer.data[partIndex], numBytes);
 
             destination += numBytes;
@@ -141,18 +198,51 @@ fifo_frames_t FifoBuffer::read(void *buffer, fifo_frames_t numFrames) {
         partIndex++;
     }
     fifo_frames_t framesRead = numFrames - framesLeft;
-    mFifo->advanceReadIndex(framesRead);
+    advanceReadIndex(framesRead);
     return framesRead;
 }
 
-fifo_frames_t FifoBuffer::write(const void *buffer, fifo_frames_t numFrames) {
+void FifoBatchReader::commit() {
+    if (mCommitNeeded) {
+        mFifo.mFifo->setReadCounter(mReadCounter);
+        mCommitNeeded = false;
+    }
+}
+
+FifoBatchWriter::FifoBatchWriter(FifoBuffer &fifo)
+        : mFifo(fifo)
+        , mReadCounter(fifo.mFifo->getReadCounter())
+        , mWriteCounter(fifo.mFifo->getWriteCounter()) {
+}
+
+fifo_frames_t FifoBatchWriter::getEmptyFramesAvailable() const {
+    fifo_frames_t fullFrames = 0;
+    __builtin_sub_overflow(mWriteCounter, mReadCounter, &fullFrames);
+    return mFifo.mFifo->getThreshold() - fullFrames;
+}
+
+fifo_frames_t FifoBatchWriter::getEmptyRoomAvailable(WrappingBuffer *wrappingBuffer) {
+    // The FIFO might have underrun so clip to capacity.
+    fifo_frames_t capacity = mFifo.mFifo->getCapacity();
+    fifo_frames_t framesAvailable = std::min(getEmptyFramesAvailable(), capacity);
+    fifo_frames_t startIndex = (fifo_frames_t) ((uint64_t) mWriteCounter % capacity);
+    mFifo.fillWrappingBuffer(wrappingBuffer, framesAvailable, startIndex);
+    return framesAvailable;
+}
+
+void FifoBatchWriter::advanceWriteIndex(fifo_frames_t numFrames) {
+    __builtin_add_overflow(mWriteCounter, numFrames, &mWriteCounter);
+    mCommitNeeded |= (numFrames != 0);
+}
+
+fifo_frames_t FifoBatchWriter::write(const void *buffer, fifo_frames_t numFrames) {
     WrappingBuffer wrappingBuffer;
     uint8_t *source = (uint8_t *) buffer;
     fifo_frames_t framesLeft = numFrames;
 
     getEmptyRoomAvailable(&wrappingBuffer);
 
-    // Read data in one or two parts.
+    // Write data in one or two parts.
     int partIndex = 0;
     while (framesLeft > 0 && partIndex < WrappingBuffer::SIZE) {
         fifo_frames_t framesToWrite = framesLeft;
@@ -161,7 +251,7 @@ fifo_frames_t FifoBuffer::write(const void *buffer, fifo_frames_t numFrames) {
             if (framesToWrite > framesAvailable) {
                 framesToWrite = framesAvailable;
             }
-            int32_t numBytes = convertFramesToBytes(framesToWrite);
+            int32_t numBytes = mFifo.convertFramesToBytes(framesToWrite);
             memcpy(wrappingBuffer.data[partIndex], source, numBytes);
 
             source += numBytes;
@@ -172,25 +262,13 @@ fifo_frames_t FifoBuffer::write(const void *buffer, fifo_frames_t numFrames) {
         partIndex++;
     }
     fifo_frames_t framesWritten = numFrames - framesLeft;
-    mFifo->advanceWriteIndex(framesWritten);
+    advanceWriteIndex(framesWritten);
     return framesWritten;
 }
 
-fifo_frames_t FifoBuffer::getThreshold() {
-    return mFifo->getThreshold();
-}
-
-void FifoBuffer::setThreshold(fifo_frames_t threshold) {
-    mFifo->setThreshold(threshold);
-}
-
-fifo_frames_t FifoBuffer::getBufferCapacityInFrames() {
-    return mFifo->getCapacity();
-}
-
-void FifoBuffer::eraseMemory() {
-    int32_t numBytes = convertFramesToBytes(getBufferCapacityInFrames());
-    if (numBytes > 0) {
-        memset(mStorage, 0, (size_t) numBytes);
+void FifoBatchWriter::commit() {
+    if (mCommitNeeded) {
+        mFifo.mFifo->setWriteCounter(mWriteCounter);
+        mCommitNeeded = false;
     }
 }
@@ -122,6 +122,8 @@ public:
     void eraseMemory();
 
 private:
+    friend class FifoBatchReader;
+    friend class FifoBatchWriter;
 
     void fillWrappingBuffer(WrappingBuffer *wrappingBuffer,
                             int32_t framesAvailable, int32_t startIndex);
@@ -134,6 +136,111 @@ private:
     std::unique_ptr<FifoControllerBase> mFifo{};
 };
 
+/**
+ * Read from a FifoBuffer in several steps while only touching the shared counters twice.
+ *
+ * The write counter is sampled when the reader is created, so data written after that
+ * will not be seen by this reader. The read counter is only published by commit(),
+ * or when the reader is destroyed, so the writer will not see the freed room until then.
+ * Only one reader may be used with a FifoBuffer at a time.
+ */
+class FifoBatchReader {
+public:
+    explicit FifoBatchReader(FifoBuffer &fifo);
+
+    ~FifoBatchReader() {
+        commit();
+    }
+
+    /**
+     * Return the regions of the FIFO that have not been read yet in this batch.
+     * They can be processed in place and then released with advanceReadIndex().
+     * @param wrappingBuffer
+     * @return total full frames available
+     */
+    fifo_frames_t getFullDataAvailable(WrappingBuffer *wrappingBuffer);
+
+    /**
+     * This may be negative if an unthrottled reader has read beyond the available data.
+     * @return number of frames that have not been read yet in this batch
+     */
+    fifo_frames_t getFullFramesAvailable() const;
+
+    /**
+     * @param numFrames number of frames to release, published by commit()
+     */
+    void advanceReadIndex(fifo_frames_t numFrames);
+
+    /**
+     * Copy data out of the FIFO and advance the read index.
+     * @return number of frames read
+     */
+    fifo_frames_t read(void *destination, fifo_frames_t numFrames);
+
+    /**
+     * Publish the read counter if it has changed.
+     */
+    void commit();
+
+private:
+    FifoBuffer     &mFifo;
+    fifo_counter_t  mReadCounter;
+    fifo_counter_t  mWriteCounter;
+    bool            mCommitNeeded = false;
+};
+
+/**
+ * Write to a FifoBuffer in several steps while only touching the shared counters twice.
+ *
+ * This is the mirror image of FifoBatchReader. The read counter is sampled when the
+ * writer is created and the write counter is only published by commit(),
+ * or when the writer is destroyed.
+ * Only one writer may be used with a FifoBuffer at a time.
+ */
+class FifoBatchWriter {
+public:
+    explicit FifoBatchWriter(FifoBuffer &fifo);
+
+    ~FifoBatchWriter() {
+        commit();
+    }
+
+    /**
+     * Return the regions of the FIFO that can still be written in this batch.
+     * They can be filled in place and then released with advanceWriteIndex().
+     * @param wrappingBuffer
+     * @return total empty frames available
+     */
+    fifo_frames_t getEmptyRoomAvailable(WrappingBuffer *wrappingBuffer);
+
+    /**
+     * @return number of frames that can still be written in this batch
+     */
+    fifo_frames_t getEmptyFramesAvailable() const;
+
+    /**
+     * @param numFrames number of frames written, published by commit()
+     */
+    void advanceWriteIndex(fifo_frames_t numFrames);
+
+    /**
+     * Copy data into the FIFO and advance the write index.
+     * @return number of frames written
+     */
+    fifo_frames_t write(const void *source, fifo_frames_t numFrames);
+
+    /**
+     * Publish the write counter if it has changed.
+     */
+    void commit();
+
+private:
+    FifoBuffer     &mFifo;
+    fifo_counter_t  mReadCounter;
+    fifo_counter_t  mWriteCounter;
+    bool            mCommitNeeded = false;
+};
+
 }  // android
 
 #endif //FIFO_FIFO_BUFFER_H
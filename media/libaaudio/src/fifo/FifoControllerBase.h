@@ -24,6 +24,10 @@ namespace android {
 typedef int64_t fifo_counter_t;
 typedef int32_t fifo_frames_t;
 
+// The read and write counters are updated by different threads or processes.
+// Keep them at least this far apart so they do not share a cache line.
+constexpr int32_t kFifoCounterAlignment = 64;
+
 /**
  * Manage the read/write indices of a circular buffer.
  *
@@ -31,9 +31,13 @@ int32_t ClipToRange::onProcess(int64_t framePosition, int32_t numFrames) {
     const float *inputBuffer = input.getBlock();
     float *outputBuffer = output.getBlock();
 
+    // Copy the limits to locals so the compiler knows that the stores
+    // cannot modify them, which lets it vectorize the loop.
+    const float minimum = mMinimum;
+    const float maximum = mMaximum;
     int32_t numSamples = framesToProcess * output.getSamplesPerFrame();
     for (int32_t i = 0; i < numSamples; i++) {
-        *outputBuffer++ = std::min(mMaximum, std::max(mMinimum, *inputBuffer++));
+        outputBuffer[i] = std::min(maximum, std::max(minimum, inputBuffer[i]));
     }
 
     return framesToProcess;
@@ -35,11 +35,21 @@ int32_t MonoToMultiConverter::onProcess(int64_t framePosition, int32_t numFrames
     float *outputBuffer = output.getBlock();
     int32_t channelCount = output.getSamplesPerFrame();
     // TODO maybe move to audio_util as audio_mono_to_multi()
-    for (int i = 0; i < framesToProcess; i++) {
-        // read one, write many
-        float sample = *inputBuffer++;
-        for (int channel = 0; channel < channelCount; channel++) {
-            *outputBuffer++ = sample;
+    if (channelCount == 2) {
+        // Stereo is by far the most common case so give the compiler
+        // a loop with a fixed stride that it can vectorize.
+        for (int i = 0; i < framesToProcess; i++) {
+            const float sample = inputBuffer[i];
+            outputBuffer[2 * i] = sample;
+            outputBuffer[2 * i + 1] = sample;
+        }
+    } else {
+        for (int i = 0; i < framesToProcess; i++) {
+            // read one, write many
+            float sample = *inputBuffer++;
+            for (int channel = 0; channel < channelCount; channel++) {
+                *outputBuffer++ = sample;
+            }
         }
     }
     return framesToProcess;
@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include <algorithm>
+#include <string.h>
 #include <unistd.h>
 #include "AudioProcessorBase.h"
 #include "RampLinear.h"
@@ -65,20 +66,40 @@ int32_t RampLinear::onProcess(int64_t framePosition, int32_t numFrames) {
     if (mRemaining > 0) { // Ramping? This doesn't happen very often.
         int32_t framesToRamp = std::min(framesLeft, mRemaining);
         framesLeft -= framesToRamp;
-        while (framesToRamp > 0) {
-            float currentLevel = interpolateCurrent();
-            for (int ch = 0; ch < channelCount; ch++) {
-                *outputBuffer++ = *inputBuffer++ * currentLevel;
+        const float levelTo = mLevelTo;
+        const float scaler = mScaler;
+        int32_t remaining = mRemaining;
+        if (channelCount == 2) {
+            for (int32_t i = 0; i < framesToRamp; i++) {
+                const float currentLevel = levelTo - (remaining - i) * scaler;
+                outputBuffer[0] = inputBuffer[0] * currentLevel;
+                outputBuffer[1] = inputBuffer[1] * currentLevel;
+                inputBuffer += 2;
+                outputBuffer += 2;
+            }
+        } else {
+            for (int32_t i = 0; i < framesToRamp; i++) {
+                const float currentLevel = levelTo - (remaining - i) * scaler;
+                for (int ch = 0; ch < channelCount; ch++) {
+                    *outputBuffer++ = *inputBuffer++ * currentLevel;
+                }
             }
-            mRemaining--;
-            framesToRamp--;
         }
+        mRemaining = remaining - framesToRamp;
     }
 
     // Process any frames after the ramp.
+    // Use a local level so the compiler can vectorize the loop.
+    const float level = mLevelTo;
     int32_t samplesLeft = framesLeft * channelCount;
-    for (int i = 0; i < samplesLeft; i++) {
-        *outputBuffer++ = *inputBuffer++ * mLevelTo;
+    if (level == 1.0f) {
+        if (outputBuffer != inputBuffer) {
+            memcpy(outputBuffer, inputBuffer, samplesLeft * sizeof(float));
+        }
+    } else {
+        for (int32_t i = 0; i < samplesLeft; i++) {
+            outputBuffer[i] = inputBuffer[i] * level;
+        }
     }
 
     return framesToProcess;
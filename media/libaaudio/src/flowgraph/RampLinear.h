@@ -53,6 +53,20 @@ public:
         return mTarget.load();
     }
 
+    /**
+     * @return true if the next call to onProcess() may apply a changing gain
+     */
+    bool isRamping() const {
+        return mRemaining > 0 || getTarget() != mLevelTo;
+    }
+
+    /**
+     * @return the gain applied once any ramp has finished
+     */
+    float getLevel() const {
+        return mLevelTo;
+    }
+
     /**
      * Force the nextSegment to start from this level.
      *
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <numeric>
+#include <unistd.h>
+#include "AudioProcessorBase.h"
+#include "SampleRateConverter.h"
+
+using namespace flowgraph;
+
+// Kaiser window shape; about 80 dB of stop band attenuation.
+constexpr double kKaiserBeta = 8.0;
+// Place the cutoff a little below the lower Nyquist rate to leave room for the transition band.
+constexpr double kCutoffScale = 0.9;
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double halfX = x * 0.5;
+    for (int k = 1; k < 32; k++) {
+        term *= halfX / k;
+        sum += term * term;
+    }
+    return sum;
+}
+
+bool SampleRateConverter::isSupported(int32_t sourceSampleRate, int32_t sinkSampleRate) {
+    if (sourceSampleRate <= 0 || sinkSampleRate <= 0) {
+        return false;
+    }
+    return sinkSampleRate / std::gcd(sourceSampleRate, sinkSampleRate) <= kMaxNumPhases;
+}
+
+SampleRateConverter::SampleRateConverter(int32_t channelCount,
+                                         int32_t sourceSampleRate,
+                                         int32_t sinkSampleRate,
+                                         int32_t numTapsPerPhase)
+        : input(*this, channelCount)
+        , output(*this, channelCount)
+        , mNumTapsPerPhase(numTapsPerPhase) {
+    assert(isSupported(sourceSampleRate, sinkSampleRate));
+    int32_t divisor = std::gcd(sourceSampleRate, sinkSampleRate);
+    mUpsampleFactor = sinkSampleRate / divisor;
+    mDownsampleFactor = sourceSampleRate / divisor;
+    // Consume the first input frame before producing the first output frame.
+    mPhase = mUpsampleFactor;
+
+    // Design a windowed sinc low pass filter at the upsampled rate, then split it into
+    // mUpsampleFactor phases of mNumTapsPerPhase taps.
+    const int32_t numPhases = mUpsampleFactor;
+    const int32_t numTaps = numPhases * mNumTapsPerPhase;
+    const double center = (numTaps - 1) * 0.5;
+    // Cutoff relative to the upsampled rate.
+    const double cutoff = kCutoffScale * 0.5 / std::max(mUpsampleFactor, mDownsampleFactor);
+    const double windowScale = 1.0 / besselI0(kKaiserBeta);
+    mCoefficients.resize(numTaps);
+    for (int32_t phase = 0; phase < numPhases; phase++) {
+        float *phaseCoefficients = &mCoefficients[phase * mNumTapsPerPhase];
+        double sum = 0.0;
+        for (int32_t tap = 0; tap < mNumTapsPerPhase; tap++) {
+            int32_t index = tap * numPhases + phase;
+            double t = index - center;
+            double sinc = (t == 0.0) ? 2.0 * cutoff
+                    : sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+            double ratio = t / (center + 0.5);
+            double window = besselI0(kKaiserBeta * sqrt(std::max(0.0, 1.0 - ratio * ratio)))
+                    * windowScale;
+            double coefficient = sinc * window;
+            phaseCoefficients[mNumTapsPerPhase - 1 - tap] = coefficient;
+            sum += coefficient;
+        }
+        // Normalize every phase to unity gain at DC so that there is no ripple
+        // in the output when the phase changes.
+        for (int32_t tap = 0; tap < mNumTapsPerPhase; tap++) {
+            phaseCoefficients[tap] /= sum;
+        }
+    }
+
+    mHistory.resize(channelCount * 2 * mNumTapsPerPhase, 0.0f);
+}
+
+int32_t SampleRateConverter::getOutputFramesForInputFrames(int32_t numInputFrames) const {
+    // Output frame j is produced once floor((mPhase + j * M) / L) more input frames
+    // have been consumed. Input still buffered from the last pull counts as available.
+    int64_t available = numInputFrames + (mInputFramesValid - mInputCursor);
+    int64_t numerator = (available + 1) * mUpsampleFactor - mPhase;
+    if (numerator <= 0) {
+        return 0;
+    }
+    return static_cast<int32_t>((numerator + mDownsampleFactor - 1) / mDownsampleFactor);
+}
+
+int32_t SampleRateConverter::getInputFramesForOutputFrames(int32_t numOutputFrames) const {
+    if (numOutputFrames <= 0) {
+        return 0;
+    }
+    int64_t needed = (mPhase + static_cast<int64_t>(numOutputFrames - 1) * mDownsampleFactor)
+            / mUpsampleFactor;
+    int64_t buffered = mInputFramesValid - mInputCursor;
+    return static_cast<int32_t>(std::max<int64_t>(0, needed - buffered));
+}
+
+void SampleRateConverter::writeHistory(const float *frame) {
+    const int32_t channelCount = output.getSamplesPerFrame();
+    float *history = mHistory.data();
+    for (int32_t channel = 0; channel < channelCount; channel++) {
+        history[mHistoryCursor] = frame[channel];
+        history[mHistoryCursor + mNumTapsPerPhase] = frame[channel];
+        history += 2 * mNumTapsPerPhase;
+    }
+    if (++mHistoryCursor == mNumTapsPerPhase) {
+        mHistoryCursor = 0;
+    }
+}
+
+bool SampleRateConverter::consumeInputFrame(int32_t maxFramesToPull) {
+    if (mInputCursor >= mInputFramesValid) {
+        mInputFramesValid = input.pullData(mInputFramePosition, maxFramesToPull);
+        mInputCursor = 0;
+        if (mInputFramesValid <= 0) {
+            mInputFramesValid = 0;
+            return false;
+        }
+        mInputFramePosition += mInputFramesValid;
+    }
+    writeHistory(input.getBlock() + mInputCursor * output.getSamplesPerFrame());
+    mInputCursor++;
+    mPhase -= mUpsampleFactor;
+    return true;
+}
+
+int32_t SampleRateConverter::drainInput(int32_t numFrames) {
+    int32_t framesConsumed = 0;
+    while (mPhase >= mUpsampleFactor && (mInputCursor < mInputFramesValid || numFrames > 0)) {
+        bool pulling = mInputCursor >= mInputFramesValid;
+        if (!consumeInputFrame(numFrames)) {
+            break;
+        }
+        if (pulling) {
+            numFrames -= mInputFramesValid;
+        }
+        framesConsumed++;
+    }
+    return framesConsumed;
+}
+
+int32_t SampleRateConverter::onProcess(int64_t framePosition, int32_t numFrames) {
+    (void) framePosition;
+    const int32_t channelCount = output.getSamplesPerFrame();
+    float *outputBuffer = output.getBlock();
+
+    int32_t framesProcessed = 0;
+    while (framesProcessed < numFrames) {
+        // Consume the input frames needed for the next output frame. Pull only what
+        // is needed for the rest of this block so that the input is never read ahead
+        // of the output.
+        while (mPhase >= mUpsampleFactor) {
+            int32_t framesNeeded = 1 + (mPhase - mUpsampleFactor
+                    + (numFrames - framesProcessed - 1) * mDownsampleFactor)
+                    / mUpsampleFactor;
+            if (!consumeInputFrame(framesNeeded)) {
+                return framesProcessed;
+            }
+        }
+
+        // Apply the filter phase for the position of this output frame.
+        const float *coefficients = &mCoefficients[mPhase * mNumTapsPerPhase];
+        const float *history = mHistory.data() + mHistoryCursor;
+        for (int32_t channel = 0; channel < channelCount; channel++) {
+            float sum = 0.0f;
+            for (int32_t tap = 0; tap < mNumTapsPerPhase; tap++) {
+                sum += coefficients[tap] * history[tap];
+            }
+            *outputBuffer++ = sum;
+            history += 2 * mNumTapsPerPhase;
+        }
+        mPhase += mDownsampleFactor;
+        framesProcessed++;
+    }
+    return framesProcessed;
+}
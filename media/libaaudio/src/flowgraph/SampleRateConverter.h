@@ -0,0 +1,128 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FLOWGRAPH_SAMPLE_RATE_CONVERTER_H
+#define FLOWGRAPH_SAMPLE_RATE_CONVERTER_H
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <vector>
+
+#include "AudioProcessorBase.h"
+
+namespace flowgraph {
+
+// Number of filter taps applied to the input for each output frame.
+constexpr int32_t kDefaultNumTapsPerPhase = 16;
+// Limit on the number of filter phases, which is the sink rate divided by the
+// greatest common divisor of the two rates. 441 is needed for 8000 => 44100.
+constexpr int32_t kMaxNumPhases = 1024;
+
+/**
+ * Streaming polyphase sample rate converter for a rational ratio of sample rates.
+ *
+ * The source rate is upsampled by L, low pass filtered and decimated by M,
+ * where L/M is the reduced ratio of the sink rate to the source rate.
+ * Only the filter phases that produce output are computed.
+ *
+ * Input frames are pulled only when they are needed for an output frame, so
+ * getOutputFramesForInputFrames() tells exactly how many frames can be read
+ * from the output before the input is exhausted. Input frames that are left
+ * over after that can be moved into the filter history with drainInput().
+ */
+class SampleRateConverter : public AudioProcessorBase {
+public:
+    SampleRateConverter(int32_t channelCount,
+                        int32_t sourceSampleRate,
+                        int32_t sinkSampleRate,
+                        int32_t numTapsPerPhase = kDefaultNumTapsPerPhase);
+
+    virtual ~SampleRateConverter() = default;
+
+    /**
+     * @return true if the conversion between these rates can be done with at most
+     *         kMaxNumPhases filter phases
+     */
+    static bool isSupported(int32_t sourceSampleRate, int32_t sinkSampleRate);
+
+    int32_t onProcess(int64_t framePosition, int32_t numFrames) override;
+
+    /**
+     * @param numInputFrames number of frames that will be available at the input
+     * @return number of output frames that can be produced from those input frames,
+     *         given the current state of the converter
+     */
+    int32_t getOutputFramesForInputFrames(int32_t numInputFrames) const;
+
+    /**
+     * @param numOutputFrames number of output frames to produce
+     * @return number of input frames that will be consumed to produce them,
+     *         given the current state of the converter
+     */
+    int32_t getInputFramesForOutputFrames(int32_t numOutputFrames) const;
+
+    /**
+     * Consume input frames that are not needed yet for the next output frame,
+     * so that the source data can be released.
+     * There must be fewer of them than would be needed for the next output frame.
+     *
+     * @param numFrames number of frames to pull from the input
+     * @return number of frames consumed
+     */
+    int32_t drainInput(int32_t numFrames);
+
+    /**
+     * @return delay of the filter, in source frames
+     */
+    double getLatencyInSourceFrames() const {
+        return (mUpsampleFactor * mNumTapsPerPhase - 1) / (2.0 * mUpsampleFactor);
+    }
+
+    AudioFloatInputPort input;
+    AudioFloatOutputPort output;
+
+private:
+    /**
+     * Move the next input frame into the history, pulling at most maxFramesToPull
+     * frames if the current input block is used up.
+     * @return false if no input frame is available
+     */
+    bool consumeInputFrame(int32_t maxFramesToPull);
+
+    void writeHistory(const float *frame);
+
+    const int32_t      mNumTapsPerPhase;
+    int32_t            mUpsampleFactor = 1;   // L, also the number of phases
+    int32_t            mDownsampleFactor = 1; // M
+    int32_t            mPhase = 0; // >= L when the next input frame must be consumed
+
+    // Coefficients for each phase, stored in reverse tap order so that they line up
+    // with the history, which is stored oldest first.
+    std::vector<float> mCoefficients;
+
+    // Per channel history of 2 * mNumTapsPerPhase samples. Each input sample is written
+    // twice so that the last mNumTapsPerPhase samples are always contiguous.
+    std::vector<float> mHistory;
+    int32_t            mHistoryCursor = 0;
+
+    int64_t            mInputFramePosition = 0; // position of the next input block
+    int32_t            mInputFramesValid = 0;   // number of frames in the input block
+    int32_t            mInputCursor = 0;        // next frame to consume in the input block
+};
+
+} /* namespace flowgraph */
+
+#endif //FLOWGRAPH_SAMPLE_RATE_CONVERTER_H
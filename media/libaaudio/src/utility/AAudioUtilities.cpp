@@ -368,6 +368,15 @@ int32_t AAudioProperty_getOutputMMapOffsetMicros() {
     return AAudioProperty_getMMapOffsetMicros(__func__, AAUDIO_PROP_OUTPUT_MMAP_OFFSET_USEC);
 }
 
+int32_t AAudioProperty_getClockModel() {
+    int32_t prop = property_get_int32(AAUDIO_PROP_CLOCK_MODEL, AAUDIO_CLOCK_MODEL_FIXED);
+    if (prop != AAUDIO_CLOCK_MODEL_FIXED && prop != AAUDIO_CLOCK_MODEL_ADAPTIVE) {
+        ALOGE("AAudioProperty_getClockModel: invalid = %d", prop);
+        prop = AAUDIO_CLOCK_MODEL_FIXED;
+    }
+    return prop;
+}
+
 int32_t AAudioProperty_getLogMask() {
     return property_get_int32(AAUDIO_PROP_LOG_MASK, 0);
 }
@@ -165,6 +165,20 @@ int32_t AAudioProperty_getInputMMapOffsetMicros();
 int32_t AAudioProperty_getOutputMMapOffsetMicros();
 #define AAUDIO_PROP_OUTPUT_MMAP_OFFSET_USEC   "aaudio.out_mmap_offset_usec"
 
+/**
+ * Read a system property that selects the model used to track the timestamps of MMAP streams.
+ * It is read when each stream is opened.
+ *
+ * @return AAUDIO_CLOCK_MODEL_FIXED or AAUDIO_CLOCK_MODEL_ADAPTIVE
+ */
+int32_t AAudioProperty_getClockModel();
+#define AAUDIO_PROP_CLOCK_MODEL   "aaudio.clock_model"
+
+// Fixed jitter allowance that slowly follows the lateness of the timestamps.
+#define AAUDIO_CLOCK_MODEL_FIXED      0
+// Estimate the drift and jitter from a window of recent timestamps.
+#define AAUDIO_CLOCK_MODEL_ADAPTIVE   1
+
 // These are powers of two that can be combined as a bit mask.
 // AAUDIO_LOG_CLOCK_MODEL_HISTOGRAM must be enabled before the stream is opened.
 #define AAUDIO_LOG_CLOCK_MODEL_HISTOGRAM   1
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stress a FifoBuffer with a producer thread and a consumer thread.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "fifo/FifoBuffer.h"
+
+using android::FifoBatchReader;
+using android::FifoBatchWriter;
+using android::FifoBuffer;
+using android::fifo_counter_t;
+using android::fifo_frames_t;
+
+constexpr int32_t kBytesPerFrame = 2 * sizeof(float); // stereo float
+constexpr fifo_frames_t kCapacityInFrames = 4 * 192;
+constexpr int32_t kStepsPerBatch = 4;
+
+// Pass data through the FIFO in chunks of arg 0 frames.
+// If arg 1 is set then the counters are only published once every kStepsPerBatch chunks,
+// as a callback that reads or writes several small chunks would do.
+static void BM_FifoProducerConsumer(benchmark::State& state) {
+    const fifo_frames_t framesPerChunk = state.range(0);
+    const bool batched = state.range(1) != 0;
+    const fifo_counter_t framesPerIteration = kStepsPerBatch * framesPerChunk;
+
+    fifo_counter_t readCounter = 0;
+    fifo_counter_t writeCounter = 0;
+    std::vector<uint8_t> storage(kCapacityInFrames * kBytesPerFrame);
+    FifoBuffer fifo(kBytesPerFrame, kCapacityInFrames, &readCounter, &writeCounter,
+                    storage.data());
+    std::atomic<bool> running{true};
+
+    std::thread producer([&]() {
+        std::vector<uint8_t> chunk(framesPerChunk * kBytesPerFrame);
+        while (running.load(std::memory_order_relaxed)) {
+            fifo_frames_t framesWritten = 0;
+            if (batched) {
+                FifoBatchWriter writer(fifo);
+                for (int step = 0; step < kStepsPerBatch; step++) {
+                    framesWritten += writer.write(chunk.data(), framesPerChunk);
+                }
+            } else {
+                for (int step = 0; step < kStepsPerBatch; step++) {
+                    framesWritten += fifo.write(chunk.data(), framesPerChunk);
+                }
+            }
+            if (framesWritten == 0) {
+                std::this_thread::yield(); // let the consumer run
+            }
+        }
+    });
+
+    std::vector<uint8_t> chunk(framesPerChunk * kBytesPerFrame);
+    int64_t framesRead = 0;
+    for (auto _ : state) {
+        // Keep reading until one batch worth of frames has been consumed.
+        fifo_counter_t framesLeft = framesPerIteration;
+        while (framesLeft > 0) {
+            fifo_frames_t framesReadNow = 0;
+            if (batched) {
+                FifoBatchReader reader(fifo);
+                for (int step = 0; step < kStepsPerBatch; step++) {
+                    framesReadNow += reader.read(chunk.data(), framesPerChunk);
+                }
+            } else {
+                for (int step = 0; step < kStepsPerBatch; step++) {
+                    framesReadNow += fifo.read(chunk.data(), framesPerChunk);
+                }
+            }
+            if (framesReadNow == 0) {
+                std::this_thread::yield(); // let the producer run
+            }
+            framesLeft -= framesReadNow;
+        }
+        framesRead += framesPerIteration - framesLeft;
+    }
+    running.store(false);
+    producer.join();
+    state.SetItemsProcessed(framesRead);
+}
+
+static void FifoProducerConsumerArgs(benchmark::internal::Benchmark *b) {
+    for (int framesPerChunk : {16, 48, 192}) {
+        for (int batched : {0, 1}) {
+            b->Args({framesPerChunk, batched});
+        }
+    }
+}
+
+BENCHMARK(BM_FifoProducerConsumer)->Apply(FifoProducerConsumerArgs)->UseRealTime();
+
+BENCHMARK_MAIN();
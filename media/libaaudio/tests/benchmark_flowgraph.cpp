@@ -0,0 +1,114 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark the AAudio client flowgraph on bursts of audio.
+ */
+
+#include <math.h>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "client/AAudioFlowGraph.h"
+
+constexpr int32_t kFramesPerBurst = 192;
+
+// Write one burst to the sink, as AudioStreamInternalPlay does, with the source
+// rate and channel count of args 0 and 1, and a 48000 Hz stereo sink.
+static void BM_FlowGraphFloatToI16(benchmark::State& state) {
+    const int32_t sourceRate = state.range(0);
+    const int32_t sourceChannelCount = state.range(1);
+    constexpr int32_t sinkRate = 48000;
+    constexpr int32_t sinkChannelCount = 2;
+
+    AAudioFlowGraph graph;
+    if (graph.configure(AUDIO_FORMAT_PCM_FLOAT, sourceChannelCount,
+                        AUDIO_FORMAT_PCM_16_BIT, sinkChannelCount,
+                        sourceRate, sinkRate) != AAUDIO_OK) {
+        state.SkipWithError("Unsupported configuration");
+        return;
+    }
+
+    const int32_t sourceFrames = graph.getSourceFramesForSinkFrames(kFramesPerBurst) + 1;
+    std::vector<float> source(sourceFrames * sourceChannelCount);
+    for (size_t i = 0; i < source.size(); i++) {
+        source[i] = sinf(i * 0.01f) * 0.5f;
+    }
+    std::vector<int16_t> sink(2 * kFramesPerBurst * sinkChannelCount);
+
+    int64_t framesWritten = 0;
+    for (auto _ : state) {
+        int32_t numSourceFrames = graph.getSourceFramesForSinkFrames(kFramesPerBurst);
+        framesWritten += graph.process(source.data(), numSourceFrames, sink.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(framesWritten);
+}
+
+BENCHMARK(BM_FlowGraphFloatToI16)
+    ->Args({48000, 2})  // no rate conversion
+    ->Args({44100, 2})
+    ->Args({44100, 1})
+    ->Args({16000, 1})
+    ->Args({96000, 2});
+
+// Convert one burst with a steady volume, with and without the single pass
+// fast path. Args are the frames per burst, the source channel count
+// and whether the fast path is enabled.
+static void BM_FlowGraphSteadyFloatToI16(benchmark::State& state) {
+    const int32_t framesPerBurst = state.range(0);
+    const int32_t sourceChannelCount = state.range(1);
+    constexpr int32_t sinkChannelCount = 2;
+
+    AAudioFlowGraph graph;
+    if (graph.configure(AUDIO_FORMAT_PCM_FLOAT, sourceChannelCount,
+                        AUDIO_FORMAT_PCM_16_BIT, sinkChannelCount) != AAUDIO_OK) {
+        state.SkipWithError("Unsupported configuration");
+        return;
+    }
+    graph.setFastPathEnabled(state.range(2) != 0);
+    graph.setRampLengthInFrames(0);
+    graph.setTargetVolume(0.5f);
+
+    std::vector<float> source(framesPerBurst * sourceChannelCount);
+    for (size_t i = 0; i < source.size(); i++) {
+        source[i] = sinf(i * 0.01f) * 0.5f;
+    }
+    std::vector<int16_t> sink(framesPerBurst * sinkChannelCount);
+
+    int64_t framesWritten = 0;
+    for (auto _ : state) {
+        graph.process(source.data(), sink.data(), framesPerBurst);
+        framesWritten += framesPerBurst;
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(framesWritten);
+}
+
+static void FlowGraphSteadyArgs(benchmark::internal::Benchmark *b) {
+    for (int framesPerBurst : {48, 96, 192}) {
+        for (int sourceChannelCount : {1, 2}) {
+            for (int fastPath : {0, 1}) {
+                b->Args({framesPerBurst, sourceChannelCount, fastPath});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_FlowGraphSteadyFloatToI16)->Apply(FlowGraphSteadyArgs);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark the shared MMAP endpoint mixer with several client streams.
+ */
+
+#include <math.h>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "AAudioMixer.h"
+
+using android::FifoBuffer;
+
+constexpr int32_t kFramesPerBurst = 192;
+constexpr int32_t kSamplesPerFrame = 2;
+// Not a multiple of the burst so that the mixer has to handle wrapping.
+constexpr int32_t kFifoCapacityInFrames = 1000;
+
+// Mix one burst from each stream. Arg 0 is the number of streams.
+// Arg 1 selects one mix() call per stream, as before, or one call for all the streams.
+static void BM_MixStreams(benchmark::State& state) {
+    const int32_t numStreams = state.range(0);
+    const bool batched = state.range(1) != 0;
+
+    AAudioMixer mixer;
+    mixer.allocate(kSamplesPerFrame, kFramesPerBurst);
+
+    std::vector<std::unique_ptr<FifoBuffer>> fifos;
+    std::vector<float> burst(kFramesPerBurst * kSamplesPerFrame);
+    for (size_t i = 0; i < burst.size(); i++) {
+        burst[i] = sinf(i * 0.01f) * 0.1f;
+    }
+    for (int32_t i = 0; i < numStreams; i++) {
+        fifos.push_back(std::make_unique<FifoBuffer>(kSamplesPerFrame * sizeof(float),
+                                                     kFifoCapacityInFrames));
+        fifos.back()->write(burst.data(), kFramesPerBurst);
+    }
+    std::vector<AAudioMixer::StreamInput> inputs(numStreams);
+
+    for (auto _ : state) {
+        mixer.clear();
+        if (batched) {
+            for (int32_t i = 0; i < numStreams; i++) {
+                inputs[i].streamIndex = i;
+                inputs[i].fifo = fifos[i].get();
+                inputs[i].gainFrom = inputs[i].gainTo = 0.5f;
+            }
+            mixer.mix(inputs.data(), numStreams);
+        } else {
+            for (int32_t i = 0; i < numStreams; i++) {
+                mixer.mix(i, fifos[i].get(), true /* allowUnderflow */);
+            }
+        }
+        // Refill the FIFOs. The stale data is still valid audio.
+        for (int32_t i = 0; i < numStreams; i++) {
+            fifos[i]->advanceWriteIndex(kFramesPerBurst);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * numStreams * kFramesPerBurst);
+}
+
+static void MixStreamsArgs(benchmark::internal::Benchmark *b) {
+    for (int numStreams : {1, 2, 4, 8, 16}) {
+        for (int batched : {0, 1}) {
+            b->Args({numStreams, batched});
+        }
+    }
+}
+
+BENCHMARK(BM_MixStreams)->Apply(MixStreamsArgs);
+
+BENCHMARK_MAIN();
@@ -25,6 +25,8 @@
 using android::fifo_frames_t;
 using android::fifo_counter_t;
 using android::FifoController;
+using android::FifoBatchReader;
+using android::FifoBatchWriter;
 using android::FifoBuffer;
 using android::WrappingBuffer;
 
@@ -325,6 +327,53 @@ public:
         verifyStorageIntegrity();
     }
 
+    // Write and read in several steps per batch. The counters must only change on commit.
+    void checkBatchWriteRead() {
+        constexpr int kStepsPerBatch = 3;
+        constexpr int kFramesPerStep = 11; // arbitrary
+        for (int batch = 0; batch < 5; batch++) {
+            const fifo_counter_t writeCounter = mFifoBuffer.getWriteCounter();
+            {
+                FifoBatchWriter writer(mFifoBuffer);
+                for (int step = 0; step < kStepsPerBatch; step++) {
+                    for (int i = 0; i < kFramesPerStep; i++) {
+                        mData[i] = mNextWriteIndex++;
+                    }
+                    ASSERT_EQ(kFramesPerStep, writer.write(mData, kFramesPerStep));
+                    ASSERT_EQ(writeCounter, mFifoBuffer.getWriteCounter());
+                }
+                writer.commit();
+                ASSERT_EQ(writeCounter + kStepsPerBatch * kFramesPerStep,
+                          mFifoBuffer.getWriteCounter());
+            }
+
+            // Consume the data in place.
+            const fifo_counter_t readCounter = mFifoBuffer.getReadCounter();
+            {
+                FifoBatchReader reader(mFifoBuffer);
+                for (int step = 0; step < kStepsPerBatch; step++) {
+                    WrappingBuffer wrappingBuffer;
+                    fifo_frames_t available = reader.getFullDataAvailable(&wrappingBuffer);
+                    ASSERT_EQ((kStepsPerBatch - step) * kFramesPerStep, available);
+                    int framesLeft = kFramesPerStep;
+                    for (int part = 0; part < WrappingBuffer::SIZE && framesLeft > 0; part++) {
+                        const int16_t *data = (const int16_t *) wrappingBuffer.data[part];
+                        int framesToCheck = std::min(framesLeft, wrappingBuffer.numFrames[part]);
+                        for (int i = 0; i < framesToCheck; i++) {
+                            ASSERT_EQ(mNextVerifyIndex++, data[i]);
+                        }
+                        framesLeft -= framesToCheck;
+                    }
+                    reader.advanceReadIndex(kFramesPerStep);
+                    ASSERT_EQ(readCounter, mFifoBuffer.getReadCounter());
+                }
+            } // The reader commits when it is destroyed.
+            ASSERT_EQ(readCounter + kStepsPerBatch * kFramesPerStep,
+                      mFifoBuffer.getReadCounter());
+        }
+        verifyStorageIntegrity();
+    }
+
     FifoBuffer     mFifoBuffer;
     fifo_frames_t  mNextWriteIndex = 0;
     fifo_frames_t  mNextVerifyIndex = 0;
@@ -386,3 +435,9 @@ TEST(test_fifo_buffer, fifo_full_wrap) {
     TestFifoBuffer tester(capacity);
     tester.checkFullWrap();
 }
+
+TEST(test_fifo_buffer, fifo_batch_write_read) {
+    constexpr int capacity = 53; // arbitrary, not a multiple of the batch size
+    TestFifoBuffer tester(capacity);
+    tester.checkBatchWriteRead();
+}
@@ -16,8 +16,10 @@
 
 // Unit tests for Isochronous Clock Model
 
+#include <algorithm>
 #include <math.h>
 #include <stdlib.h>
+#include <vector>
 
 
 #include <aaudio/AAudio.h>
@@ -163,4 +165,153 @@ TEST_F(ClockModelTestFixture, clock_slow_drift) {
 
 TEST_F(ClockModelTestFixture, clock_fast_drift) {
     checkDriftingClock(1.002 * SAMPLE_RATE, NUM_LOOPS_DRIFT);
-}
\ No newline at end of file
+}
+
+// Replay timestamp traces that look like those recorded from MMAP streams
+// and measure how well each model predicts the DSP position.
+// A trace is generated from a list of burst times so the true position is known at any time.
+class ClockModelTraceTest : public ::testing::Test {
+public:
+    struct TraceTimestamp {
+        int64_t framePosition;
+        int64_t nanoTime;
+    };
+
+    struct Trace {
+        std::vector<int64_t> burstNanos;        // time at which each DSP burst completed
+        std::vector<TraceTimestamp> timestamps; // what the service reported
+    };
+
+    struct Result {
+        double glitchRatio;        // probes where the DSP was ahead of the early estimate
+        double meanExcessMicros;   // how far behind the DSP the latest estimate was
+        double lateGlitchRatio;    // probes where the latest estimate was ahead of the DSP
+    };
+
+    /**
+     * @param framesPerSecond true rate of the DSP
+     * @param burstJitterMicros maximum random delay of each DSP burst
+     * @param preemptionInterval every this many timestamps, report one very late
+     */
+    static Trace makeTrace(double framesPerSecond, int32_t burstJitterMicros,
+                           int32_t preemptionInterval, int32_t numTimestamps) {
+        constexpr int64_t kStartNanos = 200 * NANOS_PER_MILLISECOND; // arbitrary
+        constexpr int64_t kPreemptionNanos = 3 * NANOS_PER_MILLISECOND;
+        const double nanosPerBurst = NANOS_PER_SECOND * HW_FRAMES_PER_BURST / framesPerSecond;
+        Trace trace;
+        srand48(1234); // repeatable
+        // Generate enough bursts for the timestamps below.
+        const int64_t numBursts = 12 * (int64_t) numTimestamps;
+        for (int64_t i = 0; i < numBursts; i++) {
+            trace.burstNanos.push_back(kStartNanos + (int64_t) (i * nanosPerBurst)
+                    + (int64_t) (drand48() * burstJitterMicros * NANOS_PER_MICROSECOND));
+        }
+        // Timestamps are sampled at random times, like the service does.
+        int64_t nanoTime = kStartNanos + (int64_t) nanosPerBurst;
+        for (int32_t i = 0; i < numTimestamps; i++) {
+            nanoTime += (int64_t) ((0.5 + 9.0 * drand48()) * nanosPerBurst);
+            TraceTimestamp timestamp = {positionAt(trace, nanoTime), nanoTime};
+            if (preemptionInterval > 0 && (i % preemptionInterval) == preemptionInterval - 1) {
+                timestamp.nanoTime += kPreemptionNanos; // reported late
+            }
+            trace.timestamps.push_back(timestamp);
+        }
+        return trace;
+    }
+
+    static int64_t positionAt(const Trace &trace, int64_t nanoTime) {
+        auto it = std::upper_bound(trace.burstNanos.begin(), trace.burstNanos.end(), nanoTime);
+        return (it - trace.burstNanos.begin()) * HW_FRAMES_PER_BURST;
+    }
+
+    static Result replay(const Trace &trace, bool adaptive) {
+        IsochronousClockModel model;
+        model.setSampleRate(SAMPLE_RATE);
+        model.setFramesPerBurst(HW_FRAMES_PER_BURST);
+        model.setAdaptiveEnabled(adaptive);
+        model.start(trace.timestamps[0].nanoTime - NANOS_PER_MILLISECOND);
+
+        // Skip the startup because both models are still syncing.
+        constexpr size_t kSkipTimestamps = 50;
+        int32_t numProbes = 0;
+        int32_t numGlitches = 0;
+        int32_t numLateGlitches = 0;
+        double sumExcessFrames = 0.0;
+        for (size_t i = 0; i + 1 < trace.timestamps.size(); i++) {
+            model.processTimestamp(trace.timestamps[i].framePosition,
+                                   trace.timestamps[i].nanoTime);
+            if (i < kSkipTimestamps) continue;
+            // Probe between this timestamp and the next one, as a stream would.
+            const int64_t begin = trace.timestamps[i].nanoTime;
+            const int64_t end = trace.timestamps[i + 1].nanoTime;
+            for (int64_t probe = begin; probe < end; probe += NANOS_PER_BURST / 3) {
+                const int64_t actual = positionAt(trace, probe);
+                // Only count errors larger than a burst, which would be audible.
+                if (actual > model.convertTimeToPosition(probe) + HW_FRAMES_PER_BURST) {
+                    numGlitches++;
+                }
+                const int64_t latest = model.convertLatestTimeToPosition(probe);
+                if (latest > actual) {
+                    numLateGlitches++;
+                }
+                sumExcessFrames += std::max((int64_t) 0, actual - latest);
+                numProbes++;
+            }
+        }
+        Result result;
+        result.glitchRatio = (double) numGlitches / numProbes;
+        result.lateGlitchRatio = (double) numLateGlitches / numProbes;
+        result.meanExcessMicros = sumExcessFrames / numProbes
+                * NANOS_PER_SECOND / SAMPLE_RATE / NANOS_PER_MICROSECOND;
+        return result;
+    }
+};
+
+// A regular DSP: both models must track it without glitches.
+TEST_F(ClockModelTraceTest, trace_steady) {
+    Trace trace = makeTrace(SAMPLE_RATE, 0 /* burstJitterMicros */, 0, 2000);
+    for (bool adaptive : {false, true}) {
+        Result result = replay(trace, adaptive);
+        EXPECT_EQ(0.0, result.glitchRatio) << "adaptive = " << adaptive;
+        EXPECT_EQ(0.0, result.lateGlitchRatio) << "adaptive = " << adaptive;
+    }
+}
+
+// Occasional very late timestamps, for example caused by preemption, make the fixed model
+// keep a large window for a long time. The adaptive model should ignore them.
+TEST_F(ClockModelTraceTest, trace_preemption) {
+    Trace trace = makeTrace(SAMPLE_RATE, 500 /* burstJitterMicros */, 40, 2000);
+    Result fixed = replay(trace, false);
+    Result adaptive = replay(trace, true);
+    EXPECT_EQ(0.0, adaptive.glitchRatio);
+    EXPECT_EQ(0.0, adaptive.lateGlitchRatio);
+    EXPECT_LT(adaptive.meanExcessMicros, 0.5 * fixed.meanExcessMicros);
+}
+
+// DSP bursts with variable timing on a drifting clock.
+TEST_F(ClockModelTraceTest, trace_variable_bursts_with_drift) {
+    for (double ratio : {0.998, 1.002}) {
+        Trace trace = makeTrace(ratio * SAMPLE_RATE, 2000 /* burstJitterMicros */, 40, 2000);
+        Result fixed = replay(trace, false);
+        Result adaptive = replay(trace, true);
+        EXPECT_EQ(0.0, adaptive.glitchRatio) << "ratio = " << ratio;
+        EXPECT_LT(adaptive.lateGlitchRatio, 0.001) << "ratio = " << ratio;
+        EXPECT_LT(adaptive.meanExcessMicros, fixed.meanExcessMicros) << "ratio = " << ratio;
+    }
+}
+
+// The measured rate should follow a drifting clock.
+TEST_F(ClockModelTraceTest, trace_measured_rate) {
+    for (double ratio : {0.998, 1.0, 1.002}) {
+        Trace trace = makeTrace(ratio * SAMPLE_RATE, 500 /* burstJitterMicros */, 0, 1000);
+        IsochronousClockModel model;
+        model.setSampleRate(SAMPLE_RATE);
+        model.setFramesPerBurst(HW_FRAMES_PER_BURST);
+        model.setAdaptiveEnabled(true);
+        model.start(trace.timestamps[0].nanoTime - NANOS_PER_MILLISECOND);
+        for (const TraceTimestamp &timestamp : trace.timestamps) {
+            model.processTimestamp(timestamp.framePosition, timestamp.nanoTime);
+        }
+        EXPECT_NEAR(ratio * SAMPLE_RATE, model.getMeasuredSampleRate(), 0.001 * SAMPLE_RATE);
+    }
+}
@@ -19,6 +19,8 @@
  */
 
 #include <iostream>
+#include <type_traits>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -26,12 +28,15 @@
 #include "flowgraph/MonoToMultiConverter.h"
 #include "flowgraph/SourceFloat.h"
 #include "flowgraph/RampLinear.h"
+#include "flowgraph/SampleRateConverter.h"
 #include "flowgraph/SinkFloat.h"
 #include "flowgraph/SinkI16.h"
 #include "flowgraph/SinkI24.h"
 #include "flowgraph/SourceI16.h"
 #include "flowgraph/SourceI24.h"
 
+#include "client/AAudioFlowGraph.h"
+
 using namespace flowgraph;
 
 constexpr int kBytesPerI24Packed = 3;
@@ -155,3 +160,263 @@ TEST(test_flowgraph, module_clip_to_range) {
         EXPECT_NEAR(expected[i], output[i], tolerance);
     }
 }
+
+// Convert the source in bursts through a graph, like a stream would.
+static std::vector<float> convertInBursts(AAudioFlowGraph &graph,
+                                          const std::vector<float> &source,
+                                          int32_t channelCount,
+                                          int32_t framesPerBurst) {
+    std::vector<float> sink;
+    int32_t numFrames = source.size() / channelCount;
+    for (int32_t frame = 0; frame < numFrames; frame += framesPerBurst) {
+        int32_t framesToConvert = std::min(framesPerBurst, numFrames - frame);
+        int32_t expected = graph.getSinkFramesForSourceFrames(framesToConvert);
+        std::vector<float> burst(expected * channelCount);
+        int32_t written = graph.process(&source[frame * channelCount], framesToConvert,
+                                        burst.data());
+        EXPECT_EQ(expected, written);
+        sink.insert(sink.end(), burst.begin(), burst.end());
+    }
+    return sink;
+}
+
+static std::vector<float> makeSine(double frequency, int32_t sampleRate, int32_t numFrames) {
+    std::vector<float> sine(numFrames);
+    for (int32_t i = 0; i < numFrames; i++) {
+        sine[i] = 0.5f * sin(2.0 * M_PI * frequency * i / sampleRate);
+    }
+    return sine;
+}
+
+// Signal to noise ratio of a sine wave, after fitting its amplitude and phase.
+static double measureSineSnr(const std::vector<float> &signal, double frequency,
+                             int32_t sampleRate, int32_t skipFrames) {
+    double ss = 0.0, cc = 0.0, sc = 0.0, ys = 0.0, yc = 0.0;
+    for (size_t i = skipFrames; i < signal.size(); i++) {
+        double phase = 2.0 * M_PI * frequency * i / sampleRate;
+        double s = sin(phase), c = cos(phase);
+        ss += s * s; cc += c * c; sc += s * c;
+        ys += signal[i] * s; yc += signal[i] * c;
+    }
+    double det = ss * cc - sc * sc;
+    double a = (ys * cc - yc * sc) / det;
+    double b = (yc * ss - ys * sc) / det;
+    double signalPower = 0.0, noisePower = 0.0;
+    for (size_t i = skipFrames; i < signal.size(); i++) {
+        double phase = 2.0 * M_PI * frequency * i / sampleRate;
+        double fit = a * sin(phase) + b * cos(phase);
+        signalPower += fit * fit;
+        noisePower += (signal[i] - fit) * (signal[i] - fit);
+    }
+    return 10.0 * log10(signalPower / noisePower);
+}
+
+TEST(test_flowgraph, module_sample_rate_converter_supported) {
+    EXPECT_TRUE(SampleRateConverter::isSupported(44100, 48000));
+    EXPECT_TRUE(SampleRateConverter::isSupported(48000, 44100));
+    EXPECT_TRUE(SampleRateConverter::isSupported(8000, 44100));
+    EXPECT_TRUE(SampleRateConverter::isSupported(11025, 48000));
+    EXPECT_FALSE(SampleRateConverter::isSupported(44101, 48000));
+    EXPECT_FALSE(SampleRateConverter::isSupported(0, 48000));
+}
+
+TEST(test_flowgraph, module_sample_rate_converter_frame_counts) {
+    const int32_t rates[][2] = {{44100, 48000}, {48000, 44100}, {16000, 48000}, {48000, 8000}};
+    for (const auto &rate : rates) {
+        SampleRateConverter converter{2, rate[0], rate[1]};
+        SinkFloat sinkFloat{2};
+        SourceFloat sourceFloat{2};
+        sourceFloat.output.connect(&converter.input);
+        converter.output.connect(&sinkFloat.input);
+
+        std::vector<float> input(2 * 997, 0.25f);
+        std::vector<float> output(2 * 8192);
+        int64_t totalInput = 0;
+        int64_t totalOutput = 0;
+        for (int burst = 0; burst < 50; burst++) {
+            int32_t numInput = 1 + (burst * 37) % 997; // vary the burst size
+            int32_t expected = converter.getOutputFramesForInputFrames(numInput);
+            int32_t used = converter.getInputFramesForOutputFrames(expected);
+            EXPECT_LE(used, numInput);
+            sourceFloat.setData(input.data(), numInput);
+            ASSERT_EQ(expected, sinkFloat.read(output.data(), expected));
+            EXPECT_EQ(numInput - used, converter.drainInput(numInput - used));
+            totalInput += numInput;
+            totalOutput += expected;
+        }
+        // Every input frame was consumed, so the output count follows the ratio.
+        double expectedOutput = static_cast<double>(totalInput) * rate[1] / rate[0];
+        EXPECT_NEAR(expectedOutput, totalOutput, 1.0) << rate[0] << " => " << rate[1];
+    }
+}
+
+TEST(test_flowgraph, module_sample_rate_converter_latency) {
+    constexpr int32_t sourceRate = 44100;
+    constexpr int32_t sinkRate = 48000;
+    constexpr int32_t impulseFrame = 300;
+    std::vector<float> input(2000, 0.0f);
+    input[impulseFrame] = 1.0f;
+    SourceFloat sourceFloat{1};
+    SampleRateConverter converter{1, sourceRate, sinkRate};
+    SinkFloat sinkFloat{1};
+    sourceFloat.output.connect(&converter.input);
+    converter.output.connect(&sinkFloat.input);
+
+    sourceFloat.setData(input.data(), input.size());
+    std::vector<float> output(converter.getOutputFramesForInputFrames(input.size()));
+    ASSERT_EQ((int32_t) output.size(), sinkFloat.read(output.data(), output.size()));
+
+    size_t peak = std::max_element(output.begin(), output.end()) - output.begin();
+    double expectedPeak = (impulseFrame + converter.getLatencyInSourceFrames())
+            * sinkRate / sourceRate;
+    EXPECT_NEAR(expectedPeak, peak, 1.0);
+    // The filter delay must stay well below a typical burst.
+    EXPECT_LT(converter.getLatencyInSourceFrames(), 16.0);
+}
+
+TEST(test_flowgraph, module_sample_rate_converter_dc) {
+    std::vector<float> input(1000, 0.75f);
+    SourceFloat sourceFloat{1};
+    SampleRateConverter converter{1, 44100, 48000};
+    SinkFloat sinkFloat{1};
+    sourceFloat.output.connect(&converter.input);
+    converter.output.connect(&sinkFloat.input);
+
+    sourceFloat.setData(input.data(), input.size());
+    std::vector<float> output(converter.getOutputFramesForInputFrames(input.size()));
+    ASSERT_EQ((int32_t) output.size(), sinkFloat.read(output.data(), output.size()));
+    for (size_t i = kDefaultNumTapsPerPhase * 2; i < output.size(); i++) {
+        EXPECT_NEAR(0.75f, output[i], 0.0001f) << "frame " << i;
+    }
+}
+
+TEST(test_flowgraph, graph_sample_rate_converter_quality) {
+    const int32_t rates[][2] = {{44100, 48000}, {48000, 44100}, {22050, 48000}};
+    constexpr double frequency = 1000.0;
+    constexpr double minSnr = 70.0; // dB
+    for (const auto &rate : rates) {
+        AAudioFlowGraph graph;
+        ASSERT_EQ(AAUDIO_OK, graph.configure(AUDIO_FORMAT_PCM_FLOAT, 1,
+                                             AUDIO_FORMAT_PCM_FLOAT, 1,
+                                             rate[0], rate[1]));
+        graph.setRampLengthInFrames(0);
+        std::vector<float> source = makeSine(frequency, rate[0], rate[0] / 4);
+        std::vector<float> sink = convertInBursts(graph, source, 1, 192);
+        EXPECT_NEAR(source.size() * static_cast<double>(rate[1]) / rate[0], sink.size(), 1.0);
+        double snr = measureSineSnr(sink, frequency, rate[1], 2 * kDefaultNumTapsPerPhase);
+        EXPECT_GT(snr, minSnr) << rate[0] << " => " << rate[1];
+    }
+}
+
+TEST(test_flowgraph, graph_sample_rate_converter_mono_to_stereo) {
+    AAudioFlowGraph graph;
+    ASSERT_EQ(AAUDIO_OK, graph.configure(AUDIO_FORMAT_PCM_FLOAT, 1,
+                                         AUDIO_FORMAT_PCM_16_BIT, 2,
+                                         44100, 48000));
+    std::vector<float> source = makeSine(440.0, 44100, 4410);
+    int32_t numSinkFrames = graph.getSinkFramesForSourceFrames(source.size());
+    EXPECT_LE(graph.getSourceFramesForSinkFrames(numSinkFrames), (int32_t) source.size());
+    std::vector<int16_t> sink(numSinkFrames * 2);
+    ASSERT_EQ(numSinkFrames, graph.process(source.data(), source.size(), sink.data()));
+    for (int32_t i = 0; i < numSinkFrames; i++) {
+        EXPECT_EQ(sink[2 * i], sink[2 * i + 1]);
+    }
+}
+
+// Fill a FIFO of varying room like AudioStreamInternalPlay does when it converts the rate.
+TEST(test_flowgraph, graph_sample_rate_converter_max_source_frames) {
+    const int32_t rates[][2] = {{44100, 48000}, {48000, 44100}, {8000, 48000}, {48000, 16000}};
+    for (const auto &rate : rates) {
+        AAudioFlowGraph graph;
+        ASSERT_EQ(AAUDIO_OK, graph.configure(AUDIO_FORMAT_PCM_FLOAT, 1,
+                                             AUDIO_FORMAT_PCM_FLOAT, 1,
+                                             rate[0], rate[1]));
+        std::vector<float> source(1024, 0.5f);
+        std::vector<float> sink(1024);
+        int64_t totalSource = 0;
+        int64_t totalSink = 0;
+        for (int write = 0; write < 500; write++) {
+            int32_t room = (write * 53) % 300; // vary the room in the FIFO
+            int32_t numSourceFrames = graph.getMaxSourceFramesForSinkFrames(room);
+            EXPECT_GT(graph.getSinkFramesForSourceFrames(numSourceFrames + 1), room)
+                    << rate[0] << " => " << rate[1] << ", room " << room;
+            if (numSourceFrames == 0) {
+                continue;
+            }
+            int32_t numSinkFrames = graph.getSinkFramesForSourceFrames(numSourceFrames);
+            ASSERT_LE(numSinkFrames, room) << rate[0] << " => " << rate[1];
+            ASSERT_EQ(numSinkFrames, graph.process(source.data(), numSourceFrames, sink.data()));
+            totalSource += numSourceFrames;
+            totalSink += numSinkFrames;
+        }
+        // Nothing is lost or held back by the converter, beyond the next sink frame.
+        double expectedSink = static_cast<double>(totalSource) * rate[1] / rate[0];
+        EXPECT_NEAR(expectedSink, totalSink, 2.0) << rate[0] << " => " << rate[1];
+    }
+}
+
+// Run the same data through the single pass fast path and through the graph.
+// The outputs must be identical, including while the volume is ramping.
+template <typename SourceType, typename SinkType>
+static void checkFastPathMatchesGraph(audio_format_t sourceFormat,
+                                      int32_t sourceChannelCount,
+                                      audio_format_t sinkFormat,
+                                      int32_t sinkChannelCount) {
+    constexpr int32_t kFramesPerBurst = 96;
+    constexpr int32_t kNumBursts = 20;
+    AAudioFlowGraph fastGraph;
+    AAudioFlowGraph slowGraph;
+    ASSERT_EQ(AAUDIO_OK, fastGraph.configure(sourceFormat, sourceChannelCount,
+                                             sinkFormat, sinkChannelCount));
+    ASSERT_EQ(AAUDIO_OK, slowGraph.configure(sourceFormat, sourceChannelCount,
+                                             sinkFormat, sinkChannelCount));
+    slowGraph.setFastPathEnabled(false);
+    for (AAudioFlowGraph *graph : {&fastGraph, &slowGraph}) {
+        graph->setRampLengthInFrames(2 * kFramesPerBurst + 13);
+        graph->setTargetVolume(0.7f);
+    }
+
+    std::vector<SourceType> source(kFramesPerBurst * sourceChannelCount);
+    std::vector<SinkType> fastSink(kFramesPerBurst * sinkChannelCount);
+    std::vector<SinkType> slowSink(kFramesPerBurst * sinkChannelCount);
+    for (int32_t burst = 0; burst < kNumBursts; burst++) {
+        for (size_t i = 0; i < source.size(); i++) {
+            // Exceed full scale so that clipping is exercised.
+            float sample = 1.8f * sin((burst * source.size() + i) * 0.03);
+            if (std::is_same<SourceType, int16_t>::value) {
+                source[i] = std::min(32767.0f, std::max(-32768.0f, sample * 32768.0f));
+            } else {
+                source[i] = sample;
+            }
+        }
+        if (burst == kNumBursts / 2) {
+            fastGraph.setTargetVolume(0.25f);
+            slowGraph.setTargetVolume(0.25f);
+        }
+        fastGraph.process(source.data(), fastSink.data(), kFramesPerBurst);
+        slowGraph.process(source.data(), slowSink.data(), kFramesPerBurst);
+        for (size_t i = 0; i < fastSink.size(); i++) {
+            ASSERT_EQ(slowSink[i], fastSink[i]) << "burst " << burst << ", sample " << i;
+        }
+    }
+}
+
+TEST(test_flowgraph, graph_fast_path_float_to_float) {
+    checkFastPathMatchesGraph<float, float>(AUDIO_FORMAT_PCM_FLOAT, 2,
+                                            AUDIO_FORMAT_PCM_FLOAT, 2);
+}
+
+TEST(test_flowgraph, graph_fast_path_float_mono_to_i16_stereo) {
+    checkFastPathMatchesGraph<float, int16_t>(AUDIO_FORMAT_PCM_FLOAT, 1,
+                                              AUDIO_FORMAT_PCM_16_BIT, 2);
+}
+
+TEST(test_flowgraph, graph_fast_path_i16_to_i16) {
+    checkFastPathMatchesGraph<int16_t, int16_t>(AUDIO_FORMAT_PCM_16_BIT, 2,
+                                                AUDIO_FORMAT_PCM_16_BIT, 2);
+}
+
+TEST(test_flowgraph, graph_fast_path_i16_mono_to_float_multi) {
+    checkFastPathMatchesGraph<int16_t, float>(AUDIO_FORMAT_PCM_16_BIT, 1,
+                                              AUDIO_FORMAT_PCM_FLOAT, 4);
+}
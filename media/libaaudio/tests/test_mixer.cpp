@@ -0,0 +1,175 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test the shared MMAP endpoint mixer against mixing the streams one at a time.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "AAudioMixer.h"
+
+using android::FifoBuffer;
+using android::WrappingBuffer;
+using android::fifo_frames_t;
+
+constexpr int32_t kFramesPerBurst = 192;
+constexpr int32_t kSamplesPerFrame = 2;
+// Not a multiple of the burst so that the data wraps in the middle of a burst.
+constexpr int32_t kFifoCapacityInFrames = 1000;
+
+// The previous mixer: each stream is added into the output in its own loop, one part of
+// the FIFO at a time, with the gain of each frame ramped from gainFrom to gainTo.
+static int32_t mixOneStream(float *output, FifoBuffer *fifo, bool allowUnderflow,
+                            float gainFrom, float gainTo) {
+    WrappingBuffer parts;
+    fifo_frames_t fullFrames = fifo->getFullDataAvailable(&parts);
+    fifo_frames_t framesDesired = kFramesPerBurst;
+    if (!allowUnderflow && fullFrames < framesDesired) {
+        framesDesired = fullFrames;
+    }
+    const float increment = (gainTo - gainFrom) / kFramesPerBurst;
+    int32_t framesLeft = framesDesired;
+    int32_t frame = 0;
+    for (int partIndex = 0; framesLeft > 0 && partIndex < WrappingBuffer::SIZE; partIndex++) {
+        const int32_t framesToMix = std::min(framesLeft, (int32_t) parts.numFrames[partIndex]);
+        const float *source = (const float *) parts.data[partIndex];
+        for (int32_t i = 0; i < framesToMix; i++, frame++) {
+            const float gain = increment == 0.0f ? gainTo : gainFrom + increment * frame;
+            for (int32_t channel = 0; channel < kSamplesPerFrame; channel++) {
+                output[frame * kSamplesPerFrame + channel] +=
+                        source[i * kSamplesPerFrame + channel] * gain;
+            }
+        }
+        framesLeft -= framesToMix;
+    }
+    fifo->advanceReadIndex(framesDesired);
+    return framesDesired - framesLeft;
+}
+
+class MixerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mMixer.allocate(kSamplesPerFrame, kFramesPerBurst);
+    }
+
+    // Two identical sets of FIFOs, for the mixer and for the reference.
+    void addStreams(int32_t numStreams) {
+        for (int32_t i = 0; i < numStreams; i++) {
+            for (auto *fifos : {&mFifos, &mReferenceFifos}) {
+                fifos->push_back(std::make_unique<FifoBuffer>(kSamplesPerFrame * sizeof(float),
+                                                              kFifoCapacityInFrames));
+            }
+        }
+        mInputs.resize(numStreams);
+    }
+
+    // Writes numFrames of a signal which differs for each stream and each burst.
+    void write(int32_t stream, int32_t numFrames) {
+        std::vector<float> data(numFrames * kSamplesPerFrame);
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = ((mSignal++ * 7919 + stream * 104729) % 2001 - 1000) / 1000.0f;
+        }
+        ASSERT_EQ(numFrames, mFifos[stream]->write(data.data(), numFrames));
+        ASSERT_EQ(numFrames, mReferenceFifos[stream]->write(data.data(), numFrames));
+    }
+
+    // Mixes one burst with mix() and with the reference, and compares the outputs.
+    void mixAndCompare() {
+        const int32_t numStreams = mInputs.size();
+        std::vector<float> expected(kFramesPerBurst * kSamplesPerFrame, 0.0f);
+        std::vector<int32_t> expectedFramesRead(numStreams);
+        for (int32_t i = 0; i < numStreams; i++) {
+            expectedFramesRead[i] = mixOneStream(expected.data(), mReferenceFifos[i].get(),
+                    mInputs[i].allowUnderflow, mInputs[i].gainFrom, mInputs[i].gainTo);
+            mInputs[i].streamIndex = i;
+            mInputs[i].fifo = mFifos[i].get();
+        }
+
+        mMixer.clear();
+        mMixer.mix(mInputs.data(), numStreams);
+
+        for (int32_t i = 0; i < numStreams; i++) {
+            EXPECT_EQ(expectedFramesRead[i], mInputs[i].framesRead) << "stream " << i;
+            EXPECT_EQ(mReferenceFifos[i]->getReadCounter(), mFifos[i]->getReadCounter())
+                    << "stream " << i;
+        }
+        const float *output = mMixer.getOutputBuffer();
+        for (size_t i = 0; i < expected.size(); i++) {
+            // the ramped gains are computed per span instead of per stream
+            ASSERT_NEAR(expected[i], output[i], 1e-6f) << "sample " << i;
+        }
+    }
+
+    AAudioMixer mMixer;
+    std::vector<std::unique_ptr<FifoBuffer>> mFifos;
+    std::vector<std::unique_ptr<FifoBuffer>> mReferenceFifos;
+    std::vector<AAudioMixer::StreamInput> mInputs;
+    int32_t mSignal = 0;
+};
+
+// Stream counts around the number of streams mixed per pass.
+class MixerStreamCountTest : public MixerTest,
+                             public ::testing::WithParamInterface<int32_t> {};
+
+TEST_P(MixerStreamCountTest, MatchesOneStreamAtATime) {
+    const int32_t numStreams = GetParam();
+    addStreams(numStreams);
+    // enough bursts for every FIFO to wrap several times
+    for (int32_t burst = 0; burst < 4 * kFifoCapacityInFrames / kFramesPerBurst; burst++) {
+        for (int32_t i = 0; i < numStreams; i++) {
+            mInputs[i].gainFrom = mInputs[i].gainTo = 0.25f * (i % 4 + 1);
+            write(i, kFramesPerBurst);
+        }
+        mixAndCompare();
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(StreamCounts, MixerStreamCountTest,
+        ::testing::Values(1, 2, 3, 4, 5, 6, 7, 8, 9, 16));
+
+TEST_F(MixerTest, GainRamps) {
+    constexpr int32_t kNumStreams = 6;
+    addStreams(kNumStreams);
+    for (int32_t burst = 0; burst < 12; burst++) {
+        for (int32_t i = 0; i < kNumStreams; i++) {
+            // some streams ramp up or down while the others keep their gain
+            mInputs[i].gainFrom = mInputs[i].gainTo;
+            if ((burst + i) % 3 == 0) {
+                mInputs[i].gainTo = (burst + i) % 2 ? 0.0f : 1.0f;
+            }
+            write(i, kFramesPerBurst);
+        }
+        mixAndCompare();
+    }
+}
+
+TEST_F(MixerTest, Underflow) {
+    constexpr int32_t kNumStreams = 5;
+    addStreams(kNumStreams);
+    for (int32_t burst = 0; burst < 12; burst++) {
+        for (int32_t i = 0; i < kNumStreams; i++) {
+            // partial bursts which do not line up with the FIFO wrap or with each other
+            mInputs[i].allowUnderflow = (i % 2) == 0;
+            write(i, (kFramesPerBurst * (burst + i + 1) / 7) % kFramesPerBurst);
+        }
+        mixAndCompare();
+    }
+}
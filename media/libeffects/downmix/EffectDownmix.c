@@ -487,12 +487,10 @@ static int Downmix_Process(effect_handle_t self,
             Downmix_foldFrom7Point1(pSrc, pDst, numFrames, accumulate);
             break;
         default:
-            if (!Downmix_foldGeneric(
-                    downmixInputChannelMask, pSrc, pDst, numFrames, accumulate)) {
-                ALOGE("Multichannel configuration 0x%" PRIx32 " is not supported",
-                      downmixInputChannelMask);
-                return -EINVAL;
-            }
+            // the matrix computed when configuring covers all other supported formats,
+            // including those with top channels
+            Downmix_foldMatrix(pDownmixer->matrix, pDownmixer->input_channel_count,
+                    pSrc, pDst, numFrames, accumulate);
             break;
         }
         break;
@@ -778,9 +776,16 @@ int Downmix_Configure(downmix_module_t *pDwmModule, effect_config_t *pConfig, bo
         pDownmixer->type = DOWNMIX_TYPE_FOLD;
         pDownmixer->apply_volume_correction = false;
         pDownmixer->input_channel_count = 8; // matches default input of AUDIO_CHANNEL_OUT_7POINT1
+#ifdef BUILD_FLOAT
+        Downmix_computeMatrix(AUDIO_CHANNEL_OUT_7POINT1, pDownmixer->matrix);
+#endif
     } else {
         // when configuring the effect, do not allow a blank or unsupported channel mask
+#ifdef BUILD_FLOAT
+        if (!Downmix_computeMatrix(pConfig->inputCfg.channels, pDownmixer->matrix)) {
+#else
         if (!Downmix_validChannelMask(pConfig->inputCfg.channels)) {
+#endif
             ALOGE("Downmix_Configure error: input channel mask(0x%x) not supported",
                                                         pConfig->inputCfg.channels);
             return -EINVAL;
@@ -1430,3 +1435,196 @@ bool Downmix_foldGeneric(
     return true;
 }
 #endif
+
+#ifdef BUILD_FLOAT
+// Gains to the left and right output channels of each channel of a positional mask, in channel
+// mask bit order. Channels on one side go to that side only, center channels and LFE go to both
+// sides at -3dB, and top channels are attenuated by a further 3dB. All gains are halved, as the
+// sums in the Downmix_foldXXX() functions above are.
+static const struct {
+    audio_channel_mask_t channel;
+    LVM_FLOAT left;
+    LVM_FLOAT right;
+} kDownmixChannelGains[] = {
+    {AUDIO_CHANNEL_OUT_FRONT_LEFT,            0.5f, 0.0f},
+    {AUDIO_CHANNEL_OUT_FRONT_RIGHT,           0.0f, 0.5f},
+    {AUDIO_CHANNEL_OUT_FRONT_CENTER,          0.5f * MINUS_3_DB_IN_FLOAT,
+                                              0.5f * MINUS_3_DB_IN_FLOAT},
+    {AUDIO_CHANNEL_OUT_LOW_FREQUENCY,         0.5f * MINUS_3_DB_IN_FLOAT,
+                                              0.5f * MINUS_3_DB_IN_FLOAT},
+    {AUDIO_CHANNEL_OUT_BACK_LEFT,             0.5f, 0.0f},
+    {AUDIO_CHANNEL_OUT_BACK_RIGHT,            0.0f, 0.5f},
+    {AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER,  0.5f, 0.0f},
+    {AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER, 0.0f, 0.5f},
+    {AUDIO_CHANNEL_OUT_BACK_CENTER,           0.5f * MINUS_3_DB_IN_FLOAT,
+                                              0.5f * MINUS_3_DB_IN_FLOAT},
+    {AUDIO_CHANNEL_OUT_SIDE_LEFT,             0.5f, 0.0f},
+    {AUDIO_CHANNEL_OUT_SIDE_RIGHT,            0.0f, 0.5f},
+    {AUDIO_CHANNEL_OUT_TOP_CENTER,            0.25f, 0.25f},
+    {AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT,        0.5f * MINUS_3_DB_IN_FLOAT, 0.0f},
+    {AUDIO_CHANNEL_OUT_TOP_FRONT_CENTER,      0.25f, 0.25f},
+    {AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT,       0.0f, 0.5f * MINUS_3_DB_IN_FLOAT},
+    {AUDIO_CHANNEL_OUT_TOP_BACK_LEFT,         0.5f * MINUS_3_DB_IN_FLOAT, 0.0f},
+    {AUDIO_CHANNEL_OUT_TOP_BACK_CENTER,       0.25f, 0.25f},
+    {AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT,        0.0f, 0.5f * MINUS_3_DB_IN_FLOAT},
+    {AUDIO_CHANNEL_OUT_TOP_SIDE_LEFT,         0.5f * MINUS_3_DB_IN_FLOAT, 0.0f},
+    {AUDIO_CHANNEL_OUT_TOP_SIDE_RIGHT,        0.0f, 0.5f * MINUS_3_DB_IN_FLOAT},
+};
+
+/*----------------------------------------------------------------------------
+ * Downmix_computeMatrix()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * compute the downmix to stereo matrix of a multichannel format, which may use any of the
+ * channels of kDownmixChannelGains, including the top and front left/right of center channels,
+ * and has FL/FR
+ *
+ * Inputs:
+ *  mask       the positional channel mask of the multichannel format
+ *
+ * Outputs:
+ *  matrix     gains to the left and right output channels of each input channel, in the
+ *               order of the samples in a frame; unchanged if the format is not supported
+ *
+ * Returns: false if multichannel format is not supported
+ *
+ *----------------------------------------------------------------------------
+ */
+bool Downmix_computeMatrix(uint32_t mask, LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2]) {
+    if (mask == 0 ||
+            audio_channel_mask_get_representation(mask) != AUDIO_CHANNEL_REPRESENTATION_POSITION) {
+        ALOGE("Downmix_computeMatrix: invalid channel mask 0x%" PRIx32, mask);
+        return false;
+    }
+    if ((mask & AUDIO_CHANNEL_OUT_STEREO) != AUDIO_CHANNEL_OUT_STEREO) {
+        ALOGE("Downmix_computeMatrix: front channels must be present");
+        return false;
+    }
+    LVM_FLOAT gains[DOWNMIX_MAX_INPUT_CHANNELS][2];
+    uint32_t unsupported = mask;
+    int numChan = 0;
+    for (size_t i = 0; i < sizeof(kDownmixChannelGains) / sizeof(kDownmixChannelGains[0]); i++) {
+        if (mask & kDownmixChannelGains[i].channel) {
+            gains[numChan][0] = kDownmixChannelGains[i].left;
+            gains[numChan][1] = kDownmixChannelGains[i].right;
+            numChan++;
+            unsupported &= ~kDownmixChannelGains[i].channel;
+        }
+    }
+    if (unsupported != 0) {
+        ALOGE("Downmix_computeMatrix: unsupported channels 0x%" PRIx32 " in mask 0x%" PRIx32,
+                unsupported, mask);
+        return false;
+    }
+    memcpy(matrix, gains, numChan * sizeof(gains[0]));
+    return true;
+}
+
+// left and right samples of two consecutive stereo frames
+typedef LVM_FLOAT downmix_frame_pair_t __attribute__((vector_size(4 * sizeof(LVM_FLOAT))));
+
+// Downmixes numFrames frames of numChan channels with matrix, two frames at a time in a vector
+// mapped to NEON or SSE registers. Each lane sums the channels in order, as the scalar code
+// does. When inlined with a constant channel count, the channel loop is unrolled with the gains
+// held in registers.
+static inline __attribute__((always_inline)) void Downmix_foldMatrixFrames(
+        const LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2], const int numChan,
+        const LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, const bool accumulate) {
+    downmix_frame_pair_t gains[DOWNMIX_MAX_INPUT_CHANNELS];
+    for (int ch = 0; ch < numChan; ch++) {
+        gains[ch] = (downmix_frame_pair_t){matrix[ch][0], matrix[ch][1],
+                                           matrix[ch][0], matrix[ch][1]};
+    }
+    while (numFrames >= 2) {
+        downmix_frame_pair_t sum = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int ch = 0; ch < numChan; ch++) {
+            const LVM_FLOAT first = pSrc[ch];
+            const LVM_FLOAT second = pSrc[numChan + ch];
+            sum += (downmix_frame_pair_t){first, first, second, second} * gains[ch];
+        }
+        if (accumulate) {
+            downmix_frame_pair_t dst;
+            memcpy(&dst, pDst, sizeof(dst));
+            sum += dst;
+        }
+        for (int i = 0; i < 4; i++) {
+            pDst[i] = clamp_float(sum[i]);
+        }
+        pSrc += 2 * numChan;
+        pDst += 4;
+        numFrames -= 2;
+    }
+    if (numFrames) {
+        LVM_FLOAT lt = 0.0f;
+        LVM_FLOAT rt = 0.0f;
+        for (int ch = 0; ch < numChan; ch++) {
+            lt += pSrc[ch] * matrix[ch][0];
+            rt += pSrc[ch] * matrix[ch][1];
+        }
+        if (accumulate) {
+            lt += pDst[0];
+            rt += pDst[1];
+        }
+        pDst[0] = clamp_float(lt);
+        pDst[1] = clamp_float(rt);
+    }
+}
+
+static inline __attribute__((always_inline)) void Downmix_foldMatrixN(
+        const LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2], const int numChan,
+        const LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate) {
+    // code is duplicated between the two values of accumulate to avoid repeating the test
+    // for every sample
+    if (accumulate) {
+        Downmix_foldMatrixFrames(matrix, numChan, pSrc, pDst, numFrames, true);
+    } else {
+        Downmix_foldMatrixFrames(matrix, numChan, pSrc, pDst, numFrames, false);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * Downmix_foldMatrix()
+ *----------------------------------------------------------------------------
+ * Purpose:
+ * downmix to stereo a multichannel signal with the matrix computed for its channel mask by
+ * Downmix_computeMatrix()
+ *
+ * Inputs:
+ *  matrix     the downmix matrix of the format of pSrc
+ *  numChan    the number of channels of pSrc
+ *  pSrc       multichannel audio buffer to downmix
+ *  numFrames  the number of multichannel frames to downmix
+ *  accumulate whether to mix (when true) the result of the downmix with the contents of pDst,
+ *               or overwrite pDst (when false)
+ *
+ * Outputs:
+ *  pDst       downmixed stereo audio samples
+ *
+ *----------------------------------------------------------------------------
+ */
+void Downmix_foldMatrix(const LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2], int numChan,
+        const LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate) {
+    // specialize for the channel counts of the formats without a dedicated fold:
+    // 2.1, 6.1, 5.1.2, 5.1.4 and 7.1.2, 7.1.4
+    switch (numChan) {
+    case 3:
+        Downmix_foldMatrixN(matrix, 3, pSrc, pDst, numFrames, accumulate);
+        break;
+    case 7:
+        Downmix_foldMatrixN(matrix, 7, pSrc, pDst, numFrames, accumulate);
+        break;
+    case 8:
+        Downmix_foldMatrixN(matrix, 8, pSrc, pDst, numFrames, accumulate);
+        break;
+    case 10:
+        Downmix_foldMatrixN(matrix, 10, pSrc, pDst, numFrames, accumulate);
+        break;
+    case 12:
+        Downmix_foldMatrixN(matrix, 12, pSrc, pDst, numFrames, accumulate);
+        break;
+    default:
+        Downmix_foldMatrixN(matrix, numChan, pSrc, pDst, numFrames, accumulate);
+        break;
+    }
+}
+#endif
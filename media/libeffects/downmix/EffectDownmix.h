@@ -30,6 +30,8 @@
 #ifdef BUILD_FLOAT
 #define LVM_FLOAT float
 #endif
+// one input channel per bit of a positional channel mask
+#define DOWNMIX_MAX_INPUT_CHANNELS 32
 typedef enum {
     DOWNMIX_STATE_UNINITIALIZED,
     DOWNMIX_STATE_INITIALIZED,
@@ -42,6 +44,11 @@ typedef struct {
     downmix_type_t type;
     bool apply_volume_correction;
     uint8_t input_channel_count;
+#ifdef BUILD_FLOAT
+    // gains of each input channel to the left and right output channels, for the input channel
+    // mask the downmixer is configured with
+    LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2];
+#endif
 } downmix_object_t;
 
 
@@ -103,6 +110,9 @@ void Downmix_foldFrom5Point1(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames,
 void Downmix_foldFrom7Point1(LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
 bool Downmix_foldGeneric(
         uint32_t mask, LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
+bool Downmix_computeMatrix(uint32_t mask, LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2]);
+void Downmix_foldMatrix(const LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2], int numChan,
+        const LVM_FLOAT *pSrc, LVM_FLOAT *pDst, size_t numFrames, bool accumulate);
 #else
 void Downmix_foldFromQuad(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
 void Downmix_foldFrom5Point1(int16_t *pSrc, int16_t*pDst, size_t numFrames, bool accumulate);
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <system/audio.h>
+
+extern "C" {
+#include "EffectDownmix.h"
+}
+
+// The matrix sums the channels in a different order than the folds, so results may differ in
+// the last bits.
+static constexpr float kTolerance = 1e-6f;
+// odd, to also cover the last frame the matrix downmixes on its own
+static constexpr size_t kFrameCount = 1023;
+
+static std::vector<float> randomSamples(size_t count, unsigned seed) {
+    std::minstd_rand random(seed);
+    // full scale, so that the sums exercise the clamping too
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<float> samples(count);
+    for (float &sample : samples) {
+        sample = distribution(random);
+    }
+    return samples;
+}
+
+// Downmixes with the folds the effect used before the matrix, as the reference.
+static void foldReference(uint32_t mask, float *pSrc, float *pDst, size_t numFrames,
+        bool accumulate) {
+    switch (mask) {
+    case AUDIO_CHANNEL_OUT_QUAD_BACK:
+    case AUDIO_CHANNEL_OUT_QUAD_SIDE:
+        Downmix_foldFromQuad(pSrc, pDst, numFrames, accumulate);
+        break;
+    case AUDIO_CHANNEL_OUT_5POINT1_BACK:
+    case AUDIO_CHANNEL_OUT_5POINT1_SIDE:
+        Downmix_foldFrom5Point1(pSrc, pDst, numFrames, accumulate);
+        break;
+    case AUDIO_CHANNEL_OUT_7POINT1:
+        Downmix_foldFrom7Point1(pSrc, pDst, numFrames, accumulate);
+        break;
+    default:
+        ASSERT_TRUE(Downmix_foldGeneric(mask, pSrc, pDst, numFrames, accumulate));
+        break;
+    }
+}
+
+class DownmixMatrixTest : public ::testing::TestWithParam<std::tuple<uint32_t, bool>> {};
+
+TEST_P(DownmixMatrixTest, MatchesFold) {
+    const uint32_t mask = std::get<0>(GetParam());
+    const bool accumulate = std::get<1>(GetParam());
+    const int numChan = audio_channel_count_from_out_mask(mask);
+
+    LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2];
+    ASSERT_TRUE(Downmix_computeMatrix(mask, matrix));
+
+    std::vector<float> input = randomSamples(kFrameCount * numChan, mask);
+    std::vector<float> expected = randomSamples(kFrameCount * 2, 42);
+    std::vector<float> output = expected;
+    foldReference(mask, input.data(), expected.data(), kFrameCount, accumulate);
+    Downmix_foldMatrix(matrix, numChan, input.data(), output.data(), kFrameCount, accumulate);
+
+    for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_NEAR(expected[i], output[i], kTolerance) << "sample " << i;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        DownmixMatrix, DownmixMatrixTest,
+        ::testing::Combine(
+                ::testing::Values(
+                        AUDIO_CHANNEL_OUT_QUAD_BACK,
+                        AUDIO_CHANNEL_OUT_QUAD_SIDE,
+                        AUDIO_CHANNEL_OUT_5POINT1_BACK,
+                        AUDIO_CHANNEL_OUT_5POINT1_SIDE,
+                        AUDIO_CHANNEL_OUT_7POINT1,
+                        // handled by Downmix_foldGeneric()
+                        AUDIO_CHANNEL_OUT_2POINT1,
+                        AUDIO_CHANNEL_OUT_STEREO | AUDIO_CHANNEL_OUT_FRONT_CENTER |
+                                AUDIO_CHANNEL_OUT_BACK_CENTER,
+                        AUDIO_CHANNEL_OUT_5POINT1_SIDE | AUDIO_CHANNEL_OUT_BACK_CENTER,
+                        AUDIO_CHANNEL_OUT_7POINT1 | AUDIO_CHANNEL_OUT_BACK_CENTER),
+                ::testing::Bool()));
+
+TEST(DownmixMatrix, HeightChannels) {
+    const uint32_t mask = AUDIO_CHANNEL_OUT_7POINT1POINT4;
+    const int numChan = audio_channel_count_from_out_mask(mask);
+    ASSERT_EQ(12, numChan);
+
+    LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2];
+    ASSERT_TRUE(Downmix_computeMatrix(mask, matrix));
+
+    // the 7.1 bed with silent top channels downmixes as 7.1
+    std::vector<float> bed = randomSamples(kFrameCount * 8, 7);
+    std::vector<float> input(kFrameCount * numChan);
+    for (size_t i = 0; i < kFrameCount; i++) {
+        std::copy(&bed[i * 8], &bed[i * 8] + 8, &input[i * numChan]);
+    }
+    std::vector<float> expected(kFrameCount * 2);
+    std::vector<float> output(kFrameCount * 2);
+    Downmix_foldFrom7Point1(bed.data(), expected.data(), kFrameCount, false);
+    Downmix_foldMatrix(matrix, numChan, input.data(), output.data(), kFrameCount, false);
+    for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_NEAR(expected[i], output[i], kTolerance) << "sample " << i;
+    }
+
+    // top front left and top back right at -3dB on their side only
+    std::fill(input.begin(), input.end(), 0.0f);
+    input[8] = 1.0f;                // top front left
+    input[numChan + 11] = 1.0f;     // top back right
+    Downmix_foldMatrix(matrix, numChan, input.data(), output.data(), 2, false);
+    EXPECT_NEAR(0.5f * 0.70710678f, output[0], kTolerance);
+    EXPECT_EQ(0.0f, output[1]);
+    EXPECT_EQ(0.0f, output[2]);
+    EXPECT_NEAR(0.5f * 0.70710678f, output[3], kTolerance);
+}
+
+TEST(DownmixMatrix, UnsupportedMasks) {
+    LVM_FLOAT matrix[DOWNMIX_MAX_INPUT_CHANNELS][2];
+    EXPECT_FALSE(Downmix_computeMatrix(0, matrix));
+    EXPECT_FALSE(Downmix_computeMatrix(AUDIO_CHANNEL_OUT_MONO, matrix));
+    EXPECT_FALSE(Downmix_computeMatrix(audio_channel_mask_from_representation_and_bits(
+            AUDIO_CHANNEL_REPRESENTATION_INDEX, 0xff), matrix));
+    EXPECT_TRUE(Downmix_computeMatrix(AUDIO_CHANNEL_OUT_5POINT1POINT4, matrix));
+    EXPECT_TRUE(Downmix_computeMatrix(AUDIO_CHANNEL_OUT_7POINT1POINT2, matrix));
+}
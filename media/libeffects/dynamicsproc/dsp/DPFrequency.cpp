@@ -66,6 +66,8 @@ void ChannelBuffer::initBuffers(unsigned int blockSize, unsigned int overlapSize
     input.resize(mBlockSize);
     output.resize(mBlockSize);
     outTail.resize(overlapSize);
+    complexTemp.resize(halfFftSize);
+    gainTemp.resize(halfFftSize);
 
     //module vectors
     mPreEqFactorVector.resize(halfFftSize, 1.0);
@@ -178,6 +180,11 @@ void DPFrequency::configure(size_t blockSize, size_t overlapSize,
 
     //Making sure window rms is not zero.
     mWindowRms = std::max(sqrt(mWindowRms / mVWindow.size()), MIN_ENVELOPE);
+
+    //the input is real, only compute and process the half spectrum including the Nyquist bin.
+    mFftServer.SetFlag(Eigen::FFT<float>::HalfSpectrum);
+    mWindowed.resize(mBlockSize);
+    mPowerSpectrum.resize(mHalfFFTSize);
 }
 
 void DPFrequency::updateParameters(ChannelBuffer &cb, int channelIndex) {
@@ -386,10 +393,9 @@ size_t DPFrequency::processSamples(const float *in, float *out, size_t samples)
        }
 
        //**separate into channels
-       for (size_t k = 0; k < samples; k += channelCount) {
-           for (int ch = 0; ch < channelCount; ch++) {
-               mChannelBuffers[ch].cBInput.write(*pIn++);
-           }
+       const size_t frames = samples / channelCount;
+       for (int ch = 0; ch < channelCount; ch++) {
+           mChannelBuffers[ch].cBInput.write(pIn + ch, frames, channelCount);
        }
 
        //**process all channelBuffers
@@ -413,10 +419,8 @@ size_t DPFrequency::processSamples(const float *in, float *out, size_t samples)
        }
 
        //**interleave channels
-       for (size_t k = 0; k < available; k++) {
-           for (int ch = 0; ch < channelCount; ch++) {
-               *pOut++ = mChannelBuffers[ch].cBOutput.read();
-           }
+       for (int ch = 0; ch < channelCount; ch++) {
+           mChannelBuffers[ch].cBOutput.read(pOut + ch, available, channelCount);
        }
 
        return samples;
@@ -442,9 +446,7 @@ size_t DPFrequency::processChannelBuffers(CBufferVector &channelBuffers) {
                     pCb->input.begin());
 
             //read new available data
-            for (unsigned int k = 0; k < processFrames; k++) {
-                pCb->input[mOverlapSize + k] = pCb->cBInput.read();
-            }
+            pCb->cBInput.read(&pCb->input[mOverlapSize], processFrames);
             //first stages: fft, preEq, mbc, postEq and start of Limiter
             processedSamples += processFirstStages(*pCb);
         }
@@ -466,51 +468,65 @@ size_t DPFrequency::processChannelBuffers(CBufferVector &channelBuffers) {
             }
 
             //output data
-            for (unsigned int k = 0; k < processFrames; k++) {
-                pCb->cBOutput.write(pCb->output[k]);
-            }
+            pCb->cBOutput.write(&pCb->output[0], processFrames);
         }
         available -= processFrames;
     }
     return processedSamples;
 }
+
+float DPFrequency::bandEnergy(const ChannelBuffer &cb, size_t binStart,
+        size_t binStop) const {
+    //energy of bins [binStart, binStop] once the current gains are applied.
+    const size_t binEnd = std::min(binStop + 1, mHalfFFTSize);
+    if (binStart >= binEnd) {
+        return 0;
+    }
+    const size_t count = binEnd - binStart;
+    return (mPowerSpectrum.segment(binStart, count).array() *
+            cb.gainTemp.segment(binStart, count).array().square()).sum();
+}
+
 size_t DPFrequency::processFirstStages(ChannelBuffer &cb) {
 
     //##apply window
-    Eigen::Map<Eigen::VectorXf> eWindow(&mVWindow[0], mVWindow.size());
-    Eigen::Map<Eigen::VectorXf> eInput(&cb.input[0], cb.input.size());
+    Eigen::Map<const Eigen::VectorXf> eWindow(&mVWindow[0], mVWindow.size());
+    Eigen::Map<const Eigen::VectorXf> eInput(&cb.input[0], cb.input.size());
 
-    Eigen::VectorXf eWin = eInput.cwiseProduct(eWindow); //apply window
+    mWindowed = eInput.cwiseProduct(eWindow); //apply window, no allocation
 
     //##fft
     //Note: we are using eigen with the default scaling, which ensures that
     //  IFFT( FFT(x) ) = x.
     // TODO: optimize by using the noscale option, and compensate with dB scale offsets
-    mFftServer.fwd(cb.complexTemp, eWin);
-
-    size_t cSize = cb.complexTemp.size();
-    size_t maxBin = std::min(cSize/2, mHalfFFTSize);
+    mFftServer.fwd(cb.complexTemp, mWindowed);
+
+    //The stages below do not modify the spectrum. They compute the energies they need from
+    //the power spectrum and the gains of the previous stages, and accumulate their own gain
+    //in gainTemp, which processLastStages() applies to the spectrum in a single pass.
+    //The Nyquist bin is only processed by the MBC.
+    const size_t maxBin = mBlockSize / 2;
+    if ((cb.mMbcInUse && cb.mMbcEnabled) || (cb.mLimiterInUse && cb.mLimiterEnabled)) {
+        mPowerSpectrum = cb.complexTemp.cwiseAbs2();
+    }
 
     //== EqPre (always runs)
-    for (size_t k = 0; k < maxBin; k++) {
-        cb.complexTemp[k] *= cb.mPreEqFactorVector[k];
-    }
+    cb.gainTemp.head(maxBin) =
+            Eigen::Map<const Eigen::VectorXf>(&cb.mPreEqFactorVector[0], maxBin);
+    cb.gainTemp[maxBin] = 1.0f;
 
     //== MBC
     if (cb.mMbcInUse && cb.mMbcEnabled) {
         for (size_t band = 0; band < cb.mMbcBands.size(); band++) {
             ChannelBuffer::MbcBandParams *pMbcBandParams = &cb.mMbcBands[band];
-            float fEnergySum = 0;
-
             //apply pre gain.
             float preGainFactor = dBtoLinear(pMbcBandParams->gainPreDb);
             float preGainSquared = preGainFactor * preGainFactor;
 
-            for (size_t k = pMbcBandParams->binStart; k <= pMbcBandParams->binStop; k++) {
-                fEnergySum += std::norm(cb.complexTemp[k]) * preGainSquared; //mag squared
-            }
+            float fEnergySum = bandEnergy(cb, pMbcBandParams->binStart,
+                    pMbcBandParams->binStop) * preGainSquared; //mag squared
 
-            //Eigen FFT is full spectrum, even if the source was real data.
+            //Only the half spectrum is computed for real data.
             // Each half spectrum has half the energy. This is taken into account with the * 2
             // factor in the energy computations.
             // energy = sqrt(sum_components_squared) number_points
@@ -567,8 +583,10 @@ size_t DPFrequency::processFirstStages(ChannelBuffer &cb) {
             newFactor *= dBtoLinear(pMbcBandParams->gainPostDb);
 
             //apply to this band
-            for (size_t k = pMbcBandParams->binStart; k <= pMbcBandParams->binStop; k++) {
-                cb.complexTemp[k] *= newFactor;
+            const size_t binEnd = std::min(pMbcBandParams->binStop + 1, mHalfFFTSize);
+            if (pMbcBandParams->binStart < binEnd) {
+                cb.gainTemp.segment(pMbcBandParams->binStart,
+                        binEnd - pMbcBandParams->binStart) *= newFactor;
             }
 
         } //end per band process
@@ -577,17 +595,13 @@ size_t DPFrequency::processFirstStages(ChannelBuffer &cb) {
 
     //== EqPost
     if (cb.mPostEqInUse && cb.mPostEqEnabled) {
-        for (size_t k = 0; k < maxBin; k++) {
-            cb.complexTemp[k] *= cb.mPostEqFactorVector[k];
-        }
+        cb.gainTemp.head(maxBin).array() *=
+                Eigen::Map<const Eigen::ArrayXf>(&cb.mPostEqFactorVector[0], maxBin);
     }
 
     //== Limiter. First Pass
     if (cb.mLimiterInUse && cb.mLimiterEnabled) {
-        float fEnergySum = 0;
-        for (size_t k = 0; k < maxBin; k++) {
-            fEnergySum += std::norm(cb.complexTemp[k]);
-        }
+        float fEnergySum = bandEnergy(cb, 0, maxBin - 1);
 
         //see explanation above for energy computation logic
         fEnergySum = sqrt(fEnergySum * 2) / (mBlockSize * mWindowRms);
@@ -656,20 +670,19 @@ size_t DPFrequency::processLastStages(ChannelBuffer &cb) {
 
     //apply to all if != 1.0
     if (!compareEquality(outputGainFactor, 1.0f)) {
-        size_t cSize = cb.complexTemp.size();
-        size_t maxBin = std::min(cSize/2, mHalfFFTSize);
-        for (size_t k = 0; k < maxBin; k++) {
-            cb.complexTemp[k] *= outputGainFactor;
-        }
+        cb.gainTemp.head(mBlockSize / 2) *= outputGainFactor;
     }
 
+    //apply the gains of all stages at once
+    cb.complexTemp.array() *= cb.gainTemp.array();
+
     //##ifft directly to output.
     Eigen::Map<Eigen::VectorXf> eOutput(&cb.output[0], cb.output.size());
     mFftServer.inv(eOutput, cb.complexTemp);
 
     //apply rest of window for resynthesis
-    Eigen::Map<Eigen::VectorXf> eWindow(&mVWindow[0], mVWindow.size());
-    eOutput = eOutput.cwiseProduct(eWindow);
+    Eigen::Map<const Eigen::VectorXf> eWindow(&mVWindow[0], mVWindow.size());
+    eOutput.array() *= eWindow.array();
 
     return mBlockSize;
 }
@@ -39,7 +39,8 @@ public:
     FloatVec output;    // time domain temp vector for output
     FloatVec outTail;   // time domain temp vector for output tail (for overlap-add method)
 
-    Eigen::VectorXcf complexTemp; // complex temp vector for frequency domain operations
+    Eigen::VectorXcf complexTemp; // half spectrum temp vector for frequency domain operations
+    Eigen::VectorXf gainTemp;     // per bin gain of all stages, applied once to complexTemp
 
     //Current parameters
     float inputGainDb;
@@ -136,6 +137,7 @@ private:
     size_t processChannelBuffers(CBufferVector &channelBuffers);
     size_t processFirstStages(ChannelBuffer &cb);
     size_t processLastStages(ChannelBuffer &cb);
+    float bandEnergy(const ChannelBuffer &cb, size_t binStart, size_t binStop) const;
     void processLinkedLimiters(CBufferVector &channelBuffers);
 
     size_t mBlockSize;
@@ -152,7 +154,9 @@ private:
     //dsp
     FloatVec mVWindow;  //window class.
     float mWindowRms;
-    Eigen::FFT<float> mFftServer;
+    Eigen::FFT<float> mFftServer;  //half spectrum, shared by all channels
+    Eigen::VectorXf mWindowed;     //windowed input block
+    Eigen::VectorXf mPowerSpectrum; //squared magnitude of the current block before gains
 };
 
 } //namespace dp_fx
@@ -18,6 +18,7 @@
 #define SHCIRCULARBUFFER_H
 
 #include <log/log.h>
+#include <algorithm>
 #include <vector>
 
 template <class T>
@@ -60,6 +61,56 @@ public:
         }
         return value;
     }
+    // Writes count values taken every stride elements of src, e.g. one channel of
+    // interleaved data.
+    void write(const T *src, size_t count, size_t stride = 1) {
+        if (count > availableToWrite()) {
+            ALOGE("Error: SHCircularBuffer no space to write %zu. allocated size %zu ",
+                    count, getSize());
+            count = availableToWrite();
+        }
+        mReadAvailable += count;
+        while (count > 0) {
+            const size_t run = std::min(count, getSize() - mWriteIndex);
+            T *dst = &mBuffer[mWriteIndex];
+            for (size_t k = 0; k < run; k++) {
+                dst[k] = *src;
+                src += stride;
+            }
+            mWriteIndex += run;
+            if (mWriteIndex >= getSize()) {
+                mWriteIndex = 0;
+            }
+            count -= run;
+        }
+    }
+    // Reads count values into dst every stride elements. Values not available are
+    // returned as T().
+    void read(T *dst, size_t count, size_t stride = 1) {
+        size_t available = count;
+        if (available > availableToRead()) {
+            ALOGW("Warning: SHCircularBuffer no data available to read. Default value returned");
+            available = availableToRead();
+        }
+        mReadAvailable -= available;
+        for (size_t remaining = available; remaining > 0; ) {
+            const size_t run = std::min(remaining, getSize() - mReadIndex);
+            const T *src = &mBuffer[mReadIndex];
+            for (size_t k = 0; k < run; k++) {
+                *dst = src[k];
+                dst += stride;
+            }
+            mReadIndex += run;
+            if (mReadIndex >= getSize()) {
+                mReadIndex = 0;
+            }
+            remaining -= run;
+        }
+        for (size_t k = available; k < count; k++) {
+            *dst = T();
+            dst += stride;
+        }
+    }
     inline size_t availableToRead() const {
         return mReadAvailable;
     }
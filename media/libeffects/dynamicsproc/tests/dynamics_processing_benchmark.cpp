@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../dsp/DPFrequency.h"
+
+using namespace dp_fx;
+
+static constexpr size_t kSamplingRate = 48000;
+static constexpr size_t kFrameCount = 960;  // 20 ms, a typical effect buffer
+static constexpr size_t kBlockSize = 512;   // default 10 ms preferred frame duration at 48 kHz
+
+static constexpr float kCutoffsHz[] = {100.f, 300.f, 1000.f, 3000.f, 10000.f, 20000.f};
+static constexpr uint32_t kBandCount = sizeof(kCutoffsHz) / sizeof(kCutoffsHz[0]);
+
+// Configures all stages in use and enabled, as a music playback preset would.
+static void configureAllStages(DPFrequency &dp, uint32_t channelCount) {
+    dp.init(channelCount, true /* preEqInUse */, kBandCount, true /* mbcInUse */, kBandCount,
+            true /* postEqInUse */, kBandCount, true /* limiterInUse */);
+    for (uint32_t ch = 0; ch < channelCount; ch++) {
+        DPChannel *channel = dp.getChannel(ch);
+        channel->setInputGain(-3.f);
+        channel->setOutputGain(1.f);
+        for (uint32_t b = 0; b < kBandCount; b++) {
+            DPEqBand eqBand;
+            eqBand.init(true /* enabled */, kCutoffsHz[b], (b % 3) * 2.f - 2.f /* gain */);
+            channel->getPreEq()->setBand(b, eqBand);
+            eqBand.setGain(1.f - (b % 2) * 2.f);
+            channel->getPostEq()->setBand(b, eqBand);
+
+            DPMbcBand mbcBand;
+            mbcBand.init(true /* enabled */, kCutoffsHz[b], 3.f /* attackTime */,
+                    80.f /* releaseTime */, 2.f + b /* ratio */, -30.f /* threshold */,
+                    b * 2.f /* kneeWidth */, -90.f /* noiseGateThreshold */,
+                    1.f /* expanderRatio */, 0.f /* preGain */, 1.f /* postGain */);
+            channel->getMbc()->setBand(b, mbcBand);
+        }
+        channel->getPreEq()->setEnabled(true);
+        channel->getMbc()->setEnabled(true);
+        channel->getPostEq()->setEnabled(true);
+        DPLimiter limiter;
+        limiter.init(true /* inUse */, true /* enabled */, 0 /* linkGroup */,
+                1.f /* attackTime */, 60.f /* releaseTime */, 10.f /* ratio */,
+                -2.f /* threshold */, 0.f /* postGain */);
+        channel->setLimiter(limiter);
+    }
+    dp.configure(kBlockSize, kBlockSize / 2, kSamplingRate);
+}
+
+// Processes one 20 ms buffer for state.range(0) channels.
+static void BM_DPFrequency(benchmark::State &state) {
+    const uint32_t channelCount = state.range(0);
+    const size_t sampleCount = kFrameCount * channelCount;
+
+    DPFrequency dp;
+    configureAllStages(dp, channelCount);
+
+    std::minstd_rand random(42);
+    std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+    std::vector<float> in(sampleCount);
+    for (float &sample : in) {
+        sample = distribution(random);
+    }
+    std::vector<float> out(sampleCount);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(in.data());
+        dp.processSamples(in.data(), out.data(), sampleCount);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kFrameCount);
+}
+
+BENCHMARK(BM_DPFrequency)->Arg(2)->Arg(6)->Arg(8);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <hardware/audio_effect.h>
+#include <system/audio.h>
+#include <system/audio_effects/effect_bassboost.h>
+#include <system/audio_effects/effect_equalizer.h>
+#include <system/audio_effects/effect_virtualizer.h>
+
+extern audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+static constexpr size_t kSamplingRate = 48000;
+static constexpr size_t kFrameCount = 960;  // 20 ms, a typical effect buffer
+static constexpr int32_t kSessionId = 1;
+static constexpr int32_t kIoId = 1;
+
+// Effects of the music bundle, in the order they are enabled by the benchmark.
+struct BundleEffect {
+    effect_uuid_t uuid;
+    int32_t param;      // strength or preset
+    int16_t value;
+};
+static const BundleEffect kBundleEffects[] = {
+    // NXP SW Equalizer, Rock preset: all five bands have a non-zero gain
+    {{0xce772f20, 0x847d, 0x11df, 0xbb17, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}},
+            EQ_PARAM_CUR_PRESET, 9},
+    // NXP SW BassBoost
+    {{0x8631f300, 0x72e2, 0x11df, 0xb57e, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}},
+            BASSBOOST_PARAM_STRENGTH, 800},
+    // NXP SW Virtualizer
+    {{0x1d4033c0, 0x8557, 0x11df, 0x9f2d, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}},
+            VIRTUALIZER_PARAM_STRENGTH, 800},
+};
+
+static int setParameter(effect_handle_t effect, int32_t param, int16_t value) {
+    uint32_t cmd[(sizeof(effect_param_t) + sizeof(param) + sizeof(value)) / sizeof(uint32_t)
+            + 1];
+    effect_param_t *p = reinterpret_cast<effect_param_t *>(cmd);
+    p->psize = sizeof(param);
+    p->vsize = sizeof(value);
+    *reinterpret_cast<int32_t *>(p->data) = param;
+    *reinterpret_cast<int16_t *>(p->data + sizeof(param)) = value;
+    int reply = 0;
+    uint32_t replySize = sizeof(reply);
+    const int status = (*effect)->command(effect, EFFECT_CMD_SET_PARAM,
+            sizeof(effect_param_t) + sizeof(param) + sizeof(value), p, &replySize, &reply);
+    return status != 0 ? status : reply;
+}
+
+static int configure(effect_handle_t effect, const BundleEffect &bundleEffect,
+        uint32_t channelCount) {
+    effect_config_t config{};
+    config.inputCfg.samplingRate = config.outputCfg.samplingRate = kSamplingRate;
+    config.inputCfg.channels = config.outputCfg.channels =
+            audio_channel_out_mask_from_count(channelCount);
+    config.inputCfg.format = config.outputCfg.format = AUDIO_FORMAT_PCM_FLOAT;
+    config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+    int reply = 0;
+    uint32_t replySize = sizeof(reply);
+    if ((*effect)->command(effect, EFFECT_CMD_SET_CONFIG, sizeof(config), &config,
+            &replySize, &reply) != 0 || reply != 0) {
+        return -EINVAL;
+    }
+    if ((*effect)->command(effect, EFFECT_CMD_ENABLE, 0, nullptr, &replySize, &reply) != 0
+            || reply != 0) {
+        return -EINVAL;
+    }
+    return setParameter(effect, bundleEffect.param, bundleEffect.value);
+}
+
+// Processes one 20 ms buffer for state.range(0) channels through the first state.range(1)
+// effects of the bundle: the equalizer, then the bass boost and the virtualizer.
+static void BM_MusicBundle(benchmark::State &state) {
+    const uint32_t channelCount = state.range(0);
+    const size_t effectCount = state.range(1);
+
+    std::vector<effect_handle_t> effects;
+    auto release = [&effects]() {
+        for (effect_handle_t effect : effects) {
+            AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(effect);
+        }
+    };
+    for (size_t i = 0; i < effectCount; i++) {
+        effect_handle_t effect;
+        if (AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(&kBundleEffects[i].uuid, kSessionId,
+                kIoId, &effect) != 0) {
+            state.SkipWithError("create_effect failed");
+            release();
+            return;
+        }
+        effects.push_back(effect);
+        if (configure(effect, kBundleEffects[i], channelCount) != 0) {
+            state.SkipWithError("cannot configure effect");
+            release();
+            return;
+        }
+    }
+
+    std::minstd_rand random(42);
+    std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+    std::vector<float> input(kFrameCount * channelCount);
+    for (float &sample : input) {
+        sample = distribution(random);
+    }
+    // The effects not running the bundle copy a stereo buffer to the output.
+    std::vector<float> output(kFrameCount * std::max(channelCount, 2u));
+
+    for (auto _ : state) {
+        // The bundle runs all enabled effects on the call to the last one.
+        for (effect_handle_t effect : effects) {
+            audio_buffer_t inBuffer, outBuffer;
+            inBuffer.frameCount = outBuffer.frameCount = kFrameCount;
+            inBuffer.f32 = input.data();
+            outBuffer.f32 = output.data();
+            if ((*effect)->process(effect, &inBuffer, &outBuffer) != 0) {
+                state.SkipWithError("process failed");
+                release();
+                return;
+            }
+        }
+        benchmark::DoNotOptimize(output.data());
+        benchmark::ClobberMemory();
+    }
+    release();
+
+    state.SetItemsProcessed(state.iterations() * kFrameCount);
+}
+
+static void MusicBundleArgs(benchmark::internal::Benchmark *b) {
+    for (int channelCount : {1, 2, 4, 6, 8}) {
+        for (int effectCount : {1, 3}) {
+            b->Args({channelCount, effectCount});
+        }
+    }
+}
+
+BENCHMARK(BM_MusicBundle)->Apply(MusicBundleArgs);
+
+BENCHMARK_MAIN();
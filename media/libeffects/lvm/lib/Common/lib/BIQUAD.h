@@ -274,6 +274,15 @@ void PK_Mc_D32F32C14G11_TRC_WRA_01(Biquad_FLOAT_Instance_t       *pInstance,
                                    LVM_INT16               NrChannels);
 #endif
 
+/*** 32 bit data path MULTI-CHANNEL, cascade of peaking filters ********************/
+#define PK_CASCADE_MAX_BIQUADS 8  /* Maximum number of filters passed in one call */
+void PK_Mc_D32F32C14G11_TRC_WRA_01_Cascade(Biquad_FLOAT_Instance_t  **ppInstances,
+                                           LVM_INT16                NrBiquads,
+                                           const LVM_FLOAT          *pDataIn,
+                                           LVM_FLOAT                *pDataOut,
+                                           LVM_INT16                NrFrames,
+                                           LVM_INT16                NrChannels);
+
 /**********************************************************************************
    FUNCTION PROTOTYPES: DC REMOVAL FILTERS
 ***********************************************************************************/
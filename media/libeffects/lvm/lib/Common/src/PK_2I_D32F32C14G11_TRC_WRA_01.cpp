@@ -190,3 +190,143 @@ void PK_Mc_D32F32C14G11_TRC_WRA_01 (Biquad_FLOAT_Instance_t       *pInstance,
 
     }
 #endif
+
+/**************************************************************************
+ Cascade of NrBiquads peaking filters, equivalent to calling
+ PK_Mc_D32F32C14G11_TRC_WRA_01 (or PK_2I_D32F32C14G11_TRC_WRA_01 for two
+ channels, which has the same delay layout) for each instance in turn.
+
+ The data goes through all the filters PK_CASCADE_BLOCK_FRAMES frames at a
+ time, so that each block is read and written once and stays in the cache
+ from one filter to the next. The delays of the filter being run are kept
+ in local variables, which lets the compiler keep them in registers for two
+ channels and vectorize the loop over the channels otherwise.
+ The input and output buffers may be the same. NrBiquads must be at least 1.
+***************************************************************************/
+#define PK_CASCADE_BLOCK_FRAMES 64
+
+void PK_Mc_D32F32C14G11_TRC_WRA_01_Cascade(Biquad_FLOAT_Instance_t  **ppInstances,
+                                           LVM_INT16                NrBiquads,
+                                           const LVM_FLOAT          *pDataIn,
+                                           LVM_FLOAT                *pDataOut,
+                                           LVM_INT16                NrFrames,
+                                           LVM_INT16                NrChannels)
+    {
+        LVM_FLOAT yn, temp;
+        LVM_INT16 ii, jj, bb;
+
+        for (LVM_INT16 start = 0; start < NrFrames; start += PK_CASCADE_BLOCK_FRAMES)
+        {
+            const LVM_INT16 BlockFrames = (NrFrames - start < PK_CASCADE_BLOCK_FRAMES) ?
+                (LVM_INT16)(NrFrames - start) : (LVM_INT16)PK_CASCADE_BLOCK_FRAMES;
+            const LVM_FLOAT *pIn = pDataIn + start * NrChannels;
+            LVM_FLOAT *pOut = pDataOut + start * NrChannels;
+
+            for (bb = 0; bb < NrBiquads; bb++)
+            {
+                PFilter_State_Float pBiquadState = (PFilter_State_Float) ppInstances[bb];
+                const LVM_FLOAT A0 = pBiquadState->coefs[0];
+                const LVM_FLOAT B2 = pBiquadState->coefs[1];
+                const LVM_FLOAT B1 = pBiquadState->coefs[2];
+                const LVM_FLOAT G = pBiquadState->coefs[3];
+                /* The first filter reads the input, the next ones the output in place */
+                const LVM_FLOAT *pX = bb == 0 ? pIn : pOut;
+                LVM_FLOAT *pY = pOut;
+
+                if (NrChannels == 2)
+                {
+                    LVM_FLOAT x1L = pBiquadState->pDelays[0], x1R = pBiquadState->pDelays[1];
+                    LVM_FLOAT x2L = pBiquadState->pDelays[2], x2R = pBiquadState->pDelays[3];
+                    LVM_FLOAT y1L = pBiquadState->pDelays[4], y1R = pBiquadState->pDelays[5];
+                    LVM_FLOAT y2L = pBiquadState->pDelays[6], y2R = pBiquadState->pDelays[7];
+                    for (ii = BlockFrames; ii != 0; ii--)
+                    {
+                        const LVM_FLOAT xL = pX[0], xR = pX[1];
+                        pX += 2;
+
+                        /* yn= (A0  * (x(n) - x(n-2))) + (-B2  * y(n-2)) + (-B1 * y(n-1)) */
+                        temp = xL - x2L;
+                        yn = temp * A0;
+                        temp = y2L * B2;
+                        yn += temp;
+                        temp = y1L * B1;
+                        yn += temp;
+                        y2L = y1L;
+                        y1L = yn;
+                        /* ynO= (Gain * yn) + x(n) */
+                        temp = yn * G;
+                        pY[0] = temp + xL;
+
+                        temp = xR - x2R;
+                        yn = temp * A0;
+                        temp = y2R * B2;
+                        yn += temp;
+                        temp = y1R * B1;
+                        yn += temp;
+                        y2R = y1R;
+                        y1R = yn;
+                        temp = yn * G;
+                        pY[1] = temp + xR;
+                        pY += 2;
+
+                        x2L = x1L;
+                        x1L = xL;
+                        x2R = x1R;
+                        x1R = xR;
+                    }
+                    pBiquadState->pDelays[0] = x1L;
+                    pBiquadState->pDelays[1] = x1R;
+                    pBiquadState->pDelays[2] = x2L;
+                    pBiquadState->pDelays[3] = x2R;
+                    pBiquadState->pDelays[4] = y1L;
+                    pBiquadState->pDelays[5] = y1R;
+                    pBiquadState->pDelays[6] = y2L;
+                    pBiquadState->pDelays[7] = y2R;
+                }
+                else
+                {
+                    LVM_FLOAT x1[LVM_MAX_CHANNELS], x2[LVM_MAX_CHANNELS];
+                    LVM_FLOAT y1[LVM_MAX_CHANNELS], y2[LVM_MAX_CHANNELS];
+                    for (jj = 0; jj < NrChannels; jj++)
+                    {
+                        x1[jj] = pBiquadState->pDelays[jj];
+                        x2[jj] = pBiquadState->pDelays[NrChannels + jj];
+                        y1[jj] = pBiquadState->pDelays[NrChannels * 2 + jj];
+                        y2[jj] = pBiquadState->pDelays[NrChannels * 3 + jj];
+                    }
+                    for (ii = BlockFrames; ii != 0; ii--)
+                    {
+                        for (jj = 0; jj < NrChannels; jj++)
+                        {
+                            const LVM_FLOAT xn = pX[jj];
+
+                            /* yn= (A0  * (x(n) - x(n-2))) + (-B2  * y(n-2)) + (-B1 * y(n-1)) */
+                            temp = xn - x2[jj];
+                            yn = temp * A0;
+                            temp = y2[jj] * B2;
+                            yn += temp;
+                            temp = y1[jj] * B1;
+                            yn += temp;
+                            y2[jj] = y1[jj];
+                            y1[jj] = yn;
+                            x2[jj] = x1[jj];
+                            x1[jj] = xn;
+                            /* ynO= (Gain * yn) + x(n) */
+                            temp = yn * G;
+                            pY[jj] = temp + xn;
+                        }
+                        pX += NrChannels;
+                        pY += NrChannels;
+                    }
+                    for (jj = 0; jj < NrChannels; jj++)
+                    {
+                        pBiquadState->pDelays[jj] = x1[jj];
+                        pBiquadState->pDelays[NrChannels + jj] = x2[jj];
+                        pBiquadState->pDelays[NrChannels * 2 + jj] = y1[jj];
+                        pBiquadState->pDelays[NrChannels * 3 + jj] = y2[jj];
+                    }
+                }
+            }
+        }
+
+    }
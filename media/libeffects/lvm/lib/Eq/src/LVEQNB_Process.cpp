@@ -99,56 +99,45 @@ LVEQNB_ReturnStatus_en LVEQNB_Process(LVEQNB_Handle_t       hInstance,
     if (pInstance->Params.OperatingMode == LVEQNB_ON)
     {
         /*
-         * Copy input data in to scratch buffer
+         * Filter the input in to the scratch buffer when the input is needed afterwards for
+         * the bypass mix, and straight in to the output otherwise.
          */
-        Copy_Float(pInData,     /* Source */
-                   pScratch,    /* Destination */
-                   (LVM_INT16)NrSamples);
+        LVM_FLOAT * const pFiltered =
+            pInstance->bInOperatingModeTransition == LVM_TRUE ? pScratch : pOutData;
+        const LVM_FLOAT *pToFilter = pInData;
 
         /*
-         * For each section execte the filter unless the gain is 0dB
+         * Execute the filters of all sections with a non-zero dB gain, up to
+         * PK_CASCADE_MAX_BIQUADS at a time in a single pass over the data
          */
-        if (pInstance->NBands != 0)
+        Biquad_FLOAT_Instance_t *pBiquads[PK_CASCADE_MAX_BIQUADS];
+        LVM_INT16 NrBiquads = 0;
+        for (LVM_UINT16 i = 0; i < pInstance->NBands; i++)
         {
-            for (LVM_UINT16 i = 0; i < pInstance->NBands; i++)
+            if ((pInstance->pBandDefinitions[i].Gain != 0) &&
+                (pInstance->pBiquadType[i] == LVEQNB_SinglePrecision_Float))
             {
-                /*
-                 * Check if band is non-zero dB gain
-                 */
-                if (pInstance->pBandDefinitions[i].Gain != 0)
-                {
-                    /*
-                     * Get the address of the biquad instance
-                     */
-                    Biquad_FLOAT_Instance_t *pBiquad = &pInstance->pEQNB_FilterState_Float[i];
-
-                    /*
-                     * Select single or double precision as required
-                     */
-                    switch (pInstance->pBiquadType[i])
-                    {
-                        case LVEQNB_SinglePrecision_Float:
-                        {
-#ifdef SUPPORT_MC
-                            PK_Mc_D32F32C14G11_TRC_WRA_01(pBiquad,
-                                                          pScratch,
-                                                          pScratch,
-                                                          (LVM_INT16)NrFrames,
-                                                          (LVM_INT16)NrChannels);
-#else
-                            PK_2I_D32F32C14G11_TRC_WRA_01(pBiquad,
-                                                          pScratch,
-                                                          pScratch,
-                                                          (LVM_INT16)NrFrames);
-#endif
-                            break;
-                        }
-                        default:
-                            break;
-                    }
-                }
+                pBiquads[NrBiquads++] = &pInstance->pEQNB_FilterState_Float[i];
+            }
+            if ((NrBiquads == PK_CASCADE_MAX_BIQUADS) ||
+                ((NrBiquads != 0) && (i == pInstance->NBands - 1)))
+            {
+                PK_Mc_D32F32C14G11_TRC_WRA_01_Cascade(pBiquads,
+                                                      NrBiquads,
+                                                      pToFilter,
+                                                      pFiltered,
+                                                      (LVM_INT16)NrFrames,
+                                                      (LVM_INT16)NrChannels);
+                pToFilter = pFiltered;
+                NrBiquads = 0;
             }
         }
+        if (pToFilter != pFiltered)
+        {
+            Copy_Float(pInData,              /* Source */
+                       pFiltered,            /* Destination */
+                       (LVM_INT16)NrSamples); /* All channel samples */
+        }
 
         if(pInstance->bInOperatingModeTransition == LVM_TRUE){
 #ifdef SUPPORT_MC
@@ -165,16 +154,10 @@ LVEQNB_ReturnStatus_en LVEQNB_Process(LVEQNB_Handle_t       hInstance,
                                        pScratch,
                                        (LVM_INT16)NrSamples);
 #endif
-            // duplicate with else clause(s)
             Copy_Float(pScratch,                         /* Source */
                        pOutData,                         /* Destination */
                        (LVM_INT16)NrSamples);            /* All channel samples */
         }
-        else{
-            Copy_Float(pScratch,              /* Source */
-                       pOutData,              /* Destination */
-                       (LVM_INT16)NrSamples); /* All channel samples */
-        }
     }
     else
     {
@@ -74,6 +74,18 @@ typedef enum
     LVREV_DELAYLINES_DUMMY = LVM_MAXENUM
 } LVREV_NumDelayLines_en;
 
+#ifdef SUPPORT_MC
+/* Reverb output fed to an output channel */
+typedef enum
+{
+    LVREV_CHANNEL_LEFT     = 0,                         /* Left reverb output */
+    LVREV_CHANNEL_RIGHT    = 1,                         /* Right reverb output */
+    LVREV_CHANNEL_CENTER   = 2,                         /* Average of the left and right outputs */
+    LVREV_CHANNEL_NONE     = 3,                         /* No reverb, e.g. for the LFE channel */
+    LVREV_CHANNEL_DUMMY    = LVM_MAXENUM
+} LVREV_ChannelRoute_en;
+#endif
+
 /****************************************************************************************/
 /*                                                                                      */
 /*  Structures                                                                          */
@@ -93,6 +105,12 @@ typedef struct
     LVM_Mode_en                 OperatingMode;          /* Operating mode */
     LVM_Fs_en                   SampleRate;             /* Sample rate */
     LVM_Format_en               SourceFormat;           /* Source data format */
+#ifdef SUPPORT_MC
+    LVM_INT32                   NrChannels;             /* Output channels, and input channels
+                                                           unless the source is mono */
+    LVREV_ChannelRoute_en       ChannelRoutes[LVM_MAX_CHANNELS]; /* Reverb output of each output
+                                                           channel, used when NrChannels is not 2 */
+#endif
 
     /* Parameters for REV */
     LVM_UINT16                  Level;                  /* Level, 0 to 100 representing percentage of reverb */
@@ -278,6 +296,9 @@ LVREV_ReturnStatus_en LVREV_ClearAudioBuffers(LVREV_Handle_t  hInstance);
 /*                                                                                      */
 /* NOTES:                                                                               */
 /*  1. The input and output buffers must be 32-bit aligned                              */
+/*  2. The output is stereo, or NrChannels interleaved channels when built with         */
+/*     SUPPORT_MC, each channel receiving the reverb output given by its ChannelRoutes  */
+/*     entry                                                                            */
 /*                                                                                      */
 /****************************************************************************************/
 LVREV_ReturnStatus_en LVREV_Process(LVREV_Handle_t      hInstance,
@@ -252,6 +252,15 @@ LVREV_ReturnStatus_en LVREV_GetInstanceHandle(LVREV_Handle_t            *phInsta
     pLVREV_Private->CurrentParams.SampleRate    = LVM_FS_INVALID;
     pLVREV_Private->CurrentParams.OperatingMode = LVM_MODE_DUMMY;
     pLVREV_Private->CurrentParams.SourceFormat  = LVM_SOURCE_DUMMY;
+#ifdef SUPPORT_MC
+    pLVREV_Private->CurrentParams.NrChannels    = 2;
+    for (i = 0; i < LVM_MAX_CHANNELS; i++)
+    {
+        pLVREV_Private->CurrentParams.ChannelRoutes[i] = LVREV_CHANNEL_NONE;
+    }
+    pLVREV_Private->CurrentParams.ChannelRoutes[0] = LVREV_CHANNEL_LEFT;
+    pLVREV_Private->CurrentParams.ChannelRoutes[1] = LVREV_CHANNEL_RIGHT;
+#endif
 
     pLVREV_Private->bControlPending             = LVM_FALSE;
     pLVREV_Private->bFirstControl               = LVM_TRUE;
@@ -23,6 +23,58 @@
 #include "LVREV_Private.h"
 #include "VectorArithmetic.h"
 
+#ifdef SUPPORT_MC
+/****************************************************************************************/
+/*                                                                                      */
+/* FUNCTION:                SpreadChannels                                              */
+/*                                                                                      */
+/* DESCRIPTION:                                                                         */
+/*  Writes the stereo reverb output to each output channel as given by its route        */
+/*                                                                                      */
+/* PARAMETERS:                                                                          */
+/*  pSrc                    Stereo reverb output                                        */
+/*  pDst                    Multichannel output, must not overlap pSrc                  */
+/*  pRoutes                 Route of each output channel                                */
+/*  NumSamples              Number of frames                                            */
+/*  NrChannels              Number of output channels                                   */
+/*                                                                                      */
+/****************************************************************************************/
+static void SpreadChannels(const LVM_FLOAT             *pSrc,
+                           LVM_FLOAT                   *pDst,
+                           const LVREV_ChannelRoute_en *pRoutes,
+                           LVM_INT16                   NumSamples,
+                           LVM_INT16                   NrChannels)
+{
+    LVM_INT16 ii, jj;
+
+    for (ii = NumSamples; ii != 0; ii--)
+    {
+        const LVM_FLOAT Left = pSrc[0];
+        const LVM_FLOAT Right = pSrc[1];
+        for (jj = 0; jj < NrChannels; jj++)
+        {
+            switch (pRoutes[jj])
+            {
+            case LVREV_CHANNEL_LEFT:
+                pDst[jj] = Left;
+                break;
+            case LVREV_CHANNEL_RIGHT:
+                pDst[jj] = Right;
+                break;
+            case LVREV_CHANNEL_CENTER:
+                pDst[jj] = (Left + Right) * 0.5f;
+                break;
+            default:
+                pDst[jj] = 0;
+                break;
+            }
+        }
+        pSrc += 2;
+        pDst += NrChannels;
+    }
+}
+#endif
+
 /****************************************************************************************/
 /*                                                                                      */
 /* FUNCTION:                LVREV_Process                                               */
@@ -55,6 +107,11 @@ LVREV_ReturnStatus_en LVREV_Process(LVREV_Handle_t      hInstance,
    LVM_FLOAT             *pOutput = pOutData;
    LVM_INT32             SamplesToProcess, RemainingSamples;
    LVM_INT32             format = 1;
+#ifdef SUPPORT_MC
+   LVM_INT32             NrChannels;
+#else
+   const LVM_INT32       NrChannels = 2; // FCC_2
+#endif
 
     /*
      * Check for error conditions
@@ -94,6 +151,10 @@ LVREV_ReturnStatus_en LVREV_Process(LVREV_Handle_t      hInstance,
         return LVREV_SUCCESS;
     }
 
+#ifdef SUPPORT_MC
+    NrChannels = pLVREV_Private->CurrentParams.NrChannels;
+#endif
+
     /*
      * If OFF copy and reformat the data as necessary
      */
@@ -102,14 +163,26 @@ LVREV_ReturnStatus_en LVREV_Process(LVREV_Handle_t      hInstance,
         if(pInput != pOutput)
         {
             /*
-             * Copy the data to the output buffer, convert to stereo is required
+             * Copy the data to the output buffer, convert to stereo or multichannel is required
              */
             if(pLVREV_Private->CurrentParams.SourceFormat == LVM_MONO){
+#ifdef SUPPORT_MC
+                if (NrChannels != 2)
+                {
+                    for (LVM_INT32 ii = 0; ii < NumSamples; ii++)
+                    {
+                        LoadConst_Float(pInput[ii],
+                                        &pOutput[ii * NrChannels],
+                                        (LVM_INT16)NrChannels);
+                    }
+                }
+                else
+#endif
                 MonoTo2I_Float(pInput, pOutput, NumSamples);
             } else {
                 Copy_Float(pInput,
                            pOutput,
-                           (LVM_INT16)(NumSamples << 1)); // 32 bit data, stereo
+                           (LVM_INT16)(NumSamples * NrChannels)); // 32 bit data
             }
         }
 
@@ -120,7 +193,7 @@ LVREV_ReturnStatus_en LVREV_Process(LVREV_Handle_t      hInstance,
 
     if (pLVREV_Private->CurrentParams.SourceFormat != LVM_MONO)
     {
-        format = 2;
+        format = NrChannels;
     }
 
     while (RemainingSamples!=0)
@@ -142,7 +215,7 @@ LVREV_ReturnStatus_en LVREV_Process(LVREV_Handle_t      hInstance,
 
         ReverbBlock(pInput, pOutput, pLVREV_Private, (LVM_UINT16)SamplesToProcess);
         pInput  = (LVM_FLOAT *)(pInput + (SamplesToProcess * format));
-        pOutput = (LVM_FLOAT *)(pOutput + (SamplesToProcess * 2));      // Always stereo output
+        pOutput = (LVM_FLOAT *)(pOutput + (SamplesToProcess * NrChannels));
     }
 
     return LVREV_SUCCESS;
@@ -175,11 +248,15 @@ void ReverbBlock(LVM_FLOAT *pInput, LVM_FLOAT *pOutput,
 {
     LVM_INT16   j, size;
     LVM_FLOAT   *pDelayLine;
-    LVM_FLOAT   *pDelayLineInput = pPrivate->pScratch;
+    LVM_FLOAT   *pDelayLineInput;
     LVM_FLOAT   *pScratch = pPrivate->pScratch;
     LVM_FLOAT   *pIn;
     LVM_FLOAT   *pTemp = pPrivate->pInputSave;
+    LVM_FLOAT   *pMixerOutput = pOutput;
     LVM_INT32   NumberOfDelayLines;
+#ifdef SUPPORT_MC
+    const LVM_INT32 NrChannels = pPrivate->CurrentParams.NrChannels;
+#endif
 
     /******************************************************************************
      * All calculations will go into the buffer pointed to by pTemp, this will    *
@@ -194,6 +271,10 @@ void ReverbBlock(LVM_FLOAT *pInput, LVM_FLOAT *pOutput,
      * The temp buffer will always be NumSamples in size regardless of MONO or    *
      * STEREO input. In the case of stereo input all processing is done in MONO   *
      * and the final output is converted to STEREO after the mixer                *
+     *                                                                            *
+     * Multichannel input is mixed down to MONO in the same pass which copies it  *
+     * to the temp buffer, and the STEREO output of the mixer is spread over all  *
+     * the output channels in the pass which writes the output buffer.            *
      ******************************************************************************/
 
     if(pPrivate->InstanceParams.NumDelays == LVREV_DELAYLINES_4)
@@ -213,6 +294,20 @@ void ReverbBlock(LVM_FLOAT *pInput, LVM_FLOAT *pOutput,
     {
         pIn = pInput;
     }
+#ifdef SUPPORT_MC
+    else if(pPrivate->CurrentParams.SourceFormat == LVM_MULTICHANNEL)
+    {
+        /*
+         *  Multichannel to mono conversion
+         */
+
+        FromMcToMono_Float(pInput,
+                           pTemp,
+                           (LVM_INT16)NumSamples,
+                           (LVM_INT16)NrChannels);
+        pIn = pTemp;
+    }
+#endif
     else
     {
         /*
@@ -307,6 +402,10 @@ void ReverbBlock(LVM_FLOAT *pInput, LVM_FLOAT *pOutput,
      */
     for(j = 0; j < NumberOfDelayLines; j++)
     {
+        /*
+         *  The delay line input is mixed in place at the end of the fixed delay
+         */
+        pDelayLineInput = &pPrivate->pDelay_T[j][pPrivate->T[j] - NumSamples];
 
         Copy_Float(pTemp,
                    pDelayLineInput,
@@ -398,13 +497,6 @@ void ReverbBlock(LVM_FLOAT *pInput, LVM_FLOAT *pOutput,
             default:
                 break;
         }
-
-        /*
-         *  Delay samples
-         */
-        Copy_Float(pDelayLineInput,
-                   &pPrivate->pDelay_T[j][pPrivate->T[j] - NumSamples],
-                   (LVM_INT16)(NumSamples));              /* 32-bit data */
     }
 
     /*
@@ -459,25 +551,47 @@ void ReverbBlock(LVM_FLOAT *pInput, LVM_FLOAT *pOutput,
      *  Dry/wet mixer
      */
 
+#ifdef SUPPORT_MC
+    if (NrChannels != 2)
+    {
+        /* Mix in place, the output is written when spreading the channels */
+        pMixerOutput = pTemp;
+    }
+#endif
+
     size = (LVM_INT16)(NumSamples << 1);
     MixSoft_2St_D32C31_SAT(&pPrivate->BypassMixer,
                            pTemp,
                            pTemp,
-                           pOutput,
+                           pMixerOutput,
                            size);
 
     /* Apply Gain*/
 
     Shift_Sat_Float(LVREV_OUTPUTGAIN_SHIFT,
-                    pOutput,
-                    pOutput,
+                    pMixerOutput,
+                    pMixerOutput,
                     size);
 
     MixSoft_1St_D32C31_WRA(&pPrivate->GainMixer,
-                           pOutput,
-                           pOutput,
+                           pMixerOutput,
+                           pMixerOutput,
                            size);
 
+#ifdef SUPPORT_MC
+    if (NrChannels != 2)
+    {
+        /*
+         *  Spread the stereo output over all channels
+         */
+        SpreadChannels(pMixerOutput,
+                       pOutput,
+                       pPrivate->CurrentParams.ChannelRoutes,
+                       (LVM_INT16)NumSamples,
+                       (LVM_INT16)NrChannels);
+    }
+#endif
+
     return;
 }
 /* End of file */
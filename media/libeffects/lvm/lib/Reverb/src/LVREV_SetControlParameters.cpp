@@ -81,6 +81,27 @@ LVREV_ReturnStatus_en LVREV_SetControlParameters(LVREV_Handle_t           hInsta
         return (LVREV_OUTOFRANGE);
     }
 
+#ifdef SUPPORT_MC
+    /* Only mono and multichannel sources may have more than two output channels */
+    if ((pNewParams->NrChannels < 2) || (pNewParams->NrChannels > LVM_MAX_CHANNELS) ||
+        ((pNewParams->NrChannels != 2) &&
+         (pNewParams->SourceFormat != LVM_MONO) &&
+         (pNewParams->SourceFormat != LVM_MULTICHANNEL)))
+    {
+        return LVREV_OUTOFRANGE;
+    }
+    for (LVM_INT32 ch = 0; ch < pNewParams->NrChannels; ch++)
+    {
+        if ((pNewParams->ChannelRoutes[ch] != LVREV_CHANNEL_LEFT)   &&
+            (pNewParams->ChannelRoutes[ch] != LVREV_CHANNEL_RIGHT)  &&
+            (pNewParams->ChannelRoutes[ch] != LVREV_CHANNEL_CENTER) &&
+            (pNewParams->ChannelRoutes[ch] != LVREV_CHANNEL_NONE))
+        {
+            return LVREV_OUTOFRANGE;
+        }
+    }
+#endif
+
     if (pNewParams->Level > LVREV_MAX_LEVEL)
     {
         return LVREV_OUTOFRANGE;
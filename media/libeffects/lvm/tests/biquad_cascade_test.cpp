@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Check the blocked cascade of peaking filters used by the N-band equaliser against
+ * running PK_Mc_D32F32C14G11_TRC_WRA_01 for each filter in turn.
+ */
+
+#include <math.h>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "BIQUAD.h"
+
+// Frames per block of the cascade, see PK_2I_D32F32C14G11_TRC_WRA_01.cpp.
+constexpr int kBlockFrames = 64;
+
+// A set of peaking filters, with their own delays.
+class PeakingFilters {
+public:
+    explicit PeakingFilters(int count) : mInstances(count), mTaps(count) {
+        for (int i = 0; i < count; i++) {
+            // Poles inside the unit circle at different frequencies, gains of both signs
+            const LVM_FLOAT radius = 0.9f + 0.01f * i;
+            const LVM_FLOAT omega = 0.05f + 0.35f * i;
+            PK_FLOAT_Coefs_t coefs = {
+                    .A0 = 0.02f + 0.01f * i,
+                    .B2 = -radius * radius,
+                    .B1 = 2 * radius * cosf(omega),
+                    .G = (i % 2 == 0) ? 1.5f : -0.5f,
+            };
+            PK_2I_D32F32CssGss_TRC_WRA_01_Init(&mInstances[i], &mTaps[i], &coefs);
+            memset(&mTaps[i], 0, sizeof(mTaps[i]));
+        }
+    }
+
+    // The sequential reference: one pass over the data per filter, in place after the first.
+    void runSequential(const std::vector<LVM_FLOAT> &in, std::vector<LVM_FLOAT> *out,
+                       int frames, int channels) {
+        *out = in;
+        for (auto &instance : mInstances) {
+            PK_Mc_D32F32C14G11_TRC_WRA_01(&instance, out->data(), out->data(),
+                                          frames, channels);
+        }
+    }
+
+    void runCascade(const LVM_FLOAT *in, LVM_FLOAT *out, int frames, int channels) {
+        std::vector<Biquad_FLOAT_Instance_t *> instances;
+        for (auto &instance : mInstances) {
+            instances.push_back(&instance);
+        }
+        PK_Mc_D32F32C14G11_TRC_WRA_01_Cascade(instances.data(), instances.size(), in, out,
+                                              frames, channels);
+    }
+
+    const Biquad_2I_Order2_FLOAT_Taps_t &taps(int i) const { return mTaps[i]; }
+
+private:
+    std::vector<Biquad_FLOAT_Instance_t> mInstances;
+    std::vector<Biquad_2I_Order2_FLOAT_Taps_t> mTaps;
+};
+
+// Channel count, filter count.
+class BiquadCascadeTest : public ::testing::TestWithParam<std::tuple<int, int>> {};
+
+TEST_P(BiquadCascadeTest, MatchesSequentialFilters) {
+    const int channels = std::get<0>(GetParam());
+    const int filters = std::get<1>(GetParam());
+    PeakingFilters reference(filters), cascade(filters), inPlace(filters);
+
+    std::minstd_rand generator(channels * 100 + filters);
+    std::uniform_real_distribution<LVM_FLOAT> distribution(-1.0f, 1.0f);
+    // Consecutive calls with frame counts around the block size, so that the state is
+    // carried across blocks and across calls.
+    for (int frames : {1, kBlockFrames - 1, kBlockFrames, kBlockFrames + 1, 2 * kBlockFrames,
+                       3 * kBlockFrames + 17, 7}) {
+        std::vector<LVM_FLOAT> in(frames * channels);
+        for (auto &sample : in) {
+            sample = distribution(generator);
+        }
+
+        std::vector<LVM_FLOAT> expected;
+        reference.runSequential(in, &expected, frames, channels);
+
+        std::vector<LVM_FLOAT> out(in.size());
+        cascade.runCascade(in.data(), out.data(), frames, channels);
+        std::vector<LVM_FLOAT> inOut = in;
+        inPlace.runCascade(inOut.data(), inOut.data(), frames, channels);
+
+        for (size_t i = 0; i < in.size(); i++) {
+            ASSERT_EQ(expected[i], out[i]) << "frames " << frames << " sample " << i;
+            ASSERT_EQ(expected[i], inOut[i]) << "frames " << frames << " sample " << i;
+        }
+    }
+
+    // The delays are stored back for the next call.
+    for (int i = 0; i < filters; i++) {
+        for (int tap = 0; tap < channels * 4; tap++) {
+            EXPECT_EQ(reference.taps(i).Storage[tap], cascade.taps(i).Storage[tap])
+                    << "filter " << i << " tap " << tap;
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(
+        ChannelsAndFilters,
+        BiquadCascadeTest,
+        ::testing::Combine(::testing::Values(1, 2, 4, 8),
+                           ::testing::Values(1, 2, 5, PK_CASCADE_MAX_BIQUADS)));
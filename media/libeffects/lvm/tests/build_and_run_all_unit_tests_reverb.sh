@@ -0,0 +1,91 @@
+#!/bin/bash
+#
+# Run reverb tests in this directory.
+#
+
+if [ -z "$ANDROID_BUILD_TOP" ]; then
+    echo "Android build environment not set"
+    exit -1
+fi
+
+# ensure we have mm
+. $ANDROID_BUILD_TOP/build/envsetup.sh
+
+mm -j
+
+echo "waiting for device"
+
+adb root && adb wait-for-device remount
+
+# location of test files
+testdir="/data/local/tmp/revTest"
+
+echo "========================================"
+echo "testing reverb"
+adb shell mkdir -p $testdir
+adb push $ANDROID_BUILD_TOP/cts/tests/tests/media/res/raw/sinesweepraw.raw $testdir
+adb push $OUT/testcases/snr/arm64/snr $testdir
+adb push $OUT/testcases/reverb_test/arm64/reverb_test $testdir
+
+flags_arr=(
+    "-M"
+    "-M -aux"
+    "-M -preset:1"
+    "-M -aux -preset:1"
+)
+
+fs_arr=(
+    8000
+    16000
+    22050
+    32000
+    44100
+    48000
+    88200
+    96000
+    176400
+    192000
+)
+
+# run the reverb at different channel configs, saving only the stereo channel pair, which
+# must match the stereo computation: the reverb is computed from the mix down of identical
+# channels and spread over the channels by position. reverb_test checks the other channels
+# against the front pair: the left and right side channels get the left and right reverb,
+# the center channels their average and the LFE channel none.
+error_count=0
+for flags in "${flags_arr[@]}"
+do
+    for fs in ${fs_arr[*]}
+    do
+        # mono (chMask 0) is not a supported reverb output
+        for chMask in {1..22}
+        do
+            adb shell $testdir/reverb_test -i:$testdir/sinesweepraw.raw \
+                -o:$testdir/sinesweep_$((chMask))_$((fs)).raw -chMask:$chMask -fs:$fs \
+                -checkChannels $flags
+
+            shell_ret=$?
+            if [ $shell_ret -ne 0 ]; then
+                echo "error: $shell_ret"
+                ((++error_count))
+            fi
+
+            if [[ "$chMask" -gt 1 ]]
+            then
+                adb shell $testdir/snr $testdir/sinesweep_1_$((fs)).raw \
+                    $testdir/sinesweep_$((chMask))_$((fs)).raw -thr:90.308998
+
+                # snr returns EXIT_FAILURE on mismatch.
+                shell_ret=$?
+                if [ $shell_ret -ne 0 ]; then
+                    echo "error: $shell_ret"
+                    ((++error_count))
+                fi
+            fi
+        done
+    done
+done
+
+adb shell rm -r $testdir
+echo "$error_count errors"
+exit $error_count
@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <iterator>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <audio_utils/channels.h>
+#include <audio_utils/primitives.h>
+#include <hardware/audio_effect.h>
+#include <log/log.h>
+#include <system/audio.h>
+
+#include "EffectReverb.h"
+
+extern audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+// Insert and auxiliary preset reverb implementations of the library.
+constexpr effect_uuid_t kInsertPresetReverbUuid = {
+    0x172cdf00, 0xa3bc, 0x11df, 0xa72f, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}};
+constexpr effect_uuid_t kAuxPresetReverbUuid = {
+    0xf29a1400, 0xa3bb, 0x11df, 0x8ddc, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}};
+
+constexpr audio_channel_mask_t kReverbConfigChMask[] = {
+    AUDIO_CHANNEL_OUT_MONO,
+    AUDIO_CHANNEL_OUT_STEREO,
+    AUDIO_CHANNEL_OUT_2POINT1,
+    AUDIO_CHANNEL_OUT_2POINT0POINT2,
+    AUDIO_CHANNEL_OUT_QUAD,
+    AUDIO_CHANNEL_OUT_QUAD_BACK,
+    AUDIO_CHANNEL_OUT_QUAD_SIDE,
+    AUDIO_CHANNEL_OUT_SURROUND,
+    (1 << 4) - 1,
+    AUDIO_CHANNEL_OUT_2POINT1POINT2,
+    AUDIO_CHANNEL_OUT_3POINT0POINT2,
+    AUDIO_CHANNEL_OUT_PENTA,
+    (1 << 5) - 1,
+    AUDIO_CHANNEL_OUT_3POINT1POINT2,
+    AUDIO_CHANNEL_OUT_5POINT1,
+    AUDIO_CHANNEL_OUT_5POINT1_BACK,
+    AUDIO_CHANNEL_OUT_5POINT1_SIDE,
+    (1 << 6) - 1,
+    AUDIO_CHANNEL_OUT_6POINT1,
+    (1 << 7) - 1,
+    AUDIO_CHANNEL_OUT_5POINT1POINT2,
+    AUDIO_CHANNEL_OUT_7POINT1,
+    (1 << 8) - 1,
+};
+
+struct reverbConfigParams_t {
+  int          samplingFreq = 48000;
+  audio_channel_mask_t chMask = AUDIO_CHANNEL_OUT_STEREO;
+  int          fChannels = 2;
+  bool         monoMode = false;
+  bool         auxiliary = false;
+  bool         checkChannels = false;
+  int          frameLength = 256;
+  uint16_t     preset = REVERB_PRESET_LARGEHALL;
+};
+
+void printUsage() {
+  printf("\nUsage: ");
+  printf("\n     <executable> -i:<input_file> -o:<out_file> [options]\n");
+  printf("\nwhere, \n     <inputfile>  is the 16 bit input file name");
+  printf("\n                  on which the reverb is applied");
+  printf("\n     <outputfile> processed 16 bit output file");
+  printf("\n     and options are mentioned below");
+  printf("\n");
+  printf("\n     -help (or) -h");
+  printf("\n           Prints this usage information");
+  printf("\n");
+  printf("\n     -chMask:<channel_mask>");
+  printf("\n           index of the output channel mask, see lvmtest, default 1 (stereo)");
+  printf("\n");
+  printf("\n     -fs:<sampling_freq>");
+  printf("\n           Sampling frequency, default 48000");
+  printf("\n");
+  printf("\n     -fch:<file_channels> (1 through 8)");
+  printf("\n           Number of channels in the input and output files, default 2");
+  printf("\n");
+  printf("\n     -M");
+  printf("\n           Mono mode (force all input audio channels to be identical)");
+  printf("\n");
+  printf("\n     -aux");
+  printf("\n           Auxiliary reverb, fed with the first channel of the input file");
+  printf("\n");
+  printf("\n     -checkChannels");
+  printf("\n           Check that each output channel gets the reverb of its position:");
+  printf("\n           left side channels the left one, right side channels the right one,");
+  printf("\n           center channels their average and the LFE channel none");
+  printf("\n");
+  printf("\n     -preset:<preset> (1 through 6)");
+  printf("\n           Reverb preset, default %d (large hall)", REVERB_PRESET_LARGEHALL);
+  printf("\n\n");
+}
+
+int reverbCommand(effect_handle_t effectHandle, uint32_t cmdCode, uint32_t cmdSize,
+                  void *pCmdData) {
+  int reply = 0;
+  uint32_t replySize = sizeof(reply);
+  const int status =
+      (*effectHandle)->command(effectHandle, cmdCode, cmdSize, pCmdData, &replySize, &reply);
+  return status != 0 ? status : reply;
+}
+
+int reverbCreate(effect_handle_t *pEffectHandle, const reverbConfigParams_t &params) {
+  const effect_uuid_t *uuid = params.auxiliary ? &kAuxPresetReverbUuid : &kInsertPresetReverbUuid;
+  if (AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(uuid, 1 /* sessionId */, 1 /* ioId */,
+                                                  pEffectHandle) != 0) {
+    ALOGE("Reverb library create_effect failed");
+    return -EINVAL;
+  }
+
+  effect_config_t config{};
+  config.inputCfg.samplingRate = config.outputCfg.samplingRate = params.samplingFreq;
+  config.inputCfg.channels = params.auxiliary ? AUDIO_CHANNEL_OUT_MONO : params.chMask;
+  config.outputCfg.channels = params.chMask;
+  config.inputCfg.format = config.outputCfg.format = AUDIO_FORMAT_PCM_FLOAT;
+  config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+  config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+  config.inputCfg.mask = config.outputCfg.mask = EFFECT_CONFIG_ALL;
+  int status = reverbCommand(*pEffectHandle, EFFECT_CMD_SET_CONFIG, sizeof(config), &config);
+  if (status != 0) {
+    ALOGE("Reverb EFFECT_CMD_SET_CONFIG failed: %d", status);
+    return status;
+  }
+
+  uint32_t paramData[sizeof(effect_param_t) / sizeof(uint32_t) + 2] = {};
+  effect_param_t *param = (effect_param_t *)paramData;
+  param->psize = sizeof(int32_t);
+  param->vsize = sizeof(uint16_t);
+  *(int32_t *)param->data = REVERB_PARAM_PRESET;
+  *(uint16_t *)(param->data + sizeof(int32_t)) = params.preset;
+  status = reverbCommand(*pEffectHandle, EFFECT_CMD_SET_PARAM,
+                         sizeof(effect_param_t) + param->psize + param->vsize, param);
+  if (status != 0) {
+    ALOGE("Reverb EFFECT_CMD_SET_PARAM failed: %d", status);
+    return status;
+  }
+
+  status = reverbCommand(*pEffectHandle, EFFECT_CMD_ENABLE, 0, nullptr);
+  if (status != 0) {
+    ALOGE("Reverb EFFECT_CMD_ENABLE failed: %d", status);
+  }
+  return status;
+}
+
+// Tolerance of the reverb of a channel against the one derived from the front pair.
+constexpr float kChannelTolerance = 1e-5f;
+
+// Checks the reverb of each output channel against the front left and right ones, the
+// reverb being the output minus the dry input in insert mode.
+int reverbCheckChannels(const reverbConfigParams_t &params, const float *in, const float *out,
+                        int frameLength) {
+  const int channelCount = audio_channel_count_from_out_mask(params.chMask);
+  const uint32_t leftBits = AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER |
+      AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_SIDE_LEFT |
+      AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT | AUDIO_CHANNEL_OUT_TOP_BACK_LEFT |
+      AUDIO_CHANNEL_OUT_TOP_SIDE_LEFT;
+  const uint32_t rightBits = AUDIO_CHANNEL_OUT_FRONT_RIGHT |
+      AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER | AUDIO_CHANNEL_OUT_BACK_RIGHT |
+      AUDIO_CHANNEL_OUT_SIDE_RIGHT | AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT |
+      AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT | AUDIO_CHANNEL_OUT_TOP_SIDE_RIGHT;
+  // the test masks all start with the front pair
+  if ((params.chMask & AUDIO_CHANNEL_OUT_STEREO) != AUDIO_CHANNEL_OUT_STEREO) {
+    printf("Error: channel check needs the front pair\n");
+    return -EINVAL;
+  }
+
+  for (int i = 0; i < frameLength; ++i) {
+    const float *frameIn = &in[i * channelCount];
+    const float *frameOut = &out[i * channelCount];
+    auto wet = [&](int c) { return frameOut[c] - (params.auxiliary ? 0.f : frameIn[c]); };
+    const float left = wet(0);
+    const float right = wet(1);
+
+    int c = 0;
+    for (uint32_t bits = params.chMask; bits != 0; bits &= bits - 1, ++c) {
+      const uint32_t bit = bits & -bits;
+      float expected;
+      if (bit & leftBits) {
+        expected = left;
+      } else if (bit & rightBits) {
+        expected = right;
+      } else if (bit == AUDIO_CHANNEL_OUT_LOW_FREQUENCY) {
+        expected = 0.f;
+      } else {
+        expected = (left + right) * 0.5f;
+      }
+      if (fabsf(wet(c) - expected) > kChannelTolerance) {
+        printf("Error: channel %d (0x%x) reverb %f, expected %f\n", c, bit, wet(c), expected);
+        return -EINVAL;
+      }
+    }
+  }
+  return 0;
+}
+
+int reverbMainProcess(effect_handle_t effectHandle, const reverbConfigParams_t &params,
+                      FILE *finp, FILE *fout) {
+  const int channelCount = audio_channel_count_from_out_mask(params.chMask);
+  const int frameLength = params.frameLength;
+  const int ioChannelCount = params.fChannels;
+  const int ioFrameSize = ioChannelCount * sizeof(short);  // file load size
+  const int maxChannelCount = std::max(channelCount, ioChannelCount);
+
+  std::vector<short> in(frameLength * maxChannelCount);
+  std::vector<short> out(frameLength * maxChannelCount);
+  std::vector<float> floatIn(frameLength * channelCount);
+  std::vector<float> floatOut(frameLength * channelCount);
+
+  int frameCounter = 0;
+  while (fread(in.data(), ioFrameSize, frameLength, finp) == (size_t)frameLength) {
+    if (ioChannelCount != channelCount) {
+      adjust_channels(in.data(), ioChannelCount, in.data(), channelCount, sizeof(short),
+                      frameLength * ioFrameSize);
+    }
+    memcpy_to_float_from_i16(floatIn.data(), in.data(), frameLength * channelCount);
+
+    // Mono mode will replicate the first channel to all other channels, so that the
+    // multichannel mix down of the reverb input matches the stereo one.
+    if (params.monoMode && channelCount > 1) {
+      for (int i = 0; i < frameLength; ++i) {
+        auto *fp = &floatIn[i * channelCount];
+        std::fill(fp + 1, fp + channelCount, *fp);  // replicate ch 0
+      }
+    }
+    if (params.auxiliary && channelCount > 1) {
+      // the auxiliary input is the mono send: keep the first channel of each frame
+      for (int i = 0; i < frameLength; ++i) {
+        floatIn[i] = floatIn[i * channelCount];
+      }
+    }
+
+    audio_buffer_t inBuffer = {.frameCount = (size_t)frameLength, .f32 = floatIn.data()};
+    audio_buffer_t outBuffer = {.frameCount = (size_t)frameLength, .f32 = floatOut.data()};
+    const int status = (*effectHandle)->process(effectHandle, &inBuffer, &outBuffer);
+    if (status != 0) {
+      printf("\nError: process returned with %d\n", status);
+      return status;
+    }
+    if (params.checkChannels) {
+      const int checkStatus =
+          reverbCheckChannels(params, floatIn.data(), floatOut.data(), frameLength);
+      if (checkStatus != 0) {
+        return checkStatus;
+      }
+    }
+
+    memcpy_to_i16_from_float(out.data(), floatOut.data(), frameLength * channelCount);
+    if (ioChannelCount != channelCount) {
+      adjust_channels(out.data(), channelCount, out.data(), ioChannelCount, sizeof(short),
+                      frameLength * channelCount * sizeof(short));
+    }
+    (void)fwrite(out.data(), ioFrameSize, frameLength, fout);
+    frameCounter += frameLength;
+  }
+  printf("frameCounter: [%d]\n", frameCounter);
+  return 0;
+}
+
+int main(int argc, const char *argv[]) {
+  if (argc == 1) {
+    printUsage();
+    return -1;
+  }
+
+  reverbConfigParams_t params{};  // default initialize
+  const char *infile = nullptr;
+  const char *outfile = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    printf("%s ", argv[i]);
+    if (!strncmp(argv[i], "-i:", 3)) {
+      infile = argv[i] + 3;
+    } else if (!strncmp(argv[i], "-o:", 3)) {
+      outfile = argv[i] + 3;
+    } else if (!strncmp(argv[i], "-fs:", 4)) {
+      params.samplingFreq = atoi(argv[i] + 4);
+    } else if (!strncmp(argv[i], "-chMask:", 8)) {
+      const int chMaskConfigIdx = atoi(argv[i] + 8);
+      if (chMaskConfigIdx < 0 || (size_t)chMaskConfigIdx >= std::size(kReverbConfigChMask)) {
+        ALOGE("\nError: Unsupported Channel Mask : %d\n", chMaskConfigIdx);
+        return -1;
+      }
+      params.chMask = kReverbConfigChMask[chMaskConfigIdx];
+    } else if (!strncmp(argv[i], "-fch:", 5)) {
+      const int fChannels = atoi(argv[i] + 5);
+      if (fChannels > 8 || fChannels < 1) {
+        printf("Error: Unsupported number of file channels : %d\n", fChannels);
+        return -1;
+      }
+      params.fChannels = fChannels;
+    } else if (!strcmp(argv[i], "-M")) {
+      params.monoMode = true;
+    } else if (!strcmp(argv[i], "-aux")) {
+      params.auxiliary = true;
+    } else if (!strcmp(argv[i], "-checkChannels")) {
+      params.checkChannels = true;
+    } else if (!strncmp(argv[i], "-preset:", 8)) {
+      const int preset = atoi(argv[i] + 8);
+      if (preset < REVERB_PRESET_SMALLROOM || preset > REVERB_PRESET_LAST) {
+        printf("Error: Unsupported preset : %d\n", preset);
+        return -1;
+      }
+      params.preset = (uint16_t)preset;
+    } else if (!strcmp(argv[i], "-h")) {
+      printUsage();
+      return 0;
+    }
+  }
+
+  if (infile == nullptr || outfile == nullptr) {
+    printf("Error: missing input/output files\n");
+    printUsage();
+    return -1;
+  }
+
+  FILE *finp = fopen(infile, "rb");
+  if (finp == nullptr) {
+    printf("Cannot open input file %s", infile);
+    return -1;
+  }
+
+  FILE *fout = fopen(outfile, "wb");
+  if (fout == nullptr) {
+    printf("Cannot open output file %s", outfile);
+    fclose(finp);
+    return -1;
+  }
+
+  effect_handle_t effectHandle = nullptr;
+  int errCode = reverbCreate(&effectHandle, params);
+  if (errCode == 0) {
+    errCode = reverbMainProcess(effectHandle, params, finp, fout);
+    if (errCode != 0) {
+      printf("Error: reverbMainProcess returned with the error: %d", errCode);
+    }
+  } else {
+    printf("Error: reverbCreate returned with the error: %d", errCode);
+  }
+  fclose(finp);
+  fclose(fout);
+  if (effectHandle != nullptr) {
+    AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(effectHandle);
+  }
+
+  return errCode != 0 ? -1 : 0;
+}
@@ -164,6 +164,9 @@ struct ReverbContext{
     LVM_INT16                       prevLeftVolume;
     LVM_INT16                       prevRightVolume;
     int                             volumeMode;
+#ifdef SUPPORT_MC
+    LVREV_ChannelRoute_en           channelRoutes[LVM_MAX_CHANNELS];
+#endif
 };
 
 enum {
@@ -189,6 +192,14 @@ int  Reverb_getParameter    (ReverbContext *pContext,
                              void          *pValue);
 int Reverb_LoadPreset       (ReverbContext   *pContext);
 int Reverb_paramValueSize   (int32_t param);
+void Reverb_applyVolume     (const ReverbContext *pContext,
+                             process_buffer_t    *pFrame,
+                             int                 channels,
+                             float               vl,
+                             float               vr);
+#ifdef SUPPORT_MC
+void Reverb_getChannelRoutes(audio_channel_mask_t channelMask, LVREV_ChannelRoute_en *pRoutes);
+#endif
 
 /* Effect Library Interface Implementation */
 
@@ -258,10 +269,11 @@ extern "C" int EffectCreate(const effect_uuid_t *uuid,
 
 
     int channels = audio_channel_count_from_out_mask(pContext->config.inputCfg.channels);
+    int outChannels = audio_channel_count_from_out_mask(pContext->config.outputCfg.channels);
 
-    // Allocate memory for reverb process (*2 is for STEREO)
+    // Allocate memory for reverb process
     pContext->bufferSizeIn = LVREV_MAX_FRAME_SIZE * sizeof(process_buffer_t) * channels;
-    pContext->bufferSizeOut = LVREV_MAX_FRAME_SIZE * sizeof(process_buffer_t) * FCC_2;
+    pContext->bufferSizeOut = LVREV_MAX_FRAME_SIZE * sizeof(process_buffer_t) * outChannels;
     pContext->InFrames  = (process_buffer_t *)calloc(pContext->bufferSizeIn, 1 /* size */);
     pContext->OutFrames = (process_buffer_t *)calloc(pContext->bufferSizeOut, 1 /* size */);
 
@@ -325,14 +337,14 @@ extern "C" int EffectGetDescriptor(const effect_uuid_t *uuid,
 // Apply the Reverb
 //
 // Inputs:
-//  pIn:        pointer to stereo/mono float or 16 bit input data
-//  pOut:       pointer to stereo float or 16 bit output data
+//  pIn:        pointer to mono/stereo/multichannel float input data
+//  pOut:       pointer to stereo/multichannel float output data
 //  frameCount: Frames to process
 //  pContext:   effect engine context
 //  strength    strength to be applied
 //
 //  Outputs:
-//  pOut:       pointer to updated stereo 16 bit output data
+//  pOut:       pointer to updated stereo/multichannel float output data
 //
 //----------------------------------------------------------------------------
 int process( effect_buffer_t   *pIn,
@@ -341,16 +353,18 @@ int process( effect_buffer_t   *pIn,
              ReverbContext *pContext){
 
     int channels = audio_channel_count_from_out_mask(pContext->config.inputCfg.channels);
+    int outChannels = audio_channel_count_from_out_mask(pContext->config.outputCfg.channels);
     LVREV_ReturnStatus_en   LvmStatus = LVREV_SUCCESS;              /* Function call status */
+    const process_buffer_t *pReverbIn = pContext->InFrames;
 
-    // Check that the input is either mono or stereo
-    if (!(channels == 1 || channels == FCC_2) ) {
+    // Check that the input is either mono, stereo or multichannel
+    if (!(channels == 1 || (channels >= FCC_2 && channels <= LVM_MAX_CHANNELS))) {
         ALOGE("\tLVREV_ERROR : process invalid PCM format");
         return -EINVAL;
     }
 
     size_t inSize = frameCount * sizeof(process_buffer_t) * channels;
-    size_t outSize = frameCount * sizeof(process_buffer_t) * FCC_2;
+    size_t outSize = frameCount * sizeof(process_buffer_t) * outChannels;
     if (pContext->InFrames == NULL ||
             pContext->bufferSizeIn < inSize) {
         free(pContext->InFrames);
@@ -379,28 +393,29 @@ int process( effect_buffer_t   *pIn,
     if (pContext->auxiliary) {
         static_assert(std::is_same<decltype(*pIn), decltype(*pContext->InFrames)>::value,
                 "pIn and InFrames must be same type");
-        memcpy(pContext->InFrames, pIn, frameCount * channels * sizeof(*pIn));
-        } else {
-        // insert reverb input is always stereo
-        for (int i = 0; i < frameCount; i++) {
-            pContext->InFrames[2 * i] = (process_buffer_t)pIn[2 * i] * REVERB_SEND_LEVEL;
-            pContext->InFrames[2 * i + 1] = (process_buffer_t)pIn[2 * i + 1] * REVERB_SEND_LEVEL;
+        // the reverb engine reads the auxiliary input in place
+        pReverbIn = pIn;
+    } else {
+        // insert reverb input has as many channels as the output, mixed down by the engine
+        for (int i = 0; i < frameCount * channels; i++) {
+            pContext->InFrames[i] = (process_buffer_t)pIn[i] * REVERB_SEND_LEVEL;
         }
     }
 
     if (pContext->preset && pContext->curPreset == REVERB_PRESET_NONE) {
         memset(pContext->OutFrames, 0,
-                frameCount * sizeof(*pContext->OutFrames) * FCC_2); //always stereo here
+                frameCount * sizeof(*pContext->OutFrames) * outChannels);
     } else {
         if(pContext->bEnabled == LVM_FALSE && pContext->SamplesToExitCount > 0) {
             memset(pContext->InFrames, 0,
                     frameCount * sizeof(*pContext->OutFrames) * channels);
+            pReverbIn = pContext->InFrames;
             ALOGV("\tZeroing %d samples per frame at the end of call", channels);
         }
 
-        /* Process the samples, producing a stereo output */
+        /* Process the samples, producing a stereo or multichannel output */
         LvmStatus = LVREV_Process(pContext->hInstance,      /* Instance handle */
-                                  pContext->InFrames,     /* Input buffer */
+                                  pReverbIn,              /* Input buffer */
                                   pContext->OutFrames,    /* Output buffer */
                                   frameCount);              /* Number of samples to read */
     }
@@ -412,7 +427,7 @@ int process( effect_buffer_t   *pIn,
     if (pContext->auxiliary) {
         // nothing to do here
     } else {
-        for (int i = 0; i < frameCount * FCC_2; i++) { // always stereo here
+        for (int i = 0; i < frameCount * outChannels; i++) {
             // Mix with dry input
             pContext->OutFrames[i] += pIn[i];
         }
@@ -428,8 +443,8 @@ int process( effect_buffer_t   *pIn,
             float incr = (((float)pContext->rightVolume / 4096) - vr) / frameCount;
 
             for (int i = 0; i < frameCount; i++) {
-                pContext->OutFrames[FCC_2 * i] *= vl;
-                pContext->OutFrames[FCC_2 * i + 1] *= vr;
+                Reverb_applyVolume(pContext, &pContext->OutFrames[outChannels * i],
+                                   outChannels, vl, vr);
 
                 vl += incl;
                 vr += incr;
@@ -439,9 +454,11 @@ int process( effect_buffer_t   *pIn,
         } else if (pContext->volumeMode != REVERB_VOLUME_OFF) {
             if (pContext->leftVolume != REVERB_UNIT_VOLUME ||
                 pContext->rightVolume != REVERB_UNIT_VOLUME) {
+                const float vl = (float)pContext->leftVolume / 4096;
+                const float vr = (float)pContext->rightVolume / 4096;
                 for (int i = 0; i < frameCount; i++) {
-                    pContext->OutFrames[FCC_2 * i] *= ((float)pContext->leftVolume / 4096);
-                    pContext->OutFrames[FCC_2 * i + 1] *= ((float)pContext->rightVolume / 4096);
+                    Reverb_applyVolume(pContext, &pContext->OutFrames[outChannels * i],
+                                       outChannels, vl, vr);
                 }
             }
             pContext->prevLeftVolume = pContext->leftVolume;
@@ -454,12 +471,12 @@ int process( effect_buffer_t   *pIn,
     // Accumulate if required
     if (pContext->config.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE){
         //ALOGV("\tBuffer access is ACCUMULATE");
-        for (int i = 0; i < frameCount * FCC_2; i++) { // always stereo here
+        for (int i = 0; i < frameCount * outChannels; i++) {
             pOut[i] += pContext->OutFrames[i];
         }
     }else{
         //ALOGV("\tBuffer access is WRITE");
-        memcpy(pOut, pContext->OutFrames, frameCount * sizeof(*pOut) * FCC_2);
+        memcpy(pOut, pContext->OutFrames, frameCount * sizeof(*pOut) * outChannels);
     }
 
     return 0;
@@ -502,6 +519,111 @@ void Reverb_free(ReverbContext *pContext){
     }
 }    /* end Reverb_free */
 
+//----------------------------------------------------------------------------
+// Reverb_applyVolume()
+//----------------------------------------------------------------------------
+// Purpose: Apply the left and right volumes to one output frame. The left
+// volume applies to the channels fed by the left reverb output, the right
+// volume to those fed by the right one, and their average to the others.
+//
+// Inputs:
+//  pContext:   effect engine context
+//  pFrame:     output frame
+//  channels:   number of channels in the frame
+//  vl:         left volume
+//  vr:         right volume
+//
+//----------------------------------------------------------------------------
+
+void Reverb_applyVolume(const ReverbContext *pContext, process_buffer_t *pFrame,
+                        int channels, float vl, float vr) {
+#ifdef SUPPORT_MC
+    for (int c = 0; c < channels; c++) {
+        switch (pContext->channelRoutes[c]) {
+        case LVREV_CHANNEL_LEFT:
+            pFrame[c] *= vl;
+            break;
+        case LVREV_CHANNEL_RIGHT:
+            pFrame[c] *= vr;
+            break;
+        default:
+            pFrame[c] *= (vl + vr) * 0.5f;
+            break;
+        }
+    }
+#else
+    (void)pContext;
+    (void)channels;
+    pFrame[0] *= vl;
+    pFrame[1] *= vr;
+#endif
+}   /* end Reverb_applyVolume */
+
+#ifdef SUPPORT_MC
+//----------------------------------------------------------------------------
+// Reverb_getChannelRoutes()
+//----------------------------------------------------------------------------
+// Purpose: Get the reverb output feeding each channel of an output mask:
+// the left reverb output for the channels on the left side, the right one
+// for the channels on the right side, their average for the center channels
+// and none for the LFE channel. Index masks carry no position, their
+// channels alternate between left and right.
+//
+// Inputs:
+//  channelMask:    output channel mask
+//
+// Outputs:
+//  pRoutes:        route of each output channel
+//
+//----------------------------------------------------------------------------
+
+void Reverb_getChannelRoutes(audio_channel_mask_t channelMask, LVREV_ChannelRoute_en *pRoutes) {
+    const int channels = audio_channel_count_from_out_mask(channelMask);
+    for (int c = channels; c < LVM_MAX_CHANNELS; c++) {
+        pRoutes[c] = LVREV_CHANNEL_NONE;
+    }
+    if (audio_channel_mask_get_representation(channelMask) !=
+            AUDIO_CHANNEL_REPRESENTATION_POSITION) {
+        for (int c = 0; c < channels; c++) {
+            pRoutes[c] = (c & 1) ? LVREV_CHANNEL_RIGHT : LVREV_CHANNEL_LEFT;
+        }
+        return;
+    }
+
+    // interleaved channels are in the order of the mask bits
+    int c = 0;
+    for (uint32_t bits = audio_channel_mask_get_bits(channelMask); bits != 0;
+            bits &= bits - 1) {
+        switch (bits & -bits) {
+        case AUDIO_CHANNEL_OUT_FRONT_LEFT:
+        case AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER:
+        case AUDIO_CHANNEL_OUT_BACK_LEFT:
+        case AUDIO_CHANNEL_OUT_SIDE_LEFT:
+        case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
+        case AUDIO_CHANNEL_OUT_TOP_BACK_LEFT:
+        case AUDIO_CHANNEL_OUT_TOP_SIDE_LEFT:
+            pRoutes[c++] = LVREV_CHANNEL_LEFT;
+            break;
+        case AUDIO_CHANNEL_OUT_FRONT_RIGHT:
+        case AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER:
+        case AUDIO_CHANNEL_OUT_BACK_RIGHT:
+        case AUDIO_CHANNEL_OUT_SIDE_RIGHT:
+        case AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT:
+        case AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT:
+        case AUDIO_CHANNEL_OUT_TOP_SIDE_RIGHT:
+            pRoutes[c++] = LVREV_CHANNEL_RIGHT;
+            break;
+        case AUDIO_CHANNEL_OUT_LOW_FREQUENCY:
+            pRoutes[c++] = LVREV_CHANNEL_NONE;
+            break;
+        default: // FRONT_CENTER, BACK_CENTER, TOP_CENTER, TOP_FRONT_CENTER, TOP_BACK_CENTER
+            pRoutes[c++] = LVREV_CHANNEL_CENTER;
+            break;
+        }
+    }
+}   /* end Reverb_getChannelRoutes */
+#endif
+
 //----------------------------------------------------------------------------
 // Reverb_setConfig()
 //----------------------------------------------------------------------------
@@ -525,9 +647,17 @@ int Reverb_setConfig(ReverbContext *pContext, effect_config_t *pConfig){
 
     CHECK_ARG(pConfig->inputCfg.samplingRate == pConfig->outputCfg.samplingRate);
     CHECK_ARG(pConfig->inputCfg.format == pConfig->outputCfg.format);
+#ifdef SUPPORT_MC
+    const LVM_INT32 outChannels = audio_channel_count_from_out_mask(pConfig->outputCfg.channels);
+    CHECK_ARG(outChannels >= FCC_2 && outChannels <= LVM_MAX_CHANNELS);
+    CHECK_ARG((pContext->auxiliary && pConfig->inputCfg.channels == AUDIO_CHANNEL_OUT_MONO) ||
+              ((!pContext->auxiliary) &&
+               pConfig->inputCfg.channels == pConfig->outputCfg.channels));
+#else
     CHECK_ARG((pContext->auxiliary && pConfig->inputCfg.channels == AUDIO_CHANNEL_OUT_MONO) ||
               ((!pContext->auxiliary) && pConfig->inputCfg.channels == AUDIO_CHANNEL_OUT_STEREO));
     CHECK_ARG(pConfig->outputCfg.channels == AUDIO_CHANNEL_OUT_STEREO);
+#endif
     CHECK_ARG(pConfig->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_WRITE
               || pConfig->outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE);
     CHECK_ARG(pConfig->inputCfg.format == EFFECT_BUFFER_FORMAT);
@@ -570,21 +700,42 @@ int Reverb_setConfig(ReverbContext *pContext, effect_config_t *pConfig){
         return -EINVAL;
     }
 
-    if (pContext->SampleRate != SampleRate) {
+    LVREV_ControlParams_st    ActiveParams;
+    LVREV_ReturnStatus_en     LvmStatus = LVREV_SUCCESS;
 
-        LVREV_ControlParams_st    ActiveParams;
-        LVREV_ReturnStatus_en     LvmStatus = LVREV_SUCCESS;
+    /* Get the current settings */
+    LvmStatus = LVREV_GetControlParameters(pContext->hInstance,
+                                     &ActiveParams);
 
-        //ALOGV("\tReverb_setConfig change sampling rate to %d", SampleRate);
+    LVM_ERROR_CHECK(LvmStatus, "LVREV_GetControlParameters", "Reverb_setConfig")
+    if(LvmStatus != LVREV_SUCCESS) return -EINVAL;
 
-        /* Get the current settings */
-        LvmStatus = LVREV_GetControlParameters(pContext->hInstance,
-                                         &ActiveParams);
+    bool channelsChanged = false;
+#ifdef SUPPORT_MC
+    // The engine mixes the input down and spreads its output over the output channels itself,
+    // by channel position
+    LVM_Format_en SourceFormat = LVM_MONO;
+    if (!pContext->auxiliary) {
+        SourceFormat = outChannels == FCC_2 ? LVM_STEREO : LVM_MULTICHANNEL;
+    }
+    Reverb_getChannelRoutes(pConfig->outputCfg.channels, pContext->channelRoutes);
+    channelsChanged = ActiveParams.SourceFormat != SourceFormat ||
+            ActiveParams.NrChannels != outChannels ||
+            memcmp(ActiveParams.ChannelRoutes, pContext->channelRoutes,
+                   outChannels * sizeof(pContext->channelRoutes[0])) != 0;
+#endif
 
-        LVM_ERROR_CHECK(LvmStatus, "LVREV_GetControlParameters", "Reverb_setConfig")
-        if(LvmStatus != LVREV_SUCCESS) return -EINVAL;
+    if (pContext->SampleRate != SampleRate || channelsChanged) {
+
+        //ALOGV("\tReverb_setConfig change sampling rate to %d", SampleRate);
 
         ActiveParams.SampleRate = SampleRate;
+#ifdef SUPPORT_MC
+        ActiveParams.SourceFormat = SourceFormat;
+        ActiveParams.NrChannels = outChannels;
+        memcpy(ActiveParams.ChannelRoutes, pContext->channelRoutes,
+               sizeof(ActiveParams.ChannelRoutes));
+#endif
 
         LvmStatus = LVREV_SetControlParameters(pContext->hInstance, &ActiveParams);
 
@@ -748,6 +899,11 @@ int Reverb_init(ReverbContext *pContext){
     } else {
         params.SourceFormat   = LVM_STEREO;
     }
+#ifdef SUPPORT_MC
+    params.NrChannels     = FCC_2;
+    Reverb_getChannelRoutes(AUDIO_CHANNEL_OUT_STEREO, pContext->channelRoutes);
+    memcpy(params.ChannelRoutes, pContext->channelRoutes, sizeof(params.ChannelRoutes));
+#endif
 
     /* Reverb parameters */
     params.Level          = 0;
@@ -16,10 +16,12 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 #define LOG_TAG "PreProcessing"
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 #include <utils/Timers.h>
+#include <audio_utils/primitives.h>
 #include <hardware/audio_effect.h>
 #include <audio_effects/effect_aec.h>
 #include <audio_effects/effect_agc.h>
@@ -90,12 +92,19 @@ struct preproc_effect_s {
     const preproc_ops_t *ops;       // effect ops table
     preproc_fx_handle_t engine;     // handle on webRTC engine
     uint32_t type;                  // subtype of effect
+    audio_format_t format;          // sample format at effect process interface
 #ifdef DUAL_MIC_TEST
     bool aux_channels_on;           // support auxiliary channels
     size_t cur_channel_config;      // current auciliary channel configuration
 #endif
 };
 
+// Deinterleaved float audio exchanged with the webRTC APM float interface
+struct preproc_float_buffer_s {
+    std::vector<float> samples;         // one plane of frameCount samples per channel
+    std::vector<float *> planes;        // start of each channel plane in samples
+};
+
 // Session context
 struct preproc_session_s {
     struct preproc_effect_s effects[PREPROC_NUM_EFFECTS]; // effects in this session
@@ -104,7 +113,10 @@ struct preproc_session_s {
     int io;                             // handle of input stream this session is on
     webrtc::AudioProcessing* apm;       // handle on webRTC audio processing module (APM)
     size_t apmFrameCount;               // buffer size for webRTC process (10 ms)
-    uint32_t apmSamplingRate;           // webRTC APM sampling rate (8/16 or 32 kHz)
+    uint32_t apmSamplingRate;           // webRTC APM stream sampling rate (8/16 or 32 kHz, or
+                                        // session sampling rate on the float path)
+    bool floatApi;                      // use the float APM interface at the session sampling
+                                        // rate instead of 16 bit frames and speex resamplers
     size_t frameCount;                  // buffer size before input resampler ( <=> apmFrameCount)
     uint32_t samplingRate;              // sampling rate at effect process interface
     uint32_t inChannelCount;            // input channel count
@@ -132,6 +144,9 @@ struct preproc_session_s {
     size_t revBufSize;                  // reverse channel input buffer size
     size_t framesRev;                   // number of frames in reverse channel input buffer
     SpeexResamplerState *revResampler;  // handle on reverse channel input speex resampler
+    struct preproc_float_buffer_s floatIn;  // float path input, one 10 ms chunk
+    struct preproc_float_buffer_s floatOut; // float path output, one 10 ms chunk
+    struct preproc_float_buffer_s floatRev; // float path reverse channel input, one 10 ms chunk
 };
 
 #ifdef DUAL_MIC_TEST
@@ -784,6 +799,7 @@ int Effect_Create(preproc_effect_t *effect,
                effect_handle_t  *interface)
 {
     effect->session = session;
+    effect->format = AUDIO_FORMAT_PCM_16_BIT;
     *interface = (effect_handle_t)&effect->itfe;
     return Effect_SetState(effect, PREPROC_EFFECT_STATE_CREATED);
 }
@@ -803,6 +819,115 @@ int Effect_Release(preproc_effect_t *effect)
 static const int kPreprocDefaultSr = 16000;
 static const int kPreProcDefaultCnl = 1;
 
+// The float APM interface takes 10 ms chunks at any sampling rate with a whole number of
+// frames in 10 ms and resamples to its processing rate internally with a sinc resampler.
+// AEC implementation is limited to 16kHz: sessions with an echo canceler at other rates stay on
+// the 16 bit path, which resamples to 8 or 16 kHz.
+static bool Session_CanUseFloatApi(preproc_session_t *session, uint32_t samplingRate)
+{
+    if (session->createdMsk & (1 << PREPROC_AEC)) {
+        return samplingRate == 8000 || samplingRate == 16000;
+    }
+    return samplingRate % 100 == 0;
+}
+
+static void FloatBuffer_Resize(struct preproc_float_buffer_s *buffer,
+                               uint32_t channelCount,
+                               size_t frameCount)
+{
+    buffer->samples.assign(channelCount * frameCount, 0.0f);
+    buffer->planes.resize(channelCount);
+    for (uint32_t ch = 0; ch < channelCount; ch++) {
+        buffer->planes[ch] = buffer->samples.data() + ch * frameCount;
+    }
+}
+
+static void FloatBuffer_Release(struct preproc_float_buffer_s *buffer)
+{
+    std::vector<float>().swap(buffer->samples);
+    std::vector<float *>().swap(buffer->planes);
+}
+
+// Deinterleaves frameCount frames of src into buffer planes starting at frame offset
+static void FloatBuffer_Read(struct preproc_float_buffer_s *buffer,
+                             size_t offset,
+                             const audio_buffer_t *src,
+                             audio_format_t format,
+                             uint32_t channelCount,
+                             size_t frameCount)
+{
+    if (format == AUDIO_FORMAT_PCM_FLOAT) {
+        const float *in = src->f32;
+        for (size_t i = 0; i < frameCount; i++) {
+            for (uint32_t ch = 0; ch < channelCount; ch++) {
+                buffer->planes[ch][offset + i] = *in++;
+            }
+        }
+    } else {
+        const int16_t *in = src->s16;
+        for (size_t i = 0; i < frameCount; i++) {
+            for (uint32_t ch = 0; ch < channelCount; ch++) {
+                buffer->planes[ch][offset + i] = float_from_i16(*in++);
+            }
+        }
+    }
+}
+
+// Interleaves frameCount frames of buffer planes starting at frame offset into dst
+// starting at frame dstOffset
+static void FloatBuffer_Write(const struct preproc_float_buffer_s *buffer,
+                              size_t offset,
+                              audio_buffer_t *dst,
+                              size_t dstOffset,
+                              audio_format_t format,
+                              uint32_t channelCount,
+                              size_t frameCount)
+{
+    if (format == AUDIO_FORMAT_PCM_FLOAT) {
+        float *out = dst->f32 + dstOffset * channelCount;
+        for (size_t i = 0; i < frameCount; i++) {
+            for (uint32_t ch = 0; ch < channelCount; ch++) {
+                *out++ = buffer->planes[ch][offset + i];
+            }
+        }
+    } else {
+        int16_t *out = dst->s16 + dstOffset * channelCount;
+        for (size_t i = 0; i < frameCount; i++) {
+            for (uint32_t ch = 0; ch < channelCount; ch++) {
+                *out++ = clamp16_from_float(buffer->planes[ch][offset + i]);
+            }
+        }
+    }
+}
+
+// Copies sampleCount samples of src, in the effect format, to 16 bit dst
+static void Buffer_Read16(int16_t *dst,
+                          const audio_buffer_t *src,
+                          audio_format_t format,
+                          size_t sampleCount)
+{
+    if (format == AUDIO_FORMAT_PCM_FLOAT) {
+        memcpy_to_i16_from_float(dst, src->f32, sampleCount);
+    } else {
+        memcpy(dst, src->s16, sampleCount * sizeof(int16_t));
+    }
+}
+
+// Copies sampleCount 16 bit samples of src to dst, in the effect format, starting at sample
+// dstOffset
+static void Buffer_Write16(audio_buffer_t *dst,
+                           size_t dstOffset,
+                           const int16_t *src,
+                           audio_format_t format,
+                           size_t sampleCount)
+{
+    if (format == AUDIO_FORMAT_PCM_FLOAT) {
+        memcpy_to_float_from_i16(dst->f32 + dstOffset, src, sampleCount);
+    } else {
+        memcpy(dst->s16 + dstOffset, src, sampleCount * sizeof(int16_t));
+    }
+}
+
 int Session_Init(preproc_session_t *session)
 {
     size_t i;
@@ -851,6 +976,7 @@ extern "C" int Session_CreateEffect(preproc_session_t *session,
             goto error;
         }
         session->apmSamplingRate = kPreprocDefaultSr;
+        session->floatApi = false;
         session->apmFrameCount = (kPreprocDefaultSr) / 100;
         session->frameCount = session->apmFrameCount;
         session->samplingRate = kPreprocDefaultSr;
@@ -919,12 +1045,15 @@ int Session_ReleaseEffect(preproc_session_t *session,
             speex_resampler_destroy(session->revResampler);
             session->revResampler = NULL;
         }
-        delete session->inBuf;
+        free(session->inBuf);
         session->inBuf = NULL;
-        delete session->outBuf;
+        free(session->outBuf);
         session->outBuf = NULL;
-        delete session->revBuf;
+        free(session->revBuf);
         session->revBuf = NULL;
+        FloatBuffer_Release(&session->floatIn);
+        FloatBuffer_Release(&session->floatOut);
+        FloatBuffer_Release(&session->floatRev);
 
         session->id = 0;
     }
@@ -938,18 +1067,26 @@ int Session_SetConfig(preproc_session_t *session, effect_config_t *config)
     uint32_t inCnl = audio_channel_count_from_in_mask(config->inputCfg.channels);
     uint32_t outCnl = audio_channel_count_from_in_mask(config->outputCfg.channels);
 
+    bool floatApi = Session_CanUseFloatApi(session, config->inputCfg.samplingRate);
+
     if (config->inputCfg.samplingRate != config->outputCfg.samplingRate ||
         config->inputCfg.format != config->outputCfg.format ||
-        config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+        (config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+         (config->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT || !floatApi))) {
         return -EINVAL;
     }
 
-    ALOGV("Session_SetConfig sr %d cnl %08x",
-         config->inputCfg.samplingRate, config->inputCfg.channels);
+    ALOGV("Session_SetConfig sr %d cnl %08x format %#x",
+         config->inputCfg.samplingRate, config->inputCfg.channels, config->inputCfg.format);
     int status;
 
+    // On the float path, streams are exchanged at the session rate and the APM picks its
+    // processing rate internally.
     // AEC implementation is limited to 16kHz
-    if (config->inputCfg.samplingRate >= 32000 && !(session->createdMsk & (1 << PREPROC_AEC))) {
+    if (floatApi) {
+        session->apmSamplingRate = config->inputCfg.samplingRate;
+    } else if (config->inputCfg.samplingRate >= 32000 &&
+            !(session->createdMsk & (1 << PREPROC_AEC))) {
         session->apmSamplingRate = 32000;
     } else
     if (config->inputCfg.samplingRate >= 16000) {
@@ -976,6 +1113,7 @@ int Session_SetConfig(preproc_session_t *session, effect_config_t *config)
         session->frameCount = (session->apmFrameCount * session->samplingRate) /
                 session->apmSamplingRate  + 1;
     }
+    session->floatApi = floatApi;
     session->inChannelCount = inCnl;
     session->outChannelCount = outCnl;
     session->procFrame->num_channels_ = inCnl;
@@ -990,7 +1128,17 @@ int Session_SetConfig(preproc_session_t *session, effect_config_t *config)
     session->outBufSize = 0;
     session->framesIn = 0;
     session->framesOut = 0;
+    session->framesRev = 0;
 
+    if (floatApi) {
+        FloatBuffer_Resize(&session->floatIn, inCnl, session->frameCount);
+        FloatBuffer_Resize(&session->floatOut, outCnl, session->frameCount);
+        FloatBuffer_Resize(&session->floatRev, inCnl, session->frameCount);
+    } else {
+        FloatBuffer_Release(&session->floatIn);
+        FloatBuffer_Release(&session->floatOut);
+        FloatBuffer_Release(&session->floatRev);
+    }
 
     if (session->inResampler != NULL) {
         speex_resampler_destroy(session->inResampler);
@@ -1048,11 +1196,11 @@ int Session_SetConfig(preproc_session_t *session, effect_config_t *config)
     return 0;
 }
 
-void Session_GetConfig(preproc_session_t *session, effect_config_t *config)
+void Session_GetConfig(preproc_session_t *session, audio_format_t format, effect_config_t *config)
 {
     memset(config, 0, sizeof(effect_config_t));
     config->inputCfg.samplingRate = config->outputCfg.samplingRate = session->samplingRate;
-    config->inputCfg.format = config->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config->inputCfg.format = config->outputCfg.format = format;
     config->inputCfg.channels = audio_channel_in_mask_from_count(session->inChannelCount);
     // "out" doesn't mean output device, so this is the correct API to convert channel count to mask
     config->outputCfg.channels = audio_channel_in_mask_from_count(session->outChannelCount);
@@ -1060,11 +1208,14 @@ void Session_GetConfig(preproc_session_t *session, effect_config_t *config)
             (EFFECT_CONFIG_SMP_RATE | EFFECT_CONFIG_CHANNELS | EFFECT_CONFIG_FORMAT);
 }
 
-int Session_SetReverseConfig(preproc_session_t *session, effect_config_t *config)
+int Session_SetReverseConfig(preproc_session_t *session,
+                             audio_format_t format,
+                             effect_config_t *config)
 {
     if (config->inputCfg.samplingRate != config->outputCfg.samplingRate ||
             config->inputCfg.format != config->outputCfg.format ||
-            config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+            (config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+             config->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT)) {
         return -EINVAL;
     }
 
@@ -1075,7 +1226,7 @@ int Session_SetReverseConfig(preproc_session_t *session, effect_config_t *config
         return -ENOSYS;
     }
     if (config->inputCfg.samplingRate != session->samplingRate ||
-            config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) {
+            config->inputCfg.format != format) {
         return -EINVAL;
     }
     uint32_t inCnl = audio_channel_count_from_out_mask(config->inputCfg.channels);
@@ -1094,15 +1245,20 @@ int Session_SetReverseConfig(preproc_session_t *session, effect_config_t *config
     // force process buffer reallocation
     session->revBufSize = 0;
     session->framesRev = 0;
+    if (session->floatApi) {
+        FloatBuffer_Resize(&session->floatRev, inCnl, session->frameCount);
+    }
 
     return 0;
 }
 
-void Session_GetReverseConfig(preproc_session_t *session, effect_config_t *config)
+void Session_GetReverseConfig(preproc_session_t *session,
+                              audio_format_t format,
+                              effect_config_t *config)
 {
     memset(config, 0, sizeof(effect_config_t));
     config->inputCfg.samplingRate = config->outputCfg.samplingRate = session->samplingRate;
-    config->inputCfg.format = config->outputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config->inputCfg.format = config->outputCfg.format = format;
     config->inputCfg.channels = config->outputCfg.channels =
             audio_channel_in_mask_from_count(session->revChannelCount);
     config->inputCfg.mask = config->outputCfg.mask =
@@ -1144,6 +1300,132 @@ void Session_SetProcEnabled(preproc_session_t *session, uint32_t procId, bool en
     }
 }
 
+// Float path of PreProcessingFx_Process(): input is deinterleaved into one 10 ms chunk which is
+// processed by the APM at the session sampling rate and interleaved straight into the output.
+int Session_ProcessFloat(preproc_session_t *session,
+                         audio_format_t format,
+                         audio_buffer_t *inBuffer,
+                         audio_buffer_t *outBuffer)
+{
+    size_t framesRq = outBuffer->frameCount;
+    size_t framesWr = 0;
+    if (session->framesOut) {
+        size_t fr = session->framesOut;
+        if (framesRq < fr) {
+            fr = framesRq;
+        }
+        FloatBuffer_Write(&session->floatOut,
+                          session->frameCount - session->framesOut,
+                          outBuffer,
+                          0,
+                          format,
+                          session->outChannelCount,
+                          fr);
+        session->framesOut -= fr;
+        framesWr += fr;
+    }
+    outBuffer->frameCount = framesWr;
+    if (framesWr == framesRq) {
+        inBuffer->frameCount = 0;
+        return 0;
+    }
+
+    size_t fr = session->frameCount - session->framesIn;
+    if (inBuffer->frameCount < fr) {
+        fr = inBuffer->frameCount;
+    }
+    FloatBuffer_Read(&session->floatIn,
+                     session->framesIn,
+                     inBuffer,
+                     format,
+                     session->inChannelCount,
+                     fr);
+#ifdef DUAL_MIC_TEST
+    pthread_mutex_lock(&gPcmDumpLock);
+    if (gPcmDumpFh != NULL) {
+        fwrite(inBuffer->raw,
+               fr * session->inChannelCount * audio_bytes_per_sample(format), 1,
+               gPcmDumpFh);
+    }
+    pthread_mutex_unlock(&gPcmDumpLock);
+#endif
+    session->framesIn += fr;
+    inBuffer->frameCount = fr;
+    if (session->framesIn < session->frameCount) {
+        return 0;
+    }
+    session->framesIn = 0;
+
+    const webrtc::StreamConfig inConfig(static_cast<int>(session->samplingRate),
+                                        session->inChannelCount);
+    const webrtc::StreamConfig outConfig(static_cast<int>(session->samplingRate),
+                                         session->outChannelCount);
+    // the echo canceler fails a chunk for which the echo path delay was not set
+    if (session->enabledMsk & (1 << PREPROC_AEC)) {
+        session->apm->set_stream_delay_ms(session->apm->stream_delay_ms());
+    }
+    int status = session->apm->ProcessStream(session->floatIn.planes.data(),
+                                             inConfig,
+                                             outConfig,
+                                             session->floatOut.planes.data());
+    if (status != 0) {
+        ALOGV("Session_ProcessFloat ProcessStream error %d", status);
+        return -EINVAL;
+    }
+    session->framesOut = session->frameCount;
+
+    fr = session->framesOut;
+    if (framesRq - framesWr < fr) {
+        fr = framesRq - framesWr;
+    }
+    FloatBuffer_Write(&session->floatOut,
+                      0,
+                      outBuffer,
+                      framesWr,
+                      format,
+                      session->outChannelCount,
+                      fr);
+    session->framesOut -= fr;
+    outBuffer->frameCount += fr;
+
+    return 0;
+}
+
+// Float path of PreProcessingFx_ProcessReverse()
+int Session_ProcessReverseFloat(preproc_session_t *session,
+                                audio_format_t format,
+                                audio_buffer_t *inBuffer)
+{
+    size_t fr = session->frameCount - session->framesRev;
+    if (inBuffer->frameCount < fr) {
+        fr = inBuffer->frameCount;
+    }
+    FloatBuffer_Read(&session->floatRev,
+                     session->framesRev,
+                     inBuffer,
+                     format,
+                     session->revChannelCount,
+                     fr);
+    session->framesRev += fr;
+    inBuffer->frameCount = fr;
+    if (session->framesRev < session->frameCount) {
+        return 0;
+    }
+    session->framesRev = 0;
+
+    const webrtc::StreamConfig revConfig(static_cast<int>(session->samplingRate),
+                                         session->revChannelCount);
+    int status = session->apm->ProcessReverseStream(session->floatRev.planes.data(),
+                                                    revConfig,
+                                                    revConfig,
+                                                    session->floatRev.planes.data());
+    if (status != 0) {
+        ALOGV("Session_ProcessReverseFloat ProcessReverseStream error %d", status);
+        return -EINVAL;
+    }
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 // Bundle functions
 //------------------------------------------------------------------------------
@@ -1230,6 +1512,9 @@ int PreProcessingFx_Process(effect_handle_t     self,
 
     if ((session->processedMsk & session->enabledMsk) == session->enabledMsk) {
         effect->session->processedMsk = 0;
+        if (session->floatApi) {
+            return Session_ProcessFloat(session, effect->format, inBuffer, outBuffer);
+        }
         size_t framesRq = outBuffer->frameCount;
         size_t framesWr = 0;
         if (session->framesOut) {
@@ -1237,9 +1522,11 @@ int PreProcessingFx_Process(effect_handle_t     self,
             if (outBuffer->frameCount < fr) {
                 fr = outBuffer->frameCount;
             }
-            memcpy(outBuffer->s16,
-                  session->outBuf,
-                  fr * session->outChannelCount * sizeof(int16_t));
+            Buffer_Write16(outBuffer,
+                           0,
+                           session->outBuf,
+                           effect->format,
+                           fr * session->outChannelCount);
             memcpy(session->outBuf,
                   session->outBuf + fr * session->outChannelCount,
                   (session->framesOut - fr) * session->outChannelCount * sizeof(int16_t));
@@ -1270,14 +1557,16 @@ int PreProcessingFx_Process(effect_handle_t     self,
                 }
                 session->inBuf = buf;
             }
-            memcpy(session->inBuf + session->framesIn * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
+            Buffer_Read16(session->inBuf + session->framesIn * session->inChannelCount,
+                          inBuffer,
+                          effect->format,
+                          fr * session->inChannelCount);
 #ifdef DUAL_MIC_TEST
             pthread_mutex_lock(&gPcmDumpLock);
             if (gPcmDumpFh != NULL) {
                 fwrite(inBuffer->raw,
-                       fr * session->inChannelCount * sizeof(int16_t), 1, gPcmDumpFh);
+                       fr * session->inChannelCount * audio_bytes_per_sample(effect->format), 1,
+                       gPcmDumpFh);
             }
             pthread_mutex_unlock(&gPcmDumpLock);
 #endif
@@ -1312,15 +1601,17 @@ int PreProcessingFx_Process(effect_handle_t     self,
             if (inBuffer->frameCount < fr) {
                 fr = inBuffer->frameCount;
             }
-            memcpy(session->procFrame->data_ + session->framesIn * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
+            Buffer_Read16(session->procFrame->data_ + session->framesIn * session->inChannelCount,
+                          inBuffer,
+                          effect->format,
+                          fr * session->inChannelCount);
 
 #ifdef DUAL_MIC_TEST
             pthread_mutex_lock(&gPcmDumpLock);
             if (gPcmDumpFh != NULL) {
                 fwrite(inBuffer->raw,
-                       fr * session->inChannelCount * sizeof(int16_t), 1, gPcmDumpFh);
+                       fr * session->inChannelCount * audio_bytes_per_sample(effect->format), 1,
+                       gPcmDumpFh);
             }
             pthread_mutex_unlock(&gPcmDumpLock);
 #endif
@@ -1378,9 +1669,11 @@ int PreProcessingFx_Process(effect_handle_t     self,
         if (framesRq - framesWr < fr) {
             fr = framesRq - framesWr;
         }
-        memcpy(outBuffer->s16 + framesWr * session->outChannelCount,
-              session->outBuf,
-              fr * session->outChannelCount * sizeof(int16_t));
+        Buffer_Write16(outBuffer,
+                       framesWr * session->outChannelCount,
+                       session->outBuf,
+                       effect->format,
+                       fr * session->outChannelCount);
         memcpy(session->outBuf,
               session->outBuf + fr * session->outChannelCount,
               (session->framesOut - fr) * session->outChannelCount * sizeof(int16_t));
@@ -1445,6 +1738,10 @@ int PreProcessingFx_Command(effect_handle_t  self,
             if (*(int *)pReplyData != 0) {
                 break;
             }
+            // The session path may be 16 bit while this effect exchanges float buffers, e.g.
+            // when an echo canceler is configured after a noise suppressor at 48 kHz: samples
+            // are then converted at the effect process interface.
+            effect->format = ((effect_config_t *)pCmdData)->inputCfg.format;
             if (effect->state != PREPROC_EFFECT_STATE_ACTIVE) {
                 *(int *)pReplyData = Effect_SetState(effect, PREPROC_EFFECT_STATE_CONFIG);
             }
@@ -1458,7 +1755,7 @@ int PreProcessingFx_Command(effect_handle_t  self,
                 return -EINVAL;
             }
 
-            Session_GetConfig(effect->session, (effect_config_t *)pReplyData);
+            Session_GetConfig(effect->session, effect->format, (effect_config_t *)pReplyData);
             break;
 
         case EFFECT_CMD_SET_CONFIG_REVERSE:
@@ -1471,6 +1768,7 @@ int PreProcessingFx_Command(effect_handle_t  self,
                 return -EINVAL;
             }
             *(int *)pReplyData = Session_SetReverseConfig(effect->session,
+                                                          effect->format,
                                                           (effect_config_t *)pCmdData);
             if (*(int *)pReplyData != 0) {
                 break;
@@ -1484,7 +1782,7 @@ int PreProcessingFx_Command(effect_handle_t  self,
                         "EFFECT_CMD_GET_CONFIG_REVERSE: ERROR");
                 return -EINVAL;
             }
-            Session_GetReverseConfig(effect->session, (effect_config_t *)pCmdData);
+            Session_GetReverseConfig(effect->session, effect->format, (effect_config_t *)pCmdData);
             break;
 
         case EFFECT_CMD_RESET:
@@ -1794,6 +2092,9 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
 
     if ((session->revProcessedMsk & session->revEnabledMsk) == session->revEnabledMsk) {
         effect->session->revProcessedMsk = 0;
+        if (session->floatApi) {
+            return Session_ProcessReverseFloat(session, effect->format, inBuffer);
+        }
         if (session->revResampler != NULL) {
             size_t fr = session->frameCount - session->framesRev;
             if (inBuffer->frameCount < fr) {
@@ -1812,9 +2113,10 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
                 }
                 session->revBuf = buf;
             }
-            memcpy(session->revBuf + session->framesRev * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
+            Buffer_Read16(session->revBuf + session->framesRev * session->inChannelCount,
+                          inBuffer,
+                          effect->format,
+                          fr * session->inChannelCount);
 
             session->framesRev += fr;
             inBuffer->frameCount = fr;
@@ -1846,9 +2148,10 @@ int PreProcessingFx_ProcessReverse(effect_handle_t     self,
             if (inBuffer->frameCount < fr) {
                 fr = inBuffer->frameCount;
             }
-            memcpy(session->revFrame->data_ + session->framesRev * session->inChannelCount,
-                   inBuffer->s16,
-                   fr * session->inChannelCount * sizeof(int16_t));
+            Buffer_Read16(session->revFrame->data_ + session->framesRev * session->inChannelCount,
+                          inBuffer,
+                          effect->format,
+                          fr * session->inChannelCount);
             session->framesRev += fr;
             inBuffer->frameCount = fr;
             if (session->framesRev < session->frameCount) {
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <audio_utils/primitives.h>
+#include <benchmark/benchmark.h>
+#include <hardware/audio_effect.h>
+#include <system/audio.h>
+
+extern audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+static constexpr int32_t kSessionId = 1;
+static constexpr int32_t kIoId = 1;
+
+// Pre processors benchmarked, the echo canceler also analyzes a reverse stream.
+static const effect_uuid_t kPreProcUuids[] = {
+    // Acoustic Echo Canceler
+    {0xbb392ec0, 0x8d4d, 0x11e0, 0xa896, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}},
+    // Noise Suppression
+    {0xc06c8400, 0x8e06, 0x11e0, 0x9cb6, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}},
+};
+
+static int configure(effect_handle_t effect, uint32_t samplingRate, audio_format_t format) {
+    effect_config_t config{};
+    config.inputCfg.samplingRate = config.outputCfg.samplingRate = samplingRate;
+    config.inputCfg.channels = config.outputCfg.channels = AUDIO_CHANNEL_IN_MONO;
+    config.inputCfg.format = config.outputCfg.format = format;
+    config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+    int reply = 0;
+    uint32_t replySize = sizeof(reply);
+    if ((*effect)->command(effect, EFFECT_CMD_SET_CONFIG, sizeof(config), &config,
+            &replySize, &reply) != 0 || reply != 0) {
+        return -EINVAL;
+    }
+    if ((*effect)->command(effect, EFFECT_CMD_ENABLE, 0, nullptr, &replySize, &reply) != 0
+            || reply != 0) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+// Processes 20 ms of mono capture at state.range(0) Hz in the format state.range(1) through
+// the pre processor state.range(2): 0 for the echo canceler, 1 for the noise suppressor.
+static void BM_PreProcessing(benchmark::State &state) {
+    const uint32_t samplingRate = state.range(0);
+    const audio_format_t format = static_cast<audio_format_t>(state.range(1));
+    const effect_uuid_t *uuid = &kPreProcUuids[state.range(2)];
+    const size_t frameCount = samplingRate / 50;
+
+    effect_handle_t effect;
+    if (AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(uuid, kSessionId, kIoId, &effect) != 0) {
+        state.SkipWithError("create_effect failed");
+        return;
+    }
+    if (configure(effect, samplingRate, format) != 0) {
+        state.SkipWithError("cannot configure effect");
+        AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(effect);
+        return;
+    }
+
+    std::minstd_rand random(42);
+    std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+    std::vector<float> input(frameCount);
+    std::vector<float> reverse(frameCount);
+    for (size_t i = 0; i < frameCount; i++) {
+        input[i] = distribution(random);
+        reverse[i] = distribution(random);
+    }
+    std::vector<float> output(frameCount);
+    std::vector<int16_t> input16(frameCount);
+    std::vector<int16_t> reverse16(frameCount);
+    std::vector<int16_t> output16(frameCount);
+    memcpy_to_i16_from_float(input16.data(), input.data(), frameCount);
+    memcpy_to_i16_from_float(reverse16.data(), reverse.data(), frameCount);
+    const bool isFloat = format == AUDIO_FORMAT_PCM_FLOAT;
+
+    for (auto _ : state) {
+        audio_buffer_t inBuffer, outBuffer;
+        if ((*effect)->process_reverse != nullptr) {
+            outBuffer.frameCount = 0;
+            outBuffer.raw = nullptr;
+            // each call consumes at most 10 ms of input
+            for (size_t done = 0; done < frameCount; done += inBuffer.frameCount) {
+                inBuffer.frameCount = frameCount - done;
+                inBuffer.raw = isFloat ? (void *)(reverse.data() + done)
+                                       : (void *)(reverse16.data() + done);
+                if ((*effect)->process_reverse(effect, &inBuffer, &outBuffer) != 0) {
+                    state.SkipWithError("process_reverse failed");
+                    AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(effect);
+                    return;
+                }
+            }
+        }
+        for (size_t done = 0; done < frameCount; done += inBuffer.frameCount) {
+            inBuffer.frameCount = outBuffer.frameCount = frameCount - done;
+            inBuffer.raw = isFloat ? (void *)(input.data() + done)
+                                   : (void *)(input16.data() + done);
+            outBuffer.raw = isFloat ? (void *)(output.data() + done)
+                                    : (void *)(output16.data() + done);
+            if ((*effect)->process(effect, &inBuffer, &outBuffer) != 0) {
+                state.SkipWithError("process failed");
+                AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(effect);
+                return;
+            }
+        }
+        benchmark::DoNotOptimize(output.data());
+        benchmark::DoNotOptimize(output16.data());
+        benchmark::ClobberMemory();
+    }
+    AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(effect);
+
+    state.SetItemsProcessed(state.iterations() * frameCount);
+}
+
+static void PreProcessingArgs(benchmark::internal::Benchmark *b) {
+    for (int samplingRate : {16000, 32000, 48000}) {
+        for (int format : {AUDIO_FORMAT_PCM_16_BIT, AUDIO_FORMAT_PCM_FLOAT}) {
+            for (int preProc = 0; preProc < 2; preProc++) {
+                // the echo canceler takes float only at 8 or 16 kHz
+                if (preProc == 0 && format == AUDIO_FORMAT_PCM_FLOAT && samplingRate > 16000) {
+                    continue;
+                }
+                b->Args({samplingRate, format, preProc});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_PreProcessing)->Apply(PreProcessingArgs);
+
+BENCHMARK_MAIN();
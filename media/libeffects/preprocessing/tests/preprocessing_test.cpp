@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <audio_utils/primitives.h>
+#include <gtest/gtest.h>
+#include <hardware/audio_effect.h>
+#include <system/audio.h>
+
+extern audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+static constexpr int32_t kIoId = 1;
+
+// Acoustic Echo Canceler
+static constexpr effect_uuid_t kAecUuid =
+        {0xbb392ec0, 0x8d4d, 0x11e0, 0xa896, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}};
+// Noise Suppression
+static constexpr effect_uuid_t kNsUuid =
+        {0xc06c8400, 0x8e06, 0x11e0, 0x9cb6, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}};
+
+static int configure(effect_handle_t effect, uint32_t samplingRate, audio_format_t format) {
+    effect_config_t config{};
+    config.inputCfg.samplingRate = config.outputCfg.samplingRate = samplingRate;
+    config.inputCfg.channels = config.outputCfg.channels = AUDIO_CHANNEL_IN_MONO;
+    config.inputCfg.format = config.outputCfg.format = format;
+    config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+    int reply = 0;
+    uint32_t replySize = sizeof(reply);
+    int status = (*effect)->command(effect, EFFECT_CMD_SET_CONFIG, sizeof(config), &config,
+            &replySize, &reply);
+    return status != 0 ? status : reply;
+}
+
+static int enable(effect_handle_t effect) {
+    int reply = 0;
+    uint32_t replySize = sizeof(reply);
+    int status = (*effect)->command(effect, EFFECT_CMD_ENABLE, 0, nullptr, &replySize, &reply);
+    return status != 0 ? status : reply;
+}
+
+static float rms(const float *samples, size_t count) {
+    double sum = 0.;
+    for (size_t i = 0; i < count; i++) {
+        sum += samples[i] * samples[i];
+    }
+    return sqrt(sum / count);
+}
+
+class PreProcessingTest : public ::testing::Test {
+  protected:
+    void TearDown() override {
+        for (effect_handle_t effect : mEffects) {
+            EXPECT_EQ(0, AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(effect));
+        }
+    }
+
+    void create(const effect_uuid_t *uuid, int32_t sessionId) {
+        ASSERT_EQ(0, AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(uuid, sessionId, kIoId,
+                &mEffect));
+        mEffects.push_back(mEffect);
+    }
+
+    // Processes |input| and |reverse|, when not empty, in buffers of 20 ms of mono float.
+    void process(uint32_t samplingRate, const std::vector<float> &input,
+            const std::vector<float> &reverse, std::vector<float> *output) {
+        const size_t bufferFrames = samplingRate / 50;
+        output->resize(input.size());
+        for (size_t frame = 0; frame < input.size(); frame += bufferFrames) {
+            audio_buffer_t inBuffer, outBuffer;
+            // each call consumes at most 10 ms of input
+            for (size_t done = 0; !reverse.empty() && done < bufferFrames;
+                    done += inBuffer.frameCount) {
+                inBuffer.frameCount = bufferFrames - done;
+                inBuffer.f32 = const_cast<float *>(&reverse[frame + done]);
+                outBuffer.frameCount = 0;
+                outBuffer.f32 = nullptr;
+                ASSERT_EQ(0, (*mEffect)->process_reverse(mEffect, &inBuffer, &outBuffer));
+            }
+            for (size_t done = 0; done < bufferFrames; done += inBuffer.frameCount) {
+                inBuffer.frameCount = outBuffer.frameCount = bufferFrames - done;
+                inBuffer.f32 = const_cast<float *>(&input[frame + done]);
+                outBuffer.f32 = &(*output)[frame + done];
+                ASSERT_EQ(0, (*mEffect)->process(mEffect, &inBuffer, &outBuffer));
+            }
+        }
+    }
+
+    // last created effect
+    effect_handle_t mEffect = nullptr;
+    std::vector<effect_handle_t> mEffects;
+};
+
+// Stationary noise is attenuated at the session rate on the float path.
+TEST_F(PreProcessingTest, NoiseSuppressionFloat48kHz) {
+    const uint32_t samplingRate = 48000;
+    create(&kNsUuid, 1 /* sessionId */);
+    ASSERT_EQ(0, configure(mEffect, samplingRate, AUDIO_FORMAT_PCM_FLOAT));
+    ASSERT_EQ(0, enable(mEffect));
+
+    std::minstd_rand random(42);
+    std::normal_distribution<float> distribution(0.f, 0.05f);
+    std::vector<float> input(3 * samplingRate);
+    for (float &sample : input) {
+        sample = distribution(random);
+    }
+    std::vector<float> output;
+    process(samplingRate, input, {}, &output);
+
+    // compare the last second, once the noise estimate has settled
+    const size_t start = input.size() - samplingRate;
+    EXPECT_LT(rms(&output[start], samplingRate), 0.5f * rms(&input[start], samplingRate));
+}
+
+// An echo of the reverse stream is attenuated on the float path.
+TEST_F(PreProcessingTest, EchoCancellationFloat16kHz) {
+    const uint32_t samplingRate = 16000;
+    create(&kAecUuid, 2 /* sessionId */);
+    ASSERT_EQ(0, configure(mEffect, samplingRate, AUDIO_FORMAT_PCM_FLOAT));
+    ASSERT_EQ(0, enable(mEffect));
+
+    std::minstd_rand random(42);
+    std::uniform_real_distribution<float> distribution(-0.25f, 0.25f);
+    std::vector<float> reverse(5 * samplingRate);
+    std::vector<float> input(reverse.size());
+    for (size_t i = 0; i < reverse.size(); i++) {
+        reverse[i] = distribution(random);
+        input[i] = 0.5f * reverse[i];
+    }
+    std::vector<float> output;
+    process(samplingRate, input, reverse, &output);
+
+    const size_t start = input.size() - samplingRate;
+    EXPECT_LT(rms(&output[start], samplingRate), 0.5f * rms(&input[start], samplingRate));
+}
+
+// The echo canceler is limited to 16 kHz, so a 48 kHz session stays on the 16 bit path.
+TEST_F(PreProcessingTest, EchoCancellation48kHz) {
+    create(&kAecUuid, 3 /* sessionId */);
+    EXPECT_EQ(-EINVAL, configure(mEffect, 48000, AUDIO_FORMAT_PCM_FLOAT));
+    EXPECT_EQ(0, configure(mEffect, 48000, AUDIO_FORMAT_PCM_16_BIT));
+}
+
+// An echo canceler configured after a noise suppressor at 48 kHz moves the session to the 16 bit
+// path while the noise suppressor keeps exchanging float buffers: its output must match a session
+// where both effects exchange 16 bit buffers.
+TEST_F(PreProcessingTest, NoiseSuppressionFloatThenEchoCancellation48kHz) {
+    const uint32_t samplingRate = 48000;
+    create(&kNsUuid, 4 /* sessionId */);
+    const effect_handle_t ns16 = mEffect;
+    create(&kAecUuid, 4 /* sessionId */);
+    const effect_handle_t aec16 = mEffect;
+    ASSERT_EQ(0, configure(ns16, samplingRate, AUDIO_FORMAT_PCM_16_BIT));
+    ASSERT_EQ(0, configure(aec16, samplingRate, AUDIO_FORMAT_PCM_16_BIT));
+
+    create(&kNsUuid, 5 /* sessionId */);
+    const effect_handle_t nsFloat = mEffect;
+    ASSERT_EQ(0, configure(nsFloat, samplingRate, AUDIO_FORMAT_PCM_FLOAT));
+    create(&kAecUuid, 5 /* sessionId */);
+    const effect_handle_t aec = mEffect;
+    ASSERT_EQ(-EINVAL, configure(aec, samplingRate, AUDIO_FORMAT_PCM_FLOAT));
+    ASSERT_EQ(0, configure(aec, samplingRate, AUDIO_FORMAT_PCM_16_BIT));
+
+    effect_config_t config{};
+    uint32_t replySize = sizeof(config);
+    ASSERT_EQ(0, (*nsFloat)->command(nsFloat, EFFECT_CMD_GET_CONFIG, 0, nullptr,
+            &replySize, &config));
+    EXPECT_EQ(AUDIO_FORMAT_PCM_FLOAT, config.inputCfg.format);
+    EXPECT_EQ(AUDIO_FORMAT_PCM_FLOAT, config.outputCfg.format);
+
+    for (effect_handle_t effect : {ns16, aec16, nsFloat, aec}) {
+        ASSERT_EQ(0, enable(effect));
+    }
+
+    // input on the 16 bit grid, so that both sessions process the same samples
+    std::minstd_rand random(42);
+    std::normal_distribution<float> distribution(0.f, 0.05f);
+    std::vector<int16_t> input16(2 * samplingRate);
+    for (int16_t &sample : input16) {
+        sample = clamp16_from_float(distribution(random));
+    }
+    std::vector<float> input(input16.size());
+    memcpy_to_float_from_i16(input.data(), input16.data(), input16.size());
+
+    std::vector<int16_t> output16(input16.size());
+    std::vector<float> output(input.size());
+    // each call consumes at most 10 ms of input and the resamplers of the 16 bit path may hold
+    // back part of it: outputs are appended as produced
+    const size_t bufferFrames = samplingRate / 100;
+    size_t written = 0;
+    for (size_t done = 0; done < input.size() && written < output.size(); ) {
+        audio_buffer_t inBuffer, outBuffer;
+        // the echo canceler is processed first and leaves the round to the noise suppressor
+        inBuffer.frameCount = std::min(bufferFrames, input.size() - done);
+        outBuffer.frameCount = std::min(bufferFrames, output.size() - written);
+        inBuffer.s16 = &input16[done];
+        outBuffer.s16 = &output16[written];
+        ASSERT_EQ(-ENODATA, (*aec16)->process(aec16, &inBuffer, &outBuffer));
+        ASSERT_EQ(0, (*ns16)->process(ns16, &inBuffer, &outBuffer));
+        const size_t framesIn = inBuffer.frameCount;
+        const size_t framesOut = outBuffer.frameCount;
+
+        inBuffer.frameCount = std::min(bufferFrames, input.size() - done);
+        outBuffer.frameCount = std::min(bufferFrames, output.size() - written);
+        inBuffer.f32 = &input[done];
+        outBuffer.f32 = &output[written];
+        ASSERT_EQ(-ENODATA, (*aec)->process(aec, &inBuffer, &outBuffer));
+        ASSERT_EQ(0, (*nsFloat)->process(nsFloat, &inBuffer, &outBuffer));
+        ASSERT_EQ(framesIn, inBuffer.frameCount);
+        ASSERT_EQ(framesOut, outBuffer.frameCount);
+        done += framesIn;
+        written += framesOut;
+    }
+    ASSERT_GT(written, input.size() / 2);
+
+    for (size_t i = 0; i < written; i++) {
+        ASSERT_EQ(float_from_i16(output16[i]), output[i]) << "sample " << i;
+    }
+    EXPECT_GT(rms(output.data(), written), 0.f);
+}
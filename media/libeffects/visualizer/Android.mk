@@ -24,5 +24,5 @@ LOCAL_C_INCLUDES := \
 	$(call include-path-for, audio-utils)
 
 
-LOCAL_HEADER_LIBRARIES += libhardware_headers
+LOCAL_HEADER_LIBRARIES += libhardware_headers libeigen
 include $(BUILD_SHARED_LIBRARY)
@@ -25,9 +25,14 @@
 #include <time.h>
 
 #include <algorithm> // max
+#include <atomic>
+#include <complex>
+#include <mutex>
 #include <new>
+#include <vector>
 
 #include <log/log.h>
+#include <unsupported/Eigen/FFT>
 
 #include <audio_effects/effect_visualizer.h>
 #include <audio_utils/primitives.h>
@@ -36,12 +41,39 @@
 
 static constexpr audio_format_t kProcessFormat = AUDIO_FORMAT_PCM_FLOAT;
 
+// channel average of a frame, as played
+typedef float capture_sample_t;
+
 #else
 
 static constexpr audio_format_t kProcessFormat = AUDIO_FORMAT_PCM_16_BIT;
 
+// channel average of a frame, as played
+typedef int16_t capture_sample_t;
+
 #endif // BUILD_FLOAT
 
+// Native spectrum analysis, in addition to the parameters and commands of
+// <audio_effects/effect_visualizer.h>.
+enum visualizer_fft_params {
+    // FFT size in samples, a power of two within [VISUALIZER_FFT_SIZE_MIN, VISUALIZER_FFT_SIZE_MAX]
+    VISUALIZER_PARAM_FFT_SIZE = VISUALIZER_PARAM_MEASUREMENT_MODE + 1,
+    // number of magnitude bands per spectrum, a power of two no larger than half the FFT size.
+    // The FFT bins are decimated into bands of equal width, by RMS.
+    VISUALIZER_PARAM_FFT_BANDS,
+};
+
+enum visualizer_fft_cmds {
+    // Returns float magnitudes for consecutive FFT windows, oldest first, the last window ending
+    // where VISUALIZER_CMD_CAPTURE ends. A full scale sine reads 1.0 in its band.
+    // The reply size selects the number of spectra, up to VISUALIZER_FFT_BATCH_MAX.
+    VISUALIZER_CMD_MAGNITUDES = VISUALIZER_CMD_MEASURE + 1,
+};
+
+#define VISUALIZER_FFT_SIZE_MIN 128
+#define VISUALIZER_FFT_SIZE_MAX 4096
+#define VISUALIZER_FFT_BATCH_MAX 8
+
 extern "C" {
 
 // effect_handle_t interface implementation for visualizer effect
@@ -69,7 +101,7 @@ enum visualizer_state_e {
 // that the framework has stopped playing audio and we must start returning silence
 #define MAX_STALL_TIME_MS 1000
 
-#define CAPTURE_BUF_SIZE 65536 // "64k should be enough for everyone"
+#define CAPTURE_BUF_SIZE 65536u // "64k should be enough for everyone"
 
 #define DISCARD_MEASUREMENTS_TIME_MS 2000 // discard measurements older than this number of ms
 
@@ -85,17 +117,31 @@ struct BufferStats {
     float mRmsSquared; // the average square of the samples in a buffer
 };
 
+// The capture buffer is a single producer, single consumer ring: Visualizer_process() writes the
+// samples then publishes mCaptureIdx, and the command thread reads behind it without locking.
+// Scaling to 8 bit and spectrum analysis are done by the command thread.
 struct VisualizerContext {
     const struct effect_interface_s *mItfe;
+    // AudioFlinger sends the capture commands concurrently with the other commands, but
+    // never with release_effect(). Never taken by Visualizer_process().
+    std::mutex mCommandLock;
     effect_config_t mConfig;
-    uint32_t mCaptureIdx;
+    std::atomic<uint32_t> mCaptureIdx;
     uint32_t mCaptureSize;
     uint32_t mScalingMode;
     uint8_t mState;
     uint32_t mLastCaptureIdx;
     uint32_t mLatency;
-    struct timespec mBufferUpdateTime;
-    uint8_t mCaptureBuf[CAPTURE_BUF_SIZE];
+    std::atomic<int64_t> mBufferUpdateTimeNs; // CLOCK_MONOTONIC, 0 when idle
+    capture_sample_t mCaptureBuf[CAPTURE_BUF_SIZE];
+    capture_sample_t mCaptureScratch[VISUALIZER_FFT_SIZE_MAX];
+    // for spectrum analysis
+    uint32_t mFftSize;
+    uint32_t mFftBands;
+    Eigen::FFT<float> mFftServer;
+    std::vector<float> mFftWindow;
+    std::vector<float> mFftInput;
+    std::vector<std::complex<float>> mFftOutput;
     // for measurements
     uint8_t mChannelCount; // to avoid recomputing it every time a buffer is processed
     uint32_t mMeasurementMode;
@@ -107,18 +153,21 @@ struct VisualizerContext {
 //
 //--- Local functions
 //
+static int64_t Visualizer_getMonotonicTimeNs() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+        return 0;
+    }
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 uint32_t Visualizer_getDeltaTimeMsFromUpdatedTime(VisualizerContext* pContext) {
     uint32_t deltaMs = 0;
-    if (pContext->mBufferUpdateTime.tv_sec != 0) {
-        struct timespec ts;
-        if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
-            time_t secs = ts.tv_sec - pContext->mBufferUpdateTime.tv_sec;
-            long nsec = ts.tv_nsec - pContext->mBufferUpdateTime.tv_nsec;
-            if (nsec < 0) {
-                --secs;
-                nsec += 1000000000;
-            }
-            deltaMs = secs * 1000 + nsec / 1000000;
+    const int64_t updateTimeNs = pContext->mBufferUpdateTimeNs.load(std::memory_order_acquire);
+    if (updateTimeNs != 0) {
+        const int64_t nowNs = Visualizer_getMonotonicTimeNs();
+        if (nowNs != 0) {
+            deltaMs = (nowNs - updateTimeNs) / 1000000;
         }
     }
     return deltaMs;
@@ -127,11 +176,182 @@ uint32_t Visualizer_getDeltaTimeMsFromUpdatedTime(VisualizerContext* pContext) {
 
 void Visualizer_reset(VisualizerContext *pContext)
 {
-    pContext->mCaptureIdx = 0;
+    pContext->mCaptureIdx.store(0, std::memory_order_relaxed);
     pContext->mLastCaptureIdx = 0;
-    pContext->mBufferUpdateTime.tv_sec = 0;
+    pContext->mBufferUpdateTimeNs.store(0, std::memory_order_relaxed);
     pContext->mLatency = 0;
-    memset(pContext->mCaptureBuf, 0x80, CAPTURE_BUF_SIZE);
+    std::fill(pContext->mCaptureBuf, pContext->mCaptureBuf + CAPTURE_BUF_SIZE, 0);
+}
+
+// Sizes the spectrum analysis buffers and computes the Hann window for the current FFT size.
+void Visualizer_configureFft(VisualizerContext *pContext)
+{
+    const uint32_t fftSize = pContext->mFftSize;
+    pContext->mFftWindow.resize(fftSize);
+    pContext->mFftInput.resize(fftSize);
+    pContext->mFftOutput.resize(fftSize / 2 + 1);
+    for (uint32_t i = 0; i < fftSize; i++) {
+        pContext->mFftWindow[i] = 0.5f - 0.5f * cosf(2.f * (float)M_PI * i / fftSize);
+    }
+}
+
+static bool Visualizer_isValidFftSize(uint32_t fftSize) {
+    return fftSize >= VISUALIZER_FFT_SIZE_MIN && fftSize <= VISUALIZER_FFT_SIZE_MAX
+            && (fftSize & (fftSize - 1)) == 0;
+}
+
+static uint32_t Visualizer_getFftBands(const VisualizerContext *pContext) {
+    return std::min(pContext->mFftBands, pContext->mFftSize / 2);
+}
+
+//----------------------------------------------------------------------------
+// Visualizer_getCaptureIdx()
+//----------------------------------------------------------------------------
+// Purpose: Find where a capture ends in the capture buffer, detecting when the
+//  framework has stopped playing audio.
+//
+// Inputs:
+//  pContext:   effect engine context
+//
+// Outputs:
+//  pCaptureIdx:    write index of the capture buffer
+//  pLatencySmpl:   samples between the end of the capture and the write index
+//  returns false if the capture must return silence
+//
+//----------------------------------------------------------------------------
+
+static bool Visualizer_getCaptureIdx(VisualizerContext *pContext,
+        uint32_t *pCaptureIdx, uint32_t *pLatencySmpl)
+{
+    if (pContext->mState != VISUALIZER_STATE_ACTIVE) {
+        return false;
+    }
+    const int64_t updateTimeNs = pContext->mBufferUpdateTimeNs.load(std::memory_order_acquire);
+    const uint32_t captureIdx = pContext->mCaptureIdx.load(std::memory_order_acquire);
+    const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
+    const bool stalled = pContext->mLastCaptureIdx == captureIdx;
+    pContext->mLastCaptureIdx = captureIdx;
+
+    // if audio framework has stopped playing audio although the effect is still
+    // active we must clear the capture buffer to return silence
+    if (stalled && updateTimeNs != 0 && deltaMs > MAX_STALL_TIME_MS) {
+        ALOGV("capture going to idle");
+        // unless a buffer was processed in the meantime
+        int64_t expected = updateTimeNs;
+        pContext->mBufferUpdateTimeNs.compare_exchange_strong(expected, 0);
+        return false;
+    }
+
+    int32_t latencyMs = pContext->mLatency;
+    latencyMs -= deltaMs;
+    if (latencyMs < 0) {
+        latencyMs = 0;
+    }
+    *pCaptureIdx = captureIdx;
+    *pLatencySmpl = pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
+    return true;
+}
+
+// Copies the |count| samples starting |deltaSmpl| samples behind |captureIdx|.
+static void Visualizer_readCapture(const VisualizerContext *pContext, uint32_t captureIdx,
+        uint32_t deltaSmpl, uint32_t count, capture_sample_t *pDst)
+{
+    // large sample rate, latency, or capture size, could cause overflow.
+    // do not offset more than the size of buffer.
+    if (deltaSmpl > CAPTURE_BUF_SIZE) {
+        android_errorWriteLog(0x534e4554, "31781965");
+        deltaSmpl = CAPTURE_BUF_SIZE;
+    }
+    const uint32_t capturePoint = (captureIdx + CAPTURE_BUF_SIZE - deltaSmpl) % CAPTURE_BUF_SIZE;
+    // the end of the buffer comes first when the capture wraps.
+    const uint32_t size = std::min(count, CAPTURE_BUF_SIZE - capturePoint);
+    memcpy(pDst, pContext->mCaptureBuf + capturePoint, size * sizeof(capture_sample_t));
+    memcpy(pDst + size, pContext->mCaptureBuf, (count - size) * sizeof(capture_sample_t));
+}
+
+// Scales the channel averages to the unsigned 8 bit samples returned by VISUALIZER_CMD_CAPTURE.
+static void Visualizer_scaleCapture(const VisualizerContext *pContext,
+        const capture_sample_t *pSrc, uint8_t *pDst, uint32_t count)
+{
+#ifdef BUILD_FLOAT
+    float fscale = 1.f; // multiplicative scale
+    if (pContext->mScalingMode == VISUALIZER_SCALING_MODE_NORMALIZED) {
+        // derive capture scaling factor from peak value in the capture
+        // this gives more interesting captures for display.
+        float maxSample = 0.f;
+        for (uint32_t i = 0; i < count; i++) {
+            maxSample = fmax(maxSample, fabs(pSrc[i]));
+        }
+        if (maxSample > 0.f) {
+            fscale = 0.99f / maxSample;
+            int exp; // unused
+            const float significand = frexp(fscale, &exp);
+            if (significand == 0.5f) {
+                fscale *= 255.f / 256.f; // avoid returning unaltered PCM signal
+            }
+        }
+        // else scale doesn't matter, the values are all 0.
+    } else {
+        assert(pContext->mScalingMode == VISUALIZER_SCALING_MODE_AS_PLAYED);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        pDst[i] = clamp8_from_float(pSrc[i] * fscale);
+    }
+#else
+    int32_t shift;
+    if (pContext->mScalingMode == VISUALIZER_SCALING_MODE_NORMALIZED) {
+        int32_t orAccum = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            int32_t smp = pSrc[i];
+            if (smp < 0) smp = -smp - 1; // take care to keep the max negative in range
+            orAccum |= smp;
+        }
+
+        // A maximum amplitude signal will have 17 leading zeros, which we want to
+        // translate to a shift of 8 (for converting 16 bit to 8 bit)
+        shift = 25 - __builtin_clz(orAccum | 1);
+
+        // Never scale by less than 8 to avoid returning unaltered PCM signal.
+        if (shift < 3) {
+            shift = 3;
+        }
+    } else {
+        assert(pContext->mScalingMode == VISUALIZER_SCALING_MODE_AS_PLAYED);
+        shift = 8;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        pDst[i] = ((uint8_t)(pSrc[i] >> shift))^0x80;
+    }
+#endif // BUILD_FLOAT
+}
+
+// Computes the band magnitudes of the |fftSize| samples in mCaptureScratch.
+static void Visualizer_computeMagnitudes(VisualizerContext *pContext, float *pMagnitudes)
+{
+    const uint32_t fftSize = pContext->mFftSize;
+    float windowSum = 0.f;
+    for (uint32_t i = 0; i < fftSize; i++) {
+#ifdef BUILD_FLOAT
+        const float smp = pContext->mCaptureScratch[i];
+#else
+        const float smp = pContext->mCaptureScratch[i] * (1.f / (1 << 15));
+#endif
+        pContext->mFftInput[i] = smp * pContext->mFftWindow[i];
+        windowSum += pContext->mFftWindow[i];
+    }
+    pContext->mFftServer.fwd(pContext->mFftOutput, pContext->mFftInput);
+
+    // a sine centered on a bin has a magnitude of windowSum / 2 there.
+    const float binScale = 2.f / windowSum;
+    const uint32_t bands = Visualizer_getFftBands(pContext);
+    const uint32_t binsPerBand = fftSize / 2 / bands;
+    for (uint32_t band = 0, bin = 0; band < bands; band++) {
+        float power = 0.f;
+        for (uint32_t i = 0; i < binsPerBand; i++, bin++) {
+            power += std::norm(pContext->mFftOutput[bin]);
+        }
+        pMagnitudes[band] = sqrtf(power / binsPerBand) * binScale;
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -166,6 +386,7 @@ int Visualizer_setConfig(VisualizerContext *pContext, effect_config_t *pConfig)
     if (pConfig->inputCfg.format != kProcessFormat) return -EINVAL;
 
     pContext->mConfig = *pConfig;
+    pContext->mChannelCount = channelCount;
 
     Visualizer_reset(pContext);
 
@@ -228,6 +449,12 @@ int Visualizer_init(VisualizerContext *pContext)
     pContext->mCaptureSize = VISUALIZER_CAPTURE_SIZE_MAX;
     pContext->mScalingMode = VISUALIZER_SCALING_MODE_NORMALIZED;
 
+    // spectrum analysis initialization
+    pContext->mFftSize = 1024;
+    pContext->mFftBands = pContext->mFftSize / 2;
+    pContext->mFftServer.SetFlag(Eigen::FFT<float>::HalfSpectrum);
+    Visualizer_configureFft(pContext);
+
     // measurement initialization
     pContext->mChannelCount =
             audio_channel_count_from_out_mask(pContext->mConfig.inputCfg.channels);
@@ -366,95 +593,46 @@ int Visualizer_process(
         }
     }
 
+    // the command thread scales the capture, so only the channel average is kept here.
+    // this is the only writer of mCaptureIdx.
+    uint32_t captIdx = pContext->mCaptureIdx.load(std::memory_order_relaxed);
+    capture_sample_t *buf = pContext->mCaptureBuf;
+    const size_t frameCount = inBuffer->frameCount;
+    for (size_t frameIdx = 0; frameIdx < frameCount; ) {
+        // up to the end of the buffer, so that the inner loops do not wrap
+        const size_t count = std::min(frameCount - frameIdx, (size_t)(CAPTURE_BUF_SIZE - captIdx));
+        capture_sample_t *dst = buf + captIdx;
 #ifdef BUILD_FLOAT
-    float fscale; // multiplicative scale
-#else
-    int32_t shift;
-#endif // BUILD_FLOAT
-
-    if (pContext->mScalingMode == VISUALIZER_SCALING_MODE_NORMALIZED) {
-        // derive capture scaling factor from peak value in current buffer
-        // this gives more interesting captures for display.
-
-#ifdef BUILD_FLOAT
-        float maxSample = 0.f;
-        for (size_t inIdx = 0; inIdx < sampleLen; ) {
-            // we reconstruct the actual summed value to ensure proper normalization
-            // for multichannel outputs (channels > 2 may often be 0).
-            float smp = 0.f;
-            for (int i = 0; i < pContext->mChannelCount; ++i) {
-                smp += inBuffer->f32[inIdx++];
-            }
-            maxSample = fmax(maxSample, fabs(smp));
-        }
-        if (maxSample > 0.f) {
-            fscale = 0.99f / maxSample;
-            int exp; // unused
-            const float significand = frexp(fscale, &exp);
-            if (significand == 0.5f) {
-                fscale *= 255.f / 256.f; // avoid returning unaltered PCM signal
+        const float *src = inBuffer->f32 + frameIdx * pContext->mChannelCount;
+        if (pContext->mChannelCount == FCC_2) {
+            for (size_t i = 0; i < count; i++) {
+                dst[i] = (src[2 * i] + src[2 * i + 1]) * 0.5f;
             }
         } else {
-            // scale doesn't matter, the values are all 0.
-            fscale = 1.f;
+            // Note: if channels are uncorrelated, 1/sqrt(N) could be used at the risk of clipping.
+            const float fscale = 1.f / pContext->mChannelCount;
+            for (size_t i = 0; i < count; i++) {
+                float smp = 0.f;
+                for (uint32_t c = 0; c < pContext->mChannelCount; ++c) {
+                    smp += *src++;
+                }
+                dst[i] = smp * fscale;
+            }
         }
 #else
-        int32_t orAccum = 0;
-        for (size_t i = 0; i < sampleLen; ++i) {
-            int32_t smp = inBuffer->s16[i];
-            if (smp < 0) smp = -smp - 1; // take care to keep the max negative in range
-            orAccum |= smp;
+        const int16_t *src = inBuffer->s16 + frameIdx * FCC_2;  // integer supports stereo only.
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = (src[2 * i] + src[2 * i + 1]) >> 1;
         }
-
-        // A maximum amplitude signal will have 17 leading zeros, which we want to
-        // translate to a shift of 8 (for converting 16 bit to 8 bit)
-        shift = 25 - __builtin_clz(orAccum);
-
-        // Never scale by less than 8 to avoid returning unaltered PCM signal.
-        if (shift < 3) {
-            shift = 3;
-        }
-        // add one to combine the division by 2 needed after summing left and right channels below
-        shift++;
 #endif // BUILD_FLOAT
-    } else {
-        assert(pContext->mScalingMode == VISUALIZER_SCALING_MODE_AS_PLAYED);
-#ifdef BUILD_FLOAT
-        // Note: if channels are uncorrelated, 1/sqrt(N) could be used at the risk of clipping.
-        fscale = 1.f / pContext->mChannelCount;  // account for summing all the channels together.
-#else
-        shift = 9;
-#endif // BUILD_FLOAT
-    }
-
-    uint32_t captIdx;
-    uint32_t inIdx;
-    uint8_t *buf = pContext->mCaptureBuf;
-    for (inIdx = 0, captIdx = pContext->mCaptureIdx;
-         inIdx < sampleLen;
-         captIdx++) {
+        frameIdx += count;
+        captIdx += count;
         if (captIdx >= CAPTURE_BUF_SIZE) captIdx = 0; // wrap
-
-#ifdef BUILD_FLOAT
-        float smp = 0.f;
-        for (uint32_t i = 0; i < pContext->mChannelCount; ++i) {
-            smp += inBuffer->f32[inIdx++];
-        }
-        buf[captIdx] = clamp8_from_float(smp * fscale);
-#else
-        const int32_t smp = (inBuffer->s16[inIdx] + inBuffer->s16[inIdx + 1]) >> shift;
-        inIdx += FCC_2;  // integer supports stereo only.
-        buf[captIdx] = ((uint8_t)smp)^0x80;
-#endif // BUILD_FLOAT
     }
 
-    // XXX the following two should really be atomic, though it probably doesn't
-    // matter much for visualization purposes
-    pContext->mCaptureIdx = captIdx;
-    // update last buffer update time stamp
-    if (clock_gettime(CLOCK_MONOTONIC, &pContext->mBufferUpdateTime) < 0) {
-        pContext->mBufferUpdateTime.tv_sec = 0;
-    }
+    // publish the samples, then the last buffer update time stamp
+    pContext->mCaptureIdx.store(captIdx, std::memory_order_release);
+    pContext->mBufferUpdateTimeNs.store(Visualizer_getMonotonicTimeNs(), std::memory_order_release);
 
     if (inBuffer->raw != outBuffer->raw) {
 #ifdef BUILD_FLOAT
@@ -486,7 +664,11 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
 
     VisualizerContext * pContext = (VisualizerContext *)self;
 
-    if (pContext == NULL || pContext->mState == VISUALIZER_STATE_UNINITIALIZED) {
+    if (pContext == NULL) {
+        return -EINVAL;
+    }
+    std::lock_guard<std::mutex> _l(pContext->mCommandLock);
+    if (pContext->mState == VISUALIZER_STATE_UNINITIALIZED) {
         return -EINVAL;
     }
 
@@ -573,6 +755,18 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             p->vsize = sizeof(uint32_t);
             *replySize += sizeof(uint32_t);
             break;
+        case VISUALIZER_PARAM_FFT_SIZE:
+            ALOGV("get mFftSize = %" PRIu32, pContext->mFftSize);
+            *((uint32_t *)p->data + 1) = pContext->mFftSize;
+            p->vsize = sizeof(uint32_t);
+            *replySize += sizeof(uint32_t);
+            break;
+        case VISUALIZER_PARAM_FFT_BANDS:
+            ALOGV("get mFftBands = %" PRIu32, Visualizer_getFftBands(pContext));
+            *((uint32_t *)p->data + 1) = Visualizer_getFftBands(pContext);
+            p->vsize = sizeof(uint32_t);
+            *replySize += sizeof(uint32_t);
+            break;
         default:
             p->status = -EINVAL;
         }
@@ -617,6 +811,27 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
             pContext->mMeasurementMode = *((uint32_t *)p->data + 1);
             ALOGV("set mMeasurementMode = %" PRIu32, pContext->mMeasurementMode);
             break;
+        case VISUALIZER_PARAM_FFT_SIZE: {
+            const uint32_t fftSize = *((uint32_t *)p->data + 1);
+            if (!Visualizer_isValidFftSize(fftSize)) {
+                *(int32_t *)pReplyData = -EINVAL;
+                ALOGW("set mFftSize = %u invalid", fftSize);
+            } else {
+                pContext->mFftSize = fftSize;
+                Visualizer_configureFft(pContext);
+                ALOGV("set mFftSize = %u", fftSize);
+            }
+            } break;
+        case VISUALIZER_PARAM_FFT_BANDS: {
+            const uint32_t bands = *((uint32_t *)p->data + 1);
+            if (bands == 0 || bands > VISUALIZER_FFT_SIZE_MAX / 2 || (bands & (bands - 1)) != 0) {
+                *(int32_t *)pReplyData = -EINVAL;
+                ALOGW("set mFftBands = %u invalid", bands);
+            } else {
+                pContext->mFftBands = bands;
+                ALOGV("set mFftBands = %u", bands);
+            }
+            } break;
         default:
             *(int32_t *)pReplyData = -EINVAL;
         }
@@ -634,61 +849,47 @@ int Visualizer_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
                     *replySize, captureSize);
             return -EINVAL;
         }
-        if (pContext->mState == VISUALIZER_STATE_ACTIVE) {
-            const uint32_t deltaMs = Visualizer_getDeltaTimeMsFromUpdatedTime(pContext);
-
-            // if audio framework has stopped playing audio although the effect is still
-            // active we must clear the capture buffer to return silence
-            if ((pContext->mLastCaptureIdx == pContext->mCaptureIdx) &&
-                    (pContext->mBufferUpdateTime.tv_sec != 0) &&
-                    (deltaMs > MAX_STALL_TIME_MS)) {
-                    ALOGV("capture going to idle");
-                    pContext->mBufferUpdateTime.tv_sec = 0;
-                    memset(pReplyData, 0x80, captureSize);
-            } else {
-                int32_t latencyMs = pContext->mLatency;
-                latencyMs -= deltaMs;
-                if (latencyMs < 0) {
-                    latencyMs = 0;
-                }
-                uint32_t deltaSmpl = captureSize
-                        + pContext->mConfig.inputCfg.samplingRate * latencyMs / 1000;
-
-                // large sample rate, latency, or capture size, could cause overflow.
-                // do not offset more than the size of buffer.
-                if (deltaSmpl > CAPTURE_BUF_SIZE) {
-                    android_errorWriteLog(0x534e4554, "31781965");
-                    deltaSmpl = CAPTURE_BUF_SIZE;
-                }
-
-                int32_t capturePoint;
-                //capturePoint = (int32_t)pContext->mCaptureIdx - deltaSmpl;
-                __builtin_sub_overflow((int32_t)pContext->mCaptureIdx, deltaSmpl, &capturePoint);
-                // a negative capturePoint means we wrap the buffer.
-                if (capturePoint < 0) {
-                    uint32_t size = -capturePoint;
-                    if (size > captureSize) {
-                        size = captureSize;
-                    }
-                    memcpy(pReplyData,
-                           pContext->mCaptureBuf + CAPTURE_BUF_SIZE + capturePoint,
-                           size);
-                    pReplyData = (char *)pReplyData + size;
-                    captureSize -= size;
-                    capturePoint = 0;
-                }
-                memcpy(pReplyData,
-                       pContext->mCaptureBuf + capturePoint,
-                       captureSize);
-            }
-
-            pContext->mLastCaptureIdx = pContext->mCaptureIdx;
+        uint32_t captureIdx;
+        uint32_t latencySmpl;
+        if (Visualizer_getCaptureIdx(pContext, &captureIdx, &latencySmpl)) {
+            Visualizer_readCapture(pContext, captureIdx, captureSize + latencySmpl, captureSize,
+                    pContext->mCaptureScratch);
+            Visualizer_scaleCapture(pContext, pContext->mCaptureScratch, (uint8_t *)pReplyData,
+                    captureSize);
         } else {
             memset(pReplyData, 0x80, captureSize);
         }
 
         } break;
 
+    case VISUALIZER_CMD_MAGNITUDES: {
+        const uint32_t spectrumSize = Visualizer_getFftBands(pContext) * sizeof(float);
+        if (pReplyData == NULL || replySize == NULL || *replySize == 0 ||
+                *replySize % spectrumSize != 0 ||
+                *replySize / spectrumSize > VISUALIZER_FFT_BATCH_MAX) {
+            ALOGV("VISUALIZER_CMD_MAGNITUDES() error replySize %p spectrumSize %" PRIu32,
+                    replySize, spectrumSize);
+            return -EINVAL;
+        }
+        const uint32_t spectrumCount = *replySize / spectrumSize;
+        uint32_t captureIdx;
+        uint32_t latencySmpl;
+        if (!Visualizer_getCaptureIdx(pContext, &captureIdx, &latencySmpl)) {
+            memset(pReplyData, 0, *replySize);
+            break;
+        }
+        // keep the windows apart rather than clamping each of them to the buffer size.
+        latencySmpl = std::min(latencySmpl, CAPTURE_BUF_SIZE - spectrumCount * pContext->mFftSize);
+        // the oldest window first, and the windows do not overlap.
+        float *pMagnitudes = (float *)pReplyData;
+        for (uint32_t i = spectrumCount; i > 0; i--) {
+            Visualizer_readCapture(pContext, captureIdx, i * pContext->mFftSize + latencySmpl,
+                    pContext->mFftSize, pContext->mCaptureScratch);
+            Visualizer_computeMagnitudes(pContext, pMagnitudes);
+            pMagnitudes += spectrumSize / sizeof(float);
+        }
+        } break;
+
     case VISUALIZER_CMD_MEASURE: {
         if (pReplyData == NULL || replySize == NULL ||
                 *replySize < (sizeof(int32_t) * MEASUREMENT_COUNT)) {
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <audio_effects/effect_visualizer.h>
+#include <audio_utils/primitives.h>
+#include <gtest/gtest.h>
+
+extern audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+// see EffectVisualizer.cpp
+static constexpr uint32_t VISUALIZER_PARAM_FFT_SIZE = VISUALIZER_PARAM_MEASUREMENT_MODE + 1;
+static constexpr uint32_t VISUALIZER_PARAM_FFT_BANDS = VISUALIZER_PARAM_MEASUREMENT_MODE + 2;
+static constexpr uint32_t VISUALIZER_CMD_MAGNITUDES = VISUALIZER_CMD_MEASURE + 1;
+
+static constexpr effect_uuid_t kVisualizerUuid =
+        {0xd069d9e0, 0x8329, 0x11df, 0x9168, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}};
+static constexpr uint32_t kSampleRate = 48000;
+
+class VisualizerTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        ASSERT_EQ(0, AUDIO_EFFECT_LIBRARY_INFO_SYM.create_effect(
+                &kVisualizerUuid, 0 /* sessionId */, 0 /* ioId */, &mHandle));
+        int reply = 0;
+        uint32_t replySize = sizeof(reply);
+        ASSERT_EQ(0, command(EFFECT_CMD_INIT, 0, nullptr, &replySize, &reply));
+        ASSERT_EQ(0, reply);
+
+        effect_config_t config{};
+        config.inputCfg.samplingRate = config.outputCfg.samplingRate = kSampleRate;
+        config.inputCfg.channels = config.outputCfg.channels = AUDIO_CHANNEL_OUT_STEREO;
+        config.inputCfg.format = config.outputCfg.format = AUDIO_FORMAT_PCM_FLOAT;
+        config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+        config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+        ASSERT_EQ(0, command(EFFECT_CMD_SET_CONFIG, sizeof(config), &config, &replySize, &reply));
+        ASSERT_EQ(0, reply);
+        ASSERT_EQ(0, command(EFFECT_CMD_ENABLE, 0, nullptr, &replySize, &reply));
+        ASSERT_EQ(0, reply);
+    }
+
+    void TearDown() override {
+        if (mHandle != nullptr) {
+            EXPECT_EQ(0, AUDIO_EFFECT_LIBRARY_INFO_SYM.release_effect(mHandle));
+        }
+    }
+
+    int command(uint32_t cmdCode, uint32_t cmdSize, void *pCmdData, uint32_t *replySize,
+            void *pReplyData) {
+        return (*mHandle)->command(mHandle, cmdCode, cmdSize, pCmdData, replySize, pReplyData);
+    }
+
+    int32_t setParam(uint32_t param, uint32_t value) {
+        uint32_t buf[sizeof(effect_param_t) / sizeof(uint32_t) + 2];
+        effect_param_t *p = (effect_param_t *)buf;
+        p->psize = sizeof(uint32_t);
+        p->vsize = sizeof(uint32_t);
+        *(uint32_t *)p->data = param;
+        *((uint32_t *)p->data + 1) = value;
+        int32_t reply = 0;
+        uint32_t replySize = sizeof(reply);
+        EXPECT_EQ(0, command(EFFECT_CMD_SET_PARAM, sizeof(buf), buf, &replySize, &reply));
+        return reply;
+    }
+
+    uint32_t getParam(uint32_t param) {
+        uint32_t buf[sizeof(effect_param_t) / sizeof(uint32_t) + 2] = {};
+        effect_param_t *p = (effect_param_t *)buf;
+        p->psize = sizeof(uint32_t);
+        *(uint32_t *)p->data = param;
+        uint32_t replySize = sizeof(buf);
+        EXPECT_EQ(0, command(EFFECT_CMD_GET_PARAM, sizeof(effect_param_t) + sizeof(uint32_t),
+                buf, &replySize, buf));
+        EXPECT_EQ(0, p->status);
+        return *((uint32_t *)p->data + 1);
+    }
+
+    // Processes |frames| stereo frames of |generator|, in buffers of |bufferFrames|.
+    template <typename F>
+    void process(size_t frames, size_t bufferFrames, F generator) {
+        std::vector<float> in(bufferFrames * 2);
+        std::vector<float> out(bufferFrames * 2);
+        for (size_t frame = 0; frame < frames; ) {
+            const size_t count = std::min(bufferFrames, frames - frame);
+            for (size_t i = 0; i < count; i++, frame++) {
+                generator(frame, &in[2 * i]);
+            }
+            audio_buffer_t inBuffer;
+            inBuffer.frameCount = count;
+            inBuffer.f32 = in.data();
+            audio_buffer_t outBuffer;
+            outBuffer.frameCount = count;
+            outBuffer.f32 = out.data();
+            ASSERT_EQ(0, (*mHandle)->process(mHandle, &inBuffer, &outBuffer));
+            ASSERT_EQ(0, memcmp(in.data(), out.data(), count * 2 * sizeof(float)));
+        }
+    }
+
+    effect_handle_t mHandle = nullptr;
+};
+
+TEST_F(VisualizerTest, CaptureAsPlayed) {
+    ASSERT_EQ(0, setParam(VISUALIZER_PARAM_SCALING_MODE, VISUALIZER_SCALING_MODE_AS_PLAYED));
+    // odd buffer sizes, so that the ring wraps within a buffer
+    const size_t frames = 100003;
+    auto ramp = [](size_t frame, float *smp) {
+        smp[0] = (frame % 256) / 128.f - 1.f;
+        smp[1] = smp[0] * 0.5f;
+    };
+    process(frames, 997, ramp);
+
+    std::vector<uint8_t> capture(VISUALIZER_CAPTURE_SIZE_MAX);
+    uint32_t replySize = capture.size();
+    ASSERT_EQ(0, command(VISUALIZER_CMD_CAPTURE, 0, nullptr, &replySize, capture.data()));
+    for (size_t i = 0; i < capture.size(); i++) {
+        float smp[2];
+        ramp(frames - capture.size() + i, smp);
+        EXPECT_EQ(clamp8_from_float((smp[0] + smp[1]) * 0.5f), capture[i]) << "sample " << i;
+    }
+}
+
+TEST_F(VisualizerTest, CaptureNormalized) {
+    process(4800, 480, [](size_t frame, float *smp) {
+        smp[0] = smp[1] = 0.01f * sinf(2.f * M_PI * 1000.f * frame / kSampleRate);
+    });
+    std::vector<uint8_t> capture(VISUALIZER_CAPTURE_SIZE_MAX);
+    uint32_t replySize = capture.size();
+    ASSERT_EQ(0, command(VISUALIZER_CMD_CAPTURE, 0, nullptr, &replySize, capture.data()));
+    const auto [minSample, maxSample] = std::minmax_element(capture.begin(), capture.end());
+    EXPECT_LE(*minSample, 2);
+    EXPECT_GE(*maxSample, 253);
+}
+
+TEST_F(VisualizerTest, CaptureInactive) {
+    process(4800, 480, [](size_t, float *smp) { smp[0] = smp[1] = 0.5f; });
+    int reply = 0;
+    uint32_t replySize = sizeof(reply);
+    ASSERT_EQ(0, command(EFFECT_CMD_DISABLE, 0, nullptr, &replySize, &reply));
+
+    std::vector<uint8_t> capture(VISUALIZER_CAPTURE_SIZE_MAX);
+    replySize = capture.size();
+    ASSERT_EQ(0, command(VISUALIZER_CMD_CAPTURE, 0, nullptr, &replySize, capture.data()));
+    for (uint8_t smp : capture) {
+        ASSERT_EQ(0x80, smp);
+    }
+}
+
+TEST_F(VisualizerTest, FftParameters) {
+    EXPECT_EQ(0, setParam(VISUALIZER_PARAM_FFT_SIZE, 256));
+    EXPECT_EQ(256u, getParam(VISUALIZER_PARAM_FFT_SIZE));
+    EXPECT_EQ(128u, getParam(VISUALIZER_PARAM_FFT_BANDS));
+    EXPECT_EQ(0, setParam(VISUALIZER_PARAM_FFT_BANDS, 16));
+    EXPECT_EQ(16u, getParam(VISUALIZER_PARAM_FFT_BANDS));
+
+    EXPECT_EQ(-EINVAL, setParam(VISUALIZER_PARAM_FFT_SIZE, 64));
+    EXPECT_EQ(-EINVAL, setParam(VISUALIZER_PARAM_FFT_SIZE, 1000));
+    EXPECT_EQ(-EINVAL, setParam(VISUALIZER_PARAM_FFT_SIZE, 8192));
+    EXPECT_EQ(-EINVAL, setParam(VISUALIZER_PARAM_FFT_BANDS, 0));
+    EXPECT_EQ(-EINVAL, setParam(VISUALIZER_PARAM_FFT_BANDS, 24));
+    EXPECT_EQ(256u, getParam(VISUALIZER_PARAM_FFT_SIZE));
+    EXPECT_EQ(16u, getParam(VISUALIZER_PARAM_FFT_BANDS));
+
+    // the reply size must hold a whole number of spectra, up to the batch limit
+    std::vector<float> magnitudes(16 * 9);
+    uint32_t replySize = 15 * sizeof(float);
+    EXPECT_EQ(-EINVAL, command(VISUALIZER_CMD_MAGNITUDES, 0, nullptr, &replySize,
+            magnitudes.data()));
+    replySize = magnitudes.size() * sizeof(float);
+    EXPECT_EQ(-EINVAL, command(VISUALIZER_CMD_MAGNITUDES, 0, nullptr, &replySize,
+            magnitudes.data()));
+}
+
+TEST_F(VisualizerTest, Magnitudes) {
+    const uint32_t fftSize = 512;
+    const uint32_t bands = 64;
+    ASSERT_EQ(0, setParam(VISUALIZER_PARAM_FFT_SIZE, fftSize));
+    ASSERT_EQ(0, setParam(VISUALIZER_PARAM_FFT_BANDS, bands));
+
+    // a full scale sine centered on bin 101 of 256, in band 25 of 64 with its neighbours.
+    const float frequency = 101.f * kSampleRate / fftSize;
+    process(kSampleRate, 960, [frequency](size_t frame, float *smp) {
+        smp[0] = smp[1] = sinf(2.f * M_PI * frequency * frame / kSampleRate);
+    });
+
+    const size_t batch = 4;
+    std::vector<float> magnitudes(bands * batch);
+    uint32_t replySize = magnitudes.size() * sizeof(float);
+    ASSERT_EQ(0, command(VISUALIZER_CMD_MAGNITUDES, 0, nullptr, &replySize, magnitudes.data()));
+    for (size_t spectrum = 0; spectrum < batch; spectrum++) {
+        const float *pMagnitudes = &magnitudes[spectrum * bands];
+        // the band RMS of one bin at 1.0 and its two neighbours at 0.5, over 4 bins
+        EXPECT_NEAR(sqrtf(1.5f / 4), pMagnitudes[25], 1e-3f) << "spectrum " << spectrum;
+        for (uint32_t band = 0; band < bands; band++) {
+            if (band != 25) {
+                EXPECT_LT(pMagnitudes[band], 1e-3f) << "spectrum " << spectrum << " band " << band;
+            }
+        }
+    }
+}
+
+// AudioFlinger sends the capture commands without serializing them with process() or with the
+// other commands.
+TEST_F(VisualizerTest, ConcurrentCapture) {
+    std::atomic<bool> done{false};
+    std::thread capture([this, &done] {
+        std::vector<uint8_t> waveform(VISUALIZER_CAPTURE_SIZE_MAX);
+        std::vector<float> magnitudes(4096 / 2); // the bands at the largest FFT size
+        while (!done) {
+            uint32_t replySize = waveform.size();
+            EXPECT_EQ(0, command(VISUALIZER_CMD_CAPTURE, 0, nullptr, &replySize,
+                    waveform.data()));
+            // the band count may change between the two commands
+            const uint32_t bands = getParam(VISUALIZER_PARAM_FFT_BANDS);
+            replySize = bands * sizeof(float);
+            const int status = command(VISUALIZER_CMD_MAGNITUDES, 0, nullptr, &replySize,
+                    magnitudes.data());
+            EXPECT_TRUE(status == 0 || status == -EINVAL);
+        }
+    });
+    std::thread control([this, &done] {
+        for (uint32_t fftSize = 128; !done; fftSize = fftSize == 4096 ? 128 : fftSize * 2) {
+            EXPECT_EQ(0, setParam(VISUALIZER_PARAM_FFT_SIZE, fftSize));
+        }
+    });
+    process(kSampleRate, 240, [](size_t frame, float *smp) {
+        smp[0] = smp[1] = sinf(2.f * M_PI * 1000.f * frame / kSampleRate);
+    });
+    done = true;
+    capture.join();
+    control.join();
+}
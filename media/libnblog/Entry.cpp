@@ -20,6 +20,7 @@
 #include <memory>
 #include <stddef.h>
 #include <stdint.h>
+#include <vector>
 
 #include <audio_utils/fifo.h>
 #include <media/nblog/Entry.h>
@@ -222,6 +223,38 @@ EntryIterator FormatEntry::copyWithAuthor(
     return it;
 }
 
+EntryIterator FormatEntry::appendWithAuthor(std::vector<uint8_t> *dst, int author,
+                                            const EntryIterator &end) const
+{
+    const uint8_t *last = end;
+    // fmt start, timestamp and hash
+    auto it = begin();
+    for (int i = 0; i < 3 && (const uint8_t *) it < last; i++) {
+        ++it;
+    }
+    const uint8_t *args = it;
+    // rest of entries, up to and including fmt end
+    while ((const uint8_t *) it < last && it->type != EVENT_FMT_END) {
+        ++it;
+    }
+    if ((const uint8_t *) it >= last) {
+        return end;
+    }
+    ++it;
+    dst->insert(dst->end(), mEntry, args);
+    // insert author entry
+    const size_t authorEntrySize = Entry::kOverhead + sizeof(author);
+    uint8_t authorEntry[authorEntrySize];
+    authorEntry[offsetof(entry, type)] = EVENT_FMT_AUTHOR;
+    authorEntry[offsetof(entry, length)] =
+        authorEntry[authorEntrySize + Entry::kPreviousLengthOffset] =
+        sizeof(author);
+    memcpy(&authorEntry[offsetof(entry, data)], &author, sizeof(author));
+    dst->insert(dst->end(), authorEntry, authorEntry + authorEntrySize);
+    dst->insert(dst->end(), args, (const uint8_t *) it);
+    return it;
+}
+
 int64_t HistogramEntry::timestamp() const
 {
     return EntryIterator(mEntry).payload<HistTsEntry>().ts;
@@ -258,5 +291,25 @@ EntryIterator HistogramEntry::copyWithAuthor(
     return EntryIterator(mEntry).next();
 }
 
+EntryIterator HistogramEntry::appendWithAuthor(std::vector<uint8_t> *dst, int author,
+                                               const EntryIterator &end) const
+{
+    const EntryIterator next = EntryIterator(mEntry).next();
+    if ((const uint8_t *) next > (const uint8_t *) end) {
+        return end;
+    }
+    // {type, length, struct HistTsEntry, length} becomes
+    // {type, length, struct HistTsEntryWithAuthor, length}
+    const size_t offset = dst->size();
+    dst->resize(offset + Entry::kOverhead + sizeof(HistTsEntryWithAuthor));
+    uint8_t *buffer = dst->data() + offset;
+    memcpy(buffer, mEntry, sizeof(entry) + sizeof(HistTsEntry));
+    memcpy(buffer + sizeof(entry) + sizeof(HistTsEntry), &author, sizeof(author));
+    buffer[offsetof(entry, length)] = sizeof(HistTsEntryWithAuthor);
+    buffer[offsetof(entry, data) + sizeof(HistTsEntryWithAuthor) + offsetof(ending, length)]
+        = sizeof(HistTsEntryWithAuthor);
+    return next;
+}
+
 }   // namespace NBLog
 }   // namespace android
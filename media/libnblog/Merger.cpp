@@ -18,7 +18,6 @@
 //#define LOG_NDEBUG 0
 
 #include <memory>
-#include <queue>
 #include <stddef.h>
 #include <stdint.h>
 #include <vector>
@@ -44,6 +43,7 @@ namespace android {
 namespace NBLog {
 
 Merger::Merger(const void *shared, size_t size):
+      mReaders(new ReaderList()),
       mShared((Shared *) shared),
       mFifo(mShared != NULL ?
         new audio_utils_fifo(size, sizeof(uint8_t),
@@ -52,95 +52,254 @@ Merger::Merger(const void *shared, size_t size):
 {
 }
 
+Merger::~Merger()
+{
+    delete mReaders.load();
+}
+
+// These are called by binder threads in MediaLogService while the merge thread reads the list,
+// so a modified copy of the list is published instead of changing the current one.
 void Merger::addReader(const sp<Reader> &reader)
 {
-    // FIXME This is called by binder thread in MediaLogService::registerWriter
-    //       but the access to shared variable mReaders is not yet protected by a lock.
-    mReaders.push_back(reader);
+    AutoMutex _l(mReadersLock);
+    std::unique_ptr<ReaderList> readers(new ReaderList(*mReaders.load()));
+    readers->push_back(reader);
+    publishReaders(std::move(readers));
 }
 
-// items placed in priority queue during merge
-// composed by a timestamp and the index of the snapshot where the timestamp came from
-struct MergeItem
+void Merger::removeReader(const sp<IMemory> &iMemory)
 {
-    int64_t ts;
-    int index;
-    MergeItem(int64_t ts, int index): ts(ts), index(index) {}
-};
+    AutoMutex _l(mReadersLock);
+    std::unique_ptr<ReaderList> readers(new ReaderList(*mReaders.load()));
+    for (sp<Reader> &reader : *readers) {
+        if (reader != nullptr && reader->isIMemory(iMemory)) {
+            reader.clear(); // keep the indices of the other authors
+        }
+    }
+    publishReaders(std::move(readers));
+}
 
-bool operator>(const struct MergeItem &i1, const struct MergeItem &i2)
+// Called with mReadersLock held.
+void Merger::publishReaders(std::unique_ptr<const ReaderList> readers)
 {
-    return i1.ts > i2.ts || (i1.ts == i2.ts && i1.index > i2.index);
+    mRetiredReaders.emplace_back(mReaders.exchange(readers.release()));
+    // A Readers object created after the exchange gets the new list. So if none exists
+    // now, no one holds a retired list. Otherwise they are deleted by a later call, which
+    // also releases the readers removed from them.
+    if (mReadersUsers.load() == 0) {
+        mRetiredReaders.clear();
+    }
 }
 
-// Merge registered readers, sorted by timestamp, and write data to a single FIFO in local memory
-void Merger::merge()
+Merger::Readers::Readers(const Merger &merger)
+    : mMerger(merger)
 {
-    if (true) return; // Merging is not necessary at the moment, so this is to disable it
-                      // and bypass compiler warnings about member variables not being used.
-    const int nLogs = mReaders.size();
-    std::vector<std::unique_ptr<Snapshot>> snapshots(nLogs);
-    std::vector<EntryIterator> offsets;
-    offsets.reserve(nLogs);
-    for (int i = 0; i < nLogs; ++i) {
-        snapshots[i] = mReaders[i]->getSnapshot();
-        offsets.push_back(snapshots[i]->begin());
+    // counted before the list is loaded, see publishReaders()
+    mMerger.mReadersUsers++;
+    mList = mMerger.mReaders.load();
+}
+
+Merger::Readers::~Readers()
+{
+    mMerger.mReadersUsers--;
+}
+
+Merger::Readers Merger::getReaders() const
+{
+    return Readers(*this);
+}
+
+// Returns true if the entry is merged in timestamp order, and sets its timestamp.
+static bool getMergeTimestamp(const EntryIterator &it, int64_t *ts)
+{
+    switch (it->type) {
+    case EVENT_FMT_START:
+        *ts = FormatEntry(it).timestamp();
+        return true;
+    case EVENT_AUDIO_STATE:
+    case EVENT_HISTOGRAM_ENTRY_TS:
+        *ts = HistogramEntry(it).timestamp();
+        return true;
+    default:
+        return false;
     }
-    // initialize offsets
-    // TODO custom heap implementation could allow to update top, improving performance
-    // for bursty buffers
-    std::priority_queue<MergeItem, std::vector<MergeItem>, std::greater<MergeItem>> timestamps;
-    for (int i = 0; i < nLogs; ++i)
-    {
-        if (offsets[i] != snapshots[i]->end()) {
-            std::unique_ptr<AbstractEntry> abstractEntry = AbstractEntry::buildEntry(offsets[i]);
-            if (abstractEntry == nullptr) {
-                continue;
-            }
-            timestamps.emplace(abstractEntry->timestamp(), i);
+}
+
+// Entries without a timestamp are merged together with the next entry that has one.
+void Merger::findHead(ReaderState &state)
+{
+    state.hasHead = false;
+    for (EntryIterator it = state.position;
+            (const uint8_t *) it < (const uint8_t *) state.view.end; ++it) {
+        if (getMergeTimestamp(it, &state.ts)) {
+            state.head = it;
+            state.hasHead = true;
+            return;
+        }
+    }
+}
+
+bool Merger::isBefore(const MergeHead &a, const MergeHead &b)
+{
+    return a.ts < b.ts || (a.ts == b.ts && a.index < b.index);
+}
+
+void Merger::siftDown(size_t i)
+{
+    const size_t size = mHeap.size();
+    const MergeHead head = mHeap[i];
+    for (size_t child = 2 * i + 1; child < size; child = 2 * i + 1) {
+        if (child + 1 < size && isBefore(mHeap[child + 1], mHeap[child])) {
+            child++;
+        }
+        if (!isBefore(mHeap[child], head)) {
+            break;
         }
+        mHeap[i] = mHeap[child];
+        i = child;
     }
+    mHeap[i] = head;
+}
 
-    while (!timestamps.empty()) {
-        int index = timestamps.top().index;     // find minimum timestamp
-        // copy it to the log, increasing offset
-        offsets[index] = AbstractEntry::buildEntry(offsets[index])->
-            copyWithAuthor(mFifoWriter, index);
-        // update data structures
-        timestamps.pop();
-        if (offsets[index] != snapshots[index]->end()) {
-            int64_t ts = AbstractEntry::buildEntry(offsets[index])->timestamp();
-            timestamps.emplace(ts, index);
+void Merger::pushHead(const MergeHead &head)
+{
+    size_t i = mHeap.size();
+    mHeap.push_back(head);
+    while (i > 0) {
+        const size_t parent = (i - 1) / 2;
+        if (!isBefore(head, mHeap[parent])) {
+            break;
         }
+        mHeap[i] = mHeap[parent];
+        i = parent;
     }
+    mHeap[i] = head;
 }
 
-const std::vector<sp<Reader>>& Merger::getReaders() const
+EntryIterator Merger::appendWithAuthor(const EntryIterator &it, int author,
+                                       const EntryIterator &end)
 {
-    //AutoMutex _l(mLock);
-    return mReaders;
+    if (it->type == EVENT_FMT_START) {
+        return FormatEntry(it).appendWithAuthor(&mMerged, author, end);
+    }
+    return HistogramEntry(it).appendWithAuthor(&mMerged, author, end);
+}
+
+void Merger::flushMerged()
+{
+    if (!mMerged.empty()) {
+        mFifoWriter->write(mMerged.data(), mMerged.size());
+        mMerged.clear();
+    }
+}
+
+// Merge registered readers, sorted by timestamp, and write data to a single FIFO in local memory.
+// The entries are read in place in each reader's FIFO, and the FIFO with the earliest
+// timestamp is copied until another FIFO has an earlier one, so bursts of entries
+// from one thread only cost one heap update. The merged entries are written in blocks.
+void Merger::merge(MergeListener *listener)
+{
+    if (mFifoWriter == nullptr) {
+        return;
+    }
+    const Readers readers = getReaders();
+    const int nLogs = readers->size();
+    mStates.resize(nLogs);
+    mHeap.clear();
+    for (int i = 0; i < nLogs; ++i) {
+        ReaderState &state = mStates[i];
+        state.view = (*readers)[i] != nullptr ? (*readers)[i]->getView() : Reader::View();
+        state.position = state.view.begin;
+        findHead(state);
+        if (state.hasHead) {
+            pushHead({state.ts, i});
+        }
+    }
+
+    while (!mHeap.empty()) {
+        const int index = mHeap[0].index;
+        ReaderState &state = mStates[index];
+        // earliest head of the other readers
+        const MergeHead *next = nullptr;
+        if (mHeap.size() > 1) {
+            next = &mHeap[1];
+            if (mHeap.size() > 2 && isBefore(mHeap[2], mHeap[1])) {
+                next = &mHeap[2];
+            }
+        }
+        const EntryIterator batchBegin = state.position;
+        bool withinBudget;
+        do {
+            state.position = appendWithAuthor(state.head, index, state.view.end);
+            findHead(state);
+            withinBudget = (size_t) (state.position - state.view.begin) < kMaxMergeBytesPerReader;
+        } while (state.hasHead && withinBudget
+                && (next == nullptr || isBefore({state.ts, index}, *next)));
+        if (listener != nullptr) {
+            listener->onEntries(batchBegin, state.position, index);
+        }
+        if (mMerged.size() >= kMergedWriteSize) {
+            flushMerged();
+        }
+        if (state.hasHead && withinBudget) {
+            mHeap[0].ts = state.ts;
+        } else {
+            // this reader is done, what is left is merged by the next call
+            mHeap[0] = mHeap.back();
+            mHeap.pop_back();
+        }
+        if (!mHeap.empty()) {
+            siftDown(0);
+        }
+    }
+    flushMerged();
+
+    for (int i = 0; i < nLogs; ++i) {
+        ReaderState &state = mStates[i];
+        if ((*readers)[i] == nullptr) {
+            continue;
+        }
+        // Entries after the last timestamp do not need to be sorted.
+        if (!state.hasHead && state.position != state.view.end) {
+            if (listener != nullptr) {
+                listener->onEntries(state.position, state.view.end, i);
+            }
+            state.position = state.view.end;
+        }
+        (*readers)[i]->releaseView(state.position);
+        state.view = Reader::View();
+    }
 }
 
 // ---------------------------------------------------------------------------
 
 MergeReader::MergeReader(const void *shared, size_t size, Merger &merger)
-    : Reader(shared, size, "MergeReader"), mReaders(merger.getReaders())
+    : Reader(shared, size, "MergeReader"), mMerger(merger)
 {
 }
 
+void MergeReader::processSnapshot(Snapshot &snapshot, int author)
+{
+    processEntries(snapshot.begin(), snapshot.end(), author);
+}
+
 // Takes raw content of the local merger FIFO, processes log entries, and
 // writes the data to a map of class PerformanceAnalysis, based on their thread ID.
-void MergeReader::processSnapshot(Snapshot &snapshot, int author)
+void MergeReader::processEntries(const EntryIterator &begin, const EntryIterator &end, int author)
 {
     ReportPerformance::PerformanceData& data = mThreadPerformanceData[author];
     // We don't do "auto it" because it reduces readability in this case.
-    for (EntryIterator it = snapshot.begin(); it != snapshot.end(); ++it) {
+    for (EntryIterator it = begin; it != end; ++it) {
         switch (it->type) {
         case EVENT_HISTOGRAM_ENTRY_TS: {
             const HistTsEntry payload = it.payload<HistTsEntry>();
             // TODO: hash for histogram ts and audio state need to match
             // and correspond to audio production source file location
-            mThreadPerformanceAnalysis[author][0 /*hash*/].logTsEntry(payload.ts);
+            const double intervalMs =
+                    mThreadPerformanceAnalysis[author][0 /*hash*/].logTsEntry(payload.ts);
+            if (intervalMs >= 0) {
+                data.wakeupSketch.add(intervalMs);
+            }
         } break;
         case EVENT_AUDIO_STATE: {
             mThreadPerformanceAnalysis[author][0 /*hash*/].handleStateChange();
@@ -161,6 +320,7 @@ void MergeReader::processSnapshot(Snapshot &snapshot, int author)
             const int64_t monotonicNs = it.payload<int64_t>();
             const double monotonicMs = monotonicNs * 1e-6;
             data.workHist.add(monotonicMs);
+            data.workSketch.add(monotonicMs);
             data.active += monotonicNs;
         } break;
         case EVENT_WARMUP_TIME: {
@@ -197,17 +357,14 @@ void MergeReader::processSnapshot(Snapshot &snapshot, int author)
 
 void MergeReader::getAndProcessSnapshot()
 {
-    // get a snapshot of each reader and process them
-    // TODO insert lock here
-    const size_t nLogs = mReaders.size();
-    std::vector<std::unique_ptr<Snapshot>> snapshots(nLogs);
-    for (size_t i = 0; i < nLogs; i++) {
-        snapshots[i] = mReaders[i]->getSnapshot();
-    }
-    // TODO unlock lock here
-    for (size_t i = 0; i < nLogs; i++) {
-        if (snapshots[i] != nullptr) {
-            processSnapshot(*(snapshots[i]), i);
+    // process the entries of each reader in place
+    const Merger::Readers readers = mMerger.getReaders();
+    for (size_t i = 0; i < readers->size(); i++) {
+        const sp<Reader> &reader = (*readers)[i];
+        if (reader != nullptr) {
+            const Reader::View view = reader->getView();
+            processEntries(view.begin, view.end, i);
+            reader->releaseView(view.end);
         }
     }
     checkPushToMediaMetrics();
@@ -261,9 +418,11 @@ void MergeReader::handleAuthor(const AbstractEntry &entry, String8 *body)
     if (author == -1) {
         return;
     }
-    // FIXME Needs a lock
-    const char* name = mReaders[author]->name().c_str();
-    body->appendFormat("%s: ", name);
+    const Merger::Readers readers = mMerger.getReaders();
+    if ((size_t) author >= readers->size() || (*readers)[author] == nullptr) {
+        return;
+    }
+    body->appendFormat("%s: ", (*readers)[author]->name().c_str());
 }
 
 // ---------------------------------------------------------------------------
@@ -296,12 +455,10 @@ bool MergeThread::threadLoop()
         mTimeoutUs -= kThreadSleepPeriodUs;
     }
     if (doMerge) {
-        // Merge data from all the readers
-        mMerger.merge();
-        // Process the data collected by mMerger and write it to PerformanceAnalysis
-        // FIXME: decide whether to call getAndProcessSnapshot every time
-        // or whether to have a separate thread that calls it with a lower frequency
-        mMergeReader.getAndProcessSnapshot();
+        // Merge data from all the readers, mMergeReader writes it to PerformanceAnalysis
+        // as it is merged so every entry is only read once.
+        mMerger.merge(&mMergeReader);
+        mMergeReader.checkPushToMediaMetrics();
     }
     return true;
 }
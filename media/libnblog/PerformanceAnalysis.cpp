@@ -155,24 +155,157 @@ std::string Histogram::asciiArtString(size_t indent) const {
 
 //------------------------------------------------------------------------------
 
+QuantileSketch::QuantileSketch(double lowest)
+    : mLowest(lowest > 0. ? lowest : 0.001)
+{
+}
+
+size_t QuantileSketch::indexOf(double value) const
+{
+    if (!(value >= mLowest)) { // also catches NaN
+        return 0;
+    }
+    // value = mLowest * mantissa * 2^exponent with 0.5 <= mantissa < 1
+    int exponent;
+    const double mantissa = frexp(value / mLowest, &exponent);
+    const size_t octave = exponent - 1;
+    if (octave >= kOctaves) {
+        return kNumBuckets - 1;
+    }
+    const size_t subBucket = static_cast<size_t>((2. * mantissa - 1.) * kSubBuckets);
+    return 1 + octave * kSubBuckets + std::min(subBucket, kSubBuckets - 1);
+}
+
+double QuantileSketch::valueOf(size_t index) const
+{
+    if (index == 0) {
+        return mLowest / 2;
+    }
+    const size_t octave = (index - 1) / kSubBuckets;
+    const size_t subBucket = (index - 1) % kSubBuckets;
+    return ldexp(mLowest * (1. + (subBucket + 0.5) / kSubBuckets), octave);
+}
+
+void QuantileSketch::add(double value)
+{
+    mCounts[indexOf(value)]++;
+    if (mTotalCount == 0) {
+        mMin = mMax = value;
+    } else {
+        mMin = std::min(mMin, value);
+        mMax = std::max(mMax, value);
+    }
+    mSum += value;
+    mTotalCount++;
+}
+
+void QuantileSketch::clear()
+{
+    mCounts.fill(0);
+    mTotalCount = 0;
+    mSum = mMin = mMax = 0.;
+}
+
+bool QuantileSketch::merge(const QuantileSketch &other)
+{
+    if (other.mLowest != mLowest) {
+        return false;
+    }
+    if (other.mTotalCount == 0) {
+        return true;
+    }
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        mCounts[i] += other.mCounts[i];
+    }
+    mMin = mTotalCount == 0 ? other.mMin : std::min(mMin, other.mMin);
+    mMax = mTotalCount == 0 ? other.mMax : std::max(mMax, other.mMax);
+    mSum += other.mSum;
+    mTotalCount += other.mTotalCount;
+    return true;
+}
+
+double QuantileSketch::quantile(double q) const
+{
+    if (mTotalCount == 0) {
+        return 0.;
+    }
+    // rank of the data point, starting at 1
+    const uint64_t rank = std::max((uint64_t) 1, (uint64_t) ceil(
+            std::max(0., std::min(1., q)) * mTotalCount));
+    uint64_t count = 0;
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        count += mCounts[i];
+        if (count >= rank) {
+            // the exact min and max are better than the middle of their bucket
+            return std::max(mMin, std::min(mMax, valueOf(i)));
+        }
+    }
+    return mMax;
+}
+
+void QuantileSketch::forEachBucket(
+        const std::function<void(double value, uint64_t count)> &f) const
+{
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        if (mCounts[i] != 0) {
+            f(valueOf(i), mCounts[i]);
+        }
+    }
+}
+
+std::string QuantileSketch::toString() const
+{
+    std::stringstream ss;
+    static constexpr char kDivider = '|';
+    ss << kVersion << "," << mLowest << "," << kSubBuckets << ",{";
+    bool first = true;
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        if (mCounts[i] != 0) {
+            if (!first) {
+                ss << ",";
+            }
+            ss << i << kDivider << mCounts[i];
+            first = false;
+        }
+    }
+    ss << "}";
+    return ss.str();
+}
+
+std::string QuantileSketch::percentilesString() const
+{
+    if (mTotalCount == 0) {
+        return "";
+    }
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2)
+            << "n=" << mTotalCount
+            << " p50=" << quantile(0.5)
+            << " p90=" << quantile(0.9)
+            << " p99=" << quantile(0.99)
+            << " p999=" << quantile(0.999)
+            << " max=" << mMax;
+    return ss.str();
+}
+
+//------------------------------------------------------------------------------
+
 // Given an audio processing wakeup timestamp, buckets the time interval
 // since the previous timestamp into a histogram, searches for
 // outliers, analyzes the outlier series for unexpectedly
 // small or large values and stores these as peaks
-void PerformanceAnalysis::logTsEntry(timestamp ts) {
+msInterval PerformanceAnalysis::logTsEntry(timestamp ts) {
     // after a state change, start a new series and do not
     // record time intervals in-between
     if (mBufferPeriod.mPrevTs == 0) {
         mBufferPeriod.mPrevTs = ts;
-        return;
+        return -1;
     }
 
     // calculate time interval between current and previous timestamp
     const msInterval diffMs = static_cast<msInterval>(
         deltaMs(mBufferPeriod.mPrevTs, ts));
 
-    const int diffJiffy = deltaJiffy(mBufferPeriod.mPrevTs, ts);
-
     // old versus new weight ratio when updating the buffer period mean
     static constexpr double exponentialWeight = 0.999;
     // update buffer period mean with exponential weighting
@@ -199,22 +332,15 @@ void PerformanceAnalysis::logTsEntry(timestamp ts) {
         // occurred at the current timestamp
     }
 
-    // Insert a histogram to mHists if it is empty, or
-    // close the current histogram and insert a new empty one if
-    // if the current histogram has spanned its maximum time interval.
-    if (mHists.empty() ||
-        deltaMs(mHists[0].first, ts) >= kMaxLength.HistTimespanMs) {
-        mHists.emplace_front(ts, std::map<int, int>());
-        // When memory is full, delete oldest histogram
-        // TODO: use a circular buffer
-        if (mHists.size() >= kMaxLength.Hists) {
-            mHists.resize(kMaxLength.Hists);
-        }
+    // add current time interval to the distribution, with full precision
+    if (mBufferPeriodsStartTs < 0) {
+        mBufferPeriodsStartTs = ts;
     }
-    // add current time intervals to histogram
-    ++mHists[0].second[diffJiffy];
+    const msInterval intervalMs = (ts - mBufferPeriod.mPrevTs) * 1e-6;
+    mBufferPeriods.add(intervalMs);
     // update previous timestamp
     mBufferPeriod.mPrevTs = ts;
+    return intervalMs;
 }
 
 
@@ -342,24 +468,20 @@ inline double logRound(double x, double mean) {
 // of PerformanceAnalysis
 void PerformanceAnalysis::reportPerformance(String8 *body, int author, log_hash_t hash,
                                             int maxHeight) {
-    if (mHists.empty() || body == nullptr) {
+    if (mBufferPeriods.totalCount() == 0 || body == nullptr) {
         return;
     }
 
     // ms of active audio in displayed histogram
-    double elapsedMs = 0;
+    const double elapsedMs = mBufferPeriods.mean() * mBufferPeriods.totalCount();
     // starting timestamp of histogram
-    timestamp startingTs = mHists[0].first;
+    const timestamp startingTs = mBufferPeriodsStartTs;
 
-    // histogram which stores .1 precision ms counts instead of Jiffy multiple counts
+    // histogram which stores .1 precision ms counts
     std::map<double, int> buckets;
-    for (const auto &shortHist: mHists) {
-        for (const auto &countPair : shortHist.second) {
-            const double ms = static_cast<double>(countPair.first) / kJiffyPerMs;
-            buckets[logRound(ms, mBufferPeriod.mMean)] += countPair.second;
-            elapsedMs += ms * countPair.second;
-        }
-    }
+    mBufferPeriods.forEachBucket([&](double ms, uint64_t count) {
+        buckets[logRound(round(ms * kJiffyPerMs) / kJiffyPerMs, mBufferPeriod.mMean)] += count;
+    });
 
     static const int SIZE = 128;
     char title[SIZE];
@@ -371,6 +493,7 @@ void PerformanceAnalysis::reportPerformance(String8 *body, int author, log_hash_
 
     body->appendFormat("%s",
             audio_utils_plot_histogram(buckets, title, kLabel, maxHeight).c_str());
+    body->appendFormat("\nbuffer period ms: %s\n", mBufferPeriods.percentilesString().c_str());
 
     // Now report glitches
     body->appendFormat("\ntime elapsed between glitches and glitch timestamps:\n");
@@ -399,7 +522,12 @@ void dump(int fd, int indent, PerformanceAnalysisMap &threadPerformanceAnalysis)
             }
 #ifdef WRITE_TO_FILE
             // write to file. Enable by uncommenting macro at top of file.
-            writeToFile(curr.mHists, curr.mOutlierData, curr.mPeakTimestamps,
+            std::deque<std::pair<timestamp, Hist>> hists(1);
+            hists[0].first = curr.mBufferPeriodsStartTs;
+            curr.mBufferPeriods.forEachBucket([&](double ms, uint64_t count) {
+                hists[0].second[lround(ms * kJiffyPerMs)] += count;
+            });
+            writeToFile(hists, curr.mOutlierData, curr.mPeakTimestamps,
                         kDirectory, false, thread.first, hash.first);
 #endif
         }
@@ -61,20 +61,14 @@ Reader::~Reader()
     delete mFifo;
 }
 
-// Copies content of a Reader FIFO into its Snapshot
-// The Snapshot has the same raw data, but represented as a sequence of entries
-// and an EntryIterator making it possible to process the data.
-std::unique_ptr<Snapshot> Reader::getSnapshot(bool flush)
+// Obtains the readable region of the FIFO without consuming it.
+// Returns the number of bytes available, or <= 0 if there is nothing to read.
+ssize_t Reader::obtain(audio_utils_iovec *iovec, size_t *lost)
 {
-    if (mFifoReader == NULL) {
-        return std::unique_ptr<Snapshot>(new Snapshot());
-    }
-
     // This emulates the behaviour of audio_utils_fifo_reader::read, but without incrementing the
     // reader index. The index is incremented after handling corruption, to after the last complete
     // entry of the buffer
-    size_t lost = 0;
-    audio_utils_iovec iovec[2];
+    *lost = 0;
     const size_t capacity = mFifo->capacity();
     ssize_t availToRead;
     // A call to audio_utils_fifo_reader::obtain() places the read pointer one buffer length
@@ -92,13 +86,10 @@ std::unique_ptr<Snapshot> Reader::getSnapshot(bool flush)
     size_t lostTemp;
     do {
         availToRead = mFifoReader->obtain(iovec, capacity, NULL /*timeout*/, &lostTemp);
-        lost += lostTemp;
+        *lost += lostTemp;
     } while (availToRead < 0 || ++tries <= kMaxObtainTries);
 
-    if (availToRead <= 0) {
-        ALOGW_IF(availToRead < 0, "NBLog Reader %s failed to catch up with Writer", mName.c_str());
-        return std::unique_ptr<Snapshot>(new Snapshot());
-    }
+    ALOGW_IF(availToRead < 0, "NBLog Reader %s failed to catch up with Writer", mName.c_str());
 
     // Change to #if 1 for debugging. This statement is useful for checking buffer fullness levels
     // (as seen by reader) and how much data was lost. If you find that the fullness level is
@@ -108,47 +99,69 @@ std::unique_ptr<Snapshot> Reader::getSnapshot(bool flush)
     // - log less often
     // - increase the initial shared memory allocation for the buffer
 #if 0
-    ALOGD("getSnapshot name=%s, availToRead=%zd, capacity=%zu, fullness=%.3f, lost=%zu",
-            name().c_str(), availToRead, capacity, (double)availToRead / (double)capacity, lost);
+    ALOGD("obtain name=%s, availToRead=%zd, capacity=%zu, fullness=%.3f, lost=%zu",
+            name().c_str(), availToRead, capacity, (double)availToRead / (double)capacity, *lost);
 #endif
-    std::unique_ptr<Snapshot> snapshot(new Snapshot(availToRead));
-    memcpy(snapshot->mData, (const char *) mFifo->buffer() + iovec[0].mOffset, iovec[0].mLength);
-    if (iovec[1].mLength > 0) {
-        memcpy(snapshot->mData + (iovec[0].mLength),
-                (const char *) mFifo->buffer() + iovec[1].mOffset, iovec[1].mLength);
-    }
-
-    // Handle corrupted buffer
-    // Potentially, a buffer has corrupted data on both beginning (due to overflow) and end
-    // (due to incomplete format entry). But even if the end format entry is incomplete,
-    // it ends in a complete entry (which is not an FMT_END). So is safe to traverse backwards.
-    // TODO: handle client corruption (in the middle of a buffer)
-
-    const uint8_t *back = snapshot->mData + availToRead;
-    const uint8_t *front = snapshot->mData;
+    return availToRead;
+}
 
+// Handle corrupted buffer
+// Potentially, a buffer has corrupted data on both beginning (due to overflow) and end
+// (due to incomplete format entry). But even if the end format entry is incomplete,
+// it ends in a complete entry (which is not an FMT_END). So is safe to traverse backwards.
+// TODO: handle client corruption (in the middle of a buffer)
+void Reader::findValidEntries(const uint8_t *front, const uint8_t *back,
+                              EntryIterator *begin, EntryIterator *end)
+{
     // Find last FMT_END. <back> is sitting on an entry which might be the middle of a FormatEntry.
     // We go backwards until we find an EVENT_FMT_END.
     const uint8_t *lastEnd = findLastValidEntry(front, back, invalidEndTypes);
     if (lastEnd == nullptr) {
-        snapshot->mEnd = snapshot->mBegin = EntryIterator(front);
+        *end = *begin = EntryIterator(front);
     } else {
         // end of snapshot points to after last FMT_END entry
-        snapshot->mEnd = EntryIterator(lastEnd).next();
+        *end = EntryIterator(lastEnd).next();
         // find first FMT_START
         const uint8_t *firstStart = nullptr;
-        const uint8_t *firstStartTmp = snapshot->mEnd;
+        const uint8_t *firstStartTmp = *end;
         while ((firstStartTmp = findLastValidEntry(front, firstStartTmp, invalidBeginTypes))
                 != nullptr) {
             firstStart = firstStartTmp;
         }
         // firstStart is null if no FMT_START entry was found before lastEnd
         if (firstStart == nullptr) {
-            snapshot->mBegin = snapshot->mEnd;
+            *begin = *end;
         } else {
-            snapshot->mBegin = EntryIterator(firstStart);
+            *begin = EntryIterator(firstStart);
         }
     }
+}
+
+// Copies content of a Reader FIFO into its Snapshot
+// The Snapshot has the same raw data, but represented as a sequence of entries
+// and an EntryIterator making it possible to process the data.
+std::unique_ptr<Snapshot> Reader::getSnapshot(bool flush)
+{
+    if (mFifoReader == NULL) {
+        return std::unique_ptr<Snapshot>(new Snapshot());
+    }
+
+    audio_utils_iovec iovec[2];
+    size_t lost;
+    const ssize_t availToRead = obtain(iovec, &lost);
+    if (availToRead <= 0) {
+        return std::unique_ptr<Snapshot>(new Snapshot());
+    }
+
+    std::unique_ptr<Snapshot> snapshot(new Snapshot(availToRead));
+    memcpy(snapshot->mData, (const char *) mFifo->buffer() + iovec[0].mOffset, iovec[0].mLength);
+    if (iovec[1].mLength > 0) {
+        memcpy(snapshot->mData + (iovec[0].mLength),
+                (const char *) mFifo->buffer() + iovec[1].mOffset, iovec[1].mLength);
+    }
+
+    const uint8_t *front = snapshot->mData;
+    findValidEntries(front, front + availToRead, &snapshot->mBegin, &snapshot->mEnd);
 
     // advance fifo reader index to after last entry read.
     if (flush) {
@@ -159,6 +172,59 @@ std::unique_ptr<Snapshot> Reader::getSnapshot(bool flush)
     return snapshot;
 }
 
+// Like getSnapshot(), but the data is copied into a buffer that is allocated once and then
+// reused. The writer does not wait for the reader, so the entries are parsed from the copy,
+// which is checked not to have been overwritten while it was made.
+Reader::View Reader::getView()
+{
+    View view;
+    mViewFront = nullptr;
+    if (mFifoReader == NULL) {
+        return view;
+    }
+
+    audio_utils_iovec iovec[2];
+    const ssize_t availToRead = obtain(iovec, &view.lost);
+    if (availToRead <= 0) {
+        return view;
+    }
+
+    if (mViewBuffer.size() < (size_t) availToRead) {
+        mViewBuffer.resize(mFifo->capacity());
+    }
+    memcpy(mViewBuffer.data(), (const uint8_t *) mFifo->buffer() + iovec[0].mOffset,
+            iovec[0].mLength);
+    if (iovec[1].mLength > 0) {
+        memcpy(mViewBuffer.data() + iovec[0].mLength,
+                (const uint8_t *) mFifo->buffer() + iovec[1].mOffset, iovec[1].mLength);
+    }
+
+    // If the writer overran the reader during the copy, the start of the copy may be torn.
+    // The FIFO reader has then skipped the overwritten data, and the rest is read again
+    // by the next call.
+    audio_utils_iovec overrun[2];
+    size_t lost = 0;
+    if (mFifoReader->obtain(overrun, mFifo->capacity(), NULL /*timeout*/, &lost) < 0) {
+        ALOGW("NBLog Reader %s overrun while copying", mName.c_str());
+        view.lost += lost;
+        return view;
+    }
+
+    const uint8_t *front = mViewBuffer.data();
+    findValidEntries(front, front + availToRead, &view.begin, &view.end);
+    mViewFront = front;
+    return view;
+}
+
+void Reader::releaseView(const EntryIterator &end)
+{
+    if (mViewFront == nullptr) {
+        return;
+    }
+    mFifoReader->release(end - EntryIterator(mViewFront));
+    mViewFront = nullptr;
+}
+
 bool Reader::isIMemory(const sp<IMemory>& iMemory) const
 {
     return iMemory != 0 && mIMemory != 0 &&
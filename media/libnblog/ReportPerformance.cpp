@@ -51,6 +51,10 @@ static std::unique_ptr<Json::Value> dumpToJson(const PerformanceData& data)
     root["workMsHist"] = data.workHist.toString();
     root["latencyMsHist"] = data.latencyHist.toString();
     root["warmupMsHist"] = data.warmupHist.toString();
+    root["workMsSketch"] = data.workSketch.toString();
+    root["wakeupMsSketch"] = data.wakeupSketch.toString();
+    root["workMsPercentiles"] = data.workSketch.percentilesString();
+    root["wakeupMsPercentiles"] = data.wakeupSketch.percentilesString();
     root["underruns"] = (Json::Value::Int64)data.underruns;
     root["overruns"] = (Json::Value::Int64)data.overruns;
     root["activeMs"] = (Json::Value::Int64)ns2ms(data.active);
@@ -69,6 +73,9 @@ static std::string dumpHistogramsToString(const PerformanceData& data)
     ss << "  Thread work times in ms:\n" << data.workHist.asciiArtString(4 /*indent*/);
     ss << "  Thread latencies in ms:\n" << data.latencyHist.asciiArtString(4 /*indent*/);
     ss << "  Thread warmup times in ms:\n" << data.warmupHist.asciiArtString(4 /*indent*/);
+    ss << "  Thread work time percentiles in ms: " << data.workSketch.percentilesString() << "\n";
+    ss << "  Thread wakeup interval percentiles in ms: "
+            << data.wakeupSketch.percentilesString() << "\n";
     return ss.str();
 }
 
@@ -103,6 +110,8 @@ void dumpPlots(int fd, const std::map<int, PerformanceData>& threadDataMap)
         return;
     }
 
+    // the sketches of all threads of a type are merged for a summary
+    std::map<NBLog::ThreadType, std::pair<QuantileSketch, QuantileSketch>> typeSketches;
     for (const auto &item : threadDataMap) {
         const ReportPerformance::PerformanceData& data = item.second;
         if (data.empty()) {
@@ -110,7 +119,21 @@ void dumpPlots(int fd, const std::map<int, PerformanceData>& threadDataMap)
         }
         std::string hists = ReportPerformance::dumpHistogramsToString(data);
         write(fd, hists.c_str(), hists.size());
+        auto &sketches = typeSketches[data.threadInfo.type];
+        sketches.first.merge(data.workSketch);
+        sketches.second.merge(data.wakeupSketch);
     }
+
+    std::stringstream ss;
+    for (const auto &item : typeSketches) {
+        ss << "==========================================\n";
+        ss << "All threads of type=" << NBLog::threadTypeToString(item.first) << "\n";
+        ss << "  Work time percentiles in ms: " << item.second.first.percentilesString() << "\n";
+        ss << "  Wakeup interval percentiles in ms: "
+                << item.second.second.percentilesString() << "\n";
+    }
+    const std::string summary = ss.str();
+    write(fd, summary.c_str(), summary.size());
 }
 
 static std::string dumpRetroString(const PerformanceData& data, int64_t now)
@@ -158,6 +181,12 @@ bool sendToMediaMetrics(const PerformanceData& data)
     static constexpr char kThreadWorkHist[] = "android.media.audiothread.workMs.hist";
     static constexpr char kThreadLatencyHist[] = "android.media.audiothread.latencyMs.hist";
     static constexpr char kThreadWarmupHist[] = "android.media.audiothread.warmupMs.hist";
+    static constexpr char kThreadWorkSketch[] = "android.media.audiothread.workMs.sketch";
+    static constexpr char kThreadWorkP99[] = "android.media.audiothread.workMs.p99";
+    static constexpr char kThreadWorkP999[] = "android.media.audiothread.workMs.p999";
+    static constexpr char kThreadWakeupSketch[] = "android.media.audiothread.wakeupMs.sketch";
+    static constexpr char kThreadWakeupP99[] = "android.media.audiothread.wakeupMs.p99";
+    static constexpr char kThreadWakeupP999[] = "android.media.audiothread.wakeupMs.p999";
     static constexpr char kThreadUnderruns[] = "android.media.audiothread.underruns";
     static constexpr char kThreadOverruns[] = "android.media.audiothread.overruns";
     static constexpr char kThreadActive[] = "android.media.audiothread.activeMs";
@@ -185,6 +214,21 @@ bool sendToMediaMetrics(const PerformanceData& data)
         item->setCString(kThreadWarmupHist, warmupHist.toString().c_str());
     }
 
+    // The sketches can be merged across devices, the percentiles are for quick queries.
+    const QuantileSketch &workSketch = data.workSketch;
+    if (workSketch.totalCount() > 0) {
+        item->setCString(kThreadWorkSketch, workSketch.toString().c_str());
+        item->setDouble(kThreadWorkP99, workSketch.quantile(0.99));
+        item->setDouble(kThreadWorkP999, workSketch.quantile(0.999));
+    }
+
+    const QuantileSketch &wakeupSketch = data.wakeupSketch;
+    if (wakeupSketch.totalCount() > 0) {
+        item->setCString(kThreadWakeupSketch, wakeupSketch.toString().c_str());
+        item->setDouble(kThreadWakeupP99, wakeupSketch.quantile(0.99));
+        item->setDouble(kThreadWakeupP999, wakeupSketch.quantile(0.999));
+    }
+
     if (data.underruns > 0) {
         item->setInt64(kThreadUnderruns, data.underruns);
     }
@@ -21,6 +21,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <type_traits>
+#include <vector>
 
 #include <media/nblog/Events.h>
 
@@ -159,6 +160,12 @@ public:
     virtual EntryIterator copyWithAuthor(std::unique_ptr<audio_utils_fifo_writer> &dst,
                                             int author) const = 0;
 
+    // same as copyWithAuthor, but appends to dst so that many entries can be
+    // written to a FIFO at once. The entry is not read past end, and nothing is
+    // appended if it is incomplete, in which case end is returned.
+    virtual EntryIterator appendWithAuthor(std::vector<uint8_t> *dst, int author,
+                                           const EntryIterator &end) const = 0;
+
 protected:
     // Entry starting in the given pointer, which shall not be nullptr.
     explicit AbstractEntry(const uint8_t *entry) : mEntry(entry) {}
@@ -209,6 +216,9 @@ public:
     // copy entry, adding author before timestamp, returns size of original entry
     EntryIterator copyWithAuthor(std::unique_ptr<audio_utils_fifo_writer> &dst,
                                  int author) const override;
+
+    EntryIterator appendWithAuthor(std::vector<uint8_t> *dst, int author,
+                                   const EntryIterator &end) const override;
 };
 
 class HistogramEntry : public AbstractEntry {
@@ -224,6 +234,9 @@ public:
 
     EntryIterator copyWithAuthor(std::unique_ptr<audio_utils_fifo_writer> &dst,
                                  int author) const override;
+
+    EntryIterator appendWithAuthor(std::vector<uint8_t> *dst, int author,
+                                   const EntryIterator &end) const override;
 };
 
 }   // namespace NBLog
@@ -17,6 +17,7 @@
 #ifndef ANDROID_MEDIA_NBLOG_MERGER_H
 #define ANDROID_MEDIA_NBLOG_MERGER_H
 
+#include <atomic>
 #include <memory>
 #include <stddef.h>
 #include <stdint.h>
@@ -34,6 +35,7 @@
 
 namespace android {
 
+class IMemory;
 class String16;
 class String8;
 
@@ -43,26 +45,102 @@ struct Shared;
 
 // TODO update comments to reflect current functionalities
 
+// Receives the entries of each author in the order in which they are merged.
+class MergeListener {
+public:
+    virtual ~MergeListener() = default;
+
+    // entries [begin, end) were written by the reader at index author
+    virtual void onEntries(const EntryIterator &begin, const EntryIterator &end, int author) = 0;
+};
+
 // This class is used to read data from each thread's individual FIFO in shared memory
 // and write it to a single FIFO in local memory.
 class Merger : public RefBase {
 public:
     Merger(const void *shared, size_t size);
 
-    ~Merger() override = default;
+    ~Merger() override;
+
+    using ReaderList = std::vector<sp<Reader>>;
+
+    // The reader list published when it was created, which stays valid for the lifetime
+    // of this object. Must not outlive the Merger.
+    class Readers {
+    public:
+        explicit Readers(const Merger &merger);
+        ~Readers();
+        Readers(const Readers &) = delete;
+        Readers &operator=(const Readers &) = delete;
 
+        const ReaderList &operator*() const { return *mList; }
+        const ReaderList *operator->() const { return mList; }
+
+    private:
+        const Merger &mMerger;
+        const ReaderList *mList;
+    };
+
+    // Readers can be added and removed while merge() runs, which keeps using the list it
+    // started with. The index of a reader is its author number, so removed readers leave
+    // a nullptr. A removed reader is released by the first of these calls that finds no
+    // Readers object holding a list with it.
     void addReader(const sp<NBLog::Reader> &reader);
-    // TODO add removeReader
-    void merge();
+    void removeReader(const sp<IMemory> &iMemory);
+
+    // Merge the entries of all readers, sorted by timestamp, into the local FIFO.
+    // Every entry that is consumed is also passed to the listener if there is one.
+    // Only kMaxMergeBytesPerReader bytes are consumed from each reader per call,
+    // the rest is merged by the next call.
+    void merge(MergeListener *listener = nullptr);
 
-    // FIXME This is returning a reference to a shared variable that needs a lock
-    const std::vector<sp<Reader>>& getReaders() const;
+    // Returns the current readers. The list is never modified after it is published,
+    // so it can be used without a lock for as long as the caller holds the result.
+    Readers getReaders() const;
+
+    static constexpr size_t kMaxMergeBytesPerReader = 16 * 1024;
 
 private:
-    // vector of the readers the merger is supposed to merge from.
+    // Next entry with a timestamp of one reader.
+    struct MergeHead {
+        int64_t ts;
+        int     index;
+    };
+
+    // Reading position in the view of one reader.
+    struct ReaderState {
+        Reader::View  view;
+        EntryIterator position;     // first entry not merged yet
+        EntryIterator head;         // first entry with a timestamp at or after position
+        int64_t       ts;           // timestamp of head
+        bool          hasHead;
+    };
+
+    void findHead(ReaderState &state);
+    static bool isBefore(const MergeHead &a, const MergeHead &b);
+    void siftDown(size_t i);
+    void pushHead(const MergeHead &head);
+    EntryIterator appendWithAuthor(const EntryIterator &it, int author, const EntryIterator &end);
+    void flushMerged();
+    void publishReaders(std::unique_ptr<const ReaderList> readers);
+
+    // list of the readers the merger is supposed to merge from.
     // every reader reads from a writer's buffer
-    // FIXME Needs to be protected by a lock
-    std::vector<sp<Reader>> mReaders;
+    // Replaced as a whole by publishReaders(), and read through a Readers object, which
+    // counts itself in mReadersUsers while it holds the list. Neither side takes a lock.
+    std::atomic<const ReaderList *> mReaders;
+    mutable std::atomic<int> mReadersUsers{0};
+    // Lists replaced by a new one, deleted once no Readers object can still hold them.
+    std::vector<std::unique_ptr<const ReaderList>> mRetiredReaders;
+    Mutex mReadersLock; // serializes addReader() and removeReader(), protects mRetiredReaders
+
+    // Only used by merge(), kept to avoid allocating on each merge.
+    std::vector<ReaderState> mStates;
+    std::vector<MergeHead> mHeap; // min-heap on timestamp
+    std::vector<uint8_t> mMerged; // merged entries not written to the FIFO yet
+
+    // Merged entries are written to the FIFO in blocks of about this size.
+    static constexpr size_t kMergedWriteSize = 4 * 1024;
 
     Shared * const mShared; // raw pointer to shared memory
     std::unique_ptr<audio_utils_fifo> mFifo; // FIFO itself
@@ -72,14 +150,22 @@ private:
 // This class has a pointer to the FIFO in local memory which stores the merged
 // data collected by NBLog::Merger from all Readers. It is used to process
 // this data and write the result to PerformanceAnalysis.
-class MergeReader : public Reader {
+class MergeReader : public Reader, public MergeListener {
 public:
     MergeReader(const void *shared, size_t size, Merger &merger);
 
     // process a particular snapshot of the reader
     void processSnapshot(Snapshot &snap, int author);
 
-    // call getSnapshot of the content of the reader's buffer and process the data
+    // process entries of a reader
+    void processEntries(const EntryIterator &begin, const EntryIterator &end, int author);
+
+    // MergeListener, processes the entries as they are merged
+    void onEntries(const EntryIterator &begin, const EntryIterator &end, int author) override {
+        processEntries(begin, end, author);
+    }
+
+    // process the content of each reader's buffer without merging it
     void getAndProcessSnapshot();
 
     // check for periodic push of performance data to media metrics, and perform
@@ -89,10 +175,8 @@ public:
     void dump(int fd, const Vector<String16>& args);
 
 private:
-    // FIXME Needs to be protected by a lock,
-    //       because even though our use of it is read-only there may be asynchronous updates
-    // The object is owned by the Merger class.
-    const std::vector<sp<Reader>>& mReaders;
+    // The merger owns the readers.
+    const Merger& mMerger;
 
     // analyzes, compresses and stores the merged data
     // contains a separate instance for every author (thread), and for every source file
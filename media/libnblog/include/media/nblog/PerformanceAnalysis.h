@@ -17,7 +17,9 @@
 #ifndef ANDROID_MEDIA_PERFORMANCEANALYSIS_H
 #define ANDROID_MEDIA_PERFORMANCEANALYSIS_H
 
+#include <array>
 #include <deque>
+#include <functional>
 #include <map>
 #include <string>
 #include <utility>
@@ -133,6 +135,83 @@ private:
     uint64_t mTotalCount = 0;       // Total number of values recorded
 };
 
+/*
+ * QuantileSketch keeps an approximate distribution of positive values in constant memory,
+ * so that percentiles such as p99 and p999 can be tracked for as long as a thread runs.
+ * Like HdrHistogram, values are counted in buckets that split each power of two into
+ * kSubBuckets linear buckets, so a percentile is reported within about 1.6% of its value.
+ * Unlike Histogram, no range has to be chosen for the data, and sketches with the same
+ * lowest value can be merged exactly, e.g. to combine threads.
+ *
+ * This class is not thread-safe.
+ */
+class QuantileSketch {
+public:
+    /**
+     * \brief Creates a QuantileSketch object.
+     *
+     * \param lowest the smallest value that is distinguished from 0, must be greater than 0.
+     *               Values up to lowest * 2^kOctaves are recorded with full precision,
+     *               larger values are counted in the last bucket.
+     *               The default is 1 microsecond when values are in milliseconds.
+     */
+    explicit QuantileSketch(double lowest = 0.001);
+
+    void add(double value);
+
+    void clear();
+
+    // Adds the data points of other, returns false if other has a different lowest value.
+    bool merge(const QuantileSketch &other);
+
+    uint64_t totalCount() const { return mTotalCount; }
+
+    // The following return 0 if totalCount() == 0.
+    double min() const { return mTotalCount > 0 ? mMin : 0.; }
+    double max() const { return mTotalCount > 0 ? mMax : 0.; }
+    double mean() const { return mTotalCount > 0 ? mSum / mTotalCount : 0.; }
+
+    // Returns the value below which a fraction q of the data points are, 0 <= q <= 1.
+    double quantile(double q) const;
+
+    // Calls f(value, count) for each bucket that is not empty, in increasing order.
+    // value is the middle of the bucket.
+    void forEachBucket(const std::function<void(double value, uint64_t count)> &f) const;
+
+    /**
+     * \brief Serializes the sketch into a string, similar to Histogram::toString():
+     *          version,lowest,subBuckets,{bucketIndex|count,...}
+     *
+     *        - bucketIndex 0 counts values less than lowest.
+     *        - bucketIndex i > 0 counts values in [lowest * 2^o * (1 + s / subBuckets),
+     *          lowest * 2^o * (1 + (s + 1) / subBuckets)) where o = (i - 1) / subBuckets
+     *          and s = (i - 1) % subBuckets.
+     *        - a bucketIndex is skipped if its count is 0.
+     */
+    std::string toString() const;
+
+    // Returns a summary such as "n=1000 p50=2.67 p90=2.71 p99=3.02 p999=5.12 max=6.00".
+    // Empty string is returned if totalCount() == 0.
+    std::string percentilesString() const;
+
+private:
+    static constexpr int kVersion = 1;
+    static constexpr int kSubBucketBits = 5;
+    static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+    static constexpr size_t kOctaves = 30;
+    static constexpr size_t kNumBuckets = kOctaves * kSubBuckets + 1;
+
+    size_t indexOf(double value) const;
+    double valueOf(size_t index) const;
+
+    double mLowest;
+    std::array<uint64_t, kNumBuckets> mCounts{};
+    uint64_t mTotalCount = 0;
+    double mSum = 0.;
+    double mMin = 0.;
+    double mMax = 0.;
+};
+
 // This is essentially the same as class PerformanceAnalysis, but PerformanceAnalysis
 // also does some additional analyzing of data, while the purpose of this struct is
 // to hold data.
@@ -159,6 +238,8 @@ struct PerformanceData {
     Histogram workHist{kWorkConfig};
     Histogram latencyHist{kLatencyConfig};
     Histogram warmupHist{kWarmupConfig};
+    QuantileSketch workSketch;      // work times in ms
+    QuantileSketch wakeupSketch;    // time between wakeups in ms
     int64_t underruns = 0;
     static constexpr size_t kMaxSnapshotsToStore = 256;
     std::deque<std::pair<NBLog::Event, int64_t /*timestamp*/>> snapshots;
@@ -173,6 +254,8 @@ struct PerformanceData {
         workHist.clear();
         latencyHist.clear();
         warmupHist.clear();
+        workSketch.clear();
+        wakeupSketch.clear();
         underruns = 0;
         overruns = 0;
         active = 0;
@@ -182,7 +265,8 @@ struct PerformanceData {
     // Return true if performance data has not been recorded yet, false otherwise.
     bool empty() const {
         return workHist.totalCount() == 0 && latencyHist.totalCount() == 0
-                && warmupHist.totalCount() == 0 && underruns == 0 && overruns == 0
+                && warmupHist.totalCount() == 0 && wakeupSketch.totalCount() == 0
+                && underruns == 0 && overruns == 0
                 && active == 0;
     }
 };
@@ -211,8 +295,9 @@ public:
     // Used to discard idle time intervals
     void handleStateChange();
 
-    // Writes wakeup timestamp entry to log and runs analysis
-    void logTsEntry(timestamp ts);
+    // Writes wakeup timestamp entry to log and runs analysis.
+    // Returns the time since the previous wakeup in ms, or -1 after a state change.
+    msInterval logTsEntry(timestamp ts);
 
     // FIXME: make peakdetector and storeOutlierData a single function
     // Input: mOutlierData. Looks at time elapsed between outliers
@@ -241,8 +326,9 @@ private:
     // a peak is a moment at which the average outlier interval changed significantly
     std::deque<timestamp> mPeakTimestamps;
 
-    // stores buffer period histograms with timestamp of first sample
-    std::deque<std::pair<timestamp, Hist>> mHists;
+    // distribution of buffer periods in ms, and timestamp of first sample
+    QuantileSketch mBufferPeriods;
+    timestamp mBufferPeriodsStartTs = -1;
 
     // Parameters used when detecting outliers
     struct BufferPeriod {
@@ -254,15 +340,12 @@ private:
 
     // capacity allocated to data structures
     struct MaxLength {
-        size_t Hists; // number of histograms stored in memory
         size_t Outliers; // number of values stored in outlier array
         size_t Peaks; // number of values stored in peak array
-        int HistTimespanMs; // maximum histogram timespan
     };
     // These values allow for 10 hours of data allowing for a glitch and a peak
     // as often as every 3 seconds
-    static constexpr MaxLength kMaxLength = {.Hists = 60, .Outliers = 12000,
-            .Peaks = 12000, .HistTimespanMs = 10 * kSecPerMin * kMsPerSec };
+    static constexpr MaxLength kMaxLength = {.Outliers = 12000, .Peaks = 12000 };
 
     // these variables ensure continuity while analyzing the timestamp
     // series one sample at a time.
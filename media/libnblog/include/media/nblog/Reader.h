@@ -21,6 +21,7 @@
 #include <stddef.h>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <media/nblog/Entry.h>
 #include <media/nblog/Events.h>
@@ -28,6 +29,7 @@
 
 class audio_utils_fifo;
 class audio_utils_fifo_reader;
+struct audio_utils_iovec;
 
 namespace android {
 
@@ -52,6 +54,22 @@ public:
 
     // get snapshot of readers fifo buffer, effectively consuming the buffer
     std::unique_ptr<Snapshot> getSnapshot(bool flush = true);
+
+    // Entries of the FIFO that can be processed without allocating a Snapshot.
+    struct View {
+        EntryIterator begin;
+        EntryIterator end;
+        size_t        lost = 0;     // amount of data lost (given by audio_utils_fifo_reader)
+    };
+
+    // Get the valid entries of the FIFO without consuming them.
+    // The entries are copied into a buffer owned by the reader, which is reused.
+    // The view is valid until releaseView() or the next getView().
+    View getView();
+
+    // Consume the entries of the last view up to end, which must be in [view.begin, view.end].
+    // Entries after end are returned again by the next getView().
+    void releaseView(const EntryIterator &end);
     bool     isIMemory(const sp<IMemory>& iMemory) const;
     const std::string &name() const { return mName; }
 
@@ -74,6 +92,18 @@ private:
     audio_utils_fifo_reader * const mFifoReader;    // used to read from FIFO,
                                                     // non-NULL unless constructor fails
 
+    // Start of the data returned by the last getView(), nullptr if there is none.
+    const uint8_t *mViewFront = nullptr;
+    // Holds the data of the last view.
+    std::vector<uint8_t> mViewBuffer;
+
+    // Obtain the readable data of the FIFO, returns the number of bytes available.
+    ssize_t obtain(audio_utils_iovec *iovec, size_t *lost);
+
+    // Find the range [begin, end) of complete entries in [front, back).
+    static void findValidEntries(const uint8_t *front, const uint8_t *back,
+                                 EntryIterator *begin, EntryIterator *end);
+
     // Searches for the last valid entry in the range [front, back)
     // back has to be entry-aligned. Returns nullptr if none enconuntered.
     static const uint8_t *findLastValidEntry(const uint8_t *front, const uint8_t *back,
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of the MediaLogService merge thread for 1 to 64 writers.
+
+#include <memory>
+#include <new>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <audio_utils/fifo.h>
+#include <benchmark/benchmark.h>
+#include <media/nblog/Merger.h>
+#include <media/nblog/Reader.h>
+#include <media/nblog/Timeline.h>
+#include <media/nblog/Writer.h>
+
+using namespace android;
+
+static constexpr size_t kWriterSize = 16 * 1024;   // like a normal audio thread
+static constexpr size_t kMergeSize = 64 * 1024;    // like MediaLogService
+static constexpr int kEntriesPerWriter = 128;      // per merge
+static constexpr int kEntriesPerBurst = 4;
+
+// Log memory shared by one writer and one reader.
+class SharedLog {
+public:
+    SharedLog(size_t size, const std::string &name)
+        : mMemory(new uint8_t[NBLog::Timeline::sharedSize(size)]),
+          mShared(new (mMemory.get()) NBLog::Shared()),
+          mWriter(new NBLog::Writer(mShared, size)),
+          mReader(new NBLog::Reader(mShared, size, name)) {}
+
+    const sp<NBLog::Writer> &writer() const { return mWriter; }
+    const sp<NBLog::Reader> &reader() const { return mReader; }
+
+private:
+    std::unique_ptr<uint8_t[]> mMemory;
+    NBLog::Shared * const mShared;
+    const sp<NBLog::Writer> mWriter;
+    const sp<NBLog::Reader> mReader;
+};
+
+class MergeFixture {
+public:
+    explicit MergeFixture(int numWriters)
+        : mMergeMemory(new uint8_t[NBLog::Timeline::sharedSize(kMergeSize)]),
+          mMergeShared(new (mMergeMemory.get()) NBLog::Shared()),
+          mMerger(mMergeShared, kMergeSize),
+          mMergeReader(mMergeShared, kMergeSize, mMerger) {
+        for (int i = 0; i < numWriters; i++) {
+            mLogs.emplace_back(new SharedLog(kWriterSize, "writer" + std::to_string(i)));
+            mMerger.addReader(mLogs.back()->reader());
+        }
+    }
+
+    // The writers take turns so that their timestamps interleave, like concurrent threads.
+    // Each turn is a burst of entries, like one loop of an audio thread.
+    void writeEntries() {
+        for (int i = 0; i < kEntriesPerWriter; i += kEntriesPerBurst) {
+            for (const auto &log : mLogs) {
+                const sp<NBLog::Writer> &writer = log->writer();
+                writer->logFormat("frames %d", 0x1234 /* hash */, i);
+                for (int j = 1; j < kEntriesPerBurst; j++) {
+                    writer->logEventHistTs(NBLog::EVENT_HISTOGRAM_ENTRY_TS, 0x5678 /* hash */);
+                }
+                writer->log<NBLog::EVENT_WORK_TIME>(1000000 /* ns */);
+            }
+        }
+    }
+
+    NBLog::Merger &merger() { return mMerger; }
+    NBLog::MergeReader &mergeReader() { return mMergeReader; }
+    const std::vector<std::unique_ptr<SharedLog>> &logs() const { return mLogs; }
+
+private:
+    std::unique_ptr<uint8_t[]> mMergeMemory;
+    NBLog::Shared * const mMergeShared;
+    NBLog::Merger mMerger;
+    NBLog::MergeReader mMergeReader;
+    std::vector<std::unique_ptr<SharedLog>> mLogs;
+};
+
+// Merge in timestamp order, processing the entries as they are merged.
+static void BM_Merge(benchmark::State& state) {
+    MergeFixture fixture(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        fixture.writeEntries();
+        state.ResumeTiming();
+        fixture.merger().merge(&fixture.mergeReader());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * kEntriesPerWriter);
+}
+
+BENCHMARK(BM_Merge)->RangeMultiplier(2)->Range(1, 64);
+
+// The previous merge: copy each log into a Snapshot, then merge the snapshots with a
+// priority queue, building an AbstractEntry for every entry.
+static void BM_MergeSnapshots(benchmark::State& state) {
+    struct MergeItem {
+        int64_t ts;
+        int index;
+        bool operator>(const MergeItem &other) const {
+            return ts > other.ts || (ts == other.ts && index > other.index);
+        }
+    };
+    MergeFixture fixture(state.range(0));
+    std::unique_ptr<uint8_t[]> memory(new uint8_t[NBLog::Timeline::sharedSize(kMergeSize)]);
+    NBLog::Shared *shared = new (memory.get()) NBLog::Shared();
+    audio_utils_fifo fifo(kMergeSize, sizeof(uint8_t), shared->mBuffer, shared->mRear,
+            NULL /*throttlesFront*/);
+    std::unique_ptr<audio_utils_fifo_writer> fifoWriter(new audio_utils_fifo_writer(fifo));
+    for (auto _ : state) {
+        state.PauseTiming();
+        fixture.writeEntries();
+        state.ResumeTiming();
+        const auto &logs = fixture.logs();
+        const int nLogs = logs.size();
+        std::vector<std::unique_ptr<NBLog::Snapshot>> snapshots(nLogs);
+        std::vector<NBLog::EntryIterator> offsets(nLogs);
+        std::priority_queue<MergeItem, std::vector<MergeItem>, std::greater<MergeItem>> timestamps;
+        auto pushNext = [&](int i) {
+            // skip the entries that cannot be merged
+            while (offsets[i] != snapshots[i]->end()) {
+                std::unique_ptr<NBLog::AbstractEntry> entry =
+                        NBLog::AbstractEntry::buildEntry(offsets[i]);
+                if (entry != nullptr) {
+                    timestamps.push({entry->timestamp(), i});
+                    return;
+                }
+                ++offsets[i];
+            }
+        };
+        for (int i = 0; i < nLogs; i++) {
+            snapshots[i] = logs[i]->reader()->getSnapshot();
+            fixture.mergeReader().processSnapshot(*snapshots[i], i);
+            offsets[i] = snapshots[i]->begin();
+            pushNext(i);
+        }
+        while (!timestamps.empty()) {
+            const int index = timestamps.top().index;
+            timestamps.pop();
+            offsets[index] = NBLog::AbstractEntry::buildEntry(offsets[index])
+                    ->copyWithAuthor(fifoWriter, index);
+            pushNext(index);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * kEntriesPerWriter);
+}
+
+BENCHMARK(BM_MergeSnapshots)->RangeMultiplier(2)->Range(1, 64);
+
+BENCHMARK_MAIN();
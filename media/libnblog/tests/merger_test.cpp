@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <binder/IMemory.h>
+#include <binder/MemoryDealer.h>
+#include <gtest/gtest.h>
+#include <media/nblog/Entry.h>
+#include <media/nblog/Events.h>
+#include <media/nblog/Merger.h>
+#include <media/nblog/Reader.h>
+#include <media/nblog/Timeline.h>
+#include <media/nblog/Writer.h>
+
+using namespace android;
+
+static constexpr size_t kMergeSize = 64 * 1024;    // like MediaLogService
+
+// Log memory shared by one writer and one reader, allocated like AudioFlinger::newWriter_l().
+class SharedLog {
+public:
+    SharedLog(const sp<MemoryDealer> &dealer, size_t size, const std::string &name)
+        : mMemory(dealer->allocate(NBLog::Timeline::sharedSize(size))) {
+        new (mMemory->unsecurePointer()) NBLog::Shared();
+        mWriter = new NBLog::Writer(mMemory, size);
+        mReader = new NBLog::Reader(mMemory, size, name);
+    }
+
+    const sp<IMemory> &memory() const { return mMemory; }
+    const sp<NBLog::Writer> &writer() const { return mWriter; }
+    const sp<NBLog::Reader> &reader() const { return mReader; }
+
+private:
+    const sp<IMemory> mMemory;
+    sp<NBLog::Writer> mWriter;
+    sp<NBLog::Reader> mReader;
+};
+
+// A timestamped entry read back from the merge FIFO.
+struct MergedEntry {
+    int64_t ts;
+    int author;
+    log_hash_t hash;
+};
+
+class MergerTest : public ::testing::Test {
+protected:
+    MergerTest()
+        : mDealer(new MemoryDealer(2 * 1024 * 1024, "MergerTest")),
+          mMergeMemory(new uint8_t[NBLog::Timeline::sharedSize(kMergeSize)]),
+          mMergeShared(new (mMergeMemory.get()) NBLog::Shared()),
+          mMerger(new NBLog::Merger(mMergeShared, kMergeSize)),
+          mMergedReader(new NBLog::Reader(mMergeShared, kMergeSize, "merged")) {}
+
+    // Adds a log whose writer tags its entries with hash.
+    SharedLog &addLog(size_t size) {
+        mLogs.emplace_back(new SharedLog(mDealer, size, "writer" + std::to_string(mLogs.size())));
+        mMerger->addReader(mLogs.back()->reader());
+        return *mLogs.back();
+    }
+
+    // One formatted entry and one histogram entry, both with the given hash.
+    static void writeEntries(const sp<NBLog::Writer> &writer, log_hash_t hash, int value) {
+        writer->logFormat("value %d", hash, value);
+        writer->logEventHistTs(NBLog::EVENT_HISTOGRAM_ENTRY_TS, hash);
+    }
+
+    // Returns the timestamped entries merged since the last call.
+    std::vector<MergedEntry> readMerged() {
+        std::vector<MergedEntry> entries;
+        std::unique_ptr<NBLog::Snapshot> snapshot = mMergedReader->getSnapshot();
+        for (NBLog::EntryIterator it = snapshot->begin(); it != snapshot->end(); ++it) {
+            switch (it->type) {
+            case NBLog::EVENT_FMT_START: {
+                NBLog::FormatEntry entry(it);
+                entries.push_back({entry.timestamp(), entry.author(), entry.hash()});
+                } break;
+            case NBLog::EVENT_HISTOGRAM_ENTRY_TS: {
+                NBLog::HistogramEntry entry(it);
+                entries.push_back({entry.timestamp(), entry.author(), entry.hash()});
+                } break;
+            default:
+                break;
+            }
+        }
+        return entries;
+    }
+
+    static void expectTimestampOrder(const std::vector<MergedEntry> &entries) {
+        for (size_t i = 1; i < entries.size(); i++) {
+            ASSERT_LE(entries[i - 1].ts, entries[i].ts) << "entry " << i;
+        }
+    }
+
+    const sp<MemoryDealer> mDealer;
+    std::unique_ptr<uint8_t[]> mMergeMemory;
+    NBLog::Shared * const mMergeShared;
+    const sp<NBLog::Merger> mMerger;
+    const sp<NBLog::Reader> mMergedReader;
+    std::vector<std::unique_ptr<SharedLog>> mLogs;
+};
+
+TEST_F(MergerTest, TimestampOrderAcrossReaders) {
+    constexpr int kLogs = 4;
+    constexpr int kRounds = 16;
+    for (int i = 0; i < kLogs; i++) {
+        addLog(16 * 1024);
+    }
+    // uneven bursts, so that a reader is ahead of the others in some rounds
+    for (int round = 0; round < kRounds; round++) {
+        for (int i = 0; i < kLogs; i++) {
+            for (int burst = 0; burst <= (round + i) % 3; burst++) {
+                writeEntries(mLogs[i]->writer(), i, round);
+            }
+        }
+    }
+    mMerger->merge();
+
+    const std::vector<MergedEntry> entries = readMerged();
+    size_t expected = 0;
+    for (int round = 0; round < kRounds; round++) {
+        for (int i = 0; i < kLogs; i++) {
+            expected += 2 * ((round + i) % 3 + 1);
+        }
+    }
+    EXPECT_EQ(expected, entries.size());
+    expectTimestampOrder(entries);
+}
+
+TEST_F(MergerTest, AuthorTagging) {
+    for (int i = 0; i < 3; i++) {
+        addLog(16 * 1024);
+    }
+    // a removed reader keeps its index, so the next one is author 3
+    mMerger->removeReader(mLogs[1]->memory());
+    addLog(16 * 1024);
+    for (size_t i = 0; i < mLogs.size(); i++) {
+        writeEntries(mLogs[i]->writer(), i, 0);
+    }
+    mMerger->merge();
+
+    const std::vector<MergedEntry> entries = readMerged();
+    ASSERT_EQ(6u, entries.size());
+    for (const MergedEntry &entry : entries) {
+        EXPECT_NE(1u, entry.hash);
+        EXPECT_EQ(entry.hash, (log_hash_t) entry.author);
+    }
+}
+
+TEST_F(MergerTest, FifoWrap) {
+    // small FIFOs which wrap several times, the merge FIFO being read after each merge
+    constexpr size_t kLogSize = 1024;
+    constexpr int kLogs = 2;
+    for (int i = 0; i < kLogs; i++) {
+        addLog(kLogSize);
+    }
+    int64_t lastTs = 0;
+    for (int round = 0; round < 64; round++) {
+        // each round writes about half of a log FIFO
+        for (int entry = 0; entry < 8; entry++) {
+            for (int i = 0; i < kLogs; i++) {
+                writeEntries(mLogs[i]->writer(), i, round * 8 + entry);
+            }
+        }
+        mMerger->merge();
+        const std::vector<MergedEntry> entries = readMerged();
+        ASSERT_EQ(2u * 8 * kLogs, entries.size()) << "round " << round;
+        expectTimestampOrder(entries);
+        ASSERT_LE(lastTs, entries.front().ts) << "round " << round;
+        lastTs = entries.back().ts;
+        for (const MergedEntry &entry : entries) {
+            ASSERT_EQ(entry.hash, (log_hash_t) entry.author);
+        }
+    }
+}
+
+TEST_F(MergerTest, IncompleteEntryNotAppended) {
+    SharedLog &log = addLog(16 * 1024);
+    writeEntries(log.writer(), 0, 0);
+    std::unique_ptr<NBLog::Snapshot> snapshot = log.reader()->getSnapshot();
+    const NBLog::EntryIterator format = snapshot->begin();
+    ASSERT_EQ(NBLog::EVENT_FMT_START, format->type);
+    NBLog::EntryIterator histogram = format;
+    while (histogram->type != NBLog::EVENT_HISTOGRAM_ENTRY_TS) {
+        ++histogram;
+    }
+    const uint8_t *end = snapshot->end();
+
+    // the view ends within the format entry, or before the end of the histogram entry
+    std::vector<uint8_t> merged;
+    const NBLog::EntryIterator formatEnd = format.next();
+    const uint8_t *next = NBLog::FormatEntry(format).appendWithAuthor(&merged, 1, formatEnd);
+    EXPECT_EQ((const uint8_t *) formatEnd, next);
+    const NBLog::EntryIterator truncated(end - 1);
+    next = NBLog::HistogramEntry(histogram).appendWithAuthor(&merged, 1, truncated);
+    EXPECT_EQ(end - 1, next);
+    EXPECT_TRUE(merged.empty());
+
+    next = NBLog::FormatEntry(format).appendWithAuthor(&merged, 1, snapshot->end());
+    EXPECT_EQ((const uint8_t *) histogram, next);
+    next = NBLog::HistogramEntry(histogram).appendWithAuthor(&merged, 1, snapshot->end());
+    EXPECT_EQ(end, next);
+    EXPECT_FALSE(merged.empty());
+}
+
+TEST_F(MergerTest, RemoveReaderDuringMerge) {
+    addLog(16 * 1024);
+    std::atomic<bool> done{false};
+    std::thread mergeThread([this, &done] {
+        while (!done) {
+            mMerger->merge();
+        }
+    });
+    // readers come and go while the other thread merges, the first one stays
+    for (int round = 0; round < 200; round++) {
+        SharedLog &log = addLog(4 * 1024);
+        writeEntries(log.writer(), mLogs.size() - 1, round);
+        writeEntries(mLogs[0]->writer(), 0, round);
+        mMerger->removeReader(log.memory());
+    }
+    done = true;
+    mergeThread.join();
+    mMerger->merge();
+
+    const std::vector<MergedEntry> entries = readMerged();
+    size_t firstAuthorEntries = 0;
+    for (const MergedEntry &entry : entries) {
+        ASSERT_EQ(entry.hash, (log_hash_t) entry.author);
+        firstAuthorEntries += entry.author == 0;
+    }
+    EXPECT_EQ(2u * 200, firstAuthorEntries);
+    EXPECT_EQ(201u, mMerger->getReaders()->size());
+}
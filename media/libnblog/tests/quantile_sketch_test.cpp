@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <media/nblog/PerformanceAnalysis.h>
+
+using android::ReportPerformance::QuantileSketch;
+
+static constexpr size_t kSubBuckets = 32;
+static constexpr size_t kOctaves = 30;
+static constexpr size_t kLastBucket = kOctaves * kSubBuckets;
+
+// Returns the bucket index of a single value, as serialized by toString().
+static size_t bucketOf(double lowest, double value) {
+    QuantileSketch sketch(lowest);
+    sketch.add(value);
+    const std::string s = sketch.toString();
+    const size_t begin = s.find('{') + 1;
+    return std::stoul(s.substr(begin, s.find('|') - begin));
+}
+
+// Log-uniform values between 10 us and 1 s, in ms.
+static std::vector<double> makeValues(size_t count, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> exponent(-2., 3.);
+    std::vector<double> values(count);
+    for (double &value : values) {
+        value = pow(10., exponent(generator));
+    }
+    return values;
+}
+
+TEST(QuantileSketchTest, BucketBoundaries) {
+    // lowest = 1 keeps the boundaries exact
+    EXPECT_EQ(0u, bucketOf(1., 0.));
+    EXPECT_EQ(0u, bucketOf(1., -1.));
+    EXPECT_EQ(0u, bucketOf(1., std::nan("")));
+    EXPECT_EQ(0u, bucketOf(1., std::nextafter(1., 0.)));
+    EXPECT_EQ(1u, bucketOf(1., 1.));
+    EXPECT_EQ(1u, bucketOf(1., std::nextafter(1. + 1. / kSubBuckets, 0.)));
+    EXPECT_EQ(2u, bucketOf(1., 1. + 1. / kSubBuckets));
+    EXPECT_EQ(kSubBuckets, bucketOf(1., std::nextafter(2., 0.)));
+    EXPECT_EQ(kSubBuckets + 1, bucketOf(1., 2.));
+    EXPECT_EQ(2 * kSubBuckets + 1, bucketOf(1., 4.));
+
+    // the last bucket of the range also counts larger values
+    const double max = ldexp(1., kOctaves);
+    EXPECT_EQ(kLastBucket, bucketOf(1., std::nextafter(max, 0.)));
+    EXPECT_EQ(kLastBucket - 1, bucketOf(1., ldexp(2. - 1.5 / kSubBuckets, kOctaves - 1)));
+    EXPECT_EQ(kLastBucket, bucketOf(1., max));
+    EXPECT_EQ(kLastBucket, bucketOf(1., std::numeric_limits<double>::max()));
+
+    // the default lowest value is 1 us in ms
+    EXPECT_EQ(0u, bucketOf(0.001, 0.0005));
+    EXPECT_EQ(1u, bucketOf(0.001, 0.001));
+    EXPECT_EQ(kSubBuckets + 1, bucketOf(0.001, 0.002));
+}
+
+TEST(QuantileSketchTest, QuantileErrorBound) {
+    std::vector<double> values = makeValues(100000, 1);
+    QuantileSketch sketch;
+    for (double value : values) {
+        sketch.add(value);
+    }
+    std::sort(values.begin(), values.end());
+
+    ASSERT_EQ(values.size(), sketch.totalCount());
+    EXPECT_EQ(values.front(), sketch.min());
+    EXPECT_EQ(values.back(), sketch.max());
+    // the result is clamped to the exact min and max
+    EXPECT_LE(values.front(), sketch.quantile(0.));
+    EXPECT_GE(values.back(), sketch.quantile(1.));
+
+    // the middle of a bucket is within half a sub-bucket of any value in it
+    for (double q : {0., 0.001, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999, 0.9999, 1.}) {
+        const size_t rank = std::max((size_t) 1, (size_t) ceil(q * values.size()));
+        const double expected = values[rank - 1];
+        EXPECT_NEAR(expected, sketch.quantile(q), expected / (2 * kSubBuckets) * 1.000001)
+                << "q=" << q;
+    }
+}
+
+TEST(QuantileSketchTest, Rank) {
+    // one value per octave, so each rank is in its own bucket
+    QuantileSketch sketch(1.);
+    for (double value : {8., 1., 4., 2.}) {
+        sketch.add(value);
+    }
+    const double middle = 1. + 0.5 / kSubBuckets;
+    EXPECT_EQ(1. * middle, sketch.quantile(0.));
+    EXPECT_EQ(1. * middle, sketch.quantile(0.25));
+    EXPECT_EQ(2. * middle, sketch.quantile(0.26));
+    EXPECT_EQ(2. * middle, sketch.quantile(0.5));
+    EXPECT_EQ(4. * middle, sketch.quantile(0.75));
+    EXPECT_EQ(8., sketch.quantile(0.9));
+    EXPECT_EQ(8., sketch.quantile(1.));
+}
+
+TEST(QuantileSketchTest, Empty) {
+    QuantileSketch sketch;
+    EXPECT_EQ(0u, sketch.totalCount());
+    EXPECT_EQ(0., sketch.quantile(0.5));
+    EXPECT_EQ(0., sketch.min());
+    EXPECT_EQ(0., sketch.max());
+    EXPECT_EQ("", sketch.percentilesString());
+}
+
+TEST(QuantileSketchTest, Merge) {
+    const std::vector<double> low = makeValues(5000, 2);
+    std::vector<double> high = makeValues(3000, 3);
+    for (double &value : high) {
+        value *= 1000.;
+    }
+
+    QuantileSketch all, first, second;
+    for (double value : low) {
+        all.add(value);
+        first.add(value);
+    }
+    for (double value : high) {
+        all.add(value);
+        second.add(value);
+    }
+
+    QuantileSketch merged;
+    ASSERT_TRUE(merged.merge(first));     // into an empty sketch
+    ASSERT_TRUE(merged.merge(second));
+    ASSERT_TRUE(merged.merge(QuantileSketch()));
+
+    EXPECT_EQ(all.toString(), merged.toString());
+    EXPECT_EQ(all.totalCount(), merged.totalCount());
+    EXPECT_EQ(all.min(), merged.min());
+    EXPECT_EQ(all.max(), merged.max());
+    EXPECT_DOUBLE_EQ(all.mean(), merged.mean());
+    for (double q : {0., 0.5, 0.9, 0.99, 1.}) {
+        EXPECT_EQ(all.quantile(q), merged.quantile(q)) << "q=" << q;
+    }
+
+    // sketches with a different lowest value have different buckets
+    const std::string before = merged.toString();
+    EXPECT_FALSE(merged.merge(QuantileSketch(1.)));
+    EXPECT_EQ(before, merged.toString());
+}
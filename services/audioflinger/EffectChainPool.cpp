@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EffectChainPool"
+//#define LOG_NDEBUG 0
+
+#include <chrono>
+#include <string.h>
+
+#include <audio_utils/primitives.h>
+#include <pthread.h>
+#include <utils/AndroidThreads.h>
+#include <utils/Log.h>
+
+#include "EffectChainPool.h"
+
+namespace android {
+
+EffectChainPool::EffectChainPool(size_t numWorkers, int priority, const std::string& name)
+{
+    mWorkers.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; ++i) {
+        const std::string workerName = name + "_" + std::to_string(i);
+        mWorkers.emplace_back(&EffectChainPool::threadLoop, this, priority, workerName);
+    }
+}
+
+EffectChainPool::~EffectChainPool()
+{
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mExit = true;
+    }
+    mWorkCondition.notify_all();
+    for (std::thread& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+bool EffectChainPool::run(size_t count, const std::function<void(size_t)>& task, int64_t timeoutNs)
+{
+    if (count == 0) {
+        return true;
+    }
+    ++mRuns;
+    if (mWorkers.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            task(i);
+        }
+        return true;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeoutNs);
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        mTask = &task;
+        mCount = count;
+        mNext.store(0, std::memory_order_relaxed);
+        mRemaining.store(count, std::memory_order_relaxed);
+        ++mGeneration;
+    }
+    // Wake no more workers than there are tasks left once the caller takes its share.
+    if (count - 1 >= mWorkers.size()) {
+        mWorkCondition.notify_all();
+    } else {
+        for (size_t i = 0; i < count - 1; ++i) {
+            mWorkCondition.notify_one();
+        }
+    }
+
+    runTasks(task, count);
+
+    std::unique_lock<std::mutex> l(mLock);
+    // Workers must also have left the job, so that none can claim a task of the next one
+    // with a stale task pointer.
+    const auto done = [this] {
+        return mRemaining.load(std::memory_order_acquire) == 0 && mActiveWorkers == 0;
+    };
+    const bool inTime = mDoneCondition.wait_until(l, deadline, done);
+    if (!inTime) {
+        ++mDeadlineMisses;
+        mDoneCondition.wait(l, done);
+    }
+    mTask = nullptr;
+    mCount = 0;
+    return inTime;
+}
+
+void EffectChainPool::runTasks(const std::function<void(size_t)>& task, size_t count)
+{
+    size_t completed = 0;
+    for (size_t i; (i = mNext.fetch_add(1, std::memory_order_relaxed)) < count; ) {
+        task(i);
+        ++completed;
+    }
+    if (completed > 0
+            && mRemaining.fetch_sub(completed, std::memory_order_acq_rel) == completed) {
+        // Take the lock so the notification cannot be lost between the waiter's predicate
+        // check and its wait.
+        std::lock_guard<std::mutex> _l(mLock);
+        mDoneCondition.notify_one();
+    }
+}
+
+void EffectChainPool::threadLoop(int priority, const std::string& name)
+{
+    // Thread names are limited to 16 characters including the terminator.
+    (void)pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    const int err = androidSetThreadPriority(0 /* tid */, priority);
+    ALOGW_IF(err != 0, "%s: failed to set priority %d for %s: %d",
+            __func__, priority, name.c_str(), err);
+
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> l(mLock);
+    while (true) {
+        mWorkCondition.wait(l, [&] { return mExit || mGeneration != generation; });
+        if (mExit) {
+            break;
+        }
+        generation = mGeneration;
+        if (mTask == nullptr) {
+            continue; // woke up after the job was joined
+        }
+        const std::function<void(size_t)>* task = mTask;
+        const size_t count = mCount;
+        ++mActiveWorkers;
+        l.unlock();
+
+        runTasks(*task, count);
+
+        l.lock();
+        if (--mActiveWorkers == 0) {
+            mDoneCondition.notify_one();
+        }
+    }
+}
+
+// static
+void EffectChainPool::accumulateStagedOutput(float* target, float* staged, size_t numSamples)
+{
+    accumulate_float(target, staged, numSamples);
+    memset(staged, 0, numSamples * sizeof(*staged));
+}
+
+// static
+void EffectChainPool::accumulateStagedOutput(int16_t* target, int16_t* staged, size_t numSamples)
+{
+    accumulate_i16(target, staged, numSamples);
+    memset(staged, 0, numSamples * sizeof(*staged));
+}
+
+} // namespace android
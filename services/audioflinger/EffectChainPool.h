@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_EFFECT_CHAIN_POOL_H
+#define ANDROID_AUDIO_EFFECT_CHAIN_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+// EffectChainPool runs independent tasks, typically the effect chains of the audio sessions
+// attached to a playback thread, on a small pool of worker threads.
+//
+// run() is called by a single owner thread, which also executes tasks while the workers do,
+// and returns only when all tasks have completed. Tasks are claimed in index order, so the
+// caller should order them by decreasing cost to minimize the time spent joining.
+class EffectChainPool {
+public:
+    // Creates numWorkers threads running at the given Android priority.
+    EffectChainPool(size_t numWorkers, int priority, const std::string& name);
+    ~EffectChainPool();
+
+    size_t numWorkers() const { return mWorkers.size(); }
+
+    // Executes task(0) .. task(count - 1) and waits for their completion.
+    // Returns false if the tasks did not all complete within timeoutNs after the call.
+    // Tasks still running when the timeout expires are waited for as their outputs are needed,
+    // the return value lets the caller account for the miss and degrade to serial processing.
+    bool run(size_t count, const std::function<void(size_t)>& task, int64_t timeoutNs);
+
+    uint64_t runs() const { return mRuns; }
+    uint64_t deadlineMisses() const { return mDeadlineMisses; }
+
+    // When chains run in parallel, the last effect of each chain accumulates into a private
+    // staging buffer instead of the shared buffer. Once all chains are done, the owner thread
+    // adds each staged output to the shared buffer in chain order, so the sum is the same as
+    // serial processing, and clears the staging buffer for the next period.
+    static void accumulateStagedOutput(float* target, float* staged, size_t numSamples);
+    static void accumulateStagedOutput(int16_t* target, int16_t* staged, size_t numSamples);
+
+private:
+    void threadLoop(int priority, const std::string& name);
+    void runTasks(const std::function<void(size_t)>& task, size_t count);
+
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mLock;
+    std::condition_variable mWorkCondition; // signaled when a new job or exit is posted
+    std::condition_variable mDoneCondition; // signaled when the last task or worker completes
+    // Job posted by run(), guarded by mLock. Workers copy it when they join the job.
+    const std::function<void(size_t)>* mTask = nullptr;
+    size_t mCount = 0;
+    uint64_t mGeneration = 0;               // incremented for each job
+    size_t mActiveWorkers = 0;              // workers which joined the current job
+    bool mExit = false;
+
+    std::atomic<size_t> mNext{0};           // index of the next task to claim
+    std::atomic<size_t> mRemaining{0};      // tasks of the current job not yet completed
+
+    // Statistics, only accessed by the owner thread; dumpsys reads are best effort.
+    uint64_t mRuns = 0;
+    uint64_t mDeadlineMisses = 0;
+};
+
+} // namespace android
+
+#endif // ANDROID_AUDIO_EFFECT_CHAIN_POOL_H
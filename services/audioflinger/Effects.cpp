@@ -509,6 +509,22 @@ void AudioFlinger::EffectBase::dump(int fd, const Vector<String16>& args __unuse
 #undef LOG_TAG
 #define LOG_TAG "AudioFlinger::EffectModule"
 
+// Budget for a single effect process() call as a percentage of the buffer period,
+// or 0 if effect CPU usage is only measured.
+static int32_t effectCpuBudgetPercent()
+{
+    static const int32_t percent =
+            std::clamp(property_get_int32("af.effect.cpu_budget_percent", 0), 0, 100);
+    return percent;
+}
+
+// Whether effects repeatedly exceeding their budget are bypassed rather than only reported.
+static bool effectCpuBudgetBypass()
+{
+    static const bool bypass = property_get_bool("af.effect.cpu_budget_bypass", false);
+    return bypass;
+}
+
 AudioFlinger::EffectModule::EffectModule(const sp<AudioFlinger::EffectCallbackInterface>& callback,
                                          effect_descriptor_t *desc,
                                          int id,
@@ -573,7 +589,7 @@ ssize_t AudioFlinger::EffectModule::removeHandle_l(EffectHandle *handle)
     // The effect engine will be released by the destructor when the last strong reference on
     // this object is released which can happen after next process is called.
     if (status == 0 && !mPinned) {
-        mEffectInterface->close();
+        closeInterface_l();
     }
 
     return status;
@@ -680,8 +696,9 @@ void AudioFlinger::EffectModule::process()
     };
 
     if (isProcessEnabled()) {
+        const int64_t processStartNs = systemTime();
         int ret;
-        if (isProcessImplemented()) {
+        if (isProcessImplemented() && !mOverBudgetBypassed) {
             if (auxType) {
                 // We overwrite the aux input buffer here and clear after processing.
                 // aux input is always mono.
@@ -811,6 +828,10 @@ void AudioFlinger::EffectModule::process()
 #endif
             memset(mConfig.inputCfg.buffer.raw, 0, size);
         }
+
+        if (!mOverBudgetBypassed) {
+            updateProcessStats_l(systemTime() - processStartNs);
+        }
     } else if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_INSERT &&
                 // mInBuffer->audioBuffer()->raw != mOutBuffer->audioBuffer()->raw
                 mConfig.inputCfg.buffer.raw != mConfig.outputCfg.buffer.raw) {
@@ -827,6 +848,38 @@ void AudioFlinger::EffectModule::process()
     }
 }
 
+void AudioFlinger::EffectModule::updateProcessStats_l(int64_t processNs)
+{
+    mProcessTimeUs.add(processNs * 1e-3);
+    if (mProcessBudgetNs == 0) {
+        return;
+    }
+    if (processNs <= mProcessBudgetNs) {
+        mConsecutiveOverruns = 0;
+        return;
+    }
+    ++mTotalOverruns;
+    if (++mConsecutiveOverruns != kMaxConsecutiveOverruns) {
+        return;
+    }
+    // never bypass an effect controlling the volume as this would bypass the volume too
+    const bool bypass = effectCpuBudgetBypass() && !isVolumeControl();
+    ALOGW("%s: effect %s id %d took %.3f ms for a budget of %.3f ms on %u consecutive buffers%s",
+            __func__, mDescriptor.name, mId, processNs * 1e-6, mProcessBudgetNs * 1e-6,
+            mConsecutiveOverruns, bypass ? ", bypassing" : "");
+    mOverBudgetBypassed = bypass;
+}
+
+AudioFlinger::EffectModule::ProcessStats AudioFlinger::EffectModule::getProcessStats()
+{
+    bool locked = AudioFlinger::dumpTryLock(mLock);
+    ProcessStats stats{mProcessTimeUs, mProcessBudgetNs, mTotalOverruns, mOverBudgetBypassed};
+    if (locked) {
+        mLock.unlock();
+    }
+    return stats;
+}
+
 void AudioFlinger::EffectModule::reset_l()
 {
     if (mStatus != NO_ERROR || mEffectInterface == 0) {
@@ -921,6 +974,11 @@ status_t AudioFlinger::EffectModule::configure()
     mConfig.inputCfg.buffer.frameCount = mCallback->frameCount();
     mConfig.outputCfg.buffer.frameCount = mConfig.inputCfg.buffer.frameCount;
 
+    if (mConfig.outputCfg.samplingRate != 0) {
+        mProcessBudgetNs = (int64_t)mConfig.outputCfg.buffer.frameCount * NANOS_PER_SECOND
+                / mConfig.outputCfg.samplingRate * effectCpuBudgetPercent() / 100;
+    }
+
     ALOGV("configure() %p chain %p buffer %p framecount %zu",
           this, mCallback->chain().promote().get(),
           mConfig.inputCfg.buffer.raw, mConfig.inputCfg.buffer.frameCount);
@@ -1090,6 +1148,9 @@ status_t AudioFlinger::EffectModule::start_l()
     }
     if (status == 0) {
         addEffectToHal_l();
+        // give an effect bypassed for exceeding its CPU budget another chance
+        mConsecutiveOverruns = 0;
+        mOverBudgetBypassed = false;
     }
     return status;
 }
@@ -1139,11 +1200,20 @@ void AudioFlinger::EffectModule::release_l()
     if (mEffectInterface != 0) {
         removeEffectFromHal_l();
         // release effect engine
-        mEffectInterface->close();
+        closeInterface_l();
         mEffectInterface.clear();
     }
 }
 
+// called by removeHandle_l() and release_l()
+void AudioFlinger::EffectModule::closeInterface_l()
+{
+    // wait for a capture command in progress, which does not hold mLock
+    Mutex::Autolock _l(mCaptureLock);
+    mInterfaceClosed = true;
+    mEffectInterface->close();
+}
+
 status_t AudioFlinger::EffectModule::removeEffectFromHal_l()
 {
     if ((mDescriptor.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_PRE_PROC ||
@@ -1166,6 +1236,9 @@ status_t AudioFlinger::EffectModule::command(uint32_t cmdCode,
                                              uint32_t *replySize,
                                              void *pReplyData)
 {
+    if (isCaptureCommand(cmdCode)) {
+        return captureCommand(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
+    }
     Mutex::Autolock _l(mLock);
     ALOGVV("command(), cmdCode: %d, mEffectInterface: %p", cmdCode, mEffectInterface.get());
 
@@ -1238,6 +1311,59 @@ status_t AudioFlinger::EffectModule::command(uint32_t cmdCode,
     return status;
 }
 
+// Implementation UUID of the platform visualizer (libvisualizer).
+static const effect_uuid_t kPlatformVisualizerUuid = { 0xd069d9e0, 0x8329, 0x11df, 0x9168,
+                                                       { 0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b } };
+
+// The capture commands of the platform visualizer read the waveform published by process()
+// through a lock-free ring and may run a spectrum analysis over it. VISUALIZER_CMD_MEASURE
+// reads the statistics of the last buffers processed and stays serialized with process().
+// Other visualizer implementations, e.g. offloaded or vendor ones, make no such guarantee
+// and all their commands stay serialized.
+bool AudioFlinger::EffectModule::isCaptureCommand(uint32_t cmdCode) const
+{
+    return cmdCode >= EFFECT_CMD_FIRST_PROPRIETARY && cmdCode != VISUALIZER_CMD_MEASURE &&
+            memcmp(&mDescriptor.uuid, &kPlatformVisualizerUuid, sizeof(effect_uuid_t)) == 0;
+}
+
+status_t AudioFlinger::EffectModule::captureCommand(uint32_t cmdCode,
+                                                    uint32_t cmdSize,
+                                                    void *pCmdData,
+                                                    uint32_t *replySize,
+                                                    void *pReplyData)
+{
+    sp<EffectHalInterface> effectInterface;
+    {
+        Mutex::Autolock _l(mLock);
+        if (mState == DESTROYED || mEffectInterface == 0) {
+            return NO_INIT;
+        }
+        if (mStatus != NO_ERROR) {
+            return mStatus;
+        }
+        effectInterface = mEffectInterface;
+    }
+    status_t status;
+    {
+        Mutex::Autolock _cl(mCaptureLock);
+        if (mInterfaceClosed) {
+            return NO_INIT;
+        }
+        status = effectInterface->command(cmdCode, cmdSize, pCmdData, replySize, pReplyData);
+    }
+    if (status == NO_ERROR) {
+        Mutex::Autolock _l(mLock);
+        uint32_t size = (replySize == NULL) ? 0 : *replySize;
+        for (size_t i = 1; i < mHandles.size(); i++) {
+            EffectHandle *h = mHandles[i];
+            if (h != NULL && !h->disconnected()) {
+                h->commandExecuted(cmdCode, cmdSize, pCmdData, size, pReplyData);
+            }
+        }
+    }
+    return status;
+}
+
 bool AudioFlinger::EffectModule::isProcessEnabled() const
 {
     if (mStatus != NO_ERROR) {
@@ -2032,6 +2158,31 @@ void AudioFlinger::EffectChain::clearInputBuffer_l()
     mInBuffer->commit();
 }
 
+void AudioFlinger::EffectChain::setStagedOutBuffer(const sp<EffectBufferHalInterface>& staging,
+                                                   const sp<EffectBufferHalInterface>& target)
+{
+    // the last effect of the chain accumulates into the staging buffer
+    memset(staging->audioBuffer()->raw, 0, staging->getSize());
+    mOutBuffer = staging;
+    mStagedOutTarget = target;
+    mStagedOutValid = false;
+}
+
+// Must be called with EffectChain::mLock locked
+void AudioFlinger::EffectChain::accumulateStagedOutBuffer_l()
+{
+    if (!mStagedOutValid) {
+        return;
+    }
+    const size_t numSamples = mEffectCallback->frameCount() * mEffectCallback->channelCount();
+    // The target mirrors the thread buffer; write to the thread buffer itself, the next chain
+    // or the sink picks it up from there.
+    effect_buffer_t *target = reinterpret_cast<effect_buffer_t*>(mStagedOutTarget->externalData());
+    effect_buffer_t *staged = reinterpret_cast<effect_buffer_t*>(mOutBuffer->audioBuffer()->raw);
+    EffectChainPool::accumulateStagedOutput(target, staged, numSamples);
+    mStagedOutValid = false;
+}
+
 // Must be called with EffectChain::mLock locked
 void AudioFlinger::EffectChain::process_l()
 {
@@ -2067,9 +2218,12 @@ void AudioFlinger::EffectChain::process_l()
         if (mInBuffer->audioBuffer()->raw != mOutBuffer->audioBuffer()->raw) {
             mOutBuffer->update();
         }
+        const int64_t processStartNs = systemTime();
         for (size_t i = 0; i < size; i++) {
             mEffects[i]->process();
         }
+        mProcessTimeUs.add((systemTime() - processStartNs) * 1e-3);
+        mStagedOutValid = mStagedOutTarget != 0;
         mInBuffer->commit();
         if (mInBuffer->audioBuffer()->raw != mOutBuffer->audioBuffer()->raw) {
             mOutBuffer->commit();
@@ -2417,6 +2571,23 @@ void AudioFlinger::EffectChain::dump(int fd, const Vector<String16>& args)
                 (int)outBufferStr.size(), "Out buffer      ");
         result.appendFormat("\t%s   %s   %d\n",
                 inBufferStr.c_str(), outBufferStr.c_str(), mActiveTrackCnt);
+
+        if (mProcessTimeUs.getN() > 0) {
+            result.appendFormat("\tProcess time us stats: %s\n",
+                    mProcessTimeUs.toString().c_str());
+        }
+        result.append("\tEffect ID  Budget us  Overruns  Bypassed  Process time us stats\n");
+        for (size_t i = 0; i < numEffects; ++i) {
+            const sp<EffectModule> effect = mEffects[i];
+            if (effect == 0) {
+                continue;
+            }
+            const EffectModule::ProcessStats stats = effect->getProcessStats();
+            result.appendFormat("\t%9d  %9lld  %8u  %8s  %s\n",
+                    effect->id(), (long long)(stats.budgetNs / 1000), stats.overruns,
+                    stats.bypassed ? "yes" : "no",
+                    stats.timeUs.getN() > 0 ? stats.timeUs.toString().c_str() : "-");
+        }
         write(fd, result.string(), result.size());
 
         for (size_t i = 0; i < numEffects; ++i) {
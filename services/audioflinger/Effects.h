@@ -257,6 +257,15 @@ public:
 
     sp<EffectModule> asEffectModule() override { return this; }
 
+    // CPU accounting of process() calls, reported by EffectChain::dump().
+    struct ProcessStats {
+        audio_utils::Statistics<double> timeUs; // wall clock time per process() call
+        int64_t budgetNs;                       // budget per process() call, 0 if none
+        uint32_t overruns;                      // process() calls which exceeded the budget
+        bool bypassed;                          // engine bypassed after repeated overruns
+    };
+    ProcessStats     getProcessStats();
+
     void             dump(int fd, const Vector<String16>& args);
 
 private:
@@ -265,12 +274,24 @@ private:
     // Maximum time allocated to effect engines to complete the turn off sequence
     static const uint32_t MAX_DISABLE_TIME_MS = 10000;
 
+    // Number of consecutive process() calls over budget before the effect is reported,
+    // and bypassed if the property af.effect.cpu_budget_bypass is set.
+    static constexpr uint32_t kMaxConsecutiveOverruns = 8;
+
     DISALLOW_COPY_AND_ASSIGN(EffectModule);
 
     status_t start_l();
     status_t stop_l();
     status_t removeEffectFromHal_l();
     status_t sendSetAudioDevicesCommand(const AudioDeviceTypeAddrVector &devices, uint32_t cmdCode);
+    void updateProcessStats_l(int64_t processNs);
+    bool isCaptureCommand(uint32_t cmdCode) const;
+    status_t captureCommand(uint32_t cmdCode,
+                            uint32_t cmdSize,
+                            void *pCmdData,
+                            uint32_t *replySize,
+                            void *pReplyData);
+    void closeInterface_l();
 
     effect_config_t     mConfig;    // input and output audio configuration
     sp<EffectHalInterface> mEffectInterface; // Effect module HAL
@@ -283,6 +304,18 @@ private:
     uint32_t mDisableWaitCnt;       // current process() calls count during disable period.
     bool     mOffloaded;            // effect is currently offloaded to the audio DSP
 
+    // Capture commands are sent without mLock so that they never hold off process().
+    // mCaptureLock serializes them with each other and with closing the effect interface.
+    Mutex    mCaptureLock;
+    bool     mInterfaceClosed = false; // protected by mCaptureLock
+
+    // CPU accounting, updated by process() with mLock held.
+    audio_utils::Statistics<double> mProcessTimeUs{0.995 /* alpha */};
+    int64_t  mProcessBudgetNs = 0;      // budget per process() call, set by configure()
+    uint32_t mConsecutiveOverruns = 0;  // current run of process() calls over budget
+    uint32_t mTotalOverruns = 0;        // process() calls over budget since creation
+    bool     mOverBudgetBypassed = false; // engine bypassed until the effect is restarted
+
 #ifdef FLOAT_EFFECT_CHAIN
     bool    mSupportsFloat;         // effect supports float processing
     sp<EffectBufferHalInterface> mInConversionBuffer;  // Buffers for HAL conversion if needed.
@@ -453,11 +486,24 @@ public:
     }
     void setOutBuffer(const sp<EffectBufferHalInterface>& buffer) {
         mOutBuffer = buffer;
+        mStagedOutTarget.clear();
     }
     effect_buffer_t *outBuffer() const {
         return mOutBuffer != 0 ? reinterpret_cast<effect_buffer_t*>(mOutBuffer->ptr()) : NULL;
     }
 
+    // When the session chains of a thread are processed in parallel, each chain outputs to a
+    // private staging buffer instead of accumulating into the shared thread buffer.
+    // accumulateStagedOutBuffer_l() then adds the staged output to the target buffer, serially
+    // on the thread, once all session chains are processed.
+    void setStagedOutBuffer(const sp<EffectBufferHalInterface>& staging,
+                            const sp<EffectBufferHalInterface>& target);
+    bool hasStagedOutBuffer() const { return mStagedOutTarget != 0; }
+    void accumulateStagedOutBuffer_l();
+
+    // mean wall clock time of process_l(), to schedule the most expensive chains first
+    double meanProcessTimeUs_l() const { return mProcessTimeUs.getMean(); }
+
     void incTrackCnt() { android_atomic_inc(&mTrackCnt); }
     void decTrackCnt() { android_atomic_dec(&mTrackCnt); }
     int32_t trackCnt() const { return android_atomic_acquire_load(&mTrackCnt); }
@@ -626,6 +672,13 @@ private:
              KeyedVector< int, sp<SuspendedEffectDesc> > mSuspendedEffects;
 
              const sp<EffectCallback> mEffectCallback;
+
+             // wall clock time spent processing all effects of the chain, per buffer
+             audio_utils::Statistics<double> mProcessTimeUs{0.995 /* alpha */};
+
+             // buffer accumulating mOutBuffer when the output is staged, see setStagedOutBuffer()
+             sp<EffectBufferHalInterface> mStagedOutTarget;
+             bool mStagedOutValid = false; // mOutBuffer holds output not yet accumulated
 };
 
 class DeviceEffectProxy : public EffectBase {
@@ -23,6 +23,8 @@
 #include "Configuration.h"
 #include <math.h>
 #include <fcntl.h>
+#include <algorithm>
+#include <functional>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -206,6 +208,17 @@ static const int kFastTrackMultiplierMax = 2;
 // The actual value to use, which can be specified per-device via property af.fast_track_multiplier.
 static int sFastTrackMultiplier = kFastTrackMultiplier;
 
+// Maximum number of worker threads processing session effect chains in parallel,
+// the actual number is set per-device via property af.effect.parallel_chains (default 0: off).
+static const int32_t kEffectChainPoolWorkersMax = 7;
+
+static size_t effectChainPoolWorkers()
+{
+    static const size_t workers = std::clamp(
+            property_get_int32("af.effect.parallel_chains", 0), 0, kEffectChainPoolWorkersMax);
+    return workers;
+}
+
 // See Thread::readOnlyHeap().
 // Initially this heap is used to allocate client buffers for "fast" AudioRecord.
 // Eventually it will be the single buffer that FastCapture writes into via HAL read(),
@@ -2030,6 +2043,12 @@ void AudioFlinger::PlaybackThread::dumpInternals_l(int fd, const Vector<String16
     dprintf(fd, "  Sink buffer : %p\n", mSinkBuffer);
     dprintf(fd, "  Mixer buffer: %p\n", mMixerBuffer);
     dprintf(fd, "  Effect buffer: %p\n", mEffectBuffer);
+    if (mEffectChainPool != nullptr) {
+        dprintf(fd, "  Effect chain pool: %zu workers, %llu runs, %llu deadline misses%s\n",
+                mEffectChainPool->numWorkers(), (unsigned long long)mEffectChainPool->runs(),
+                (unsigned long long)mEffectChainPool->deadlineMisses(),
+                mEffectChainPoolMisses >= kMaxEffectChainPoolMisses ? " (serial fallback)" : "");
+    }
     dprintf(fd, "  Fast track availMask=%#x\n", mFastTrackAvailMask);
     dprintf(fd, "  Standby delay ns=%lld\n", (long long)mStandbyDelayNs);
     AudioStreamOut *output = mOutput;
@@ -3238,7 +3257,7 @@ void AudioFlinger::PlaybackThread::invalidateTracks(audio_stream_type_t streamTy
 status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& chain)
 {
     audio_session_t session = chain->sessionId();
-    sp<EffectBufferHalInterface> halInBuffer, halOutBuffer;
+    sp<EffectBufferHalInterface> halInBuffer, halOutBuffer, halStagingBuffer;
     status_t result = mAudioFlinger->mEffectsFactoryHal->mirrorBuffer(
             mEffectBufferEnabled ? mEffectBuffer : mSinkBuffer,
             mEffectBufferEnabled ? mEffectBufferSize : mSinkBufferSize,
@@ -3263,6 +3282,19 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
 #endif
             ALOGV("addEffectChain_l() creating new input buffer %p session %d",
                     buffer, session);
+
+            if (mEffectChainPool == nullptr && mType == MIXER && effectChainPoolWorkers() > 0) {
+                mEffectChainPool = std::make_unique<EffectChainPool>(effectChainPoolWorkers(),
+                        ANDROID_PRIORITY_URGENT_AUDIO, std::string(mThreadName) + "Fx");
+            }
+            // Haptic data is copied between the chain buffers after processing, see threadLoop(),
+            // so chains of threads with haptic channels are always processed in place.
+            if (mEffectChainPool != nullptr && mHapticChannelCount == 0) {
+                result = mAudioFlinger->mEffectsFactoryHal->allocateBuffer(
+                        numSamples * sizeof(effect_buffer_t),
+                        &halStagingBuffer);
+                if (result != OK) return result;
+            }
         }
 
         // Attach all tracks with same session ID to this chain.
@@ -3286,7 +3318,12 @@ status_t AudioFlinger::PlaybackThread::addEffectChain_l(const sp<EffectChain>& c
     }
     chain->setThread(this);
     chain->setInBuffer(halInBuffer);
-    chain->setOutBuffer(halOutBuffer);
+    if (halStagingBuffer != 0) {
+        chain->setStagedOutBuffer(halStagingBuffer, halOutBuffer);
+    } else {
+        chain->setOutBuffer(halOutBuffer);
+    }
+    mEffectChainPoolMisses = 0;
     // Effect chain for session AUDIO_SESSION_DEVICE is inserted at end of effect
     // chains list in order to be processed last as it contains output device effects.
     // Effect chain for session AUDIO_SESSION_OUTPUT_STAGE is inserted just before to apply post
@@ -3326,6 +3363,7 @@ size_t AudioFlinger::PlaybackThread::removeEffectChain_l(const sp<EffectChain>&
     for (size_t i = 0; i < mEffectChains.size(); i++) {
         if (chain == mEffectChains[i]) {
             mEffectChains.removeAt(i);
+            mEffectChainPoolMisses = 0;
             // detach all active tracks from the chain
             for (const sp<Track> &track : mActiveTracks) {
                 if (session == track->sessionId()) {
@@ -3349,6 +3387,51 @@ size_t AudioFlinger::PlaybackThread::removeEffectChain_l(const sp<EffectChain>&
     return mEffectChains.size();
 }
 
+// Processes the leading chains of effectChains which have a staged output buffer, on
+// mEffectChainPool, then accumulates their output into the thread buffer.
+// Must be called with all effect chains locked, returns the number of chains processed.
+size_t AudioFlinger::PlaybackThread::processStagedEffectChains_l(
+        const Vector< sp<EffectChain> >& effectChains)
+{
+    mStagedEffectChains.clear();
+    for (size_t i = 0; i < effectChains.size() && effectChains[i]->hasStagedOutBuffer(); i++) {
+        mStagedEffectChains.push_back(effectChains[i].get());
+    }
+    const size_t count = mStagedEffectChains.size();
+    if (count == 0) {
+        return 0;
+    }
+
+    // Tasks are claimed in order: start with the most expensive chains to shorten the join.
+    std::sort(mStagedEffectChains.begin(), mStagedEffectChains.end(),
+            [](EffectChain *a, EffectChain *b) {
+                return a->meanProcessTimeUs_l() > b->meanProcessTimeUs_l();
+            });
+    const std::function<void(size_t)> process = [this](size_t i) {
+        mStagedEffectChains[i]->process_l();
+    };
+    if (mEffectChainPoolMisses < kMaxEffectChainPoolMisses) {
+        // Leave at least half of the period to the global chains and the write.
+        const int64_t timeoutNs =
+                (int64_t)mNormalFrameCount * NANOS_PER_SECOND / mSampleRate / 2;
+        if (mEffectChainPool->run(count, process, timeoutNs)) {
+            mEffectChainPoolMisses = 0;
+        } else if (++mEffectChainPoolMisses == kMaxEffectChainPoolMisses) {
+            ALOGW("%s: %u consecutive deadline misses processing %zu effect chains in parallel, "
+                    "falling back to serial processing", __func__, mEffectChainPoolMisses, count);
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            process(i);
+        }
+    }
+
+    for (EffectChain *chain : mStagedEffectChains) {
+        chain->accumulateStagedOutBuffer_l();
+    }
+    return count;
+}
+
 status_t AudioFlinger::PlaybackThread::attachAuxEffect(
         const sp<AudioFlinger::PlaybackThread::Track>& track, int EffectId)
 {
@@ -3833,7 +3916,9 @@ bool AudioFlinger::PlaybackThread::threadLoop()
 
             // only process effects if we're going to write
             if (mSleepTimeUs == 0 && mType != OFFLOAD) {
-                for (size_t i = 0; i < effectChains.size(); i ++) {
+                // session chains with a staged output come first and are processed in parallel
+                for (size_t i = processStagedEffectChains_l(effectChains);
+                        i < effectChains.size(); i ++) {
                     effectChains[i]->process_l();
                     // TODO: Write haptic data directly to sink buffer when mixing.
                     if (activeHapticSessionId != AUDIO_SESSION_NONE
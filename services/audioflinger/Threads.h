@@ -1023,6 +1023,20 @@ protected:
     // haptic playback.
     audio_channel_mask_t            mHapticChannelMask = AUDIO_CHANNEL_NONE;
     uint32_t                        mHapticChannelCount = 0;
+
+    // Parallel processing of the effect chains of audio sessions, enabled on mixer threads
+    // by setting the property af.effect.parallel_chains to the number of worker threads.
+    // Session chains added while mEffectChainPool exists output to a staging buffer,
+    // see EffectChain::setStagedOutBuffer().
+    size_t      processStagedEffectChains_l(const Vector< sp<EffectChain> >& effectChains);
+
+    // Consecutive pool deadline misses before falling back to serial processing,
+    // until the set of effect chains changes.
+    static constexpr uint32_t kMaxEffectChainPoolMisses = 16;
+
+    std::unique_ptr<EffectChainPool> mEffectChainPool;
+    uint32_t                        mEffectChainPoolMisses = 0; // consecutive deadline misses
+    std::vector<EffectChain *>      mStagedEffectChains;  // scratch for threadLoop(), no alloc
 private:
     // mMasterMute is in both PlaybackThread and in AudioFlinger.  When a
     // PlaybackThread needs to find out if master-muted, it checks it's local
@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "EffectChainPoolTests"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+
+#include <audio_utils/primitives.h>
+#include <gtest/gtest.h>
+#include <hardware/audio_effect.h>
+#include <system/audio.h>
+#include <utils/Log.h>
+#include <utils/ThreadDefs.h>
+
+#include "EffectChainPool.h"
+
+using namespace android;
+
+namespace {
+
+constexpr int64_t kNoTimeoutNs = 1000000000LL;
+
+} // namespace
+
+TEST(EffectChainPoolTest, runs_each_task_once) {
+    EffectChainPool pool(3 /* numWorkers */, ANDROID_PRIORITY_NORMAL, "PoolTest");
+    ASSERT_EQ(3u, pool.numWorkers());
+
+    constexpr size_t kMaxTasks = 16;
+    std::vector<std::atomic<int>> runs(kMaxTasks);
+    std::minstd_rand random(42);
+    for (int iteration = 0; iteration < 2000; ++iteration) {
+        const size_t count = random() % kMaxTasks + 1;
+        for (auto& run : runs) {
+            run = 0;
+        }
+        const std::function<void(size_t)> task = [&](size_t i) {
+            runs[i]++;
+        };
+        ASSERT_TRUE(pool.run(count, task, kNoTimeoutNs));
+        for (size_t i = 0; i < kMaxTasks; ++i) {
+            ASSERT_EQ(i < count ? 1 : 0, runs[i].load()) << "iteration " << iteration;
+        }
+    }
+    EXPECT_EQ(2000u, pool.runs());
+    EXPECT_EQ(0u, pool.deadlineMisses());
+}
+
+TEST(EffectChainPoolTest, waits_for_tasks_after_deadline) {
+    EffectChainPool pool(2 /* numWorkers */, ANDROID_PRIORITY_NORMAL, "PoolTest");
+    std::atomic<int> completed{0};
+    const std::function<void(size_t)> task = [&](size_t) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        completed++;
+    };
+    EXPECT_FALSE(pool.run(4, task, 1000000 /* timeoutNs */));
+    EXPECT_EQ(4, completed.load());
+    EXPECT_EQ(1u, pool.deadlineMisses());
+
+    // a miss does not affect the next run
+    completed = 0;
+    EXPECT_TRUE(pool.run(3, task, kNoTimeoutNs));
+    EXPECT_EQ(3, completed.load());
+}
+
+TEST(EffectChainPoolTest, no_workers_runs_on_caller) {
+    EffectChainPool pool(0 /* numWorkers */, ANDROID_PRIORITY_NORMAL, "PoolTest");
+    const std::thread::id caller = std::this_thread::get_id();
+    int runs = 0;
+    const std::function<void(size_t)> task = [&](size_t) {
+        EXPECT_EQ(caller, std::this_thread::get_id());
+        ++runs;
+    };
+    EXPECT_TRUE(pool.run(5, task, kNoTimeoutNs));
+    EXPECT_EQ(5, runs);
+}
+
+TEST(EffectChainPoolTest, accumulate_staged_output) {
+    std::vector<float> target = {1.f, -2.f, 0.5f};
+    std::vector<float> staged = {0.25f, 1.f, -0.5f};
+    EffectChainPool::accumulateStagedOutput(target.data(), staged.data(), target.size());
+    EXPECT_EQ((std::vector<float>{1.25f, -1.f, 0.f}), target);
+    EXPECT_EQ((std::vector<float>{0.f, 0.f, 0.f}), staged);
+
+    std::vector<int16_t> target16 = {32000, -32000, 100};
+    std::vector<int16_t> staged16 = {1000, -1000, -50};
+    EffectChainPool::accumulateStagedOutput(target16.data(), staged16.data(), target16.size());
+    EXPECT_EQ((std::vector<int16_t>{32767, -32768, 50}), target16);  // saturated
+    EXPECT_EQ((std::vector<int16_t>{0, 0, 0}), staged16);
+}
+
+// Stress test processing session effect chains made of the LVM bundle equalizer and
+// dynamics processing the way EffectChain does: the first effect processes in place in the
+// session buffer and the last one accumulates into the chain output. Processed serially, the
+// chains accumulate in turn into the thread buffer. Processed on the pool, each chain
+// accumulates into its own staging buffer, see EffectChain::setStagedOutBuffer(), and the
+// staged outputs are then added to the thread buffer in chain order, see
+// EffectChain::accumulateStagedOutBuffer_l().
+class EffectChainPoolStressTest : public ::testing::Test {
+protected:
+    static constexpr size_t kSessions = 8;
+    static constexpr size_t kFrameCount = 960;       // 20 ms at 48 kHz
+    static constexpr uint32_t kSampleRate = 48000;
+    static constexpr size_t kChannelCount = 2;
+    static constexpr size_t kSamples = kFrameCount * kChannelCount;
+    static constexpr size_t kBuffers = 250;          // 5 seconds of audio
+
+    struct Chain {
+        // effects with the library which created them, in processing order
+        std::vector<std::pair<audio_effect_library_t*, effect_handle_t>> effects;
+        std::vector<float> inBuffer;
+        std::vector<float> stagingBuffer;            // only used on the pool
+        float* outBuffer = nullptr;                  // mix or staging buffer
+    };
+
+    void SetUp() override {
+        mBundle = openLibrary("libbundlewrapper.so");
+        mDynamicsProcessing = openLibrary("libdynproc.so");
+        if (mBundle == nullptr || mDynamicsProcessing == nullptr) {
+            GTEST_SKIP() << "effect libraries not available";
+        }
+    }
+
+    void TearDown() override {
+        for (auto* chains : {&mSerialChains, &mParallelChains}) {
+            for (Chain& chain : *chains) {
+                for (const auto& [library, effect] : chain.effects) {
+                    library->release_effect(effect);
+                }
+            }
+        }
+        for (void* handle : mHandles) {
+            dlclose(handle);
+        }
+    }
+
+    audio_effect_library_t* openLibrary(const char* name) {
+#ifdef __LP64__
+        const std::string path = std::string("/vendor/lib64/soundfx/") + name;
+#else
+        const std::string path = std::string("/vendor/lib/soundfx/") + name;
+#endif
+        void* handle = dlopen(path.c_str(), RTLD_NOW);
+        if (handle == nullptr) {
+            ALOGW("%s: cannot open %s: %s", __func__, path.c_str(), dlerror());
+            return nullptr;
+        }
+        mHandles.push_back(handle);
+        return reinterpret_cast<audio_effect_library_t*>(
+                dlsym(handle, AUDIO_EFFECT_LIBRARY_INFO_SYM_AS_STR));
+    }
+
+    // Like EffectModule::configure(), an effect with distinct buffers accumulates.
+    static effect_handle_t createEffect(audio_effect_library_t* library,
+            const effect_uuid_t& uuid, int32_t sessionId, float* inBuffer, float* outBuffer) {
+        effect_handle_t effect = nullptr;
+        if (library->create_effect(&uuid, sessionId, 1 /* ioId */, &effect) != 0) {
+            return nullptr;
+        }
+        int32_t reply = 0;
+        uint32_t replySize = sizeof(reply);
+        if ((*effect)->command(effect, EFFECT_CMD_INIT, 0, nullptr, &replySize, &reply) != 0
+                || reply != 0) {
+            library->release_effect(effect);
+            return nullptr;
+        }
+        effect_config_t config{};
+        for (buffer_config_t* cfg : {&config.inputCfg, &config.outputCfg}) {
+            cfg->samplingRate = kSampleRate;
+            cfg->channels = AUDIO_CHANNEL_OUT_STEREO;
+            cfg->format = AUDIO_FORMAT_PCM_FLOAT;
+            cfg->buffer.frameCount = kFrameCount;
+            cfg->mask = EFFECT_CONFIG_ALL;
+        }
+        config.inputCfg.buffer.f32 = inBuffer;
+        config.outputCfg.buffer.f32 = outBuffer;
+        config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+        config.outputCfg.accessMode = inBuffer == outBuffer
+                ? EFFECT_BUFFER_ACCESS_WRITE : EFFECT_BUFFER_ACCESS_ACCUMULATE;
+        replySize = sizeof(reply);
+        if ((*effect)->command(effect, EFFECT_CMD_SET_CONFIG, sizeof(config), &config,
+                &replySize, &reply) != 0 || reply != 0) {
+            library->release_effect(effect);
+            return nullptr;
+        }
+        replySize = sizeof(reply);
+        (*effect)->command(effect, EFFECT_CMD_ENABLE, 0, nullptr, &replySize, &reply);
+        return effect;
+    }
+
+    // Creates the chains, which output to mix or, if staged, to their staging buffer.
+    void createChains(std::vector<Chain>* chains, int32_t firstSessionId, bool staged,
+            std::vector<float>* mix) {
+        // implementation UUIDs of the bundle equalizer and of dynamics processing
+        static const effect_uuid_t kEqualizerUuid =
+                {0xce772f20, 0x847d, 0x11df, 0xbb17, {0x00, 0x02, 0xa5, 0xd5, 0xc5, 0x1b}};
+        static const effect_uuid_t kDynamicsProcessingUuid =
+                {0xe0e6539b, 0x1781, 0x7261, 0x676f, {0x6d, 0x75, 0x73, 0x69, 0x63, 0x40}};
+
+        chains->resize(kSessions);
+        for (size_t i = 0; i < kSessions; ++i) {
+            Chain& chain = (*chains)[i];
+            const int32_t sessionId = firstSessionId + i;
+            chain.inBuffer.resize(kSamples);
+            if (staged) {
+                chain.stagingBuffer.assign(kSamples, 0.f);
+            }
+            chain.outBuffer = staged ? chain.stagingBuffer.data() : mix->data();
+
+            effect_handle_t effect = createEffect(mBundle, kEqualizerUuid, sessionId,
+                    chain.inBuffer.data(), chain.inBuffer.data());
+            ASSERT_NE(nullptr, effect);
+            chain.effects.emplace_back(mBundle, effect);
+            effect = createEffect(mDynamicsProcessing, kDynamicsProcessingUuid, sessionId,
+                    chain.inBuffer.data(), chain.outBuffer);
+            ASSERT_NE(nullptr, effect);
+            chain.effects.emplace_back(mDynamicsProcessing, effect);
+        }
+    }
+
+    // Deterministic noise, different for each buffer and for each session or the mix.
+    static void fillNoise(std::vector<float>* buffer, size_t bufferIndex, size_t source) {
+        std::minstd_rand random(bufferIndex * (kSessions + 1) + source + 1);
+        std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+        for (float& sample : *buffer) {
+            sample = distribution(random);
+        }
+    }
+
+    // Processes all chains for one buffer, on pool if not null. The mix starts with the
+    // tracks which are not in a session with effects.
+    static void processBuffer(std::vector<Chain>& chains, size_t bufferIndex,
+            EffectChainPool* pool, std::vector<float>* mix) {
+        fillNoise(mix, bufferIndex, kSessions);
+        for (size_t i = 0; i < chains.size(); ++i) {
+            fillNoise(&chains[i].inBuffer, bufferIndex, i);
+        }
+        const std::function<void(size_t)> process = [&chains](size_t i) {
+            Chain& chain = chains[i];
+            audio_buffer_t inBuffer{kFrameCount, {chain.inBuffer.data()}};
+            audio_buffer_t outBuffer{kFrameCount, {chain.outBuffer}};
+            for (size_t e = 0; e < chain.effects.size(); ++e) {
+                const effect_handle_t effect = chain.effects[e].second;
+                (*effect)->process(effect, &inBuffer,
+                        e + 1 == chain.effects.size() ? &outBuffer : &inBuffer);
+            }
+        };
+        if (pool == nullptr) {
+            for (size_t i = 0; i < chains.size(); ++i) {
+                process(i);
+            }
+            return;
+        }
+        ASSERT_TRUE(pool->run(chains.size(), process, kNoTimeoutNs));
+        for (Chain& chain : chains) {
+            EffectChainPool::accumulateStagedOutput(
+                    mix->data(), chain.stagingBuffer.data(), kSamples);
+        }
+    }
+
+    std::vector<void*> mHandles;
+    audio_effect_library_t* mBundle = nullptr;
+    audio_effect_library_t* mDynamicsProcessing = nullptr;
+    std::vector<Chain> mSerialChains;
+    std::vector<Chain> mParallelChains;
+};
+
+TEST_F(EffectChainPoolStressTest, parallel_matches_serial) {
+    std::vector<float> serialMix(kSamples);
+    std::vector<float> parallelMix(kSamples);
+    createChains(&mSerialChains, 1 /* firstSessionId */, false /* staged */, &serialMix);
+    createChains(&mParallelChains, 1 + kSessions /* firstSessionId */, true /* staged */,
+            &parallelMix);
+    if (HasFatalFailure()) return;
+
+    const size_t workers = std::clamp(std::thread::hardware_concurrency(), 1u, 8u) - 1;
+    EffectChainPool pool(workers, ANDROID_PRIORITY_URGENT_AUDIO, "PoolStress");
+
+    for (size_t i = 0; i < kBuffers; ++i) {
+        processBuffer(mSerialChains, i, nullptr /* pool */, &serialMix);
+        processBuffer(mParallelChains, i, &pool, &parallelMix);
+        if (HasFatalFailure()) return;
+
+        // same effects on the same input in the same accumulation order: bit exact
+        ASSERT_EQ(0, memcmp(serialMix.data(), parallelMix.data(), kSamples * sizeof(float)))
+                << "buffer " << i;
+        for (const Chain& chain : mParallelChains) {
+            ASSERT_TRUE(std::all_of(chain.stagingBuffer.begin(), chain.stagingBuffer.end(),
+                    [](float sample) { return sample == 0.f; })) << "buffer " << i;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "AudioPolicyConfig.h"
+
+namespace android {
+
+// A binary snapshot of an audio policy configuration parsed from XML, which restores the modules,
+// mix ports, device ports, routes and global settings without parsing. A snapshot is only valid
+// for the build it was taken on and for the exact contents of the XML files it was parsed from.
+
+// Restores config from the snapshot in cacheFile if it was taken from configFile and none of the
+// files it was parsed from changed since. config is left untouched on failure.
+status_t loadAudioPolicyConfigCache(const char *cacheFile, const char *configFile,
+                                    AudioPolicyConfig *config);
+
+// Writes a snapshot of config, parsed from sourceFiles: the configuration file first followed
+// by the files it includes, to cacheFile.
+status_t saveAudioPolicyConfigCache(const char *cacheFile,
+                                    const std::vector<std::string> &sourceFiles,
+                                    const AudioPolicyConfig &config);
+
+} // namespace android
@@ -22,4 +22,9 @@ namespace android {
 
 status_t deserializeAudioPolicyFile(const char *fileName, AudioPolicyConfig *config);
 
+// Same as above, but restores the configuration from the snapshot in cacheFile when it is up to
+// date, and otherwise parses fileName and refreshes the snapshot.
+status_t deserializeAudioPolicyFile(const char *fileName, AudioPolicyConfig *config,
+                                    const char *cacheFile);
+
 } // namespace android
@@ -0,0 +1,451 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "APM::AudioPolicyConfigCache"
+//#define LOG_NDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <binder/Parcel.h>
+#include <cutils/properties.h>
+#include <utils/Log.h>
+#include "AudioPolicyConfigCache.h"
+
+namespace android {
+
+namespace {
+
+constexpr int32_t kMagic = 0x41504343; // 'APCC'
+// Must be incremented whenever the layout or the meaning of the snapshot changes.
+constexpr int32_t kVersion = 1;
+
+// A file the snapshot was taken from, identified by its size and contents hash.
+struct SourceFile {
+    std::string path;
+    int64_t size = 0;
+    uint64_t hash = 0;
+};
+
+bool readFile(const char *path, std::string *contents)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    contents->clear();
+    char buffer[4096];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+        contents->append(buffer, count);
+    }
+    close(fd);
+    return count == 0;
+}
+
+// 64 bit FNV-1a, stable across builds and devices.
+uint64_t hashContents(const std::string &contents)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : contents) {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool getSourceFile(const std::string &path, SourceFile *source)
+{
+    std::string contents;
+    if (!readFile(path.c_str(), &contents)) {
+        return false;
+    }
+    source->path = path;
+    source->size = contents.size();
+    source->hash = hashContents(contents);
+    return true;
+}
+
+std::string getBuildFingerprint()
+{
+    char fingerprint[PROPERTY_VALUE_MAX];
+    property_get("ro.build.fingerprint", fingerprint, "");
+    return fingerprint;
+}
+
+#define RETURN_IF_ERROR(x) do { status_t status = (x); if (status != NO_ERROR) return status; } \
+        while (false)
+
+status_t writeProfilesAndGains(Parcel *parcel, AudioPort *port)
+{
+    RETURN_IF_ERROR(parcel->writeParcelable(port->getAudioProfiles()));
+    return parcel->writeParcelable(port->getGains());
+}
+
+status_t readProfilesAndGains(const Parcel &parcel, AudioPort *port)
+{
+    AudioProfileVector profiles;
+    RETURN_IF_ERROR(parcel.readParcelable(&profiles));
+    AudioGains gains;
+    RETURN_IF_ERROR(parcel.readParcelable(&gains));
+    port->setAudioProfiles(profiles);
+    port->setGains(gains);
+    return NO_ERROR;
+}
+
+status_t writeMixPort(Parcel *parcel, const sp<IOProfile> &mixPort)
+{
+    RETURN_IF_ERROR(parcel->writeUtf8AsUtf16(mixPort->getName()));
+    RETURN_IF_ERROR(parcel->writeUint32(mixPort->getFlags()));
+    RETURN_IF_ERROR(parcel->writeUint32(mixPort->maxOpenCount));
+    RETURN_IF_ERROR(parcel->writeUint32(mixPort->maxActiveCount));
+    return writeProfilesAndGains(parcel, mixPort.get());
+}
+
+status_t readMixPort(const Parcel &parcel, audio_port_role_t role, sp<IOProfile> *mixPort)
+{
+    std::string name;
+    RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&name));
+    *mixPort = new IOProfile(name, role);
+    uint32_t flags;
+    RETURN_IF_ERROR(parcel.readUint32(&flags));
+    (*mixPort)->setFlags(flags);
+    // after the flags, as in the XML configuration
+    RETURN_IF_ERROR(parcel.readUint32(&(*mixPort)->maxOpenCount));
+    RETURN_IF_ERROR(parcel.readUint32(&(*mixPort)->maxActiveCount));
+    return readProfilesAndGains(parcel, mixPort->get());
+}
+
+status_t writeDevicePort(Parcel *parcel, const sp<DeviceDescriptor> &devicePort)
+{
+    RETURN_IF_ERROR(parcel->writeUtf8AsUtf16(devicePort->getTagName()));
+    RETURN_IF_ERROR(parcel->writeUint32(devicePort->type()));
+    RETURN_IF_ERROR(parcel->writeUtf8AsUtf16(devicePort->address()));
+    std::vector<int32_t> encodedFormats(devicePort->encodedFormats().begin(),
+            devicePort->encodedFormats().end());
+    RETURN_IF_ERROR(parcel->writeInt32Vector(encodedFormats));
+    return writeProfilesAndGains(parcel, devicePort.get());
+}
+
+status_t readDevicePort(const Parcel &parcel, sp<DeviceDescriptor> *devicePort)
+{
+    std::string tagName;
+    RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&tagName));
+    uint32_t type;
+    RETURN_IF_ERROR(parcel.readUint32(&type));
+    if (!audio_is_output_devices(type) && !audio_is_input_device(type)) {
+        return BAD_VALUE;
+    }
+    std::string address;
+    RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&address));
+    std::vector<int32_t> encodedFormatValues;
+    RETURN_IF_ERROR(parcel.readInt32Vector(&encodedFormatValues));
+    FormatVector encodedFormats;
+    for (int32_t format : encodedFormatValues) {
+        encodedFormats.push_back(static_cast<audio_format_t>(format));
+    }
+    *devicePort = new DeviceDescriptor(static_cast<audio_devices_t>(type), tagName, address,
+            encodedFormats);
+    return readProfilesAndGains(parcel, devicePort->get());
+}
+
+status_t writeRoute(Parcel *parcel, const sp<AudioRoute> &route)
+{
+    RETURN_IF_ERROR(parcel->writeInt32(route->getType()));
+    RETURN_IF_ERROR(parcel->writeUtf8AsUtf16(route->getSink()->getTagName()));
+    RETURN_IF_ERROR(parcel->writeUint32(route->getSources().size()));
+    for (const auto &source : route->getSources()) {
+        RETURN_IF_ERROR(parcel->writeUtf8AsUtf16(source->getTagName()));
+    }
+    return NO_ERROR;
+}
+
+// Same as RouteTraits::deserialize() in the serializer.
+status_t readRoute(const Parcel &parcel, const sp<HwModule> &module, sp<AudioRoute> *route)
+{
+    int32_t type;
+    RETURN_IF_ERROR(parcel.readInt32(&type));
+    *route = new AudioRoute(static_cast<audio_route_type_t>(type));
+    std::string tagName;
+    RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&tagName));
+    sp<PolicyAudioPort> sink = module->findPortByTagName(tagName);
+    if (sink == nullptr) {
+        return BAD_VALUE;
+    }
+    (*route)->setSink(sink);
+    uint32_t count;
+    RETURN_IF_ERROR(parcel.readUint32(&count));
+    PolicyAudioPortVector sources;
+    for (uint32_t i = 0; i < count; i++) {
+        RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&tagName));
+        sp<PolicyAudioPort> source = module->findPortByTagName(tagName);
+        if (source == nullptr) {
+            return BAD_VALUE;
+        }
+        sources.add(source);
+    }
+    sink->addRoute(*route);
+    for (const auto &source : sources) {
+        source->addRoute(*route);
+    }
+    (*route)->setSources(sources);
+    return NO_ERROR;
+}
+
+status_t writeModule(Parcel *parcel, const sp<HwModule> &module, const AudioPolicyConfig &config)
+{
+    RETURN_IF_ERROR(parcel->writeUtf8AsUtf16(module->getName()));
+    RETURN_IF_ERROR(parcel->writeUint32(module->getHalVersionMajor()));
+    RETURN_IF_ERROR(parcel->writeUint32(module->getHalVersionMinor()));
+    for (const auto *mixPorts : {&module->getOutputProfiles(), &module->getInputProfiles()}) {
+        RETURN_IF_ERROR(parcel->writeUint32(mixPorts->size()));
+        for (const auto &mixPort : *mixPorts) {
+            RETURN_IF_ERROR(writeMixPort(parcel, mixPort));
+        }
+    }
+    const DeviceVector &devicePorts = module->getDeclaredDevices();
+    RETURN_IF_ERROR(parcel->writeUint32(devicePorts.size()));
+    for (const auto &devicePort : devicePorts) {
+        RETURN_IF_ERROR(writeDevicePort(parcel, devicePort));
+    }
+    RETURN_IF_ERROR(parcel->writeUint32(module->getRoutes().size()));
+    for (const auto &route : module->getRoutes()) {
+        RETURN_IF_ERROR(writeRoute(parcel, route));
+    }
+
+    std::vector<std::string> attachedDevices;
+    for (const auto *devices : {&config.getOutputDevices(), &config.getInputDevices()}) {
+        for (const auto &device : *devices) {
+            if (devicePorts.contains(device)) {
+                attachedDevices.push_back(device->getTagName());
+            }
+        }
+    }
+    RETURN_IF_ERROR(parcel->writeUint32(attachedDevices.size()));
+    for (const auto &tagName : attachedDevices) {
+        RETURN_IF_ERROR(parcel->writeUtf8AsUtf16(tagName));
+    }
+    const sp<DeviceDescriptor> &defaultOutputDevice = config.getDefaultOutputDevice();
+    return parcel->writeUtf8AsUtf16(
+            defaultOutputDevice != nullptr && devicePorts.contains(defaultOutputDevice) ?
+            defaultOutputDevice->getTagName() : "");
+}
+
+// Modules and devices restored from a snapshot, applied to the configuration once complete.
+struct Snapshot {
+    HwModuleCollection modules;
+    DeviceVector attachedDevices;
+    sp<DeviceDescriptor> defaultOutputDevice;
+};
+
+// Same as ModuleTraits::deserialize() in the serializer.
+status_t readModule(const Parcel &parcel, Snapshot *snapshot)
+{
+    std::string name;
+    RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&name));
+    uint32_t versionMajor, versionMinor;
+    RETURN_IF_ERROR(parcel.readUint32(&versionMajor));
+    RETURN_IF_ERROR(parcel.readUint32(&versionMinor));
+    sp<HwModule> module = new HwModule(name.c_str(), versionMajor, versionMinor);
+
+    IOProfileCollection mixPorts;
+    for (audio_port_role_t role : {AUDIO_PORT_ROLE_SOURCE, AUDIO_PORT_ROLE_SINK}) {
+        uint32_t count;
+        RETURN_IF_ERROR(parcel.readUint32(&count));
+        for (uint32_t i = 0; i < count; i++) {
+            sp<IOProfile> mixPort;
+            RETURN_IF_ERROR(readMixPort(parcel, role, &mixPort));
+            mixPorts.add(mixPort);
+        }
+    }
+    module->setProfiles(mixPorts);
+
+    uint32_t count;
+    RETURN_IF_ERROR(parcel.readUint32(&count));
+    DeviceVector devicePorts;
+    for (uint32_t i = 0; i < count; i++) {
+        sp<DeviceDescriptor> devicePort;
+        RETURN_IF_ERROR(readDevicePort(parcel, &devicePort));
+        devicePorts.add(devicePort);
+    }
+    module->setDeclaredDevices(devicePorts);
+
+    RETURN_IF_ERROR(parcel.readUint32(&count));
+    AudioRouteVector routes;
+    for (uint32_t i = 0; i < count; i++) {
+        sp<AudioRoute> route;
+        RETURN_IF_ERROR(readRoute(parcel, module, &route));
+        routes.add(route);
+    }
+    module->setRoutes(routes);
+
+    RETURN_IF_ERROR(parcel.readUint32(&count));
+    std::string tagName;
+    for (uint32_t i = 0; i < count; i++) {
+        RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&tagName));
+        sp<DeviceDescriptor> device = devicePorts.getDeviceFromTagName(tagName);
+        if (device == nullptr) {
+            return BAD_VALUE;
+        }
+        snapshot->attachedDevices.add(device);
+    }
+    RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&tagName));
+    if (!tagName.empty() && snapshot->defaultOutputDevice == nullptr) {
+        snapshot->defaultOutputDevice = devicePorts.getDeviceFromTagName(tagName);
+    }
+    snapshot->modules.add(module);
+    return NO_ERROR;
+}
+
+} // namespace
+
+status_t loadAudioPolicyConfigCache(const char *cacheFile, const char *configFile,
+                                    AudioPolicyConfig *config)
+{
+    std::string data;
+    if (!readFile(cacheFile, &data)) {
+        ALOGV("%s: no snapshot %s", __func__, cacheFile);
+        return NAME_NOT_FOUND;
+    }
+    Parcel parcel;
+    RETURN_IF_ERROR(parcel.setData(reinterpret_cast<const uint8_t*>(data.data()), data.size()));
+
+    int32_t magic, version;
+    RETURN_IF_ERROR(parcel.readInt32(&magic));
+    RETURN_IF_ERROR(parcel.readInt32(&version));
+    std::string fingerprint;
+    RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&fingerprint));
+    if (magic != kMagic || version != kVersion || fingerprint != getBuildFingerprint()) {
+        ALOGW("%s: discarding snapshot %s from another build", __func__, cacheFile);
+        return BAD_VALUE;
+    }
+    uint32_t count;
+    RETURN_IF_ERROR(parcel.readUint32(&count));
+    for (uint32_t i = 0; i < count; i++) {
+        SourceFile expected, actual;
+        RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&expected.path));
+        RETURN_IF_ERROR(parcel.readInt64(&expected.size));
+        RETURN_IF_ERROR(parcel.readUint64(&expected.hash));
+        if ((i == 0 && expected.path != configFile) || !getSourceFile(expected.path, &actual)
+                || actual.size != expected.size || actual.hash != expected.hash) {
+            ALOGV("%s: snapshot %s is not up to date with %s", __func__, cacheFile,
+                    expected.path.c_str());
+            return BAD_VALUE;
+        }
+    }
+    if (count == 0) {
+        return BAD_VALUE;
+    }
+
+    bool speakerDrcEnabled, callScreenModeSupported;
+    RETURN_IF_ERROR(parcel.readBool(&speakerDrcEnabled));
+    RETURN_IF_ERROR(parcel.readBool(&callScreenModeSupported));
+    std::string engineLibraryNameSuffix;
+    RETURN_IF_ERROR(parcel.readUtf8FromUtf16(&engineLibraryNameSuffix));
+    AudioPolicyConfig::SurroundFormats surroundFormats;
+    RETURN_IF_ERROR(parcel.readUint32(&count));
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t format;
+        RETURN_IF_ERROR(parcel.readInt32(&format));
+        std::vector<int32_t> subformats;
+        RETURN_IF_ERROR(parcel.readInt32Vector(&subformats));
+        auto &formats = surroundFormats[static_cast<audio_format_t>(format)];
+        for (int32_t subformat : subformats) {
+            formats.insert(static_cast<audio_format_t>(subformat));
+        }
+    }
+    Snapshot snapshot;
+    RETURN_IF_ERROR(parcel.readUint32(&count));
+    for (uint32_t i = 0; i < count; i++) {
+        RETURN_IF_ERROR(readModule(parcel, &snapshot));
+    }
+    if (parcel.dataAvail() != 0) {
+        ALOGE("%s: corrupted snapshot %s", __func__, cacheFile);
+        return BAD_VALUE;
+    }
+
+    config->setHwModules(snapshot.modules);
+    for (const auto &device : snapshot.attachedDevices) {
+        config->addDevice(device);
+    }
+    if (snapshot.defaultOutputDevice != nullptr && config->getDefaultOutputDevice() == nullptr) {
+        config->setDefaultOutputDevice(snapshot.defaultOutputDevice);
+    }
+    config->setSpeakerDrcEnabled(speakerDrcEnabled);
+    config->setCallScreenModeSupported(callScreenModeSupported);
+    config->setEngineLibraryNameSuffix(engineLibraryNameSuffix);
+    config->setSurroundFormats(surroundFormats);
+    ALOGV("%s: restored %s from snapshot %s", __func__, configFile, cacheFile);
+    return NO_ERROR;
+}
+
+status_t saveAudioPolicyConfigCache(const char *cacheFile,
+                                    const std::vector<std::string> &sourceFiles,
+                                    const AudioPolicyConfig &config)
+{
+    Parcel parcel;
+    RETURN_IF_ERROR(parcel.writeInt32(kMagic));
+    RETURN_IF_ERROR(parcel.writeInt32(kVersion));
+    RETURN_IF_ERROR(parcel.writeUtf8AsUtf16(getBuildFingerprint()));
+    RETURN_IF_ERROR(parcel.writeUint32(sourceFiles.size()));
+    for (const auto &path : sourceFiles) {
+        SourceFile source;
+        if (!getSourceFile(path, &source)) {
+            ALOGW("%s: cannot read %s", __func__, path.c_str());
+            return NAME_NOT_FOUND;
+        }
+        RETURN_IF_ERROR(parcel.writeUtf8AsUtf16(source.path));
+        RETURN_IF_ERROR(parcel.writeInt64(source.size));
+        RETURN_IF_ERROR(parcel.writeUint64(source.hash));
+    }
+
+    RETURN_IF_ERROR(parcel.writeBool(config.isSpeakerDrcEnabled()));
+    RETURN_IF_ERROR(parcel.writeBool(config.isCallScreenModeSupported()));
+    RETURN_IF_ERROR(parcel.writeUtf8AsUtf16(config.getEngineLibraryNameSuffix()));
+    RETURN_IF_ERROR(parcel.writeUint32(config.getSurroundFormats().size()));
+    for (const auto &[format, subformats] : config.getSurroundFormats()) {
+        RETURN_IF_ERROR(parcel.writeInt32(format));
+        RETURN_IF_ERROR(parcel.writeInt32Vector(
+                std::vector<int32_t>(subformats.begin(), subformats.end())));
+    }
+    const HwModuleCollection modules = config.getHwModules();
+    RETURN_IF_ERROR(parcel.writeUint32(modules.size()));
+    for (const auto &module : modules) {
+        RETURN_IF_ERROR(writeModule(&parcel, module, config));
+    }
+
+    // write then rename so that a concurrent or interrupted save never leaves a partial snapshot
+    const std::string tmpFile = std::string(cacheFile) + ".tmp";
+    int fd = open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        ALOGW("%s: cannot create %s: %s", __func__, tmpFile.c_str(), strerror(errno));
+        return -errno;
+    }
+    const bool written = write(fd, parcel.data(), parcel.dataSize())
+            == static_cast<ssize_t>(parcel.dataSize());
+    close(fd);
+    if (!written || rename(tmpFile.c_str(), cacheFile) != 0) {
+        ALOGW("%s: cannot write %s", __func__, cacheFile);
+        unlink(tmpFile.c_str());
+        return INVALID_OPERATION;
+    }
+    return NO_ERROR;
+}
+
+} // namespace android
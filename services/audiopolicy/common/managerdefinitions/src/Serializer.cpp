@@ -17,18 +17,23 @@
 #define LOG_TAG "APM::Serializer"
 //#define LOG_NDEBUG 0
 
+#include <algorithm>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <hidl/Status.h>
 #include <libxml/parser.h>
 #include <libxml/xinclude.h>
+#include <libxml/xmlIO.h>
 #include <media/convert.h>
 #include <utils/Log.h>
 #include <utils/StrongPointer.h>
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
+#include "AudioPolicyConfigCache.h"
 #include "Serializer.h"
 #include "TypeConverter.h"
 
@@ -235,7 +240,10 @@ public:
     {
         ALOGV("%s: Version=%s Root=%s", __func__, mVersion.c_str(), rootName);
     }
-    status_t deserialize(const char *configFile, AudioPolicyConfig *config);
+    // If includedFiles is not null, the paths of the files opened to parse configFile are
+    // appended to it, including those of nested XIncludes.
+    status_t deserialize(const char *configFile, AudioPolicyConfig *config,
+                         std::vector<std::string> *includedFiles = nullptr);
 
 private:
     static constexpr const char *rootName = "audioPolicyConfiguration";
@@ -276,6 +284,48 @@ std::string getXmlAttribute(const xmlNode *cur, const char *attribute)
     return value;
 }
 
+// Files opened by the parser on this thread while deserialize() records them: the
+// configuration file and every file it includes, directly or from an included file.
+thread_local std::vector<std::string> *gOpenedFiles = nullptr;
+
+// Input match callback which records the file and lets the default callbacks open it.
+int recordOpenedFile(const char *uri)
+{
+    if (gOpenedFiles == nullptr || uri == nullptr) {
+        return 0;
+    }
+    static const std::string kFileScheme = "file://";
+    std::string path(uri);
+    if (path.compare(0, kFileScheme.size(), kFileScheme) == 0) {
+        path.erase(0, kFileScheme.size());
+    }
+    if (std::find(gOpenedFiles->begin(), gOpenedFiles->end(), path) == gOpenedFiles->end()) {
+        gOpenedFiles->push_back(path);
+    }
+    return 0;
+}
+
+// Records the files opened by the parser into files for the lifetime of this object.
+class OpenedFilesRecorder
+{
+public:
+    explicit OpenedFilesRecorder(std::vector<std::string> *files)
+    {
+        static std::once_flag registered;
+        std::call_once(registered, [] {
+            // the callbacks registered last are matched first, so the default ones must be
+            // registered before.
+            xmlInitParser();
+            xmlRegisterInputCallbacks(recordOpenedFile, nullptr, nullptr, nullptr);
+        });
+        gOpenedFiles = files;
+    }
+    ~OpenedFilesRecorder() { gOpenedFiles = nullptr; }
+
+    OpenedFilesRecorder(const OpenedFilesRecorder&) = delete;
+    OpenedFilesRecorder& operator=(const OpenedFilesRecorder&) = delete;
+};
+
 template <class Trait>
 const xmlNode* getReference(const xmlNode *cur, const std::string &refName)
 {
@@ -749,8 +799,13 @@ Return<SurroundSoundFormatTraits::Element> SurroundSoundFormatTraits::deserializ
     return pair;
 }
 
-status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig *config)
+status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig *config,
+                                       std::vector<std::string> *includedFiles)
 {
+    std::unique_ptr<OpenedFilesRecorder> recorder;
+    if (includedFiles != nullptr) {
+        recorder = std::make_unique<OpenedFilesRecorder>(includedFiles);
+    }
     auto doc = make_xmlUnique(xmlParseFile(configFile));
     if (doc == nullptr) {
         ALOGE("%s: Could not parse %s document.", __func__, configFile);
@@ -764,6 +819,7 @@ status_t PolicySerializer::deserialize(const char *configFile, AudioPolicyConfig
     if (xmlXIncludeProcess(doc.get()) < 0) {
         ALOGE("%s: libxml failed to resolve XIncludes on %s document.", __func__, configFile);
     }
+    recorder.reset();
 
     if (xmlStrcmp(root->name, reinterpret_cast<const xmlChar*>(rootName)))  {
         ALOGE("%s: No %s root element found in xml data %s.", __func__, rootName,
@@ -807,4 +863,20 @@ status_t deserializeAudioPolicyFile(const char *fileName, AudioPolicyConfig *con
     return serializer.deserialize(fileName, config);
 }
 
+status_t deserializeAudioPolicyFile(const char *fileName, AudioPolicyConfig *config,
+                                   const char *cacheFile)
+{
+    if (loadAudioPolicyConfigCache(cacheFile, fileName, config) == NO_ERROR) {
+        return NO_ERROR;
+    }
+    PolicySerializer serializer;
+    std::vector<std::string> sourceFiles{fileName};
+    status_t status = serializer.deserialize(fileName, config, &sourceFiles);
+    if (status == NO_ERROR) {
+        // a failure only costs parsing again on next start
+        saveAudioPolicyConfigCache(cacheFile, sourceFiles, *config);
+    }
+    return status;
+}
+
 } // namespace android
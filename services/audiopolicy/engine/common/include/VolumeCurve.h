@@ -25,9 +25,11 @@
 #include <utils/KeyedVector.h>
 #include <system/audio.h>
 #include <cutils/config_utils.h>
+#include <algorithm>
 #include <string>
 #include <map>
 #include <utility>
+#include <vector>
 
 namespace android {
 
@@ -57,6 +59,8 @@ public:
 
     float volIndexToDb(int indexInUi, int volIndexMin, int volIndexMax) const;
 
+    bool isEmpty() const { return mCurvePoints.isEmpty(); }
+
     void dump(String8 *dst, int spaces = 0, bool curvePoints = false) const;
 
     device_category getDeviceCategory() const { return mDeviceCategory; }
@@ -66,7 +70,9 @@ private:
     SortedVector<CurvePoint> mCurvePoints;
 };
 
-// Volume Curves for a given use case indexed by device category
+// Volume Curves for a given use case indexed by device category.
+// The attenuation of each volume index is precomputed per device category when a curve is added
+// or switched and when the index range changes: curves must be complete when added.
 class VolumeCurves : public KeyedVector<device_category, sp<VolumeCurve> >,
                      public IVolumeCurves
 {
@@ -80,6 +86,9 @@ public:
     {
         mIndexMin = indexMin;
         mIndexMax = indexMax;
+        for (size_t index = 0; index < size(); index++) {
+            updateVolumeTable(keyAt(index));
+        }
         return NO_ERROR;
     }
 
@@ -144,6 +153,7 @@ public:
     {
         ALOG_ASSERT(indexOfKey(deviceCategory) >= 0, "Invalid device category for Volume Curve");
         replaceValueFor(deviceCategory, volumeCurve);
+        updateVolumeTable(deviceCategory);
     }
 
     ssize_t add(const sp<VolumeCurve> &volumeCurve)
@@ -153,13 +163,19 @@ public:
         if (index < 0) {
             // Keep track of original Volume Curves per device category in order to switch curves.
             mOriginVolumeCurves.add(deviceCategory, volumeCurve);
-            return KeyedVector::add(deviceCategory, volumeCurve);
+            index = KeyedVector::add(deviceCategory, volumeCurve);
+            updateVolumeTable(deviceCategory);
         }
         return index;
     }
 
     virtual float volIndexToDb(device_category deviceCat, int indexInUi) const
     {
+        const auto table = mVolumeTables.find(deviceCat);
+        if (table != mVolumeTables.end() && indexInUi >= 0) {
+            // indices above max are clamped by the curve
+            return table->second[std::min<size_t>(indexInUi, table->second.size() - 1)];
+        }
         sp<VolumeCurve> vc = getCurvesFor(deviceCat);
         if (vc != 0) {
             return vc->volIndexToDb(indexInUi, mIndexMin, mIndexMax);
@@ -182,7 +198,15 @@ public:
     void dump(String8 *dst, int spaces = 0, bool curvePoints = false) const override;
 
 private:
+    // Largest index range for which attenuations are precomputed.
+    static constexpr int kMaxVolumeTableIndex = 1000;
+
+    // Precomputes the attenuation of indices 0 to mIndexMax for the curve of deviceCategory.
+    void updateVolumeTable(device_category deviceCategory);
+
     KeyedVector<device_category, sp<VolumeCurve> > mOriginVolumeCurves;
+    /** attenuation in dB per volume index from 0 to mIndexMax, per device category. */
+    std::map<device_category, std::vector<float>> mVolumeTables;
     std::map<audio_devices_t, int> mIndexCur; /**< current volume index per device. */
     int mIndexMin; /**< min volume index. */
     int mIndexMax; /**< max volume index. */
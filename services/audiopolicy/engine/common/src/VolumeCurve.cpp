@@ -77,6 +77,22 @@ float VolumeCurve::volIndexToDb(int indexInUi, int volIndexMin, int volIndexMax)
     return decibels;
 }
 
+void VolumeCurves::updateVolumeTable(device_category deviceCategory)
+{
+    mVolumeTables.erase(deviceCategory);
+    sp<VolumeCurve> curve = getCurvesFor(deviceCategory);
+    // other cases are handled by the curve: uninitialized or invalid range, empty curve
+    if (curve == 0 || curve->isEmpty() || mIndexMin < 0 || mIndexMax <= mIndexMin
+            || mIndexMax > kMaxVolumeTableIndex) {
+        return;
+    }
+    std::vector<float> &table = mVolumeTables[deviceCategory];
+    table.reserve(mIndexMax + 1);
+    for (int index = 0; index <= mIndexMax; index++) {
+        table.push_back(curve->volIndexToDb(index, mIndexMin, mIndexMax));
+    }
+}
+
 void VolumeCurve::dump(String8 *dst, int spaces, bool curvePoints) const
 {
     if (!curvePoints) {
@@ -35,10 +35,14 @@
         "audio_policy_configuration_a2dp_offload_disabled.xml"
 #define AUDIO_POLICY_BLUETOOTH_LEGACY_HAL_XML_CONFIG_FILE_NAME \
         "audio_policy_configuration_bluetooth_legacy_hal.xml"
+// Snapshot of the last configuration parsed, see AudioPolicyConfigCache.h
+#define AUDIO_POLICY_XML_CONFIG_CACHE_FILE \
+        "/data/misc/audioserver/audio_policy_configuration.bin"
 
 #include <algorithm>
 #include <inttypes.h>
 #include <math.h>
+#include <optional>
 #include <set>
 #include <unordered_set>
 #include <vector>
@@ -142,6 +146,7 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(const sp<DeviceDescript
 {
     // handle output devices
     if (audio_is_output_device(device->type())) {
+        const nsecs_t startNs = systemTime();
         SortedVector <audio_io_handle_t> outputs;
 
         ssize_t index = mAvailableOutputDevices.indexOf(device);
@@ -219,6 +224,16 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(const sp<DeviceDescript
         // Propagate device availability to Engine
         setEngineDeviceConnectionState(device, state);
 
+        // Only the strategies whose routing can change and the outputs they use are re-evaluated
+        RoutingUpdateTrace::Event &routingUpdate =
+                mRoutingUpdates.begin(device->type(), device->address(), state, startNs);
+        const std::map<product_strategy_t, DeviceVector> strategies =
+                getStrategiesToReroute(outputs);
+        routingUpdate.strategies = mEngine->getOrderedProductStrategies().size();
+        for (const auto &strategy : strategies) {
+            routingUpdate.changedStrategies.push_back(strategy.first);
+        }
+
         // No need to evaluate playback routing when connecting a remote submix
         // output device used by a dynamic policy of type recorder as no
         // playback use case is affected.
@@ -256,7 +271,7 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(const sp<DeviceDescript
         };
 
         if (doCheckForDeviceAndOutputChanges) {
-            checkForDeviceAndOutputChanges(checkCloseOutputs);
+            checkForDeviceAndOutputChanges(checkCloseOutputs, &strategies);
         } else {
             checkCloseOutputs();
         }
@@ -266,10 +281,25 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(const sp<DeviceDescript
             updateCallRouting(newDevices);
         }
         const DeviceVector msdOutDevices = getMsdAudioOutDevices();
+        routingUpdate.outputs = mOutputs.size();
         for (size_t i = 0; i < mOutputs.size(); i++) {
             sp<SwAudioOutputDescriptor> desc = mOutputs.valueAt(i);
             if ((mEngine->getPhoneState() != AUDIO_MODE_IN_CALL) || (desc != mPrimaryOutput)) {
                 DeviceVector newDevices = getNewOutputDevices(desc, true /*fromCache*/);
+                // leave alone an output whose devices do not change, which was not opened by
+                // this connection and which no re-evaluated strategy can be routed to: neither
+                // its patch nor its strategy mute state can change.
+                if (!desc->isDuplicated() && desc->getPatchHandle() != AUDIO_PATCH_HANDLE_NONE
+                        && outputs.indexOf(mOutputs.keyAt(i)) < 0
+                        && desc->filterSupportedDevices(newDevices) == desc->devices()
+                        && std::none_of(strategies.begin(), strategies.end(),
+                                [&desc](const auto &strategy) {
+                                    return desc->supportedDevices().containsAtLeastOne(
+                                            strategy.second);
+                                })) {
+                    continue;
+                }
+                routingUpdate.reroutedOutputs.push_back(mOutputs.keyAt(i));
                 // do not force device change on duplicated output because if device is 0, it will
                 // also force a device 0 for the two outputs it is duplicated to which may override
                 // a valid device selection on those outputs.
@@ -287,6 +317,11 @@ status_t AudioPolicyManager::setDeviceConnectionStateInt(const sp<DeviceDescript
         }
 
         mpClientInterface->onAudioPortListUpdate();
+        mRoutingUpdates.end(routingUpdate);
+        ALOGV("%s() %zu/%zu strategies and %zu/%zu outputs re-evaluated in %" PRId64 " us",
+                __func__, routingUpdate.changedStrategies.size(), routingUpdate.strategies,
+                routingUpdate.reroutedOutputs.size(), routingUpdate.outputs,
+                ns2us(routingUpdate.durationNs));
         return NO_ERROR;
     }  // end if is output device
 
@@ -932,6 +967,34 @@ status_t AudioPolicyManager::getOutputForAttrInt(
     ALOGV("%s() attributes=%s stream=%s session %d selectedDeviceId %d", __func__,
           toString(*resultAttr).c_str(), toString(*stream).c_str(), session, requestedPortId);
 
+    std::optional<RoutingDecisionCache::Key> cacheKey;
+    product_strategy_t strategy = PRODUCT_STRATEGY_NONE;
+    nsecs_t now = 0;
+    if (msdDevices.isEmpty() && isRoutingDecisionCacheable(*resultAttr, *stream, config, *flags)) {
+        cacheKey.emplace(*resultAttr, *stream, uid, requestedPortId, *config, *flags);
+        strategy = mEngine->getProductStrategyForAttributes(*resultAttr);
+        now = systemTime();
+        if (mRoutingDecisions.needsValidation(strategy, now)) {
+            mRoutingDecisions.validate(now, [this](const audio_attributes_t &attributes) {
+                return getRoutingDecisionDevices(attributes);
+            }, strategy);
+        }
+        RoutingDecisionCache::Decision decision;
+        if (mRoutingDecisions.lookup(strategy, *cacheKey, &decision)
+                && mOutputs.indexOfKey(decision.output) >= 0) {
+            *output = decision.output;
+            *selectedDeviceId = decision.selectedDeviceId;
+            *flags = decision.flags;
+            *isRequestedDeviceForExclusiveUse = decision.isRequestedDeviceForExclusiveUse;
+            *outputType = decision.outputType;
+            ALOGV("%s returns cached output %d selectedDeviceId %d",
+                  __func__, *output, *selectedDeviceId);
+            return NO_ERROR;
+        }
+    } else if (mRoutingDecisions.isEnabled()) {
+        mRoutingDecisions.bypass();
+    }
+
     // The primary output is the explicit routing (eg. setPreferredDevice) if specified,
     //       otherwise, fallback to the dynamic policies, if none match, query the engine.
     // Secondary outputs are always found by dynamic policies as the engine do not support them
@@ -1047,9 +1110,61 @@ status_t AudioPolicyManager::getOutputForAttrInt(
 
     ALOGV("%s returns output %d selectedDeviceId %d", __func__, *output, *selectedDeviceId);
 
+    // Only cache decisions no dynamic policy took part in. If secondary mixes were not queried,
+    // a later request querying them must not hit.
+    if (cacheKey.has_value() && primaryMix == nullptr
+            && (secondaryMixes != nullptr ? secondaryMixes->empty() : mPolicyMixes.isEmpty())) {
+        const DeviceVector strategyDevices = requestedDevice == nullptr ?
+                outputDevices : getRoutingDecisionDevices(*resultAttr);
+        mRoutingDecisions.store(strategy, *resultAttr, strategyDevices, now, *cacheKey,
+                {*output, *selectedDeviceId, *flags, *isRequestedDeviceForExclusiveUse,
+                 *outputType});
+    }
+
     return NO_ERROR;
 }
 
+DeviceVector AudioPolicyManager::getRoutingDecisionDevices(
+        const audio_attributes_t &attributes) const
+{
+    return mEngine->getOutputDevicesForAttributes(attributes, nullptr, false /*fromCache*/);
+}
+
+void AudioPolicyManager::validateRoutingDecisions(bool clientStopped)
+{
+    if (!mRoutingDecisions.isEnabled()) {
+        return;
+    }
+    const nsecs_t now = systemTime();
+    if (clientStopped) {
+        mRoutingDecisions.onClientStopped(now);
+    }
+    mRoutingDecisions.validate(now, [this](const audio_attributes_t &attributes) {
+        return getRoutingDecisionDevices(attributes);
+    });
+}
+
+bool AudioPolicyManager::isRoutingDecisionCacheable(const audio_attributes_t &attr,
+                                                    audio_stream_type_t stream,
+                                                    const audio_config_t *config,
+                                                    audio_output_flags_t flags) const
+{
+    if (!mRoutingDecisions.isEnabled()) {
+        return false;
+    }
+    // Requests for which openDirectOutput() is bypassed once getOutputForDevices() has adjusted
+    // the flags: direct outputs are opened with side effects and depend on the session.
+    const audio_output_flags_t directFlags = (audio_output_flags_t)(AUDIO_OUTPUT_FLAG_DIRECT |
+            AUDIO_OUTPUT_FLAG_COMPRESS_OFFLOAD | AUDIO_OUTPUT_FLAG_HW_AV_SYNC |
+            AUDIO_OUTPUT_FLAG_MMAP_NOIRQ);
+    return (flags & directFlags) == 0 &&
+            (attr.flags & AUDIO_FLAG_HW_AV_SYNC) == 0 &&
+            stream != AUDIO_STREAM_VOICE_CALL &&
+            audio_is_linear_pcm(config->format) &&
+            config->sample_rate <= SAMPLE_RATE_HZ_MAX &&
+            audio_channel_count_from_out_mask(config->channel_mask) <= 2;
+}
+
 status_t AudioPolicyManager::getOutputForAttr(const audio_attributes_t *attr,
                                               audio_io_handle_t *output,
                                               audio_session_t session,
@@ -1620,6 +1735,8 @@ status_t AudioPolicyManager::startOutput(audio_port_handle_t portId)
 
     uint32_t delayMs;
     status = startSource(outputDesc, client, &delayMs);
+    // client activity and preferred devices are taken into account by the device selection
+    validateRoutingDecisions(false /*clientStopped*/);
 
     if (status != NO_ERROR) {
         outputDesc->stop();
@@ -1824,6 +1941,7 @@ status_t AudioPolicyManager::stopOutput(audio_port_handle_t portId)
           outputDesc->mIoHandle, client->stream(), client->session());
 
     status_t status = stopSource(outputDesc, client);
+    validateRoutingDecisions(true /*clientStopped*/);
 
     if (status == NO_ERROR ) {
         outputDesc->stop();
@@ -3002,6 +3120,8 @@ status_t AudioPolicyManager::registerPolicyMixes(const Vector<AudioMix>& mixes)
             }
         }
     }
+    // mixes, including loop back mixes, take part in the output selection
+    mRoutingDecisions.invalidate();
     if (res != NO_ERROR) {
         unregisterPolicyMixes(mixes);
     } else if (checkOutputs) {
@@ -3061,6 +3181,7 @@ status_t AudioPolicyManager::unregisterPolicyMixes(Vector<AudioMix> mixes)
             }
         }
     }
+    mRoutingDecisions.invalidate();
     if (res == NO_ERROR && checkOutputs) {
         checkForDeviceAndOutputChanges();
         updateCallAndOutputRouting();
@@ -3269,6 +3390,8 @@ void AudioPolicyManager::dump(String8 *dst) const
     mAudioPatches.dump(dst);
     mPolicyMixes.dump(dst);
     mAudioSources.dump(dst);
+    mRoutingDecisions.dump(dst);
+    mRoutingUpdates.dump(dst);
 
     dst->appendFormat(" AllowedCapturePolicies:\n");
     for (auto& policy : mAllowedCapturePolicies) {
@@ -3290,6 +3413,7 @@ status_t AudioPolicyManager::dump(int fd)
 status_t AudioPolicyManager::setAllowedCapturePolicy(uid_t uid, audio_flags_mask_t capturePolicy)
 {
     mAllowedCapturePolicies[uid] = capturePolicy;
+    mRoutingDecisions.invalidate();
     return NO_ERROR;
 }
 
@@ -4130,6 +4254,7 @@ status_t AudioPolicyManager::connectAudioSource(const sp<SourceClientDescriptor>
         swOutput->addClient(sourceDesc);
         uint32_t delayMs = 0;
         status = startSource(swOutput, sourceDesc, &delayMs);
+        validateRoutingDecisions(false /*clientStopped*/);
         if (status != NO_ERROR) {
             ALOGW("%s failed to start source, error %d", __FUNCTION__, status);
             goto FailureSourceActive;
@@ -4401,6 +4526,7 @@ status_t AudioPolicyManager::disconnectAudioSource(const sp<SourceClientDescript
     sp<SwAudioOutputDescriptor> swOutput = sourceDesc->swOutput().promote();
     if (swOutput != 0) {
         status_t status = stopSource(swOutput, sourceDesc);
+        validateRoutingDecisions(true /*clientStopped*/);
         if (status == NO_ERROR) {
             swOutput->stop();
         }
@@ -4464,7 +4590,8 @@ static status_t deserializeAudioPolicyXmlConfig(AudioPolicyConfig &config) {
         for (const auto& path : audio_get_configuration_paths()) {
             snprintf(audioPolicyXmlConfigFile, sizeof(audioPolicyXmlConfigFile),
                      "%s/%s", path.c_str(), fileName);
-            ret = deserializeAudioPolicyFile(audioPolicyXmlConfigFile, &config);
+            ret = deserializeAudioPolicyFile(audioPolicyXmlConfigFile, &config,
+                                             AUDIO_POLICY_XML_CONFIG_CACHE_FILE);
             if (ret == NO_ERROR) {
                 config.setSource(audioPolicyXmlConfigFile);
                 return ret;
@@ -4729,6 +4856,7 @@ void AudioPolicyManager::addOutput(audio_io_handle_t output,
                                    const sp<SwAudioOutputDescriptor>& outputDesc)
 {
     mOutputs.add(output, outputDesc);
+    mRoutingDecisions.invalidate();
     applyStreamVolumes(outputDesc, DeviceTypeSet(), 0 /* delayMs */, true /* force */);
     updateMono(output); // update mono status when adding to output list
     selectOutputForMusicEffects();
@@ -4738,6 +4866,7 @@ void AudioPolicyManager::addOutput(audio_io_handle_t output,
 void AudioPolicyManager::removeOutput(audio_io_handle_t output)
 {
     mOutputs.removeItem(output);
+    mRoutingDecisions.invalidate();
     selectOutputForMusicEffects();
 }
 
@@ -5208,12 +5337,13 @@ SortedVector<audio_io_handle_t> AudioPolicyManager::getOutputsForDevices(
     return outputs;
 }
 
-void AudioPolicyManager::checkForDeviceAndOutputChanges(std::function<bool()> onOutputsChecked)
+void AudioPolicyManager::checkForDeviceAndOutputChanges(std::function<bool()> onOutputsChecked,
+        const std::map<product_strategy_t, DeviceVector> *strategies)
 {
     // checkA2dpSuspend must run before checkOutputForAllStrategies so that A2DP
     // output is suspended before any tracks are moved to it
     checkA2dpSuspend();
-    checkOutputForAllStrategies();
+    checkOutputForAllStrategies(strategies);
     checkSecondaryOutputs();
     if (onOutputsChecked != nullptr && onOutputsChecked()) checkA2dpSuspend();
     updateDevicesAndOutputs();
@@ -5342,14 +5472,55 @@ void AudioPolicyManager::checkOutputForAttributes(const audio_attributes_t &attr
     }
 }
 
-void AudioPolicyManager::checkOutputForAllStrategies()
+void AudioPolicyManager::checkOutputForAllStrategies(
+        const std::map<product_strategy_t, DeviceVector> *strategies)
 {
     for (const auto &strategy : mEngine->getOrderedProductStrategies()) {
+        if (strategies != nullptr && strategies->count(strategy) == 0) {
+            continue;
+        }
         auto attributes = mEngine->getAllAttributesForProductStrategy(strategy).front();
         checkOutputForAttributes(attributes);
     }
 }
 
+std::map<product_strategy_t, DeviceVector> AudioPolicyManager::getStrategiesToReroute(
+        const SortedVector<audio_io_handle_t> &outputs)
+{
+    // outputs opened or closed since mPreviousOutputs was saved, in addition to the ones
+    // reported by checkOutputsForDevice()
+    std::vector<sp<SwAudioOutputDescriptor>> changedOutputs;
+    for (size_t i = 0; i < mOutputs.size(); i++) {
+        if (outputs.indexOf(mOutputs.keyAt(i)) >= 0
+                || mPreviousOutputs.indexOfKey(mOutputs.keyAt(i)) < 0) {
+            changedOutputs.push_back(mOutputs.valueAt(i));
+        }
+    }
+    for (size_t i = 0; i < mPreviousOutputs.size(); i++) {
+        if (mOutputs.indexOfKey(mPreviousOutputs.keyAt(i)) < 0) {
+            changedOutputs.push_back(mPreviousOutputs.valueAt(i));
+        }
+    }
+
+    std::map<product_strategy_t, DeviceVector> strategies;
+    for (const auto &strategy : mEngine->getOrderedProductStrategies()) {
+        auto attributes = mEngine->getAllAttributesForProductStrategy(strategy).front();
+        DeviceVector devices =
+                mEngine->getOutputDevicesForAttributes(attributes, nullptr, true /*fromCache*/);
+        const DeviceVector newDevices =
+                mEngine->getOutputDevicesForAttributes(attributes, nullptr, false /*fromCache*/);
+        bool reroute = devices != newDevices;
+        devices.add(newDevices);
+        for (size_t i = 0; i < changedOutputs.size() && !reroute; i++) {
+            reroute = changedOutputs[i]->supportedDevices().containsAtLeastOne(devices);
+        }
+        if (reroute) {
+            strategies.emplace(strategy, devices);
+        }
+    }
+    return strategies;
+}
+
 void AudioPolicyManager::checkSecondaryOutputs() {
     std::set<audio_stream_type_t> streamsToInvalidate;
     for (size_t i = 0; i < mOutputs.size(); i++) {
@@ -5661,6 +5832,7 @@ uint32_t AudioPolicyManager::setBeaconMute(bool mute) {
 void AudioPolicyManager::updateDevicesAndOutputs()
 {
     mEngine->updateDeviceSelectionCache();
+    mRoutingDecisions.invalidate();
     mPreviousOutputs = mOutputs;
 }
 
@@ -18,6 +18,7 @@
 
 #include <atomic>
 #include <functional>
+#include <map>
 #include <memory>
 #include <unordered_set>
 
@@ -48,6 +49,8 @@
 #include <EffectDescriptor.h>
 #include <SoundTriggerSession.h>
 #include "EngineLibrary.h"
+#include "RoutingDecisionCache.h"
+#include "RoutingUpdateTrace.h"
 #include "TypeConverter.h"
 
 namespace android {
@@ -523,7 +526,9 @@ protected:
         // if 'onOutputsChecked' callback is provided, it is executed after the outputs
         // check via 'checkOutputForAllStrategies'. If the callback returns 'true',
         // A2DP suspend status is rechecked.
-        void checkForDeviceAndOutputChanges(std::function<bool()> onOutputsChecked = nullptr);
+        // If 'strategies' is provided, only the outputs of these product strategies are checked.
+        void checkForDeviceAndOutputChanges(std::function<bool()> onOutputsChecked = nullptr,
+                const std::map<product_strategy_t, DeviceVector> *strategies = nullptr);
 
         /**
          * @brief updates routing for all outputs (including call if call in progress).
@@ -547,8 +552,21 @@ protected:
         /**
          * @brief checkOutputForAllStrategies Same as @see checkOutputForAttributes()
          *      but for a all product strategies in order of priority
+         * @param strategies if not null, only the product strategies in this map are checked
          */
-        void checkOutputForAllStrategies();
+        void checkOutputForAllStrategies(
+                const std::map<product_strategy_t, DeviceVector> *strategies = nullptr);
+
+        /**
+         * @brief getStrategiesToReroute returns the product strategies which must be checked
+         *      after a device connection state change: the ones whose devices selected by the
+         *      engine changed, and the ones which can be routed to an output opened or closed by
+         *      the change. Must be called before updateDevicesAndOutputs().
+         * @param outputs outputs returned by checkOutputsForDevice()
+         * @return map of the product strategies to their previous and new devices
+         */
+        std::map<product_strategy_t, DeviceVector> getStrategiesToReroute(
+                const SortedVector<audio_io_handle_t> &outputs);
 
         // Same as checkOutputForStrategy but for secondary outputs. Make sure if a secondary
         // output condition changes, the track is properly rerouted
@@ -787,6 +805,12 @@ protected:
         std::unordered_set<audio_format_t> mManualSurroundFormats;
 
         std::unordered_map<uid_t, audio_flags_mask_t> mAllowedCapturePolicies;
+
+        // Outputs selected for mixed playback requests, see getOutputForAttrInt().
+        RoutingDecisionCache mRoutingDecisions;
+
+        // Strategies and outputs re-evaluated on the last device connection state changes.
+        RoutingUpdateTrace mRoutingUpdates;
 protected:
         void onNewAudioModulesAvailableInt(DeviceVector *newDevices);
 
@@ -839,6 +863,18 @@ protected:
                 bool *isRequestedDeviceForExclusiveUse,
                 std::vector<sp<AudioPolicyMix>> *secondaryMixes,
                 output_type_t *outputType);
+        // Returns the devices the engine selects for attributes without explicit routing, which
+        // cached routing decisions are checked against.
+        DeviceVector getRoutingDecisionDevices(const audio_attributes_t &attributes) const;
+        // Drops the cached routing decisions of the strategies for which client activity changed
+        // the devices selected by the engine.
+        void validateRoutingDecisions(bool clientStopped);
+        // Returns true if the request can only be served by a mixed output, in which case
+        // getOutputForAttrInt() has no side effect and its decision can be cached.
+        bool isRoutingDecisionCacheable(const audio_attributes_t &attr,
+                audio_stream_type_t stream,
+                const audio_config_t *config,
+                audio_output_flags_t flags) const;
         // internal method to return the output handle for the given device and format
         virtual audio_io_handle_t getOutputForDevices(
                 const DeviceVector &devices,
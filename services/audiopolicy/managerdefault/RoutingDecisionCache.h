@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <tuple>
+
+#include <string.h>
+#include <sys/types.h>
+
+#include <DeviceDescriptor.h>
+#include <policy.h>
+#include <system/audio.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include "AudioPolicyInterface.h"
+
+namespace android {
+
+// Memoizes the output selected by AudioPolicyManager::getOutputForAttrInt() for requests which
+// can only be served by a mixed output.
+//
+// A decision depends on the available devices, the phone state and forced usages, the preferred
+// devices and device affinities, the registered policy mixes and the opened outputs. The policy
+// manager must call invalidate() whenever any of these changes, which advances the generation
+// and drops all decisions taken with the previous state.
+//
+// Decisions are grouped by product strategy, with the devices the engine selected for the
+// strategy when they were taken. Client activity only changes the engine selection of some
+// strategies (e.g. sonification follows active calls and media, and the active clients with a
+// preferred device take precedence), so on client start and stop the policy manager queries the
+// engine again for each cached strategy and only drops those whose devices changed.
+class RoutingDecisionCache {
+public:
+    // Requests differing only by audio session share a decision: the session only matters when
+    // opening direct outputs, which are never cached.
+    struct Key {
+        audio_usage_t usage;
+        audio_content_type_t contentType;
+        audio_source_t source;
+        audio_flags_mask_t attributesFlags;
+        std::string tags;
+        audio_stream_type_t stream;
+        uid_t uid;
+        audio_port_handle_t requestedPortId;
+        uint32_t sampleRate;
+        audio_channel_mask_t channelMask;
+        audio_format_t format;
+        audio_output_flags_t flags;
+
+        Key(const audio_attributes_t &attributes, audio_stream_type_t stream, uid_t uid,
+                audio_port_handle_t requestedPortId, const audio_config_t &config,
+                audio_output_flags_t flags)
+            : usage(attributes.usage), contentType(attributes.content_type),
+              source(attributes.source), attributesFlags(attributes.flags),
+              tags(attributes.tags, strnlen(attributes.tags, AUDIO_ATTRIBUTES_TAGS_MAX_SIZE)),
+              stream(stream), uid(uid), requestedPortId(requestedPortId),
+              sampleRate(config.sample_rate), channelMask(config.channel_mask),
+              format(config.format), flags(flags) {}
+
+        auto asTuple() const {
+            return std::tie(usage, contentType, source, attributesFlags, tags, stream, uid,
+                    requestedPortId, sampleRate, channelMask, format, flags);
+        }
+
+        bool operator<(const Key &other) const {
+            return asTuple() < other.asTuple();
+        }
+    };
+
+    struct Decision {
+        audio_io_handle_t output;
+        audio_port_handle_t selectedDeviceId;
+        audio_output_flags_t flags;     // output flags as adjusted by the selection
+        bool isRequestedDeviceForExclusiveUse;
+        AudioPolicyInterface::output_type_t outputType;
+    };
+
+    // Decisions taken for the requests following a product strategy.
+    struct Strategy {
+        // attributes of one of the requests, to query the engine for the strategy again
+        audio_attributes_t attributes;
+        // devices selected by the engine for the strategy, without explicit routing
+        DeviceVector devices;
+        // last time the devices were checked against the engine
+        nsecs_t validatedNs;
+        std::map<Key, Decision> decisions;
+    };
+
+    // Upper bound on the number of decisions kept, all are dropped when reached.
+    static constexpr size_t kMaxDecisions = 64;
+
+    bool isEnabled() const { return mEnabled; }
+    void setEnabled(bool enabled) {
+        mEnabled = enabled;
+        invalidate();
+    }
+
+    // Returns true and fills decision if a decision was taken for key in the current generation.
+    bool lookup(product_strategy_t strategy, const Key &key, Decision *decision) {
+        auto it = mStrategies.find(strategy);
+        if (it != mStrategies.end()) {
+            auto decisionIt = it->second.decisions.find(key);
+            if (decisionIt != it->second.decisions.end()) {
+                ++mHits;
+                *decision = decisionIt->second;
+                return true;
+            }
+        }
+        ++mMisses;
+        return false;
+    }
+
+    // Stores a decision for a request following strategy, for which the engine selected devices
+    // without explicit routing. Decisions taken with other devices are dropped.
+    void store(product_strategy_t strategy, const audio_attributes_t &attributes,
+            const DeviceVector &devices, nsecs_t now, const Key &key, const Decision &decision) {
+        if (mSize >= kMaxDecisions) {
+            invalidate();
+        }
+        auto [it, inserted] = mStrategies.try_emplace(strategy);
+        Strategy &entry = it->second;
+        if (inserted || entry.devices != devices) {
+            mSize -= entry.decisions.size();
+            entry.decisions.clear();
+            entry.attributes = attributes;
+            entry.devices = devices;
+            entry.validatedNs = now;
+        }
+        mSize -= entry.decisions.size();
+        entry.decisions.insert_or_assign(key, decision);
+        mSize += entry.decisions.size();
+    }
+
+    // Counts a request which cannot be cached, e.g. because it may need a direct output.
+    void bypass() { ++mBypasses; }
+
+    void invalidate() {
+        ++mGeneration;
+        mStrategies.clear();
+        mSize = 0;
+    }
+
+    // Drops the decisions taken for strategy.
+    void invalidate(product_strategy_t strategy) {
+        auto it = mStrategies.find(strategy);
+        if (it != mStrategies.end()) {
+            ++mGeneration;
+            ++mStrategyInvalidations;
+            mSize -= it->second.decisions.size();
+            mStrategies.erase(it);
+        }
+    }
+
+    // Records that a client stopped at now. Some engines keep routing as if a stream was active
+    // for a while after it stopped (see SONIFICATION_RESPECTFUL_AFTER_MUSIC_DELAY), so the
+    // devices of the strategies must be checked again on lookups until that delay has elapsed.
+    void onClientStopped(nsecs_t now) { mLastStopNs = now; }
+
+    // Returns true if the devices of the strategy must be checked against the engine before
+    // its decisions are used at time now.
+    bool needsValidation(product_strategy_t strategy, nsecs_t now) const {
+        auto it = mStrategies.find(strategy);
+        return it != mStrategies.end() && mLastStopNs != 0
+                && it->second.validatedNs <= mLastStopNs + kActivityDelayNs
+                && now > it->second.validatedNs;
+    }
+
+    // Checks the devices of each strategy, or only of strategy if not PRODUCT_STRATEGY_NONE,
+    // with getDevices(attributes) and drops the decisions of those for which they changed.
+    template <typename GetDevices>
+    void validate(nsecs_t now, GetDevices getDevices,
+            product_strategy_t strategy = PRODUCT_STRATEGY_NONE) {
+        for (auto it = mStrategies.begin(); it != mStrategies.end(); ) {
+            if (strategy != PRODUCT_STRATEGY_NONE && it->first != strategy) {
+                ++it;
+                continue;
+            }
+            ++mValidations;
+            if (getDevices(it->second.attributes) != it->second.devices) {
+                ++mGeneration;
+                ++mStrategyInvalidations;
+                mSize -= it->second.decisions.size();
+                it = mStrategies.erase(it);
+            } else {
+                it->second.validatedNs = now;
+                ++it;
+            }
+        }
+    }
+
+    uint64_t generation() const { return mGeneration; }
+    uint64_t hits() const { return mHits; }
+    uint64_t misses() const { return mMisses; }
+    uint64_t strategyInvalidations() const { return mStrategyInvalidations; }
+    size_t size() const { return mSize; }
+    size_t size(product_strategy_t strategy) const {
+        auto it = mStrategies.find(strategy);
+        return it != mStrategies.end() ? it->second.decisions.size() : 0;
+    }
+
+    void dump(String8 *dst) const {
+        const uint64_t lookups = mHits + mMisses;
+        dst->appendFormat(" Routing decision cache: %s, %zu decisions in %zu strategies, "
+                "generation %llu\n", mEnabled ? "enabled" : "disabled", mSize,
+                mStrategies.size(), (unsigned long long)mGeneration);
+        dst->appendFormat("  hits %llu, misses %llu, bypasses %llu, hit rate %.1f%%\n",
+                (unsigned long long)mHits, (unsigned long long)mMisses,
+                (unsigned long long)mBypasses, lookups != 0 ? mHits * 100. / lookups : 0.);
+        dst->appendFormat("  validations %llu, strategy invalidations %llu\n",
+                (unsigned long long)mValidations, (unsigned long long)mStrategyInvalidations);
+    }
+
+private:
+    static constexpr nsecs_t kActivityDelayNs =
+            SONIFICATION_RESPECTFUL_AFTER_MUSIC_DELAY * 1000000LL;
+
+    bool mEnabled = true;
+    uint64_t mGeneration = 0;
+    std::map<product_strategy_t, Strategy> mStrategies;
+    size_t mSize = 0;
+    nsecs_t mLastStopNs = 0;
+
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+    uint64_t mBypasses = 0;
+    uint64_t mValidations = 0;
+    uint64_t mStrategyInvalidations = 0;
+};
+
+} // namespace android
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <policy.h>
+#include <system/audio.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+// Records, for the last device connection state changes, which product strategies changed
+// device selection and which outputs were checked and re-routed as a consequence.
+class RoutingUpdateTrace {
+public:
+    struct Event {
+        nsecs_t startNs = 0;
+        nsecs_t durationNs = 0;
+        audio_devices_t device = AUDIO_DEVICE_NONE;
+        std::string address;
+        audio_policy_dev_state_t state = AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE;
+        size_t strategies = 0;                              // strategies evaluated
+        std::vector<product_strategy_t> changedStrategies;  // strategies re-evaluated
+        size_t outputs = 0;                                 // outputs evaluated
+        std::vector<audio_io_handle_t> reroutedOutputs;     // outputs passed to setOutputDevices
+    };
+
+    static constexpr size_t kMaxEvents = 16;
+
+    // Starts recording the event for a state change of device which started being handled at
+    // startNs, ended by end().
+    Event& begin(audio_devices_t device, const std::string &address,
+            audio_policy_dev_state_t state, nsecs_t startNs) {
+        if (mEvents.size() >= kMaxEvents) {
+            mEvents.pop_front();
+        }
+        Event &event = mEvents.emplace_back();
+        event.startNs = startNs;
+        event.device = device;
+        event.address = address;
+        event.state = state;
+        return event;
+    }
+
+    void end(Event &event) {
+        event.durationNs = systemTime() - event.startNs;
+    }
+
+    // Returns the last event recorded, or nullptr if none.
+    const Event* last() const { return mEvents.empty() ? nullptr : &mEvents.back(); }
+
+    void dump(String8 *dst) const {
+        dst->appendFormat(" Routing updates on device connection (last %zu):\n", mEvents.size());
+        for (const Event &event : mEvents) {
+            dst->appendFormat("  %s device %#x address \"%s\" in %.3f ms: strategies %zu/%zu (",
+                    event.state == AUDIO_POLICY_DEVICE_STATE_AVAILABLE ? "connect" : "disconnect",
+                    event.device, event.address.c_str(), event.durationNs * 1e-6,
+                    event.changedStrategies.size(), event.strategies);
+            for (size_t i = 0; i < event.changedStrategies.size(); ++i) {
+                dst->appendFormat("%s%u", i == 0 ? "" : " ", event.changedStrategies[i]);
+            }
+            dst->appendFormat("), outputs %zu/%zu (", event.reroutedOutputs.size(),
+                    event.outputs);
+            for (size_t i = 0; i < event.reroutedOutputs.size(); ++i) {
+                dst->appendFormat("%s%d", i == 0 ? "" : " ", event.reroutedOutputs[i]);
+            }
+            dst->append(")\n");
+        }
+    }
+
+private:
+    std::deque<Event> mEvents;
+};
+
+} // namespace android
@@ -29,7 +29,11 @@ class AudioPolicyTestManager : public AudioPolicyManager {
     using AudioPolicyManager::getOutputs;
     using AudioPolicyManager::getAvailableOutputDevices;
     using AudioPolicyManager::getAvailableInputDevices;
+    using AudioPolicyManager::updateCallAndOutputRouting;
     uint32_t getAudioPortGeneration() const { return mAudioPortGeneration; }
+    const RoutingDecisionCache& getRoutingDecisions() const { return mRoutingDecisions; }
+    void setRoutingDecisionCacheEnabled(bool enabled) { mRoutingDecisions.setEnabled(enabled); }
+    const RoutingUpdateTrace& getRoutingUpdates() const { return mRoutingUpdates; }
 };
 
 }  // namespace android
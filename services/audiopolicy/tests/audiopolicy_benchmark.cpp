@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define LOG_TAG "APM_Benchmark"
+#include <Serializer.h>
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+#include <utils/Log.h>
+
+#include "AudioPolicyInterface.h"
+#include "AudioPolicyManagerTestClient.h"
+#include "AudioPolicyTestManager.h"
+
+using namespace android;
+using base::StringPrintf;
+
+namespace {
+
+// Dynamic devices connected and disconnected by the benchmarks, declared in the primary module.
+constexpr audio_devices_t kUsbHeadset = AUDIO_DEVICE_OUT_USB_HEADSET;
+constexpr char kUsbHeadsetAddress[] = "card=1;device=0";
+constexpr audio_devices_t kBtScoHeadset = AUDIO_DEVICE_OUT_BLUETOOTH_SCO_HEADSET;
+constexpr char kBtScoHeadsetAddress[] = "00:11:22:33:44:55";
+
+// Usages of the clients made active before measuring, in rotation.
+constexpr audio_usage_t kClientUsages[] = {
+    AUDIO_USAGE_MEDIA, AUDIO_USAGE_GAME, AUDIO_USAGE_ASSISTANCE_NAVIGATION_GUIDANCE,
+    AUDIO_USAGE_ASSISTANCE_SONIFICATION, AUDIO_USAGE_NOTIFICATION,
+};
+
+const char* const kProfile =
+        "<profile name=\"\" format=\"AUDIO_FORMAT_PCM_16_BIT\" samplingRates=\"48000\" "
+        "channelMasks=\"AUDIO_CHANNEL_OUT_STEREO\"/>";
+
+// Returns an audio policy configuration with a primary module and busModules additional
+// modules each exposing busesPerModule attached bus devices, each bus fed by its own mix port,
+// as found on automotive platforms.
+std::string makeConfig(size_t busModules, size_t busesPerModule) {
+    std::string xml =
+            "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+            "<audioPolicyConfiguration version=\"1.0\">\n"
+            "  <globalConfiguration speaker_drc_enabled=\"true\"/>\n"
+            "  <modules>\n";
+    xml += StringPrintf(
+            "    <module name=\"primary\" halVersion=\"2.0\">\n"
+            "      <attachedDevices><item>Speaker</item><item>Built-In Mic</item>"
+            "</attachedDevices>\n"
+            "      <defaultOutputDevice>Speaker</defaultOutputDevice>\n"
+            "      <mixPorts>\n"
+            "        <mixPort name=\"primary output\" role=\"source\" "
+            "flags=\"AUDIO_OUTPUT_FLAG_PRIMARY\">%s</mixPort>\n"
+            "        <mixPort name=\"deep buffer output\" role=\"source\" "
+            "flags=\"AUDIO_OUTPUT_FLAG_DEEP_BUFFER\">%s</mixPort>\n"
+            "        <mixPort name=\"primary input\" role=\"sink\">"
+            "<profile name=\"\" format=\"AUDIO_FORMAT_PCM_16_BIT\" samplingRates=\"48000\" "
+            "channelMasks=\"AUDIO_CHANNEL_IN_STEREO\"/></mixPort>\n"
+            "        <mixPort name=\"bt sco output\" role=\"source\">%s</mixPort>\n"
+            "      </mixPorts>\n"
+            "      <devicePorts>\n"
+            "        <devicePort tagName=\"Speaker\" type=\"AUDIO_DEVICE_OUT_SPEAKER\" "
+            "role=\"sink\"/>\n"
+            "        <devicePort tagName=\"Built-In Mic\" type=\"AUDIO_DEVICE_IN_BUILTIN_MIC\" "
+            "role=\"source\"/>\n"
+            "        <devicePort tagName=\"USB Headset\" type=\"AUDIO_DEVICE_OUT_USB_HEADSET\" "
+            "role=\"sink\"/>\n"
+            "        <devicePort tagName=\"BT SCO Headset\" "
+            "type=\"AUDIO_DEVICE_OUT_BLUETOOTH_SCO_HEADSET\" role=\"sink\"/>\n"
+            "      </devicePorts>\n"
+            "      <routes>\n"
+            "        <route type=\"mix\" sink=\"Speaker\" "
+            "sources=\"primary output,deep buffer output\"/>\n"
+            "        <route type=\"mix\" sink=\"USB Headset\" "
+            "sources=\"primary output,deep buffer output\"/>\n"
+            "        <route type=\"mix\" sink=\"BT SCO Headset\" sources=\"bt sco output\"/>\n"
+            "        <route type=\"mix\" sink=\"primary input\" sources=\"Built-In Mic\"/>\n"
+            "      </routes>\n"
+            "    </module>\n",
+            kProfile, kProfile, kProfile);
+    for (size_t m = 0; m < busModules; ++m) {
+        std::string attached;
+        std::string mixPorts;
+        std::string devicePorts;
+        std::string routes;
+        for (size_t b = 0; b < busesPerModule; ++b) {
+            const std::string bus = StringPrintf("bus%zu_%zu", m, b);
+            attached += StringPrintf("<item>%s</item>", bus.c_str());
+            mixPorts += StringPrintf(
+                    "        <mixPort name=\"%s output\" role=\"source\">%s</mixPort>\n",
+                    bus.c_str(), kProfile);
+            devicePorts += StringPrintf(
+                    "        <devicePort tagName=\"%s\" type=\"AUDIO_DEVICE_OUT_BUS\" "
+                    "role=\"sink\" address=\"%s\">%s</devicePort>\n",
+                    bus.c_str(), bus.c_str(), kProfile);
+            routes += StringPrintf(
+                    "        <route type=\"mix\" sink=\"%s\" sources=\"%s output\"/>\n",
+                    bus.c_str(), bus.c_str());
+        }
+        xml += StringPrintf(
+                "    <module name=\"bus%zu\" halVersion=\"2.0\">\n"
+                "      <attachedDevices>%s</attachedDevices>\n"
+                "      <mixPorts>\n%s      </mixPorts>\n"
+                "      <devicePorts>\n%s      </devicePorts>\n"
+                "      <routes>\n%s      </routes>\n"
+                "    </module>\n",
+                m, attached.c_str(), mixPorts.c_str(), devicePorts.c_str(), routes.c_str());
+    }
+    xml += "  </modules>\n</audioPolicyConfiguration>\n";
+    return xml;
+}
+
+// Audio policy manager initialized from a synthetic configuration.
+class Manager {
+public:
+    Manager(size_t busModules, size_t busesPerModule) {
+        TemporaryFile config;
+        if (base::WriteStringToFile(makeConfig(busModules, busesPerModule), config.path)) {
+            initialize(config.path, nullptr /*cacheFile*/);
+        }
+    }
+
+    // Initializes from configFile, through the configuration snapshot in cacheFile if not null.
+    Manager(const char *configFile, const char *cacheFile) {
+        initialize(configFile, cacheFile);
+    }
+
+    ~Manager() {
+        if (mManager != nullptr) {
+            for (audio_port_handle_t portId : mActiveClients) {
+                mManager->stopOutput(portId);
+                mManager->releaseOutput(portId);
+            }
+        }
+    }
+
+    AudioPolicyTestManager* get() const { return mManager.get(); }
+
+    status_t getOutputForAttr(audio_usage_t usage, audio_port_handle_t *portId) {
+        audio_attributes_t attr = AUDIO_ATTRIBUTES_INITIALIZER;
+        attr.usage = usage;
+        audio_config_t config = AUDIO_CONFIG_INITIALIZER;
+        config.sample_rate = 48000;
+        config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        audio_io_handle_t output = AUDIO_IO_HANDLE_NONE;
+        audio_stream_type_t stream = AUDIO_STREAM_DEFAULT;
+        audio_output_flags_t flags = AUDIO_OUTPUT_FLAG_NONE;
+        audio_port_handle_t selectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+        AudioPolicyInterface::output_type_t outputType;
+        mSecondaryOutputs.clear();
+        *portId = AUDIO_PORT_HANDLE_NONE;
+        return mManager->getOutputForAttr(&attr, &output, AUDIO_SESSION_NONE, &stream,
+                0 /*uid*/, &config, &flags, &selectedDeviceId, portId, &mSecondaryOutputs,
+                &outputType);
+    }
+
+    // Creates and starts count clients which stay active until destruction.
+    bool startClients(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            audio_port_handle_t portId;
+            const audio_usage_t usage = kClientUsages[i % std::size(kClientUsages)];
+            if (getOutputForAttr(usage, &portId) != NO_ERROR) {
+                return false;
+            }
+            mActiveClients.push_back(portId);
+            if (mManager->startOutput(portId) != NO_ERROR) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    status_t setDeviceConnectionState(audio_devices_t device, const char *address,
+            audio_policy_dev_state_t state) {
+        return mManager->setDeviceConnectionState(device, state, address, "" /*name*/,
+                AUDIO_FORMAT_DEFAULT);
+    }
+
+private:
+    void initialize(const char *configFile, const char *cacheFile) {
+        mClient.reset(new AudioPolicyManagerTestClient);
+        mManager.reset(new AudioPolicyTestManager(mClient.get()));
+        const status_t status = cacheFile != nullptr ?
+                deserializeAudioPolicyFile(configFile, &mManager->getConfig(), cacheFile) :
+                deserializeAudioPolicyFile(configFile, &mManager->getConfig());
+        if (status != NO_ERROR || mManager->initialize() != NO_ERROR) {
+            ALOGE("%s: cannot initialize audio policy manager", __func__);
+            mManager.reset();
+        }
+    }
+
+    std::unique_ptr<AudioPolicyManagerTestClient> mClient;
+    std::unique_ptr<AudioPolicyTestManager> mManager;
+    std::vector<audio_io_handle_t> mSecondaryOutputs;
+    std::vector<audio_port_handle_t> mActiveClients;
+};
+
+// Arguments: bus modules, buses per module, active clients.
+void ScaledConfigs(benchmark::internal::Benchmark* b) {
+    for (int busModules : {0, 2, 4}) {
+        for (int clients : {0, 8}) {
+            b->Args({busModules, 8 /* busesPerModule */, clients});
+        }
+    }
+}
+
+// Arguments: bus modules, buses per module, active clients, routing decision cache enabled.
+void CachedScaledConfigs(benchmark::internal::Benchmark* b) {
+    for (int busModules : {0, 2, 4}) {
+        for (int clients : {0, 8}) {
+            for (int cache : {0, 1}) {
+                b->Args({busModules, 8 /* busesPerModule */, clients, cache});
+            }
+        }
+    }
+}
+
+bool setUp(benchmark::State& state, Manager& manager) {
+    if (manager.get() == nullptr) {
+        state.SkipWithError("cannot initialize audio policy manager");
+        return false;
+    }
+    if (!manager.startClients(state.range(2))) {
+        state.SkipWithError("cannot start clients");
+        return false;
+    }
+    state.counters["outputs"] = manager.get()->getOutputs().size();
+    return true;
+}
+
+} // namespace
+
+// Creates and releases a track for the given usage, with the routing decision cache
+// disabled (state.range(3) == 0) or enabled.
+static void BM_GetOutputForAttr(benchmark::State& state, audio_usage_t usage) {
+    Manager manager(state.range(0), state.range(1));
+    if (!setUp(state, manager)) {
+        return;
+    }
+    manager.get()->setRoutingDecisionCacheEnabled(state.range(3) != 0);
+
+    for (auto _ : state) {
+        audio_port_handle_t portId;
+        if (manager.getOutputForAttr(usage, &portId) != NO_ERROR) {
+            state.SkipWithError("getOutputForAttr failed");
+            return;
+        }
+        manager.get()->releaseOutput(portId);
+    }
+    const RoutingDecisionCache& cache = manager.get()->getRoutingDecisions();
+    state.counters["hits"] = cache.hits();
+    state.counters["misses"] = cache.misses();
+}
+
+BENCHMARK_CAPTURE(BM_GetOutputForAttr, media, AUDIO_USAGE_MEDIA)->Apply(CachedScaledConfigs);
+BENCHMARK_CAPTURE(BM_GetOutputForAttr, game, AUDIO_USAGE_GAME)->Apply(CachedScaledConfigs);
+BENCHMARK_CAPTURE(BM_GetOutputForAttr, notification, AUDIO_USAGE_NOTIFICATION)
+        ->Apply(CachedScaledConfigs);
+
+// Creates, starts, stops and releases a track for the given usage, as a short sound does, with
+// the routing decision cache disabled (state.range(3) == 0) or enabled. Client activity is part
+// of the device selection, so this measures the hit rate of the cache for real track lifecycles.
+static void BM_TrackLifecycle(benchmark::State& state, audio_usage_t usage) {
+    Manager manager(state.range(0), state.range(1));
+    if (!setUp(state, manager)) {
+        return;
+    }
+    manager.get()->setRoutingDecisionCacheEnabled(state.range(3) != 0);
+
+    for (auto _ : state) {
+        audio_port_handle_t portId;
+        if (manager.getOutputForAttr(usage, &portId) != NO_ERROR) {
+            state.SkipWithError("getOutputForAttr failed");
+            return;
+        }
+        if (manager.get()->startOutput(portId) != NO_ERROR
+                || manager.get()->stopOutput(portId) != NO_ERROR) {
+            state.SkipWithError("start or stop failed");
+            return;
+        }
+        manager.get()->releaseOutput(portId);
+    }
+    const RoutingDecisionCache& cache = manager.get()->getRoutingDecisions();
+    const uint64_t lookups = cache.hits() + cache.misses();
+    state.counters["hits"] = cache.hits();
+    state.counters["misses"] = cache.misses();
+    state.counters["hit_rate"] = lookups != 0 ? (double)cache.hits() / lookups : 0.;
+    state.counters["strategy_invalidations"] = cache.strategyInvalidations();
+}
+
+BENCHMARK_CAPTURE(BM_TrackLifecycle, media, AUDIO_USAGE_MEDIA)->Apply(CachedScaledConfigs);
+BENCHMARK_CAPTURE(BM_TrackLifecycle, game, AUDIO_USAGE_GAME)->Apply(CachedScaledConfigs);
+BENCHMARK_CAPTURE(BM_TrackLifecycle, notification, AUDIO_USAGE_NOTIFICATION)
+        ->Apply(CachedScaledConfigs);
+
+// Starts and stops one more media client.
+static void BM_StartStopOutput(benchmark::State& state) {
+    Manager manager(state.range(0), state.range(1));
+    if (!setUp(state, manager)) {
+        return;
+    }
+    audio_port_handle_t portId;
+    if (manager.getOutputForAttr(AUDIO_USAGE_MEDIA, &portId) != NO_ERROR) {
+        state.SkipWithError("getOutputForAttr failed");
+        return;
+    }
+    for (auto _ : state) {
+        if (manager.get()->startOutput(portId) != NO_ERROR
+                || manager.get()->stopOutput(portId) != NO_ERROR) {
+            state.SkipWithError("start or stop failed");
+            break;
+        }
+    }
+    manager.get()->releaseOutput(portId);
+}
+
+BENCHMARK(BM_StartStopOutput)->Apply(ScaledConfigs);
+
+// Connects and disconnects a device, as a flapping Bluetooth or USB headset does.
+static void BM_DeviceConnectionStorm(benchmark::State& state, audio_devices_t device,
+        const char *address) {
+    Manager manager(state.range(0), state.range(1));
+    if (!setUp(state, manager)) {
+        return;
+    }
+    for (auto _ : state) {
+        if (manager.setDeviceConnectionState(device, address,
+                        AUDIO_POLICY_DEVICE_STATE_AVAILABLE) != NO_ERROR
+                || manager.setDeviceConnectionState(device, address,
+                        AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE) != NO_ERROR) {
+            state.SkipWithError("device connection failed");
+            return;
+        }
+    }
+    // outputs re-routed on the last disconnection
+    const RoutingUpdateTrace::Event* event = manager.get()->getRoutingUpdates().last();
+    if (event != nullptr) {
+        state.counters["rerouted"] = event->reroutedOutputs.size();
+    }
+}
+
+BENCHMARK_CAPTURE(BM_DeviceConnectionStorm, usb_headset, kUsbHeadset, kUsbHeadsetAddress)
+        ->Apply(ScaledConfigs);
+BENCHMARK_CAPTURE(BM_DeviceConnectionStorm, bt_sco_headset, kBtScoHeadset,
+        kBtScoHeadsetAddress)->Apply(ScaledConfigs);
+
+// Sweeps the music volume index on the default device, applying the volume of every volume
+// group to every output as a volume change storm does.
+static void BM_SetStreamVolumeIndex(benchmark::State& state) {
+    Manager manager(state.range(0), state.range(1));
+    if (!setUp(state, manager)) {
+        return;
+    }
+    constexpr int kMaxIndex = 100;
+    manager.get()->initStreamVolume(AUDIO_STREAM_MUSIC, 0 /*indexMin*/, kMaxIndex);
+    int index = 0;
+    for (auto _ : state) {
+        if (manager.get()->setStreamVolumeIndex(AUDIO_STREAM_MUSIC, index,
+                        AUDIO_DEVICE_OUT_DEFAULT_FOR_VOLUME) != NO_ERROR) {
+            state.SkipWithError("setStreamVolumeIndex failed");
+            return;
+        }
+        index = (index + 7) % (kMaxIndex + 1);
+    }
+}
+
+BENCHMARK(BM_SetStreamVolumeIndex)->Apply(ScaledConfigs);
+
+// Re-evaluates the routing of the call and of all outputs, as done after forced usage,
+// phone state, preferred device and affinity changes.
+static void BM_UpdateCallAndOutputRouting(benchmark::State& state) {
+    Manager manager(state.range(0), state.range(1));
+    if (!setUp(state, manager)) {
+        return;
+    }
+    for (auto _ : state) {
+        manager.get()->updateCallAndOutputRouting();
+    }
+}
+
+BENCHMARK(BM_UpdateCallAndOutputRouting)->Apply(ScaledConfigs);
+
+// Time from the creation of the audio policy manager to its first track, parsing the
+// configuration file (state.range(2) == 0) or restoring it from an up to date snapshot.
+static void BM_ColdStartToFirstOutput(benchmark::State& state) {
+    TemporaryFile config;
+    TemporaryDir cacheDir;
+    const std::string cacheFile = std::string(cacheDir.path) + "/config.bin";
+    if (!base::WriteStringToFile(makeConfig(state.range(0), state.range(1)), config.path)) {
+        state.SkipWithError("cannot write configuration");
+        return;
+    }
+    const bool snapshot = state.range(2) != 0;
+    if (snapshot && Manager(config.path, cacheFile.c_str()).get() == nullptr) {
+        state.SkipWithError("cannot take configuration snapshot");
+        return;
+    }
+
+    for (auto _ : state) {
+        auto manager = std::make_unique<Manager>(
+                config.path, snapshot ? cacheFile.c_str() : nullptr);
+        audio_port_handle_t portId;
+        if (manager->get() == nullptr
+                || manager->getOutputForAttr(AUDIO_USAGE_MEDIA, &portId) != NO_ERROR) {
+            state.SkipWithError("getOutputForAttr failed");
+            return;
+        }
+        state.PauseTiming();
+        manager->get()->releaseOutput(portId);
+        manager.reset();
+        state.ResumeTiming();
+    }
+}
+
+// Arguments: bus modules, buses per module, configuration snapshot enabled.
+void SnapshotConfigs(benchmark::internal::Benchmark* b) {
+    for (int busModules : {0, 2, 4}) {
+        for (int snapshot : {0, 1}) {
+            b->Args({busModules, 8 /* busesPerModule */, snapshot});
+        }
+    }
+}
+
+BENCHMARK(BM_ColdStartToFirstOutput)->Apply(SnapshotConfigs)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
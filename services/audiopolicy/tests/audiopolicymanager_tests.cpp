@@ -14,14 +14,17 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <gtest/gtest.h>
 
 #define LOG_TAG "APM_Test"
+#include <AudioPolicyConfigCache.h>
 #include <Serializer.h>
 #include <android-base/file.h>
 #include <media/AudioPolicy.h>
@@ -1070,6 +1073,379 @@ INSTANTIATE_TEST_CASE_P(
                 )
         );
 
+TEST_F(AudioPolicyManagerTestWithConfigurationFile, RoutingDecisionCacheHit) {
+    const RoutingDecisionCache& cache = mManager->getRoutingDecisions();
+    audio_port_handle_t selectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+    audio_io_handle_t output = AUDIO_IO_HANDLE_NONE;
+    audio_port_handle_t portId;
+    getOutputForAttr(&selectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/, AUDIO_OUTPUT_FLAG_NONE, &output, &portId);
+    const uint64_t hits = cache.hits();
+    const uint64_t misses = cache.misses();
+    ASSERT_EQ(1u, cache.size());
+    mManager->releaseOutput(portId);
+
+    // Same request in another session: same decision, taken from the cache.
+    audio_port_handle_t cachedSelectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+    audio_io_handle_t cachedOutput = AUDIO_IO_HANDLE_NONE;
+    getOutputForAttr(&cachedSelectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/, AUDIO_OUTPUT_FLAG_NONE, &cachedOutput, &portId);
+    EXPECT_EQ(output, cachedOutput);
+    EXPECT_EQ(selectedDeviceId, cachedSelectedDeviceId);
+    EXPECT_EQ(hits + 1, cache.hits());
+    EXPECT_EQ(misses, cache.misses());
+
+    // Starting and stopping a client without preferred device does not change the devices
+    // selected for media, the decision is kept.
+    const uint64_t generation = cache.generation();
+    ASSERT_EQ(NO_ERROR, mManager->startOutput(portId));
+    EXPECT_EQ(1u, cache.size());
+    ASSERT_EQ(NO_ERROR, mManager->stopOutput(portId));
+    EXPECT_EQ(1u, cache.size());
+    EXPECT_EQ(generation, cache.generation());
+    mManager->releaseOutput(portId);
+
+    getOutputForAttr(&cachedSelectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/, AUDIO_OUTPUT_FLAG_NONE, &cachedOutput);
+    EXPECT_EQ(output, cachedOutput);
+    EXPECT_EQ(hits + 2, cache.hits());
+}
+
+TEST_F(AudioPolicyManagerTestWithConfigurationFile, RoutingDecisionCacheActivity) {
+    const RoutingDecisionCache& cache = mManager->getRoutingDecisions();
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(
+            AUDIO_DEVICE_OUT_HDMI, AUDIO_POLICY_DEVICE_STATE_AVAILABLE,
+            "audio_policy_test_out_hdmi", "test_out_hdmi", AUDIO_FORMAT_DEFAULT));
+    audio_port speaker;
+    ASSERT_TRUE(findDevicePort(AUDIO_PORT_ROLE_SINK, AUDIO_DEVICE_OUT_SPEAKER, "", &speaker));
+
+    // Media follows HDMI, alarms are also played on the speaker.
+    audio_port_handle_t selectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+    getOutputForAttr(&selectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/);
+    selectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+    audio_attributes_t alarm = AUDIO_ATTRIBUTES_INITIALIZER;
+    alarm.usage = AUDIO_USAGE_ALARM;
+    getOutputForAttr(&selectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/, AUDIO_OUTPUT_FLAG_NONE, nullptr /*output*/, nullptr /*portId*/,
+            alarm);
+    ASSERT_EQ(2u, cache.size());
+
+    // A media client routed to the speaker takes over the media routing once active: only the
+    // media decisions are dropped.
+    audio_port_handle_t preferredDeviceId = speaker.id;
+    audio_port_handle_t portId;
+    getOutputForAttr(&preferredDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/, AUDIO_OUTPUT_FLAG_NONE, nullptr /*output*/, &portId);
+    ASSERT_EQ(3u, cache.size());
+    const uint64_t invalidations = cache.strategyInvalidations();
+    ASSERT_EQ(NO_ERROR, mManager->startOutput(portId));
+    EXPECT_EQ(invalidations + 1, cache.strategyInvalidations());
+    EXPECT_EQ(1u, cache.size());
+
+    // And are dropped again when it stops.
+    selectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+    getOutputForAttr(&selectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/);
+    EXPECT_EQ(speaker.id, selectedDeviceId);
+    ASSERT_EQ(2u, cache.size());
+    ASSERT_EQ(NO_ERROR, mManager->stopOutput(portId));
+    EXPECT_EQ(invalidations + 2, cache.strategyInvalidations());
+    EXPECT_EQ(1u, cache.size());
+    mManager->releaseOutput(portId);
+
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(
+            AUDIO_DEVICE_OUT_HDMI, AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE,
+            "audio_policy_test_out_hdmi", "test_out_hdmi", AUDIO_FORMAT_DEFAULT));
+}
+
+TEST_F(AudioPolicyManagerTestWithConfigurationFile, RoutingDecisionCacheInvalidation) {
+    const RoutingDecisionCache& cache = mManager->getRoutingDecisions();
+    audio_port_handle_t selectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+    getOutputForAttr(&selectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/);
+    ASSERT_EQ(1u, cache.size());
+
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(
+            AUDIO_DEVICE_OUT_HDMI, AUDIO_POLICY_DEVICE_STATE_AVAILABLE,
+            "audio_policy_test_out_hdmi", "test_out_hdmi", AUDIO_FORMAT_DEFAULT));
+    EXPECT_EQ(0u, cache.size());
+
+    getOutputForAttr(&selectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/);
+    ASSERT_EQ(1u, cache.size());
+    mManager->setForceUse(AUDIO_POLICY_FORCE_FOR_MEDIA, AUDIO_POLICY_FORCE_SPEAKER);
+    EXPECT_EQ(0u, cache.size());
+
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(
+            AUDIO_DEVICE_OUT_HDMI, AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE,
+            "audio_policy_test_out_hdmi", "test_out_hdmi", AUDIO_FORMAT_DEFAULT));
+}
+
+TEST_F(AudioPolicyManagerTestWithConfigurationFile, RoutingDecisionCacheBypass) {
+    const RoutingDecisionCache& cache = mManager->getRoutingDecisions();
+    // Multichannel requests may be served by a direct output and are never cached.
+    audio_port_handle_t selectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+    getOutputForAttr(&selectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_5POINT1,
+            48000 /*sampleRate*/);
+    EXPECT_EQ(0u, cache.size());
+    EXPECT_EQ(0u, cache.hits() + cache.misses());
+
+    mManager->setRoutingDecisionCacheEnabled(false);
+    getOutputForAttr(&selectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/);
+    EXPECT_EQ(0u, cache.size());
+    EXPECT_EQ(0u, cache.hits() + cache.misses());
+}
+
+TEST_F(AudioPolicyManagerTestWithConfigurationFile, RoutingUpdateOnDeviceConnection) {
+    audio_port_handle_t selectedDeviceId = AUDIO_PORT_HANDLE_NONE;
+    audio_io_handle_t primaryOutput = AUDIO_IO_HANDLE_NONE;
+    audio_port_handle_t portId;
+    getOutputForAttr(&selectedDeviceId, AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,
+            48000 /*sampleRate*/, AUDIO_OUTPUT_FLAG_NONE, &primaryOutput, &portId);
+    mManager->releaseOutput(portId);
+    auto isRerouted = [](const RoutingUpdateTrace::Event* event, audio_io_handle_t output) {
+        return std::find(event->reroutedOutputs.begin(), event->reroutedOutputs.end(), output)
+                != event->reroutedOutputs.end();
+    };
+
+    // No strategy uses BT SCO unless forced to: only the output opened for it is routed.
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(
+            AUDIO_DEVICE_OUT_BLUETOOTH_SCO, AUDIO_POLICY_DEVICE_STATE_AVAILABLE,
+            "hfp_client_out", "" /*name*/, AUDIO_FORMAT_DEFAULT));
+    const RoutingUpdateTrace::Event* event = mManager->getRoutingUpdates().last();
+    ASSERT_NE(nullptr, event);
+    EXPECT_EQ(AUDIO_DEVICE_OUT_BLUETOOTH_SCO, event->device);
+    EXPECT_EQ(AUDIO_POLICY_DEVICE_STATE_AVAILABLE, event->state);
+    EXPECT_LT(0u, event->strategies);
+    EXPECT_TRUE(event->changedStrategies.empty());
+    EXPECT_EQ(mManager->getOutputs().size(), event->outputs);
+    EXPECT_FALSE(isRerouted(event, primaryOutput));
+    EXPECT_EQ(1u, event->reroutedOutputs.size());
+
+    // Media moves to HDMI, which is also served by the primary output.
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(
+            AUDIO_DEVICE_OUT_HDMI, AUDIO_POLICY_DEVICE_STATE_AVAILABLE,
+            "audio_policy_test_out_hdmi", "test_out_hdmi", AUDIO_FORMAT_DEFAULT));
+    event = mManager->getRoutingUpdates().last();
+    ASSERT_NE(nullptr, event);
+    EXPECT_EQ(AUDIO_DEVICE_OUT_HDMI, event->device);
+    EXPECT_FALSE(event->changedStrategies.empty());
+    EXPECT_TRUE(isRerouted(event, primaryOutput));
+
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(
+            AUDIO_DEVICE_OUT_HDMI, AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE,
+            "audio_policy_test_out_hdmi", "test_out_hdmi", AUDIO_FORMAT_DEFAULT));
+    event = mManager->getRoutingUpdates().last();
+    ASSERT_NE(nullptr, event);
+    EXPECT_EQ(AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE, event->state);
+    EXPECT_TRUE(isRerouted(event, primaryOutput));
+
+    ASSERT_EQ(NO_ERROR, mManager->setDeviceConnectionState(
+            AUDIO_DEVICE_OUT_BLUETOOTH_SCO, AUDIO_POLICY_DEVICE_STATE_UNAVAILABLE,
+            "hfp_client_out", "" /*name*/, AUDIO_FORMAT_DEFAULT));
+    event = mManager->getRoutingUpdates().last();
+    ASSERT_NE(nullptr, event);
+    EXPECT_FALSE(isRerouted(event, primaryOutput));
+}
+
+class AudioPolicyManagerTestConfigCache : public AudioPolicyManagerTestWithConfigurationFile {
+protected:
+    void SetUpManagerConfig() override;
+    std::string getCacheFile() const { return std::string(mCacheDir.path) + "/config.bin"; }
+
+    TemporaryDir mCacheDir;
+};
+
+void AudioPolicyManagerTestConfigCache::SetUpManagerConfig() {
+    // No snapshot yet: parses the XML and takes a snapshot.
+    status_t status = deserializeAudioPolicyFile(getConfigFile().c_str(), &mManager->getConfig(),
+            getCacheFile().c_str());
+    ASSERT_EQ(NO_ERROR, status);
+}
+
+TEST_F(AudioPolicyManagerTestConfigCache, SnapshotRestoresConfig) {
+    HwModuleCollection parsedModules, restoredModules;
+    DeviceVector parsedOutputs, parsedInputs, restoredOutputs, restoredInputs;
+    sp<DeviceDescriptor> parsedDefault, restoredDefault;
+    AudioPolicyConfig parsed(parsedModules, parsedOutputs, parsedInputs, parsedDefault);
+    AudioPolicyConfig restored(restoredModules, restoredOutputs, restoredInputs, restoredDefault);
+    ASSERT_EQ(NO_ERROR, deserializeAudioPolicyFile(getConfigFile().c_str(), &parsed));
+    ASSERT_EQ(NO_ERROR, loadAudioPolicyConfigCache(
+            getCacheFile().c_str(), getConfigFile().c_str(), &restored));
+
+    auto tagNames = [](const DeviceVector &devices) {
+        std::vector<std::string> names;
+        for (const auto &device : devices) names.push_back(device->getTagName());
+        return names;
+    };
+    ASSERT_EQ(parsedModules.size(), restoredModules.size());
+    for (size_t i = 0; i < parsedModules.size(); ++i) {
+        const sp<HwModule> &expected = parsedModules[i], &actual = restoredModules[i];
+        ASSERT_STREQ(expected->getName(), actual->getName());
+        EXPECT_EQ(expected->getHalVersionMajor(), actual->getHalVersionMajor());
+        EXPECT_EQ(expected->getHalVersionMinor(), actual->getHalVersionMinor());
+        ASSERT_EQ(expected->getOutputProfiles().size(), actual->getOutputProfiles().size());
+        ASSERT_EQ(expected->getInputProfiles().size(), actual->getInputProfiles().size());
+        IOProfileCollection expectedProfiles = expected->getOutputProfiles();
+        expectedProfiles.appendVector(expected->getInputProfiles());
+        IOProfileCollection actualProfiles = actual->getOutputProfiles();
+        actualProfiles.appendVector(actual->getInputProfiles());
+        for (size_t j = 0; j < expectedProfiles.size(); ++j) {
+            EXPECT_EQ(expectedProfiles[j]->getName(), actualProfiles[j]->getName());
+            EXPECT_EQ(expectedProfiles[j]->getFlags(), actualProfiles[j]->getFlags());
+            EXPECT_EQ(expectedProfiles[j]->maxOpenCount, actualProfiles[j]->maxOpenCount);
+            EXPECT_EQ(expectedProfiles[j]->maxActiveCount, actualProfiles[j]->maxActiveCount);
+            EXPECT_EQ(expectedProfiles[j]->getAudioProfiles().size(),
+                    actualProfiles[j]->getAudioProfiles().size());
+            EXPECT_EQ(tagNames(expectedProfiles[j]->getSupportedDevices()),
+                    tagNames(actualProfiles[j]->getSupportedDevices()));
+        }
+        EXPECT_EQ(tagNames(expected->getDeclaredDevices()),
+                tagNames(actual->getDeclaredDevices()));
+        for (size_t j = 0; j < expected->getDeclaredDevices().size(); ++j) {
+            EXPECT_TRUE(expected->getDeclaredDevices()[j]->equals(
+                    actual->getDeclaredDevices()[j]));
+        }
+        EXPECT_EQ(expected->getRoutes().size(), actual->getRoutes().size());
+    }
+    EXPECT_EQ(tagNames(parsedOutputs), tagNames(restoredOutputs));
+    EXPECT_EQ(tagNames(parsedInputs), tagNames(restoredInputs));
+    ASSERT_NE(nullptr, restoredDefault);
+    EXPECT_EQ(parsedDefault->getTagName(), restoredDefault->getTagName());
+    EXPECT_EQ(parsed.isSpeakerDrcEnabled(), restored.isSpeakerDrcEnabled());
+    EXPECT_EQ(parsed.getEngineLibraryNameSuffix(), restored.getEngineLibraryNameSuffix());
+    EXPECT_EQ(parsed.getSurroundFormats(), restored.getSurroundFormats());
+}
+
+TEST_F(AudioPolicyManagerTestConfigCache, InitFromSnapshot) {
+    AudioPolicyManagerTestClient client;
+    AudioPolicyTestManager manager(&client);
+    ASSERT_EQ(NO_ERROR, loadAudioPolicyConfigCache(
+            getCacheFile().c_str(), getConfigFile().c_str(), &manager.getConfig()));
+    ASSERT_EQ(NO_ERROR, manager.initialize());
+    ASSERT_EQ(NO_ERROR, manager.initCheck());
+    EXPECT_EQ(mManager->getOutputs().size(), manager.getOutputs().size());
+    EXPECT_EQ(mManager->getAvailableOutputDevices().size(),
+            manager.getAvailableOutputDevices().size());
+    EXPECT_EQ(mManager->getAvailableInputDevices().size(),
+            manager.getAvailableInputDevices().size());
+}
+
+TEST_F(AudioPolicyManagerTestConfigCache, StaleSnapshotIsIgnored) {
+    HwModuleCollection modules;
+    DeviceVector outputs, inputs;
+    sp<DeviceDescriptor> defaultOutput;
+    AudioPolicyConfig config(modules, outputs, inputs, defaultOutput);
+    // Taken from another configuration file.
+    const std::string configFile = std::string(mCacheDir.path) + "/config.xml";
+    EXPECT_NE(NO_ERROR, loadAudioPolicyConfigCache(
+            getCacheFile().c_str(), configFile.c_str(), &config));
+
+    std::string xml;
+    ASSERT_TRUE(base::ReadFileToString(getConfigFile(), &xml));
+    ASSERT_TRUE(base::WriteStringToFile(xml, configFile));
+    ASSERT_EQ(NO_ERROR, deserializeAudioPolicyFile(configFile.c_str(), &config,
+            getCacheFile().c_str()));
+    ASSERT_EQ(NO_ERROR, loadAudioPolicyConfigCache(
+            getCacheFile().c_str(), configFile.c_str(), &config));
+
+    // Taken from an older version of the configuration file.
+    ASSERT_TRUE(base::WriteStringToFile(xml + "<!-- modified -->\n", configFile));
+    EXPECT_NE(NO_ERROR, loadAudioPolicyConfigCache(
+            getCacheFile().c_str(), configFile.c_str(), &config));
+    ASSERT_EQ(NO_ERROR, deserializeAudioPolicyFile(configFile.c_str(), &config,
+            getCacheFile().c_str()));
+    EXPECT_EQ(NO_ERROR, loadAudioPolicyConfigCache(
+            getCacheFile().c_str(), configFile.c_str(), &config));
+}
+
+TEST_F(AudioPolicyManagerTestConfigCache, IncludedFileChangeInvalidatesSnapshot) {
+    // main.xml includes sub/a2dp.xml, which includes sub/nested.xml.
+    const std::string dir(mCacheDir.path);
+    const std::string configFile = dir + "/main.xml";
+    const std::string moduleFile = dir + "/sub/a2dp.xml";
+    const std::string nestedFile = dir + "/sub/nested.xml";
+    const std::string cacheFile = dir + "/main.bin";
+    ASSERT_EQ(0, mkdir((dir + "/sub").c_str(), 0700));
+    ASSERT_TRUE(base::WriteStringToFile(R"(<?xml version="1.0" encoding="UTF-8"?>
+<audioPolicyConfiguration version="1.0" xmlns:xi="http://www.w3.org/2001/XInclude">
+    <globalConfiguration speaker_drc_enabled="false"/>
+    <modules>
+        <module name="primary" halVersion="2.0">
+            <attachedDevices>
+                <item>Speaker</item>
+            </attachedDevices>
+            <defaultOutputDevice>Speaker</defaultOutputDevice>
+            <mixPorts>
+                <mixPort name="primary output" role="source" flags="AUDIO_OUTPUT_FLAG_PRIMARY">
+                    <profile name="" format="AUDIO_FORMAT_PCM_16_BIT"
+                             samplingRates="48000" channelMasks="AUDIO_CHANNEL_OUT_STEREO"/>
+                </mixPort>
+            </mixPorts>
+            <devicePorts>
+                <devicePort tagName="Speaker" type="AUDIO_DEVICE_OUT_SPEAKER" role="sink"/>
+            </devicePorts>
+            <routes>
+                <route type="mix" sink="Speaker" sources="primary output"/>
+            </routes>
+        </module>
+        <xi:include href="sub/a2dp.xml"/>
+    </modules>
+</audioPolicyConfiguration>
+)", configFile));
+    ASSERT_TRUE(base::WriteStringToFile(R"(<?xml version="1.0" encoding="UTF-8"?>
+<module name="a2dp" halVersion="2.0" xmlns:xi="http://www.w3.org/2001/XInclude">
+    <mixPorts>
+        <mixPort name="a2dp output" role="source">
+            <profile name="" format="AUDIO_FORMAT_PCM_16_BIT"
+                     samplingRates="44100" channelMasks="AUDIO_CHANNEL_OUT_STEREO"/>
+        </mixPort>
+    </mixPorts>
+    <xi:include href="nested.xml"/>
+    <routes>
+        <route type="mix" sink="BT A2DP Out" sources="a2dp output"/>
+    </routes>
+</module>
+)", moduleFile));
+    const std::string nestedXml = R"(<?xml version="1.0" encoding="UTF-8"?>
+<devicePorts>
+    <devicePort tagName="BT A2DP Out" type="AUDIO_DEVICE_OUT_BLUETOOTH_A2DP" role="sink"/>
+</devicePorts>
+)";
+    ASSERT_TRUE(base::WriteStringToFile(nestedXml, nestedFile));
+
+    HwModuleCollection modules;
+    DeviceVector outputs, inputs;
+    sp<DeviceDescriptor> defaultOutput;
+    AudioPolicyConfig config(modules, outputs, inputs, defaultOutput);
+    ASSERT_EQ(NO_ERROR, deserializeAudioPolicyFile(configFile.c_str(), &config,
+            cacheFile.c_str()));
+    sp<HwModule> a2dpModule = modules.getModuleFromName("a2dp");
+    ASSERT_NE(nullptr, a2dpModule);
+    ASSERT_EQ(1u, a2dpModule->getDeclaredDevices().size());
+    EXPECT_EQ("BT A2DP Out", a2dpModule->getDeclaredDevices()[0]->getTagName());
+    EXPECT_EQ(NO_ERROR, loadAudioPolicyConfigCache(
+            cacheFile.c_str(), configFile.c_str(), &config));
+
+    // A change in the file included by an included file.
+    ASSERT_TRUE(base::WriteStringToFile(nestedXml + "<!-- modified -->\n", nestedFile));
+    EXPECT_NE(NO_ERROR, loadAudioPolicyConfigCache(
+            cacheFile.c_str(), configFile.c_str(), &config));
+    ASSERT_EQ(NO_ERROR, deserializeAudioPolicyFile(configFile.c_str(), &config,
+            cacheFile.c_str()));
+    EXPECT_EQ(NO_ERROR, loadAudioPolicyConfigCache(
+            cacheFile.c_str(), configFile.c_str(), &config));
+
+    // A change in the module file included by the configuration file.
+    std::string moduleXml;
+    ASSERT_TRUE(base::ReadFileToString(moduleFile, &moduleXml));
+    ASSERT_TRUE(base::WriteStringToFile(moduleXml + "<!-- modified -->\n", moduleFile));
+    EXPECT_NE(NO_ERROR, loadAudioPolicyConfigCache(
+            cacheFile.c_str(), configFile.c_str(), &config));
+}
+
 class AudioPolicyManagerTVTest : public AudioPolicyManagerTestWithConfigurationFile {
 protected:
     std::string getConfigFile() override { return sTvConfig; }
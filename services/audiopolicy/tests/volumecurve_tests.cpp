@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <initializer_list>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include <Volume.h>
+#include <VolumeCurve.h>
+
+using namespace android;
+
+static sp<VolumeCurve> makeCurve(device_category deviceCategory,
+                                 std::initializer_list<CurvePoint> points) {
+    sp<VolumeCurve> curve = new VolumeCurve(deviceCategory);
+    for (const CurvePoint &point : points) {
+        curve->add(point);
+    }
+    return curve;
+}
+
+// Like the default media curves: the speaker curve starts at index 1, the headset curve at 0.
+static sp<VolumeCurve> makeSpeakerCurve() {
+    return makeCurve(DEVICE_CATEGORY_SPEAKER, {{1, -5800}, {20, -4000}, {60, -1700}, {100, 0}});
+}
+
+static sp<VolumeCurve> makeHeadsetCurve() {
+    return makeCurve(DEVICE_CATEGORY_HEADSET, {{0, -4950}, {33, -3350}, {66, -1700}, {100, 0}});
+}
+
+// Compares the attenuation of every index, from below the range to above it, with the
+// interpolation of the curve points.
+static void expectMatchesCurve(const VolumeCurves &curves, device_category deviceCategory,
+                               const sp<VolumeCurve> &curve) {
+    const int indexMin = curves.getVolumeIndexMin();
+    const int indexMax = curves.getVolumeIndexMax();
+    for (int index = -1; index <= indexMax + 5; index++) {
+        const float expected = curve->volIndexToDb(index, indexMin, indexMax);
+        const float decibels = curves.volIndexToDb(deviceCategory, index);
+        if (std::isnan(expected)) {
+            EXPECT_TRUE(std::isnan(decibels)) << "index " << index;
+        } else {
+            EXPECT_EQ(expected, decibels) << "index " << index << " range [" << indexMin
+                                          << ", " << indexMax << "]";
+        }
+    }
+}
+
+class VolumeCurvesRangeTest : public testing::TestWithParam<std::pair<int, int>> {};
+
+TEST_P(VolumeCurvesRangeTest, MatchesInterpolation) {
+    const sp<VolumeCurve> speaker = makeSpeakerCurve();
+    const sp<VolumeCurve> headset = makeHeadsetCurve();
+    // a single point curve has one step
+    const sp<VolumeCurve> earpiece = makeCurve(DEVICE_CATEGORY_EARPIECE, {{50, -1000}});
+
+    VolumeCurves curves(GetParam().first, GetParam().second);
+    curves.add(speaker);
+    curves.add(headset);
+    curves.add(earpiece);
+    expectMatchesCurve(curves, DEVICE_CATEGORY_SPEAKER, speaker);
+    expectMatchesCurve(curves, DEVICE_CATEGORY_HEADSET, headset);
+    expectMatchesCurve(curves, DEVICE_CATEGORY_EARPIECE, earpiece);
+}
+
+INSTANTIATE_TEST_CASE_P(
+        IndexRanges,
+        VolumeCurvesRangeTest,
+        testing::Values(
+                std::make_pair(0, 100),
+                std::make_pair(0, 15),   // music
+                std::make_pair(1, 7),    // voice call
+                std::make_pair(0, 1),
+                std::make_pair(3, 1000), // largest precomputed range
+                std::make_pair(0, 1001), // interpolated on each call
+                std::make_pair(-1, -1))  // not initialized by AudioService yet
+        );
+
+TEST(VolumeCurvesTest, CurvePoints) {
+    VolumeCurves curves(0, 100);
+    curves.add(makeSpeakerCurve());
+    EXPECT_FLOAT_EQ(VOLUME_MIN_DB, curves.volIndexToDb(DEVICE_CATEGORY_SPEAKER, 0));
+    EXPECT_FLOAT_EQ(-40.0f, curves.volIndexToDb(DEVICE_CATEGORY_SPEAKER, 20));
+    EXPECT_FLOAT_EQ(-28.5f, curves.volIndexToDb(DEVICE_CATEGORY_SPEAKER, 40));
+    EXPECT_FLOAT_EQ(-17.0f, curves.volIndexToDb(DEVICE_CATEGORY_SPEAKER, 60));
+    EXPECT_FLOAT_EQ(0.0f, curves.volIndexToDb(DEVICE_CATEGORY_SPEAKER, 100));
+    // indices above the max are clamped
+    EXPECT_FLOAT_EQ(0.0f, curves.volIndexToDb(DEVICE_CATEGORY_SPEAKER, 150));
+
+    // an index of 0 is a mute request when the min index is not 0
+    curves.initVolume(1, 100);
+    EXPECT_FLOAT_EQ(VOLUME_MIN_DB, curves.volIndexToDb(DEVICE_CATEGORY_SPEAKER, 0));
+    EXPECT_FLOAT_EQ(0.0f, curves.volIndexToDb(DEVICE_CATEGORY_SPEAKER, 100));
+}
+
+TEST(VolumeCurvesTest, UpdatedOnRangeAndCurveChange) {
+    const sp<VolumeCurve> speaker = makeSpeakerCurve();
+    VolumeCurves curves(0, 100);
+    curves.add(speaker);
+    expectMatchesCurve(curves, DEVICE_CATEGORY_SPEAKER, speaker);
+
+    // each range replaces the attenuations of the previous one
+    for (const auto &range : {std::make_pair(0, 15), std::make_pair(1, 30),
+                              std::make_pair(-1, -1)}) {
+        curves.initVolume(range.first, range.second);
+        expectMatchesCurve(curves, DEVICE_CATEGORY_SPEAKER, speaker);
+    }
+    curves.initVolume(0, 15);
+
+    // switch to the curve of another use case, as done for accessibility, then restore
+    const sp<VolumeCurve> other =
+            makeCurve(DEVICE_CATEGORY_SPEAKER, {{0, -2400}, {50, -1200}, {100, 0}});
+    curves.setVolumeCurve(DEVICE_CATEGORY_SPEAKER, other);
+    expectMatchesCurve(curves, DEVICE_CATEGORY_SPEAKER, other);
+    ASSERT_EQ(NO_ERROR, curves.restoreOriginVolumeCurve());
+    expectMatchesCurve(curves, DEVICE_CATEGORY_SPEAKER, speaker);
+}
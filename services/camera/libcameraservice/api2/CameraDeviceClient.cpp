@@ -2128,6 +2128,9 @@ status_t CameraDeviceClient::dumpClient(int fd, const Vector<String16>& args) {
     } else {
         dprintf(fd, "      No output streams configured.\n");
     }
+    for (size_t i = 0; i < mCompositeStreamMap.size(); i++) {
+        mCompositeStreamMap.valueAt(i)->dump(fd, args);
+    }
     // TODO: print dynamic/request section from most recent requests
     mFrameProcessor->dump(fd, args);
 
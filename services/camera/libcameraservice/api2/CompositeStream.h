@@ -77,6 +77,9 @@ public:
     // Notify when shutter notify is triggered
     virtual void onShutter(const CaptureResultExtras& /*resultExtras*/, nsecs_t /*timestamp*/) {}
 
+    // Debug dump of the composite stream's state.
+    virtual void dump(int /*fd*/, const Vector<String16>& /*args*/) const {}
+
     void onResultAvailable(const CaptureResult& result);
     bool onError(int32_t errorCode, const CaptureResultExtras& resultExtras);
 
@@ -18,9 +18,11 @@
 #define ATRACE_TAG ATRACE_TAG_CAMERA
 //#define LOG_NDEBUG 0
 
+#include <algorithm>
 #include <linux/memfd.h>
 #include <pthread.h>
 #include <sys/syscall.h>
+#include <unistd.h>
 
 #include <android/hardware/camera/device/3.5/types.h>
 #include <libyuv.h>
@@ -69,12 +71,20 @@ HeicCompositeStream::HeicCompositeStream(sp<CameraDeviceBase> device,
         mCodecOutputCounter(0),
         mQuality(-1),
         mGridTimestampUs(0),
+        mTileCopyJobs(nullptr),
+        mTileCopySource(nullptr),
+        mNextTileCopyJob(0),
+        mPendingTileCopyJobs(0),
+        mTileCopyLatency(kTileCopyLatencyBinSize),
+        mEncodeLatency(kEncodeLatencyBinSize),
+        mMuxLatency(kMuxLatencyBinSize),
         mStatusId(StatusTracker::NO_STATUS_ID) {
 }
 
 HeicCompositeStream::~HeicCompositeStream() {
     // Call deinitCodec in case stream hasn't been deleted yet to avoid any
     // memory/resource leak.
+    stopTileCopyThreads();
     deinitCodec();
 
     mInputAppSegmentBuffers.clear();
@@ -215,6 +225,7 @@ status_t HeicCompositeStream::deleteInternalStreams() {
                 strerror(-res), res);
     }
 
+    stopTileCopyThreads();
     deinitCodec();
 
     if (mAppSegmentStreamId >= 0) {
@@ -513,6 +524,9 @@ status_t HeicCompositeStream::configureStream() {
         mStatusId = statusTracker->addComponent();
     }
 
+    if (mUseGrid) {
+        startTileCopyThreads();
+    }
     run("HeicCompositeStreamProc");
 
     return NO_ERROR;
@@ -1019,8 +1033,10 @@ status_t HeicCompositeStream::processAppSegment(int64_t frameNumber, InputFrame
     }
 
     sp<ABuffer> aBuffer = new ABuffer(appSegmentBuffer, appSegmentBufferSize);
+    nsecs_t muxStart = systemTime();
     auto res = inputFrame.muxer->writeSampleData(aBuffer, inputFrame.trackIndex,
             inputFrame.timestamp, MediaCodec::BUFFER_FLAG_MUXER_DATA);
+    inputFrame.muxDuration += systemTime() - muxStart;
     delete[] appSegmentBuffer;
 
     if (res != OK) {
@@ -1044,6 +1060,8 @@ status_t HeicCompositeStream::processAppSegment(int64_t frameNumber, InputFrame
 }
 
 status_t HeicCompositeStream::processCodecInputFrame(InputFrame &inputFrame) {
+    std::vector<TileCopyJob> jobs;
+    jobs.reserve(inputFrame.codecInputBuffers.size());
     for (auto& inputBuffer : inputFrame.codecInputBuffers) {
         sp<MediaCodecBuffer> buffer;
         auto res = mCodec->getInputBuffer(inputBuffer.index, &buffer);
@@ -1053,7 +1071,7 @@ status_t HeicCompositeStream::processCodecInputFrame(InputFrame &inputFrame) {
             return res;
         }
 
-        // Copy one tile from source to destination.
+        // Location of the tile in the source image.
         size_t tileX = inputBuffer.tileIndex % mGridCols;
         size_t tileY = inputBuffer.tileIndex / mGridCols;
         size_t top = mGridHeight * tileY;
@@ -1066,20 +1084,37 @@ status_t HeicCompositeStream::processCodecInputFrame(InputFrame &inputFrame) {
                 " timeUs %" PRId64, __FUNCTION__, tileX, tileY, top, left, width, height,
                 inputBuffer.timeUs);
 
-        res = copyOneYuvTile(buffer, inputFrame.yuvBuffer, top, left, width, height);
-        if (res != OK) {
+        jobs.push_back({buffer, top, left, width, height, OK});
+    }
+
+    // Copy all available tiles in parallel, then queue them in tile order.
+    nsecs_t copyStart = systemTime();
+    copyYuvTiles(inputFrame.yuvBuffer, jobs);
+    inputFrame.tileCopyDuration += systemTime() - copyStart;
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].res != OK) {
             ALOGE("%s: Failed to copy YUV tile %s (%d)", __FUNCTION__,
-                    strerror(-res), res);
-            return res;
+                    strerror(-jobs[i].res), jobs[i].res);
+            return jobs[i].res;
         }
 
-        res = mCodec->queueInputBuffer(inputBuffer.index, 0, buffer->capacity(),
+        const CodecInputBufferInfo& inputBuffer = inputFrame.codecInputBuffers[i];
+        auto res = mCodec->queueInputBuffer(inputBuffer.index, 0, jobs[i].buffer->capacity(),
                 inputBuffer.timeUs, 0, nullptr /*errorDetailMsg*/);
         if (res != OK) {
             ALOGE("%s: Failed to queueInputBuffer to Codec: %s (%d)",
                     __FUNCTION__, strerror(-res), res);
             return res;
         }
+        if (inputFrame.firstTileQueuedTime == 0) {
+            inputFrame.firstTileQueuedTime = systemTime();
+        }
+    }
+
+    if (inputFrame.codecInputCounter == mGridRows * mGridCols) {
+        Mutex::Autolock l(mStatsLock);
+        mTileCopyLatency.add(0, inputFrame.tileCopyDuration);
     }
 
     inputFrame.codecInputBuffers.clear();
@@ -1103,8 +1138,10 @@ status_t HeicCompositeStream::processOneCodecOutputFrame(int64_t frameNumber,
     }
 
     sp<ABuffer> aBuffer = new ABuffer(buffer->data(), buffer->size());
+    nsecs_t muxStart = systemTime();
     res = inputFrame.muxer->writeSampleData(
             aBuffer, inputFrame.trackIndex, inputFrame.timestamp, 0 /*flags*/);
+    inputFrame.muxDuration += systemTime() - muxStart;
     if (res != OK) {
         ALOGE("%s: Failed to write buffer index %d to muxer: %s (%d)",
                 __FUNCTION__, it->index, strerror(-res), res);
@@ -1116,6 +1153,10 @@ status_t HeicCompositeStream::processOneCodecOutputFrame(int64_t frameNumber,
         ALOGW("%s: Codec generated more tiles than expected!", __FUNCTION__);
     } else {
         inputFrame.pendingOutputTiles--;
+        if (inputFrame.pendingOutputTiles == 0 && inputFrame.firstTileQueuedTime != 0) {
+            Mutex::Autolock l(mStatsLock);
+            mEncodeLatency.add(inputFrame.firstTileQueuedTime, systemTime());
+        }
     }
 
     inputFrame.codecOutputBuffers.erase(inputFrame.codecOutputBuffers.begin());
@@ -1128,6 +1169,7 @@ status_t HeicCompositeStream::processOneCodecOutputFrame(int64_t frameNumber,
 status_t HeicCompositeStream::processCompletedInputFrame(int64_t frameNumber,
         InputFrame &inputFrame) {
     sp<ANativeWindow> outputANW = mOutputSurface;
+    nsecs_t muxStart = systemTime();
     inputFrame.muxer->stop();
 
     // Copy the content of the file to memory.
@@ -1156,6 +1198,11 @@ status_t HeicCompositeStream::processCompletedInputFrame(int64_t frameNumber,
 
     close(inputFrame.fileFd);
     inputFrame.fileFd = -1;
+    inputFrame.muxDuration += systemTime() - muxStart;
+    {
+        Mutex::Autolock l(mStatsLock);
+        mMuxLatency.add(0, inputFrame.muxDuration);
+    }
 
     // Fill in HEIC header
     uint8_t *header = static_cast<uint8_t*>(dstBuffer) + mMaxHeicBufferSize - sizeof(CameraBlob);
@@ -1626,6 +1673,105 @@ void HeicCompositeStream::initCopyRowFunction(int32_t width)
 #endif
 }
 
+void HeicCompositeStream::startTileCopyThreads() {
+    long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threadCount = (cpuCount > 1) ? static_cast<size_t>(cpuCount - 1) : 0;
+    // The composite processing thread copies tiles as well.
+    size_t maxThreads = kMaxTileCopyThreads;
+    threadCount = std::min({threadCount, maxThreads, mGridRows * mGridCols - 1});
+    for (size_t i = 0; i < threadCount; i++) {
+        sp<TileCopyThread> thread = new TileCopyThread(this);
+        status_t res = thread->run("HeicTileCopy");
+        if (res != OK) {
+            ALOGW("%s: Failed to start tile copy thread: %s (%d)", __FUNCTION__,
+                    strerror(-res), res);
+            break;
+        }
+        Mutex::Autolock l(mTileCopyLock);
+        mTileCopyThreads.push_back(thread);
+        ALOGV("%s: %zu tile copy threads", __FUNCTION__, mTileCopyThreads.size());
+    }
+}
+
+void HeicCompositeStream::stopTileCopyThreads() {
+    std::vector<sp<TileCopyThread>> threads;
+    {
+        Mutex::Autolock l(mTileCopyLock);
+        threads.swap(mTileCopyThreads);
+        for (auto& thread : threads) {
+            thread->requestExit();
+        }
+        mTileCopyCondition.broadcast();
+    }
+    // The workers need mTileCopyLock to exit.
+    for (auto& thread : threads) {
+        thread->join();
+    }
+}
+
+void HeicCompositeStream::copyYuvTiles(const CpuConsumer::LockedBuffer& yuvBuffer,
+        std::vector<TileCopyJob>& jobs) {
+    ATRACE_CALL();
+    Mutex::Autolock l(mTileCopyLock);
+    mTileCopySource = &yuvBuffer;
+    mTileCopyJobs = &jobs;
+    mNextTileCopyJob = 0;
+    mPendingTileCopyJobs = jobs.size();
+    mTileCopyCondition.broadcast();
+
+    while (copyNextYuvTileLocked()) {}
+    while (mPendingTileCopyJobs > 0) {
+        mTileCopyDoneCondition.wait(mTileCopyLock);
+    }
+    mTileCopyJobs = nullptr;
+    mTileCopySource = nullptr;
+}
+
+bool HeicCompositeStream::copyNextYuvTileLocked() {
+    if (mTileCopyJobs == nullptr || mNextTileCopyJob >= mTileCopyJobs->size()) {
+        return false;
+    }
+    TileCopyJob& job = (*mTileCopyJobs)[mNextTileCopyJob++];
+    const CpuConsumer::LockedBuffer& yuvBuffer = *mTileCopySource;
+
+    mTileCopyLock.unlock();
+    job.res = copyOneYuvTile(job.buffer, yuvBuffer, job.top, job.left, job.width, job.height);
+    mTileCopyLock.lock();
+
+    if (--mPendingTileCopyJobs == 0) {
+        mTileCopyDoneCondition.signal();
+    }
+    return true;
+}
+
+bool HeicCompositeStream::TileCopyThread::threadLoop() {
+    Mutex::Autolock l(mParent->mTileCopyLock);
+    // Sleep until copyYuvTiles() queues tiles or stopTileCopyThreads() asks to exit; both
+    // signal under mTileCopyLock, so neither can be missed between the check and the wait.
+    if (!mParent->copyNextYuvTileLocked() && !exitPending()) {
+        mParent->mTileCopyCondition.wait(mParent->mTileCopyLock);
+    }
+    return true;
+}
+
+void HeicCompositeStream::dump(int fd, const Vector<String16>& /*args*/) const {
+    size_t tileCopyThreads;
+    {
+        Mutex::Autolock l(mTileCopyLock);
+        tileCopyThreads = mTileCopyThreads.size();
+    }
+    String8 lines;
+    lines.appendFormat("    HEIC composite stream %d: %s, grid %zu x %zu, %zu tile copy threads\n",
+            mMainImageStreamId, mUseHeic ? "HEIC" : "HEVC", mGridRows, mGridCols,
+            tileCopyThreads);
+    write(fd, lines.string(), lines.size());
+
+    Mutex::Autolock l(mStatsLock);
+    mTileCopyLatency.dump(fd, "      YUV tile copy latency histogram:");
+    mEncodeLatency.dump(fd, "      HEVC encode latency histogram:");
+    mMuxLatency.dump(fd, "      Muxer latency histogram:");
+}
+
 size_t HeicCompositeStream::calcAppSegmentMaxSize(const CameraMetadata& info) {
     camera_metadata_ro_entry_t entry = info.find(ANDROID_HEIC_INFO_MAX_JPEG_APP_SEGMENTS_COUNT);
     size_t maxAppsSegment = 1;
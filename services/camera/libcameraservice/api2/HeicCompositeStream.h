@@ -30,6 +30,7 @@
 #include <media/stagefright/MediaMuxer.h>
 
 #include "CompositeStream.h"
+#include "utils/LatencyHistogram.h"
 
 namespace android {
 namespace camera3 {
@@ -76,6 +77,8 @@ public:
     static bool isSizeSupportedByHeifEncoder(int32_t width, int32_t height,
             bool* useHeic, bool* useGrid, int64_t* stall, AString* hevcName = nullptr);
     static bool isInMemoryTempFileSupported();
+
+    void dump(int fd, const Vector<String16>& args) const override;
 protected:
 
     bool threadLoop() override;
@@ -173,10 +176,16 @@ private:
         size_t                    pendingOutputTiles;
         size_t                    codecInputCounter;
 
+        // Per-stage latency bookkeeping
+        nsecs_t                   tileCopyDuration;
+        nsecs_t                   firstTileQueuedTime;
+        nsecs_t                   muxDuration;
+
         InputFrame() : orientation(0), quality(kDefaultJpegQuality), error(false),
                        exifError(false), timestamp(-1), requestId(-1), fenceFd(-1),
                        fileFd(-1), trackIndex(-1), anb(nullptr), appSegmentWritten(false),
-                       pendingOutputTiles(0), codecInputCounter(0) { }
+                       pendingOutputTiles(0), codecInputCounter(0), tileCopyDuration(0),
+                       firstTileQueuedTime(0), muxDuration(0) { }
     };
 
     void compilePendingInputLocked();
@@ -275,6 +284,55 @@ private:
     // Function pointer of libyuv row copy.
     void (*mFnCopyRow)(const uint8_t* src, uint8_t* dst, int width);
 
+    //
+    // Parallel YUV tile copy (for HEVC YUV tiling only). The tiles available
+    // for an input frame are split between the composite processing thread and
+    // a few worker threads, and queued to the codec in tile order once all of
+    // them are copied.
+    //
+    struct TileCopyJob {
+        sp<MediaCodecBuffer> buffer;
+        size_t top, left, width, height;
+        status_t res;
+    };
+
+    class TileCopyThread : public Thread {
+    public:
+        explicit TileCopyThread(HeicCompositeStream* parent) : mParent(parent) {}
+    private:
+        bool threadLoop() override;
+        HeicCompositeStream* mParent;
+    };
+
+    void startTileCopyThreads();
+    void stopTileCopyThreads();
+    // Copy all jobs, using the worker threads and the calling thread.
+    void copyYuvTiles(const CpuConsumer::LockedBuffer& yuvBuffer,
+            std::vector<TileCopyJob>& jobs);
+    // Copy one pending job if there is any. Returns false if no job is pending.
+    bool copyNextYuvTileLocked();
+
+    static const size_t kMaxTileCopyThreads = 3;
+    static const int32_t kTileCopyLatencyBinSize = 2; // in ms
+    static const int32_t kEncodeLatencyBinSize = 20; // in ms
+    static const int32_t kMuxLatencyBinSize = 5; // in ms
+    // Guards the tile copy threads and jobs below.
+    mutable Mutex     mTileCopyLock;
+    std::vector<sp<TileCopyThread>> mTileCopyThreads;
+    Condition         mTileCopyCondition;     // signalled when jobs are queued or on exit
+    Condition         mTileCopyDoneCondition;
+    std::vector<TileCopyJob>* mTileCopyJobs;
+    const CpuConsumer::LockedBuffer* mTileCopySource;
+    size_t            mNextTileCopyJob;
+    size_t            mPendingTileCopyJobs;
+
+    // Per-stage capture latency: copying YUV tiles into codec input buffers,
+    // HEVC encoding (first tile queued to last tile encoded), and muxing.
+    mutable Mutex     mStatsLock;
+    CameraLatencyHistogram mTileCopyLatency;
+    CameraLatencyHistogram mEncodeLatency;
+    CameraLatencyHistogram mMuxLatency;
+
     // A set of APP_SEGMENT error frame numbers
     std::set<int64_t> mExifErrorFrameNumbers;
     void flagAnExifErrorFrameNumber(int64_t frameNumber);
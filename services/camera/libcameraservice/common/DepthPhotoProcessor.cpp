@@ -34,6 +34,7 @@
 #include <jpeglib.h>
 #include <libexif/exif-data.h>
 #include <libexif/exif-system.h>
+#include <algorithm>
 #include <math.h>
 #include <sstream>
 #include <utils/Errors.h>
@@ -235,100 +236,138 @@ status_t encodeGrayscaleJpeg(size_t width, size_t height, uint8_t *in, void *out
     return ret;
 }
 
-inline void unpackDepth16(uint16_t value, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    // Android densely packed depth map. The units for the range are in
-    // millimeters and need to be scaled to meters.
-    // The confidence value is encoded in the 3 most significant bits.
-    // The confidence data needs to be additionally normalized with
-    // values 1.0f, 0.0f representing maximum and minimum confidence
-    // respectively.
-    auto point = static_cast<float>(value & 0x1FFF) / 1000.f;
-    points->push_back(point);
-
-    auto conf = (value >> 13) & 0x7;
-    float normConfidence = (conf == 0) ? 1.f : (static_cast<float>(conf) - 1) / 7.f;
-    confidence->push_back(normConfidence);
-    if (normConfidence < CONFIDENCE_THRESHOLD) {
-        return;
-    }
+// Android densely packed depth map. The units for the range are in
+// millimeters and need to be scaled to meters.
+// The confidence value is encoded in the 3 most significant bits.
+static const uint16_t DEPTH_RANGE_MASK = 0x1FFF;
+static const size_t DEPTH_CONFIDENCE_SHIFT = 13;
+static const size_t DEPTH_CONFIDENCE_LEVELS = 8;
 
-    if (*near > point) {
-        *near = point;
-    }
-    if (*far < point) {
-        *far = point;
-    }
+static inline float unpackDepthRange(uint16_t range) {
+    return static_cast<float>(range) / 1000.f;
 }
 
-// Trivial case, read forward from top,left corner.
-void rotate0AndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    for (size_t i = 0; i < inputFrame.mDepthMapHeight; i++) {
-        for (size_t j = 0; j < inputFrame.mDepthMapWidth; j++) {
-            unpackDepth16(inputFrame.mDepthMapBuffer[i*inputFrame.mDepthMapStride + j], points,
-                    confidence, near, far);
-        }
-    }
+// The confidence data needs to be additionally normalized with
+// values 1.0f, 0.0f representing maximum and minimum confidence
+// respectively.
+static inline float unpackDepthConfidence(uint16_t conf) {
+    return (conf == 0) ? 1.f : (static_cast<float>(conf) - 1) / 7.f;
 }
 
-// 90 degrees CW rotation can be applied by starting to read from bottom, left corner
-// transposing rows and columns.
-void rotate90AndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    for (size_t i = 0; i < inputFrame.mDepthMapWidth; i++) {
-        for (ssize_t j = inputFrame.mDepthMapHeight-1; j >= 0; j--) {
-            unpackDepth16(inputFrame.mDepthMapBuffer[j*inputFrame.mDepthMapStride + i], points,
-                    confidence, near, far);
-        }
+int unpackDepthMap(const DepthPhotoInputFrame& inputFrame, bool applyOrientation,
+        uint8_t *depth /*out*/, uint8_t *confidence /*out*/, float *near /*out*/,
+        float *far /*out*/, bool *switchDimensions /*out*/) {
+    if ((inputFrame.mDepthMapBuffer == nullptr) || (depth == nullptr) ||
+            (confidence == nullptr) || (near == nullptr) || (far == nullptr) ||
+            (switchDimensions == nullptr)) {
+        return BAD_VALUE;
     }
-}
 
-// 180 CW degrees rotation can be applied by starting to read backwards from bottom, right corner.
-void rotate180AndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    for (ssize_t i = inputFrame.mDepthMapHeight-1; i >= 0; i--) {
-        for (ssize_t j = inputFrame.mDepthMapWidth-1; j >= 0; j--) {
-            unpackDepth16(inputFrame.mDepthMapBuffer[i*inputFrame.mDepthMapStride + j], points,
-                    confidence, near, far);
+    // Only 8 confidence levels exist, so both the normalized confidence and
+    // whether a sample is confident enough to contribute to the near/far
+    // range can be looked up instead of computed per sample.
+    uint8_t confidenceQuantized[DEPTH_CONFIDENCE_LEVELS];
+    uint32_t confidentMask = 0;
+    for (size_t i = 0; i < DEPTH_CONFIDENCE_LEVELS; i++) {
+        float normConfidence = unpackDepthConfidence(i);
+        confidenceQuantized[i] = floorf(normConfidence * 255.0f);
+        if (normConfidence >= CONFIDENCE_THRESHOLD) {
+            confidentMask |= 1 << i;
         }
     }
-}
 
-// 270 degrees CW rotation can be applied by starting to read from top, right corner
-// transposing rows and columns.
-void rotate270AndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    for (ssize_t i = inputFrame.mDepthMapWidth-1; i >= 0; i--) {
-        for (size_t j = 0; j < inputFrame.mDepthMapHeight; j++) {
-            unpackDepth16(inputFrame.mDepthMapBuffer[j*inputFrame.mDepthMapStride + i], points,
-                    confidence, near, far);
+    // Find the near/far range of the confident samples directly on the packed
+    // values. The loop is branch free so that it can be vectorized, and the
+    // result does not depend on the orientation.
+    const size_t width = inputFrame.mDepthMapWidth;
+    const size_t height = inputFrame.mDepthMapHeight;
+    uint16_t nearRange = DEPTH_RANGE_MASK;
+    uint16_t farRange = 0;
+    for (size_t i = 0; i < height; i++) {
+        const uint16_t *row = inputFrame.mDepthMapBuffer + i * inputFrame.mDepthMapStride;
+        for (size_t j = 0; j < width; j++) {
+            uint16_t range = row[j] & DEPTH_RANGE_MASK;
+            bool confident = (confidentMask >> (row[j] >> DEPTH_CONFIDENCE_SHIFT)) & 1;
+            nearRange = std::min<uint16_t>(nearRange, confident ? range : DEPTH_RANGE_MASK);
+            farRange = std::max<uint16_t>(farRange, confident ? range : 0);
         }
     }
-}
+    if (nearRange >= farRange) {
+        ALOGE("%s: Near and far range values must not match!", __FUNCTION__);
+        return BAD_VALUE;
+    }
+    *near = unpackDepthRange(nearRange);
+    *far = unpackDepthRange(farRange);
+
+    // Range inverse coding of every possible depth value within [near, far].
+    // Samples with low confidence are clamped into this range before lookup.
+    uint8_t depthQuantized[DEPTH_RANGE_MASK + 1];
+    for (uint16_t range = nearRange; range <= farRange; range++) {
+        float point = unpackDepthRange(range);
+        depthQuantized[range] = floorf(((*far * (point - *near)) /
+                (point * (*far - *near))) * 255.0f);
+    }
 
-bool rotateAndUnpack(DepthPhotoInputFrame inputFrame, std::vector<float> *points /*out*/,
-        std::vector<float> *confidence /*out*/, float *near /*out*/, float *far /*out*/) {
-    switch (inputFrame.mOrientation) {
+    // Physical rotation is applied by walking the source in the order of the
+    // destination rows:
+    //  - 0 degrees: read forward from top, left corner.
+    //  - 90 degrees CW: read each column upwards, starting from bottom, left corner.
+    //  - 180 degrees CW: read backwards from bottom, right corner.
+    //  - 270 degrees CW: read each column downwards, starting from top, right corner.
+    DepthPhotoOrientation orientation = applyOrientation ? inputFrame.mOrientation :
+            DepthPhotoOrientation::DEPTH_ORIENTATION_0_DEGREES;
+    const ssize_t stride = inputFrame.mDepthMapStride;
+    const uint16_t *start = inputFrame.mDepthMapBuffer;
+    ssize_t rowStep, columnStep;
+    size_t outWidth = width, outHeight = height;
+    switch (orientation) {
         case DepthPhotoOrientation::DEPTH_ORIENTATION_0_DEGREES:
-            rotate0AndUnpack(inputFrame, points, confidence, near, far);
-            return false;
+            rowStep = stride;
+            columnStep = 1;
+            break;
         case DepthPhotoOrientation::DEPTH_ORIENTATION_90_DEGREES:
-            rotate90AndUnpack(inputFrame, points, confidence, near, far);
-            return true;
+            start += (height - 1) * stride;
+            rowStep = 1;
+            columnStep = -stride;
+            outWidth = height;
+            outHeight = width;
+            break;
         case DepthPhotoOrientation::DEPTH_ORIENTATION_180_DEGREES:
-            rotate180AndUnpack(inputFrame, points, confidence, near, far);
-            return false;
+            start += (height - 1) * stride + width - 1;
+            rowStep = -stride;
+            columnStep = -1;
+            break;
         case DepthPhotoOrientation::DEPTH_ORIENTATION_270_DEGREES:
-            rotate270AndUnpack(inputFrame, points, confidence, near, far);
-            return true;
+            start += width - 1;
+            rowStep = -1;
+            columnStep = stride;
+            outWidth = height;
+            outHeight = width;
+            break;
         default:
             ALOGE("%s: Unsupported depth photo rotation: %d, default to 0", __FUNCTION__,
-                    inputFrame.mOrientation);
-            rotate0AndUnpack(inputFrame, points, confidence, near, far);
+                    orientation);
+            rowStep = stride;
+            columnStep = 1;
+    }
+    *switchDimensions = (outWidth != width) || (outHeight != height);
+
+    for (size_t i = 0; i < outHeight; i++) {
+        const uint16_t *src = start + i * rowStep;
+        uint8_t *depthRow = depth + i * outWidth;
+        uint8_t *confidenceRow = confidence + i * outWidth;
+        for (size_t j = 0; j < outWidth; j++, src += columnStep) {
+            uint16_t range = *src & DEPTH_RANGE_MASK;
+            uint16_t conf = *src >> DEPTH_CONFIDENCE_SHIFT;
+            if (((confidentMask >> conf) & 1) == 0) {
+                range = std::clamp(range, nearRange, farRange);
+            }
+            depthRow[j] = depthQuantized[range];
+            confidenceRow[j] = confidenceQuantized[conf];
+        }
     }
 
-    return false;
+    return OK;
 }
 
 std::unique_ptr<dynamic_depth::DepthMap> processDepthMapFrame(DepthPhotoInputFrame inputFrame,
@@ -338,21 +377,17 @@ std::unique_ptr<dynamic_depth::DepthMap> processDepthMapFrame(DepthPhotoInputFra
         return nullptr;
     }
 
-    std::vector<float> points, confidence;
-
     size_t pointCount = inputFrame.mDepthMapWidth * inputFrame.mDepthMapHeight;
-    points.reserve(pointCount);
-    confidence.reserve(pointCount);
-    float near = UINT16_MAX;
-    float far = .0f;
-    *switchDimensions = false;
+    std::vector<uint8_t> pointsQuantized(pointCount), confidenceQuantized(pointCount);
+    float near, far;
     // Physical rotation of depth and confidence maps may be needed in case
     // the EXIF orientation is set to 0 degrees and the depth photo orientation
     // (source color image) has some different value.
-    if (exifOrientation == ExifOrientation::ORIENTATION_0_DEGREES) {
-        *switchDimensions = rotateAndUnpack(inputFrame, &points, &confidence, &near, &far);
-    } else {
-        rotate0AndUnpack(inputFrame, &points, &confidence, &near, &far);
+    bool applyOrientation = (exifOrientation == ExifOrientation::ORIENTATION_0_DEGREES);
+    if (unpackDepthMap(inputFrame, applyOrientation, pointsQuantized.data(),
+                confidenceQuantized.data(), &near, &far, switchDimensions) != OK) {
+        ALOGE("%s: Depth map unpacking failed!", __FUNCTION__);
+        return nullptr;
     }
 
     size_t width = inputFrame.mDepthMapWidth;
@@ -362,26 +397,6 @@ std::unique_ptr<dynamic_depth::DepthMap> processDepthMapFrame(DepthPhotoInputFra
         height = inputFrame.mDepthMapWidth;
     }
 
-    if (near == far) {
-        ALOGE("%s: Near and far range values must not match!", __FUNCTION__);
-        return nullptr;
-    }
-
-    std::vector<uint8_t> pointsQuantized, confidenceQuantized;
-    pointsQuantized.reserve(pointCount); confidenceQuantized.reserve(pointCount);
-    auto pointIt = points.begin();
-    auto confidenceIt = confidence.begin();
-    while ((pointIt != points.end()) && (confidenceIt != confidence.end())) {
-        auto point = *pointIt;
-        if ((*confidenceIt) < CONFIDENCE_THRESHOLD) {
-            point = std::clamp(point, near, far);
-        }
-        pointsQuantized.push_back(floorf(((far * (point - near)) /
-                (point * (far - near))) * 255.0f));
-        confidenceQuantized.push_back(floorf(*confidenceIt * 255.0f));
-        confidenceIt++; pointIt++;
-    }
-
     DepthMapParams depthParams(DepthFormat::kRangeInverse, near, far, DepthUnits::kMeters,
             "android/depthmap");
     depthParams.confidence_uri = "android/confidencemap";
@@ -64,6 +64,14 @@ struct DepthPhotoInputFrame {
             mOrientation(DepthPhotoOrientation::DEPTH_ORIENTATION_0_DEGREES) {}
 };
 
+// Unpack a DEPTH16 depth map into 8-bit range inverse depth and confidence planes, each
+// holding mDepthMapWidth * mDepthMapHeight samples. The planes are physically rotated
+// according to mOrientation if 'applyOrientation' is set, in which case 'switchDimensions'
+// reports whether the output width and height are swapped.
+int unpackDepthMap(const DepthPhotoInputFrame& /*inputFrame*/, bool /*applyOrientation*/,
+        uint8_t* /*depth out*/, uint8_t* /*confidence out*/, float* /*near out*/,
+        float* /*far out*/, bool* /*switchDimensions out*/);
+
 int processDepthPhotoFrame(DepthPhotoInputFrame /*inputFrame*/,
         size_t /*depthPhotoBufferSize*/, void* /*depthPhotoBuffer out*/,
         size_t* /*depthPhotoActualSize out*/);
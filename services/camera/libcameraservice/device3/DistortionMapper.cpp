@@ -20,6 +20,9 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
+
+#include <cutils/properties.h>
 
 #include "device3/DistortionMapper.h"
 
@@ -28,7 +31,11 @@ namespace android {
 namespace camera3 {
 
 
-DistortionMapper::DistortionMapper() : mValidMapping(false), mValidGrids(false) {
+DistortionMapper::DistortionMapper() : mValidMapping(false), mValidGrids(false),
+        mBucketMinX(0), mBucketMinY(0), mBucketMaxX(0), mBucketMaxY(0),
+        mInvBucketWidth(0), mInvBucketHeight(0),
+        mUseLut(property_get_bool("camera.distortion.use_lut", false)), mValidLut(false),
+        mLutStep(0), mLutWidth(0), mLutHeight(0), mLutMaxError(-1) {
 }
 
 bool DistortionMapper::isDistortionSupported(const CameraMetadata &deviceInfo) {
@@ -193,7 +200,7 @@ status_t DistortionMapper::updateCalibration(const CameraMetadata &result) {
     // Need to recalculate grid
     mValidGrids = false;
 
-    return OK;
+    return updateLut();
 }
 
 status_t DistortionMapper::mapRawToCorrected(int32_t *coordPairs, int coordCount,
@@ -208,39 +215,11 @@ status_t DistortionMapper::mapRawToCorrected(int32_t *coordPairs, int coordCount
     }
 
     for (int i = 0; i < coordCount * 2; i += 2) {
-        const GridQuad *quad = findEnclosingQuad(coordPairs + i, mDistortedGrid);
-        if (quad == nullptr) {
-            ALOGE("Raw to corrected mapping failure: No quad found for (%d, %d)",
-                    *(coordPairs + i), *(coordPairs + i + 1));
-            return INVALID_OPERATION;
-        }
-        ALOGV("src xy: %d, %d, enclosing quad: (%f, %f), (%f, %f), (%f, %f), (%f, %f)",
-                coordPairs[i], coordPairs[i+1],
-                quad->coords[0], quad->coords[1],
-                quad->coords[2], quad->coords[3],
-                quad->coords[4], quad->coords[5],
-                quad->coords[6], quad->coords[7]);
-
-        const GridQuad *corrQuad = quad->src;
-        if (corrQuad == nullptr) {
-            ALOGE("Raw to corrected mapping failure: No src quad found");
-            return INVALID_OPERATION;
+        float corrX, corrY;
+        if (!mValidLut || !lookupRawToCorrected(coordPairs + i, &corrX, &corrY)) {
+            status_t res = mapRawToCorrectedExact(coordPairs + i, &corrX, &corrY);
+            if (res != OK) return res;
         }
-        ALOGV("              corr quad: (%f, %f), (%f, %f), (%f, %f), (%f, %f)",
-                corrQuad->coords[0], corrQuad->coords[1],
-                corrQuad->coords[2], corrQuad->coords[3],
-                corrQuad->coords[4], corrQuad->coords[5],
-                corrQuad->coords[6], corrQuad->coords[7]);
-
-        float u = calculateUorV(coordPairs + i, *quad, /*calculateU*/ true);
-        float v = calculateUorV(coordPairs + i, *quad, /*calculateU*/ false);
-
-        ALOGV("uv: %f, %f", u, v);
-
-        // Interpolate along top edge of corrected quad (which are axis-aligned) for x
-        float corrX = corrQuad->coords[0] + u * (corrQuad->coords[2] - corrQuad->coords[0]);
-        // Interpolate along left edge of corrected quad (which are axis-aligned) for y
-        float corrY = corrQuad->coords[1] + v * (corrQuad->coords[7] - corrQuad->coords[1]);
 
         // Clamp to within active array
         if (clamp) {
@@ -255,6 +234,43 @@ status_t DistortionMapper::mapRawToCorrected(int32_t *coordPairs, int coordCount
     return OK;
 }
 
+status_t DistortionMapper::mapRawToCorrectedExact(const int32_t pt[2], float *corrX,
+        float *corrY) const {
+    ssize_t quadIndex = findEnclosingDistortedQuad(pt);
+    if (quadIndex < 0) {
+        ALOGE("Raw to corrected mapping failure: No quad found for (%d, %d)", pt[0], pt[1]);
+        return INVALID_OPERATION;
+    }
+    const GridQuad *quad = &mDistortedGrid[quadIndex];
+    ALOGV("src xy: %d, %d, enclosing quad: (%f, %f), (%f, %f), (%f, %f), (%f, %f)",
+            pt[0], pt[1],
+            quad->coords[0], quad->coords[1],
+            quad->coords[2], quad->coords[3],
+            quad->coords[4], quad->coords[5],
+            quad->coords[6], quad->coords[7]);
+
+    // Distorted and corrected grids share their layout; look up the corrected quad by
+    // index rather than through the src pointer, which is not updated when copying.
+    const GridQuad *corrQuad = &mCorrectedGrid[quadIndex];
+    ALOGV("              corr quad: (%f, %f), (%f, %f), (%f, %f), (%f, %f)",
+            corrQuad->coords[0], corrQuad->coords[1],
+            corrQuad->coords[2], corrQuad->coords[3],
+            corrQuad->coords[4], corrQuad->coords[5],
+            corrQuad->coords[6], corrQuad->coords[7]);
+
+    float u = calculateUorV(pt, *quad, /*calculateU*/ true);
+    float v = calculateUorV(pt, *quad, /*calculateU*/ false);
+
+    ALOGV("uv: %f, %f", u, v);
+
+    // Interpolate along top edge of corrected quad (which are axis-aligned) for x
+    *corrX = corrQuad->coords[0] + u * (corrQuad->coords[2] - corrQuad->coords[0]);
+    // Interpolate along left edge of corrected quad (which are axis-aligned) for y
+    *corrY = corrQuad->coords[1] + v * (corrQuad->coords[7] - corrQuad->coords[1]);
+
+    return OK;
+}
+
 status_t DistortionMapper::mapRawToCorrectedSimple(int32_t *coordPairs, int coordCount,
         bool clamp) const {
     if (!mValidMapping) return INVALID_OPERATION;
@@ -388,6 +404,36 @@ status_t DistortionMapper::mapCorrectedRectToRaw(int32_t *rects, int rectCount,
     return OK;
 }
 
+static bool isPointInQuad(float x, float y, const DistortionMapper::GridQuad& quad) {
+    const float &x1 = quad.coords[0];
+    const float &y1 = quad.coords[1];
+    const float &x2 = quad.coords[2];
+    const float &y2 = quad.coords[3];
+    const float &x3 = quad.coords[4];
+    const float &y3 = quad.coords[5];
+    const float &x4 = quad.coords[6];
+    const float &y4 = quad.coords[7];
+
+    // Point-in-quad test:
+
+    // Quad has corners P1-P4; if P is within the quad, then it is on the same side of all the
+    // edges (or on top of one of the edges or corners), traversed in a consistent direction.
+    // This means that the cross product of edge En = Pn->P(n+1 mod 4) and line Ep = Pn->P must
+    // have the same sign (or be zero) for all edges.
+    // For clockwise traversal, the sign should be negative or zero for Ep x En, indicating that
+    // En is to the left of Ep, or overlapping.
+    float s1 = (x - x1) * (y2 - y1) - (y - y1) * (x2 - x1);
+    if (s1 > 0) return false;
+    float s2 = (x - x2) * (y3 - y2) - (y - y2) * (x3 - x2);
+    if (s2 > 0) return false;
+    float s3 = (x - x3) * (y4 - y3) - (y - y3) * (x4 - x3);
+    if (s3 > 0) return false;
+    float s4 = (x - x4) * (y1 - y4) - (y - y4) * (x1 - x4);
+    if (s4 > 0) return false;
+
+    return true;
+}
+
 status_t DistortionMapper::buildGrids() {
     if (mCorrectedGrid.size() != kGridSize * kGridSize) {
         mCorrectedGrid.resize(kGridSize * kGridSize);
@@ -418,43 +464,206 @@ status_t DistortionMapper::buildGrids() {
         }
     }
 
+    buildBuckets();
     mValidGrids = true;
     return OK;
 }
 
+void DistortionMapper::buildBuckets() {
+    mBucketMinX = mBucketMinY = std::numeric_limits<float>::max();
+    mBucketMaxX = mBucketMaxY = std::numeric_limits<float>::lowest();
+    for (const GridQuad& quad : mDistortedGrid) {
+        for (size_t k = 0; k < quad.coords.size(); k += 2) {
+            mBucketMinX = std::min(mBucketMinX, quad.coords[k]);
+            mBucketMaxX = std::max(mBucketMaxX, quad.coords[k]);
+            mBucketMinY = std::min(mBucketMinY, quad.coords[k + 1]);
+            mBucketMaxY = std::max(mBucketMaxY, quad.coords[k + 1]);
+        }
+    }
+    mInvBucketWidth = kBucketCount / (mBucketMaxX - mBucketMinX);
+    mInvBucketHeight = kBucketCount / (mBucketMaxY - mBucketMinY);
+
+    // Bucket of a coordinate; monotonic, so a point within a quad's bounding box always
+    // falls into one of the buckets covered by that bounding box.
+    auto bucketX = [this](float x) {
+        return std::min(kBucketCount - 1,
+                static_cast<size_t>(std::max(0.f, (x - mBucketMinX) * mInvBucketWidth)));
+    };
+    auto bucketY = [this](float y) {
+        return std::min(kBucketCount - 1,
+                static_cast<size_t>(std::max(0.f, (y - mBucketMinY) * mInvBucketHeight)));
+    };
+
+    // Two passes over the quads; first count the quads per bucket, then fill them in grid
+    // order, so that each bucket lists its quads in the same order as a linear search.
+    std::vector<std::array<size_t, 4>> quadBuckets(mDistortedGrid.size());
+    mBucketStart.assign(kBucketCount * kBucketCount + 1, 0);
+    for (size_t q = 0; q < mDistortedGrid.size(); q++) {
+        const auto& coords = mDistortedGrid[q].coords;
+        float minX = std::min({coords[0], coords[2], coords[4], coords[6]});
+        float maxX = std::max({coords[0], coords[2], coords[4], coords[6]});
+        float minY = std::min({coords[1], coords[3], coords[5], coords[7]});
+        float maxY = std::max({coords[1], coords[3], coords[5], coords[7]});
+        quadBuckets[q] = {bucketX(minX), bucketX(maxX), bucketY(minY), bucketY(maxY)};
+        for (size_t by = quadBuckets[q][2]; by <= quadBuckets[q][3]; by++) {
+            for (size_t bx = quadBuckets[q][0]; bx <= quadBuckets[q][1]; bx++) {
+                mBucketStart[by * kBucketCount + bx + 1]++;
+            }
+        }
+    }
+    for (size_t b = 1; b < mBucketStart.size(); b++) {
+        mBucketStart[b] += mBucketStart[b - 1];
+    }
+    mBucketQuads.resize(mBucketStart.back());
+    std::vector<uint32_t> fill(mBucketStart.begin(), mBucketStart.end() - 1);
+    for (size_t q = 0; q < mDistortedGrid.size(); q++) {
+        for (size_t by = quadBuckets[q][2]; by <= quadBuckets[q][3]; by++) {
+            for (size_t bx = quadBuckets[q][0]; bx <= quadBuckets[q][1]; bx++) {
+                mBucketQuads[fill[by * kBucketCount + bx]++] = q;
+            }
+        }
+    }
+}
+
+ssize_t DistortionMapper::findEnclosingDistortedQuad(const int32_t pt[2]) const {
+    const float x = pt[0];
+    const float y = pt[1];
+    if (x < mBucketMinX || x > mBucketMaxX || y < mBucketMinY || y > mBucketMaxY) {
+        return -1;
+    }
+    size_t bx = std::min(kBucketCount - 1,
+            static_cast<size_t>(std::max(0.f, (x - mBucketMinX) * mInvBucketWidth)));
+    size_t by = std::min(kBucketCount - 1,
+            static_cast<size_t>(std::max(0.f, (y - mBucketMinY) * mInvBucketHeight)));
+    size_t bucket = by * kBucketCount + bx;
+    for (size_t i = mBucketStart[bucket]; i < mBucketStart[bucket + 1]; i++) {
+        if (isPointInQuad(x, y, mDistortedGrid[mBucketQuads[i]])) {
+            return mBucketQuads[i];
+        }
+    }
+    return -1;
+}
+
+void DistortionMapper::setLutMode(bool enabled) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mUseLut == enabled) return;
+    mUseLut = enabled;
+    status_t res = updateLut();
+    if (res != OK) {
+        ALOGE("Unable to build distortion grids for the lookup table: %d", res);
+    }
+}
+
+float DistortionMapper::getLutMaxError() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mValidLut ? mLutMaxError : -1;
+}
+
+status_t DistortionMapper::updateLut() {
+    mValidLut = false;
+    mLutMaxError = -1;
+    if (!mUseLut || !mValidMapping) return OK;
+
+    if (!mValidGrids) {
+        status_t res = buildGrids();
+        if (res != OK) return res;
+    }
+    if (buildLut() != OK) {
+        ALOGW("Unable to build raw to corrected lookup table, using exact mapping");
+    }
+    return OK;
+}
+
+status_t DistortionMapper::buildLut() {
+    // Refine the table until the interpolation error is within bounds
+    for (size_t cells = kLutInitialCells; cells <= kLutMaxCells; cells *= 2) {
+        float maxError;
+        status_t res = buildLut(cells, &maxError);
+        if (res != OK) return res;
+        ALOGV("Raw to corrected table with %zu cells: max error %f", cells, maxError);
+        if (maxError <= kMaxLutError) {
+            mLutMaxError = maxError;
+            mValidLut = true;
+            return OK;
+        }
+    }
+    return INVALID_OPERATION;
+}
+
+status_t DistortionMapper::buildLut(size_t cells, float *maxError) {
+    // Nodes are placed at integer raw coordinates covering the pre-correction active array.
+    int32_t arrayWidth = static_cast<int32_t>(mArrayWidth);
+    int32_t arrayHeight = static_cast<int32_t>(mArrayHeight);
+    mLutStep = std::max<int32_t>(1, (std::max(arrayWidth, arrayHeight) + cells - 1) / cells);
+    mLutWidth = (arrayWidth - 1 + mLutStep - 1) / mLutStep + 1;
+    mLutHeight = (arrayHeight - 1 + mLutStep - 1) / mLutStep + 1;
+    if (mLutWidth < 2 || mLutHeight < 2) return BAD_VALUE;
+
+    mLut.resize(mLutWidth * mLutHeight * 2);
+    for (size_t j = 0; j < mLutHeight; j++) {
+        for (size_t i = 0; i < mLutWidth; i++) {
+            int32_t pt[2] = { static_cast<int32_t>(i) * mLutStep,
+                    static_cast<int32_t>(j) * mLutStep };
+            size_t index = (j * mLutWidth + i) * 2;
+            status_t res = mapRawToCorrectedExact(pt, &mLut[index], &mLut[index + 1]);
+            if (res != OK) return res;
+        }
+    }
+
+    // Interpolation error is largest away from the nodes; check it at every cell center
+    // and edge midpoint.
+    *maxError = 0;
+    int32_t half = std::max(1, mLutStep / 2);
+    for (size_t j = 0; j + 1 < mLutHeight; j++) {
+        for (size_t i = 0; i + 1 < mLutWidth; i++) {
+            int32_t x = static_cast<int32_t>(i) * mLutStep;
+            int32_t y = static_cast<int32_t>(j) * mLutStep;
+            const int32_t samples[3][2] = {{x + half, y + half}, {x + half, y}, {x, y + half}};
+            for (const auto& pt : samples) {
+                float exactX, exactY, lutX, lutY;
+                status_t res = mapRawToCorrectedExact(pt, &exactX, &exactY);
+                if (res != OK || !lookupRawToCorrected(pt, &lutX, &lutY)) {
+                    return INVALID_OPERATION;
+                }
+                *maxError = std::max(*maxError,
+                        std::hypot(lutX - exactX, lutY - exactY));
+            }
+        }
+    }
+    return OK;
+}
+
+bool DistortionMapper::lookupRawToCorrected(const int32_t pt[2], float *corrX,
+        float *corrY) const {
+    if (pt[0] < 0 || pt[1] < 0) return false;
+    size_t i = pt[0] / mLutStep;
+    size_t j = pt[1] / mLutStep;
+    if (i >= mLutWidth || j >= mLutHeight) return false;
+    // Points on the last row or column interpolate within the preceding cell
+    i = std::min(i, mLutWidth - 2);
+    j = std::min(j, mLutHeight - 2);
+    float u = static_cast<float>(pt[0] - static_cast<int32_t>(i) * mLutStep) / mLutStep;
+    float v = static_cast<float>(pt[1] - static_cast<int32_t>(j) * mLutStep) / mLutStep;
+
+    const float *p00 = &mLut[(j * mLutWidth + i) * 2];
+    const float *p10 = p00 + 2;
+    const float *p01 = p00 + mLutWidth * 2;
+    const float *p11 = p01 + 2;
+    for (size_t k = 0; k < 2; k++) {
+        float top = p00[k] + u * (p10[k] - p00[k]);
+        float bottom = p01[k] + u * (p11[k] - p01[k]);
+        (k == 0 ? *corrX : *corrY) = top + v * (bottom - top);
+    }
+    return true;
+}
+
 const DistortionMapper::GridQuad* DistortionMapper::findEnclosingQuad(
         const int32_t pt[2], const std::vector<GridQuad>& grid) {
     const float x = pt[0];
     const float y = pt[1];
 
     for (const GridQuad& quad : grid) {
-        const float &x1 = quad.coords[0];
-        const float &y1 = quad.coords[1];
-        const float &x2 = quad.coords[2];
-        const float &y2 = quad.coords[3];
-        const float &x3 = quad.coords[4];
-        const float &y3 = quad.coords[5];
-        const float &x4 = quad.coords[6];
-        const float &y4 = quad.coords[7];
-
-        // Point-in-quad test:
-
-        // Quad has corners P1-P4; if P is within the quad, then it is on the same side of all the
-        // edges (or on top of one of the edges or corners), traversed in a consistent direction.
-        // This means that the cross product of edge En = Pn->P(n+1 mod 4) and line Ep = Pn->P must
-        // have the same sign (or be zero) for all edges.
-        // For clockwise traversal, the sign should be negative or zero for Ep x En, indicating that
-        // En is to the left of Ep, or overlapping.
-        float s1 = (x - x1) * (y2 - y1) - (y - y1) * (x2 - x1);
-        if (s1 > 0) continue;
-        float s2 = (x - x2) * (y3 - y2) - (y - y2) * (x3 - x2);
-        if (s2 > 0) continue;
-        float s3 = (x - x3) * (y4 - y3) - (y - y3) * (x4 - x3);
-        if (s3 > 0) continue;
-        float s4 = (x - x4) * (y1 - y4) - (y - y4) * (x1 - x4);
-        if (s4 > 0) continue;
-
-        return &quad;
+        if (isPointInQuad(x, y, quad)) return &quad;
     }
     return nullptr;
 }
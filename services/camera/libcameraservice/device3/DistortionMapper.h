@@ -43,7 +43,14 @@ class DistortionMapper : private CoordinateMapper {
             mArrayWidth(other.mArrayWidth), mArrayHeight(other.mArrayHeight),
             mActiveWidth(other.mActiveWidth), mActiveHeight(other.mActiveHeight),
             mArrayDiffX(other.mArrayDiffX), mArrayDiffY(other.mArrayDiffY),
-            mCorrectedGrid(other.mCorrectedGrid), mDistortedGrid(other.mDistortedGrid) {}
+            mCorrectedGrid(other.mCorrectedGrid), mDistortedGrid(other.mDistortedGrid),
+            mBucketMinX(other.mBucketMinX), mBucketMinY(other.mBucketMinY),
+            mBucketMaxX(other.mBucketMaxX), mBucketMaxY(other.mBucketMaxY),
+            mInvBucketWidth(other.mInvBucketWidth), mInvBucketHeight(other.mInvBucketHeight),
+            mBucketStart(other.mBucketStart), mBucketQuads(other.mBucketQuads),
+            mUseLut(other.mUseLut), mValidLut(other.mValidLut), mLutStep(other.mLutStep),
+            mLutWidth(other.mLutWidth), mLutHeight(other.mLutHeight),
+            mLutMaxError(other.mLutMaxError), mLut(other.mLut) {}
 
     /**
      * Check whether distortion correction is supported by the camera HAL
@@ -150,6 +157,21 @@ class DistortionMapper : private CoordinateMapper {
     // if it is false, then an interpolation coordinate for edges E14 and E23 is found.
     static float calculateUorV(const int32_t pt[2], const GridQuad& quad, bool calculateU);
 
+    /**
+     * Enable or disable the lookup table mode for raw to corrected mapping with complex
+     * correction. In this mode the mapping is interpolated from a table of precomputed
+     * corrected coordinates over the pre-correction active array, with the table resolution
+     * chosen so that the interpolation error stays below kMaxLutError pixels. Coordinates
+     * outside of the table fall back to the exact mapping.
+     */
+    void setLutMode(bool enabled);
+
+    /**
+     * Maximum interpolation error of the current lookup table, in pixels, or a negative
+     * value if no lookup table is in use.
+     */
+    float getLutMaxError() const;
+
   private:
     mutable std::mutex mMutex;
 
@@ -159,6 +181,13 @@ class DistortionMapper : private CoordinateMapper {
     constexpr static float kGridMargin = 0.05f;
     // Fuzziness for float inequality tests
     constexpr static float kFloatFuzz = 1e-4;
+    // Number of buckets in each dimension of the distorted grid spatial index
+    constexpr static size_t kBucketCount = 2 * kGridSize;
+    // Initial and maximum number of cells in each dimension of the raw to corrected table
+    constexpr static size_t kLutInitialCells = 64;
+    constexpr static size_t kLutMaxCells = 512;
+    // Maximum allowed interpolation error of the raw to corrected table, in pixels
+    constexpr static float kMaxLutError = 0.25f;
 
     // Single implementation for various mapCorrectedToRaw methods
     template<typename T>
@@ -173,6 +202,28 @@ class DistortionMapper : private CoordinateMapper {
     // Utility to create reverse mapping grids
     status_t buildGrids();
 
+    // Index the distorted grid quads by uniform buckets over their bounding box
+    void buildBuckets();
+
+    // Find the index of the distorted grid quad enclosing the point using the bucket index;
+    // returns -1 if none do
+    ssize_t findEnclosingDistortedQuad(const int32_t pt[2]) const;
+
+    // Map a single raw coordinate to unclamped corrected coordinates through the grids
+    status_t mapRawToCorrectedExact(const int32_t pt[2], float *corrX, float *corrY) const;
+
+    // Rebuild the raw to corrected lookup table, and the grids it is built from, if the lookup
+    // table mode is enabled; called when the calibration or the mode changes
+    status_t updateLut();
+
+    // Build the raw to corrected lookup table; the grids must be valid
+    status_t buildLut();
+    status_t buildLut(size_t cells, float *maxError);
+
+    // Interpolate the corrected coordinates from the lookup table; returns false if the
+    // point is outside of the table
+    bool lookupRawToCorrected(const int32_t pt[2], float *corrX, float *corrY) const;
+
 
     bool mValidMapping;
     bool mValidGrids;
@@ -194,6 +245,22 @@ class DistortionMapper : private CoordinateMapper {
     std::vector<GridQuad> mCorrectedGrid;
     std::vector<GridQuad> mDistortedGrid;
 
+    // Bounding box of the distorted grid, and inverse bucket dimensions
+    float mBucketMinX, mBucketMinY, mBucketMaxX, mBucketMaxY;
+    float mInvBucketWidth, mInvBucketHeight;
+    // Distorted quad indices of bucket b are mBucketQuads[mBucketStart[b]..mBucketStart[b+1])
+    std::vector<uint32_t> mBucketStart;
+    std::vector<uint32_t> mBucketQuads;
+
+    // Raw to corrected lookup table; (x,y) pairs for mLutWidth x mLutHeight nodes spaced
+    // mLutStep pixels apart, starting at raw (0,0)
+    bool mUseLut;
+    bool mValidLut;
+    int32_t mLutStep;
+    size_t mLutWidth, mLutHeight;
+    float mLutMaxError;
+    std::vector<float> mLut;
+
 }; // class DistortionMapper
 
 } // namespace camera3
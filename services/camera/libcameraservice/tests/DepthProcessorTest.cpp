@@ -17,10 +17,13 @@
 #define LOG_NDEBUG 0
 #define LOG_TAG "DepthProcessorTest"
 
+#include <algorithm>
 #include <array>
 #include <random>
 
 #include <gtest/gtest.h>
+#include <android-base/stringprintf.h>
+#include <android-base/chrono_utils.h>
 
 #include "../common/DepthPhotoProcessor.h"
 #include "../utils/ExifUtils.h"
@@ -317,3 +320,150 @@ TEST(DepthProcessorTest, TestDephtPhotoPhysicalRotation) {
         ASSERT_EQ(confidenceMapHeight, expectedHeight);
     }
 }
+
+// Straightforward per-sample reference of the depth map unpacking and quantization.
+static void unpackDepthMapReference(const DepthPhotoInputFrame& inputFrame,
+        std::vector<uint8_t> *depth /*out*/, std::vector<uint8_t> *confidence /*out*/) {
+    size_t width = inputFrame.mDepthMapWidth;
+    size_t height = inputFrame.mDepthMapHeight;
+    bool transpose = (inputFrame.mOrientation == DEPTH_ORIENTATION_90_DEGREES) ||
+            (inputFrame.mOrientation == DEPTH_ORIENTATION_270_DEGREES);
+    size_t outWidth = transpose ? height : width;
+    size_t outHeight = transpose ? width : height;
+
+    std::vector<float> points, confidences;
+    float near = UINT16_MAX, far = .0f;
+    for (size_t i = 0; i < outHeight; i++) {
+        for (size_t j = 0; j < outWidth; j++) {
+            size_t x, y;
+            switch (inputFrame.mOrientation) {
+                case DEPTH_ORIENTATION_90_DEGREES:
+                    x = i; y = height - 1 - j;
+                    break;
+                case DEPTH_ORIENTATION_180_DEGREES:
+                    x = width - 1 - j; y = height - 1 - i;
+                    break;
+                case DEPTH_ORIENTATION_270_DEGREES:
+                    x = width - 1 - i; y = j;
+                    break;
+                default:
+                    x = j; y = i;
+            }
+            uint16_t value = inputFrame.mDepthMapBuffer[y * inputFrame.mDepthMapStride + x];
+            float point = static_cast<float>(value & 0x1FFF) / 1000.f;
+            auto conf = (value >> 13) & 0x7;
+            float normConfidence = (conf == 0) ? 1.f : (static_cast<float>(conf) - 1) / 7.f;
+            points.push_back(point);
+            confidences.push_back(normConfidence);
+            if (normConfidence >= .15f) {
+                near = std::min(near, point);
+                far = std::max(far, point);
+            }
+        }
+    }
+
+    depth->clear();
+    confidence->clear();
+    for (size_t i = 0; i < points.size(); i++) {
+        float point = points[i];
+        if (confidences[i] < .15f) {
+            point = std::clamp(point, near, far);
+        }
+        depth->push_back(floorf(((far * (point - near)) / (point * (far - near))) * 255.0f));
+        confidence->push_back(floorf(confidences[i] * 255.0f));
+    }
+}
+
+static void generateDepth16BufferWithRange(uint16_t minRange, uint16_t maxRange,
+        std::vector<uint16_t> *depth16Buffer /*out*/) {
+    std::default_random_engine gen(kSeed+2);
+    std::uniform_int_distribution<int> rangeDist(minRange, maxRange);
+    std::uniform_int_distribution<int> confidenceDist(0, 7);
+    for (size_t i = 0; i < depth16Buffer->size(); i++) {
+        (*depth16Buffer)[i] = rangeDist(gen) | (confidenceDist(gen) << 13);
+    }
+}
+
+TEST(DepthProcessorTest, UnpackDepthMapMatchesReference) {
+    DepthPhotoOrientation depthOrientations[] = {
+            DepthPhotoOrientation::DEPTH_ORIENTATION_0_DEGREES,
+            DepthPhotoOrientation::DEPTH_ORIENTATION_90_DEGREES,
+            DepthPhotoOrientation::DEPTH_ORIENTATION_180_DEGREES,
+            DepthPhotoOrientation::DEPTH_ORIENTATION_270_DEGREES };
+    // Odd dimensions and a padded stride exercise the row and column walk.
+    const size_t width = 161, height = 97, stride = 176;
+    std::vector<uint16_t> depth16Buffer(stride * height);
+    generateDepth16BufferWithRange(/*minRange*/ 100, /*maxRange*/ 0x1FFF, &depth16Buffer);
+
+    for (auto depthOrientation : depthOrientations) {
+        DepthPhotoInputFrame inputFrame;
+        inputFrame.mDepthMapBuffer = depth16Buffer.data();
+        inputFrame.mDepthMapWidth = width;
+        inputFrame.mDepthMapHeight = height;
+        inputFrame.mDepthMapStride = stride;
+        inputFrame.mOrientation = depthOrientation;
+
+        std::vector<uint8_t> expectedDepth, expectedConfidence;
+        unpackDepthMapReference(inputFrame, &expectedDepth, &expectedConfidence);
+
+        std::vector<uint8_t> depth(width * height), confidence(width * height);
+        float near, far;
+        bool switchDimensions;
+        ASSERT_EQ(unpackDepthMap(inputFrame, /*applyOrientation*/ true, depth.data(),
+                confidence.data(), &near, &far, &switchDimensions), OK);
+        ASSERT_EQ(switchDimensions,
+                (depthOrientation == DepthPhotoOrientation::DEPTH_ORIENTATION_90_DEGREES) ||
+                (depthOrientation == DepthPhotoOrientation::DEPTH_ORIENTATION_270_DEGREES));
+        ASSERT_EQ(depth, expectedDepth) << "orientation " << depthOrientation;
+        ASSERT_EQ(confidence, expectedConfidence) << "orientation " << depthOrientation;
+    }
+}
+
+TEST(DepthProcessorTest, UnpackDepthMapPerformance) {
+    DepthPhotoOrientation depthOrientations[] = {
+            DepthPhotoOrientation::DEPTH_ORIENTATION_0_DEGREES,
+            DepthPhotoOrientation::DEPTH_ORIENTATION_90_DEGREES,
+            DepthPhotoOrientation::DEPTH_ORIENTATION_180_DEGREES,
+            DepthPhotoOrientation::DEPTH_ORIENTATION_270_DEGREES };
+    const size_t iterations = 100;
+    std::vector<uint16_t> depth16Buffer(kTestBufferDepthSize);
+    generateDepth16BufferWithRange(/*minRange*/ 100, /*maxRange*/ 0x1FFF, &depth16Buffer);
+
+    using DurationUs = std::chrono::duration<double, std::micro>;
+    for (auto depthOrientation : depthOrientations) {
+        DepthPhotoInputFrame inputFrame;
+        inputFrame.mDepthMapBuffer = depth16Buffer.data();
+        inputFrame.mDepthMapWidth = inputFrame.mDepthMapStride = kTestBufferWidth;
+        inputFrame.mDepthMapHeight = kTestBufferHeight;
+        inputFrame.mOrientation = depthOrientation;
+
+        std::vector<uint8_t> depth(kTestBufferDepthSize), confidence(kTestBufferDepthSize);
+        float near, far;
+        bool switchDimensions;
+        base::Timer unpackTimer;
+        for (size_t i = 0; i < iterations; i++) {
+            ASSERT_EQ(unpackDepthMap(inputFrame, /*applyOrientation*/ true, depth.data(),
+                    confidence.data(), &near, &far, &switchDimensions), OK);
+        }
+        auto unpackDuration = unpackTimer.duration();
+
+        std::vector<uint8_t> expectedDepth, expectedConfidence;
+        base::Timer referenceTimer;
+        for (size_t i = 0; i < iterations; i++) {
+            unpackDepthMapReference(inputFrame, &expectedDepth, &expectedConfidence);
+        }
+        auto referenceDuration = referenceTimer.duration();
+
+        ASSERT_EQ(depth, expectedDepth) << "orientation " << depthOrientation;
+        ASSERT_EQ(confidence, expectedConfidence) << "orientation " << depthOrientation;
+
+        RecordProperty(base::StringPrintf("UnpackDurationUs[%d]", depthOrientation),
+                base::StringPrintf("%f",
+                        (std::chrono::duration_cast<DurationUs>(unpackDuration) /
+                            iterations).count()));
+        RecordProperty(base::StringPrintf("ReferenceUnpackDurationUs[%d]", depthOrientation),
+                base::StringPrintf("%f",
+                        (std::chrono::duration_cast<DurationUs>(referenceDuration) /
+                            iterations).count()));
+    }
+}
@@ -374,3 +374,74 @@ TEST(DistortionMapperTest, CompareToOpenCV) {
                 << expCoords[i] << ", " << expCoords[i + 1] << ")";
     }
 }
+
+// Compare the lookup table mode of raw to corrected mapping against the exact mapping, and
+// record the time per coordinate of both.
+TEST(DistortionMapperTest, LutTransform) {
+    status_t res;
+
+    float bigDistortion[] = {0.1, -0.003, 0.004, 0.02, 0.01};
+
+    DistortionMapper exactMapper;
+    setupTestMapper(&exactMapper, bigDistortion, testICal,
+            /*activeArray*/testActiveArray,
+            /*preCorrectionActiveArray*/testPreCorrActiveArray);
+    exactMapper.setLutMode(false);
+
+    DistortionMapper lutMapper;
+    setupTestMapper(&lutMapper, bigDistortion, testICal,
+            /*activeArray*/testActiveArray,
+            /*preCorrectionActiveArray*/testPreCorrActiveArray);
+    lutMapper.setLutMode(true);
+
+    // The table is built as soon as the mode is enabled
+    float lutMaxError = lutMapper.getLutMaxError();
+    ASSERT_GE(lutMaxError, 0.f);
+    ASSERT_LE(lutMaxError, 0.25f);
+    ASSERT_LT(exactMapper.getLutMaxError(), 0.f);
+
+    unsigned int seed = 1234; // Ensure repeatability for debugging
+    const size_t coordCount = 1e5; // Number of random test points
+
+    std::default_random_engine gen(seed);
+    std::uniform_int_distribution<int> x_dist(0, testPreCorrActiveArray[2] - 1);
+    std::uniform_int_distribution<int> y_dist(0, testPreCorrActiveArray[3] - 1);
+
+    std::vector<int32_t> exactCoords(coordCount * 2);
+    for (size_t i = 0; i < exactCoords.size(); i += 2) {
+        exactCoords[i] = x_dist(gen);
+        exactCoords[i + 1] = y_dist(gen);
+    }
+    exactCoords.insert(exactCoords.end(), basicCoords.begin(), basicCoords.end());
+    auto lutCoords = exactCoords;
+
+    // Build the grids of the exact mapper outside of the timed section
+    int32_t warmup[2] = {0, 0};
+    ASSERT_EQ(exactMapper.mapRawToCorrected(warmup, 1, /*clamp*/false, /*simple*/false), OK);
+
+    base::Timer exactTimer;
+    res = exactMapper.mapRawToCorrected(exactCoords.data(), exactCoords.size() / 2,
+            /*clamp*/false, /*simple*/false);
+    auto exactDuration = exactTimer.duration();
+    ASSERT_EQ(res, OK);
+
+    base::Timer lutTimer;
+    res = lutMapper.mapRawToCorrected(lutCoords.data(), lutCoords.size() / 2,
+            /*clamp*/false, /*simple*/false);
+    auto lutDuration = lutTimer.duration();
+    ASSERT_EQ(res, OK);
+
+    // The table error bound is below half a pixel, so rounding can differ by at most one
+    for (size_t i = 0; i < exactCoords.size(); i++) {
+        EXPECT_LE(std::abs(exactCoords[i] - lutCoords[i]), 1) << "coordinate " << i;
+    }
+
+    using DurationUs = std::chrono::duration<double, std::micro>;
+    RecordProperty("LutMaxError", base::StringPrintf("%f", lutMaxError));
+    RecordProperty("ExactRawToCorrectedDurationPerCoordUs", base::StringPrintf("%f",
+            (std::chrono::duration_cast<DurationUs>(exactDuration) /
+                (exactCoords.size() / 2)).count()));
+    RecordProperty("LutRawToCorrectedDurationPerCoordUs", base::StringPrintf("%f",
+            (std::chrono::duration_cast<DurationUs>(lutDuration) /
+                (lutCoords.size() / 2)).count()));
+}
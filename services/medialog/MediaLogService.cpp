@@ -32,8 +32,8 @@ static const char kDeadlockedString[] = "MediaLogService may be deadlocked\n";
 // mMerger, mMergeReader, and mMergeThread all point to the same location in memory
 // mMergerShared. This is the local memory FIFO containing data merged from all
 // individual thread FIFOs in shared memory. mMergeThread is used to periodically
-// call NBLog::Merger::merge() to collect the data and write it to the FIFO, and call
-// NBLog::MergeReader::getAndProcessSnapshot to process the merged data.
+// call NBLog::Merger::merge() to collect the data and write it to the FIFO, which passes
+// the merged data to NBLog::MergeReader to be processed.
 MediaLogService::MediaLogService() :
     BnMediaLogService(),
     mMergerShared((NBLog::Shared*) malloc(NBLog::Timeline::sharedSize(kMergeBufferSize))),
@@ -71,11 +71,11 @@ void MediaLogService::unregisterWriter(const sp<IMemory>& shared)
     if (!isAudioServerOrMediaServerUid(IPCThreadState::self()->getCallingUid()) || shared == 0) {
         return;
     }
+    mMerger.removeReader(shared);
     Mutex::Autolock _l(mLock);
     for (size_t i = 0; i < mDumpReaders.size(); ) {
         if (mDumpReaders[i]->isIMemory(shared)) {
             mDumpReaders.removeAt(i);
-            // TODO mMerger.removeReaders(shared)
         } else {
             i++;
         }
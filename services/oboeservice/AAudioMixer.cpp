@@ -20,7 +20,9 @@
 
 #define ATRACE_TAG ATRACE_TAG_AUDIO
 
+#include <algorithm>
 #include <cstring>
+#include <optional>
 #include <utils/Trace.h>
 
 #include "AAudioMixer.h"
@@ -30,6 +32,7 @@
 #endif
 
 using android::WrappingBuffer;
+using android::FifoBatchReader;
 using android::FifoBuffer;
 using android::fifo_frames_t;
 
@@ -50,24 +53,39 @@ void AAudioMixer::clear() {
 }
 
 int32_t AAudioMixer::mix(int streamIndex, FifoBuffer *fifo, bool allowUnderflow) {
-    WrappingBuffer wrappingBuffer;
-    float *destination = mOutputBuffer;
+    StreamInput stream;
+    stream.streamIndex = streamIndex;
+    stream.fifo = fifo;
+    stream.allowUnderflow = allowUnderflow;
+    mix(&stream, 1);
+    return stream.framesRead;
+}
 
+void AAudioMixer::mix(StreamInput *streams, int32_t numStreams) {
 #if AAUDIO_MIXER_ATRACE_ENABLED
     ATRACE_BEGIN("aaMix");
 #endif /* AAUDIO_MIXER_ATRACE_ENABLED */
 
+    for (int32_t first = 0; first < numStreams; first += kMaxStreamsPerPass) {
+        mixGroup(&streams[first], std::min(kMaxStreamsPerPass, numStreams - first));
+    }
+
+#if AAUDIO_MIXER_ATRACE_ENABLED
+    ATRACE_END();
+#endif /* AAUDIO_MIXER_ATRACE_ENABLED */
+}
+
+int32_t AAudioMixer::prepareStream(StreamInput *stream, FifoBatchReader *reader,
+                                   WrappingBuffer *parts) {
     // Gather the data from the client. May be in two parts.
-    fifo_frames_t fullFrames = fifo->getFullDataAvailable(&wrappingBuffer);
+    fifo_frames_t fullFrames = reader->getFullDataAvailable(parts);
 #if AAUDIO_MIXER_ATRACE_ENABLED
     if (ATRACE_ENABLED()) {
         char rdyText[] = "aaMixRdy#";
-        char letter = 'A' + (streamIndex % 26);
+        char letter = 'A' + (stream->streamIndex % 26);
         rdyText[sizeof(rdyText) - 2] = letter;
         ATRACE_INT(rdyText, fullFrames);
     }
-#else /* MIXER_ATRACE_ENABLED */
-    (void) trackIndex;
 #endif /* AAUDIO_MIXER_ATRACE_ENABLED */
 
     // If allowUnderflow then always advance by one burst even if we do not have the data.
@@ -77,42 +95,137 @@ int32_t AAudioMixer::mix(int streamIndex, FifoBuffer *fifo, bool allowUnderflow)
     // Generally, allowUnderflow will be false when stopping a stream and we want to
     // use up whatever data is in the queue.
     fifo_frames_t framesDesired = mFramesPerBurst;
-    if (!allowUnderflow && fullFrames < framesDesired) {
+    if (!stream->allowUnderflow && fullFrames < framesDesired) {
         framesDesired = fullFrames; // just use what is available then stop
     }
 
-    // Mix data in one or two parts.
-    int partIndex = 0;
+    // Only mix the frames that are actually in the FIFO.
     int32_t framesLeft = framesDesired;
-    while (framesLeft > 0 && partIndex < WrappingBuffer::SIZE) {
-        fifo_frames_t framesToMixFromPart = framesLeft;
-        fifo_frames_t framesAvailableFromPart = wrappingBuffer.numFrames[partIndex];
-        if (framesAvailableFromPart > 0) {
-            if (framesToMixFromPart > framesAvailableFromPart) {
-                framesToMixFromPart = framesAvailableFromPart;
-            }
-            mixPart(destination, (float *)wrappingBuffer.data[partIndex],
-                    framesToMixFromPart);
+    for (int partIndex = 0; partIndex < WrappingBuffer::SIZE; partIndex++) {
+        parts->numFrames[partIndex] = std::max(0,
+                std::min(framesLeft, (int32_t) parts->numFrames[partIndex]));
+        framesLeft -= parts->numFrames[partIndex];
+    }
+    stream->framesRead = framesDesired - framesLeft;
+    return framesDesired;
+}
+
+namespace {
+
+// Add the sources into the destination, each with a constant gain.
+// The destination is loaded and stored once per sample and the sources are
+// added in stream order, so the result matches mixing the streams one at a time.
+template <int N>
+void accumulate(float *destination, const float * const *sources, const float *gains,
+                int32_t numSamples) {
+    float * __restrict dst = destination;
+    const float * __restrict s0 = sources[0];
+    const float * __restrict s1 = (N > 1) ? sources[1] : nullptr;
+    const float * __restrict s2 = (N > 2) ? sources[2] : nullptr;
+    const float * __restrict s3 = (N > 3) ? sources[3] : nullptr;
+    const float g0 = gains[0];
+    const float g1 = (N > 1) ? gains[1] : 0.0f;
+    const float g2 = (N > 2) ? gains[2] : 0.0f;
+    const float g3 = (N > 3) ? gains[3] : 0.0f;
+    for (int32_t i = 0; i < numSamples; i++) {
+        float sum = dst[i] + s0[i] * g0;
+        if (N > 1) sum += s1[i] * g1;
+        if (N > 2) sum += s2[i] * g2;
+        if (N > 3) sum += s3[i] * g3;
+        dst[i] = sum;
+    }
+}
 
-            destination += framesToMixFromPart * mSamplesPerFrame;
-            framesLeft -= framesToMixFromPart;
+// Same as accumulate() but the gains change by a fixed increment every frame.
+// This only happens for one burst after a gain change.
+void accumulateRamp(float *destination, const float * const *sources, const float *gains,
+                    const float *increments, int32_t numSources,
+                    int32_t numFrames, int32_t samplesPerFrame) {
+    for (int32_t frame = 0; frame < numFrames; frame++) {
+        for (int32_t channel = 0; channel < samplesPerFrame; channel++) {
+            const int32_t i = frame * samplesPerFrame + channel;
+            float sum = destination[i];
+            for (int32_t source = 0; source < numSources; source++) {
+                sum += sources[source][i] * (gains[source] + increments[source] * frame);
+            }
+            destination[i] = sum;
         }
-        partIndex++;
     }
-    fifo->advanceReadIndex(framesDesired);
+}
 
-#if AAUDIO_MIXER_ATRACE_ENABLED
-    ATRACE_END();
-#endif /* AAUDIO_MIXER_ATRACE_ENABLED */
+} // namespace
+
+void AAudioMixer::mixGroup(StreamInput *streams, int32_t numStreams) {
+    // Each FIFO is read in a batch, so that its counters are only loaded once
+    // and the read counter is only stored once per burst.
+    std::optional<FifoBatchReader> readers[kMaxStreamsPerPass];
+    WrappingBuffer parts[kMaxStreamsPerPass];
+    int32_t framesDesired[kMaxStreamsPerPass];
+    int32_t lastFrame = 0;
+    for (int32_t i = 0; i < numStreams; i++) {
+        readers[i].emplace(*streams[i].fifo);
+        framesDesired[i] = prepareStream(&streams[i], &*readers[i], &parts[i]);
+        lastFrame = std::max(lastFrame, streams[i].framesRead);
+    }
 
-    return (framesDesired - framesLeft); // framesRead
-}
+    // Walk through the burst in spans where every stream is contiguous,
+    // so each span can be mixed in one pass over the output.
+    int32_t frame = 0;
+    while (frame < lastFrame) {
+        const float *sources[kMaxStreamsPerPass];
+        float gains[kMaxStreamsPerPass];
+        float increments[kMaxStreamsPerPass];
+        int32_t numSources = 0;
+        bool ramping = false;
+        int32_t spanFrames = lastFrame - frame;
+        for (int32_t i = 0; i < numStreams; i++) {
+            const StreamInput &stream = streams[i];
+            if (frame >= stream.framesRead) {
+                continue; // no more data from this stream
+            }
+            const int32_t firstPartFrames = parts[i].numFrames[0];
+            const float *source;
+            int32_t framesAvailable;
+            if (frame < firstPartFrames) {
+                source = (const float *) parts[i].data[0] + frame * mSamplesPerFrame;
+                framesAvailable = firstPartFrames - frame;
+            } else {
+                source = (const float *) parts[i].data[1]
+                        + (frame - firstPartFrames) * mSamplesPerFrame;
+                framesAvailable = stream.framesRead - frame;
+            }
+            spanFrames = std::min(spanFrames, framesAvailable);
+            const float increment = (stream.gainTo - stream.gainFrom) / mFramesPerBurst;
+            sources[numSources] = source;
+            gains[numSources] = (increment == 0.0f)
+                    ? stream.gainTo
+                    : stream.gainFrom + increment * frame;
+            increments[numSources] = increment;
+            ramping |= (increment != 0.0f);
+            numSources++;
+        }
+
+        float *destination = mOutputBuffer + frame * mSamplesPerFrame;
+        const int32_t numSamples = spanFrames * mSamplesPerFrame;
+        if (ramping) {
+            accumulateRamp(destination, sources, gains, increments, numSources,
+                           spanFrames, mSamplesPerFrame);
+        } else {
+            switch (numSources) {
+                case 1: accumulate<1>(destination, sources, gains, numSamples); break;
+                case 2: accumulate<2>(destination, sources, gains, numSamples); break;
+                case 3: accumulate<3>(destination, sources, gains, numSamples); break;
+                case 4: accumulate<4>(destination, sources, gains, numSamples); break;
+                default: break;
+            }
+        }
+        frame += spanFrames;
+    }
 
-void AAudioMixer::mixPart(float *destination, float *source, int32_t numFrames) {
-    int32_t numSamples = numFrames * mSamplesPerFrame;
-    // TODO maybe optimize using SIMD
-    for (int sampleIndex = 0; sampleIndex < numSamples; sampleIndex++) {
-        *destination++ += *source++;
+    // Only release the data after it has been read.
+    for (int32_t i = 0; i < numStreams; i++) {
+        readers[i]->advanceReadIndex(framesDesired[i]);
+        readers[i]->commit();
     }
 }
 
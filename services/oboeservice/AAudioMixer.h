@@ -24,6 +24,23 @@
 
 class AAudioMixer {
 public:
+    /**
+     * Number of streams that are accumulated together in one pass over the output.
+     */
+    static constexpr int32_t kMaxStreamsPerPass = 4;
+
+    /**
+     * Describes one stream for mix().
+     */
+    struct StreamInput {
+        int                  streamIndex = 0;       // for marking stream variables in systrace
+        android::FifoBuffer *fifo = nullptr;        // to read from
+        bool                 allowUnderflow = true; // advance read index past the write index
+        float                gainFrom = 1.0f;       // gain at the start of the burst
+        float                gainTo = 1.0f;         // gain at the end of the burst
+        int32_t              framesRead = 0;        // set by mix()
+    };
+
     AAudioMixer() {}
     ~AAudioMixer();
 
@@ -40,12 +57,29 @@ public:
      */
     int32_t mix(int streamIndex, android::FifoBuffer *fifo, bool allowUnderflow);
 
+    /**
+     * Mix from several FIFOs, applying a gain to each one.
+     * The gain ramps linearly across the burst when gainFrom and gainTo differ.
+     * Up to kMaxStreamsPerPass streams are added to the output in a single pass.
+     *
+     * @param streams framesRead is set for each stream
+     * @param numStreams number of streams in the array
+     */
+    void mix(StreamInput *streams, int32_t numStreams);
+
     float *getOutputBuffer();
 
     int32_t getFramesPerBurst() const { return mFramesPerBurst; }
 
 private:
-    void mixPart(float *destination, float *source, int32_t numFrames);
+    /**
+     * Return up to two parts of the FIFO in parts, limited to one burst, and return
+     * the number of frames that the read index will be advanced by.
+     */
+    int32_t prepareStream(StreamInput *stream, android::FifoBatchReader *reader,
+                          android::WrappingBuffer *parts);
+
+    void mixGroup(StreamInput *streams, int32_t numStreams);
 
     float   *mOutputBuffer = nullptr;
     int32_t  mSamplesPerFrame = 0;
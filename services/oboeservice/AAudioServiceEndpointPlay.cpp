@@ -80,7 +80,6 @@ void *AAudioServiceEndpointPlay::callbackLoop() {
 
             std::lock_guard <std::mutex> lock(mLockStreams);
             for (const auto& clientStream : mRegisteredStreams) {
-                int64_t clientFramesRead = 0;
                 bool allowUnderflow = true;
 
                 if (clientStream->isSuspended()) {
@@ -97,48 +96,33 @@ void *AAudioServiceEndpointPlay::callbackLoop() {
                 sp<AAudioServiceStreamShared> streamShared =
                         static_cast<AAudioServiceStreamShared *>(clientStream.get());
 
-                {
-                    // Lock the AudioFifo to protect against close.
-                    std::lock_guard <std::mutex> lock(streamShared->getAudioDataQueueLock());
-
-                    FifoBuffer *fifo = streamShared->getAudioDataFifoBuffer_l();
-                    if (fifo != nullptr) {
-
-                        // Determine offset between framePosition in client's stream
-                        // vs the underlying MMAP stream.
-                        clientFramesRead = fifo->getReadCounter();
-                        // These two indices refer to the same frame.
-                        int64_t positionOffset = mmapFramesWritten - clientFramesRead;
-                        streamShared->setTimestampPositionOffset(positionOffset);
-
-                        int32_t framesMixed = mMixer.mix(index, fifo, allowUnderflow);
-
-                        if (streamShared->isFlowing()) {
-                            // Consider it an underflow if we got less than a burst
-                            // after the data started flowing.
-                            bool underflowed = allowUnderflow
-                                               && framesMixed < mMixer.getFramesPerBurst();
-                            if (underflowed) {
-                                streamShared->incrementXRunCount();
-                            }
-                        } else if (framesMixed > 0) {
-                            // Mark beginning of data flow after a start.
-                            streamShared->setFlowing(true);
-                        }
-                        clientFramesRead = fifo->getReadCounter();
+                // Lock the AudioFifo to protect against close.
+                // The lock is held until the group containing this stream has been mixed.
+                std::unique_lock <std::mutex> queueLock(streamShared->getAudioDataQueueLock());
+                FifoBuffer *fifo = streamShared->getAudioDataFifoBuffer_l();
+                if (fifo != nullptr) {
+                    // Determine offset between framePosition in client's stream
+                    // vs the underlying MMAP stream.
+                    int64_t clientFramesRead = fifo->getReadCounter();
+                    // These two indices refer to the same frame.
+                    int64_t positionOffset = mmapFramesWritten - clientFramesRead;
+                    streamShared->setTimestampPositionOffset(positionOffset);
+
+                    AAudioMixer::StreamInput &input = mMixerInputs[mNumMixerInputs];
+                    input.streamIndex = index;
+                    input.fifo = fifo;
+                    input.allowUnderflow = allowUnderflow;
+                    mMixerStreams[mNumMixerInputs] = streamShared;
+                    mMixerLocks[mNumMixerInputs] = std::move(queueLock);
+                    mNumMixerInputs++;
+                    if (mNumMixerInputs == AAudioMixer::kMaxStreamsPerPass) {
+                        mixStreamGroup();
                     }
                 }
 
-                if (clientFramesRead > 0) {
-                    // This timestamp represents the completion of data being read out of the
-                    // client buffer. It is sent to the client and used in the timing model
-                    // to decide when the client has room to write more data.
-                    Timestamp timestamp(clientFramesRead, AudioClock::getNanoseconds());
-                    streamShared->markTransferTime(timestamp);
-                }
-
                 index++; // just used for labelling tracks in systrace
             }
+            mixStreamGroup();
         }
 
         // Write mixer output to stream using a blocking write.
@@ -158,3 +142,41 @@ void *AAudioServiceEndpointPlay::callbackLoop() {
           __func__, mCallbackEnabled.load(), getStreamInternal()->getState(), result);
     return NULL; // TODO review
 }
+
+// Mix the pending group of streams, then update each stream and release its FIFO.
+void AAudioServiceEndpointPlay::mixStreamGroup() {
+    if (mNumMixerInputs == 0) {
+        return;
+    }
+    mMixer.mix(mMixerInputs, mNumMixerInputs);
+
+    for (int32_t i = 0; i < mNumMixerInputs; i++) {
+        const AAudioMixer::StreamInput &input = mMixerInputs[i];
+        sp<AAudioServiceStreamShared> streamShared = std::move(mMixerStreams[i]);
+        int32_t framesMixed = input.framesRead;
+
+        if (streamShared->isFlowing()) {
+            // Consider it an underflow if we got less than a burst
+            // after the data started flowing.
+            bool underflowed = input.allowUnderflow
+                               && framesMixed < mMixer.getFramesPerBurst();
+            if (underflowed) {
+                streamShared->incrementXRunCount();
+            }
+        } else if (framesMixed > 0) {
+            // Mark beginning of data flow after a start.
+            streamShared->setFlowing(true);
+        }
+        int64_t clientFramesRead = input.fifo->getReadCounter();
+        mMixerLocks[i].unlock();
+
+        if (clientFramesRead > 0) {
+            // This timestamp represents the completion of data being read out of the
+            // client buffer. It is sent to the client and used in the timing model
+            // to decide when the client has room to write more data.
+            Timestamp timestamp(clientFramesRead, AudioClock::getNanoseconds());
+            streamShared->markTransferTime(timestamp);
+        }
+    }
+    mNumMixerInputs = 0;
+}
@@ -45,9 +45,17 @@ public:
     void *callbackLoop() override;
 
 private:
+    void mixStreamGroup();
+
     AudioStreamInternalPlay  mStreamInternalPlay; // for playing output of mixer
     bool                     mLatencyTuningEnabled = false; // TODO implement tuning
     AAudioMixer              mMixer;    //
+
+    // Streams waiting to be mixed together, only used by the callbackLoop() thread.
+    AAudioMixer::StreamInput mMixerInputs[AAudioMixer::kMaxStreamsPerPass];
+    android::sp<AAudioServiceStreamShared> mMixerStreams[AAudioMixer::kMaxStreamsPerPass];
+    std::unique_lock<std::mutex> mMixerLocks[AAudioMixer::kMaxStreamsPerPass];
+    int32_t                  mNumMixerInputs = 0;
 };
 
 } /* namespace aaudio */
@@ -29,9 +29,11 @@
 namespace aaudio {
 
 // Determine the placement of the counters and data in shared memory.
+// The counters are written by different processes so keep them on separate cache lines.
+// The client gets these offsets from the RingBufferParcelable.
 #define SHARED_RINGBUFFER_READ_OFFSET   0
-#define SHARED_RINGBUFFER_WRITE_OFFSET  sizeof(fifo_counter_t)
-#define SHARED_RINGBUFFER_DATA_OFFSET   (SHARED_RINGBUFFER_WRITE_OFFSET + sizeof(fifo_counter_t))
+#define SHARED_RINGBUFFER_WRITE_OFFSET  android::kFifoCounterAlignment
+#define SHARED_RINGBUFFER_DATA_OFFSET   (2 * android::kFifoCounterAlignment)
 
 /**
  * Atomic FIFO that uses shared memory.